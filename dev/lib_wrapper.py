@@ -1,5 +1,5 @@
 from typing import List, NamedTuple
-from ctypes import CDLL, c_double, c_int
+from ctypes import CDLL, c_char_p, c_double, c_int
 from numpy import ndarray, ctypeslib, empty, double, int32, zeros
 from numpy.linalg import norm
 
@@ -65,7 +65,8 @@ def solve(type: int,
           tailGrid: ndarray,
           tailVertices: ndarray,
           tailFaces: ndarray,
-          delta: ndarray, A: ndarray, B: ndarray, Psi: ndarray, Ctau1: ndarray, Ctau2: ndarray) -> List[ndarray]:
+          delta: ndarray, A: ndarray, B: ndarray, Psi: ndarray, Ctau1: ndarray, Ctau2: ndarray,
+          closureTable: str = None) -> List[ndarray]:
     
     # Calculated parameters
     nf = facesAreas.size
@@ -216,6 +217,12 @@ def solve(type: int,
 
     lib.solve.restype = None
 
+    # Laminar closures lookup table
+    if closureTable is not None:
+        lib.loadClosureTable.argtypes = [c_char_p]
+        lib.loadClosureTable.restype = c_int
+        lib.loadClosureTable(closureTable.encode())
+
     # Solve linear system
     lib.solve(type,
               nv,
@@ -286,4 +293,21 @@ def solve(type: int,
 
     verticesParams = VerticesParams(doublet_v, sigma_v, cp_v, velField_v, velNorm_v, transpiration_v, delta_v, A_v, B_v, Psi_v, Ctau1_v, Ctau2_v, tauWall_v)
     
-    return [facesParams, verticesParams]
\ No newline at end of file
+    return [facesParams, verticesParams]
+
+def generateClosureTable(path: str,
+                         nA: int = 36, nB: int = 21, nPsi: int = 21, nMach: int = 7,
+                         rangeA: List[float] = [-1.0, 6.0],
+                         rangeB: List[float] = [-1.0, 1.0],
+                         rangePsi: List[float] = [-1.0, 1.0],
+                         rangeMach: List[float] = [0.0, 0.6]) -> bool:
+    """Writes the laminar closures lookup table used by solve(closureTable=path)"""
+
+    lib = CDLL('./bin/libsolver.so')
+
+    lib.generateClosureTable.argtypes = [c_char_p, c_int, c_int, c_int, c_int] + 8 * [c_double]
+    lib.generateClosureTable.restype = c_int
+
+    return lib.generateClosureTable(path.encode(), nA, nB, nPsi, nMach,
+                                    rangeA[0], rangeA[1], rangeB[0], rangeB[1],
+                                    rangePsi[0], rangePsi[1], rangeMach[0], rangeMach[1]) == 1
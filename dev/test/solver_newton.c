@@ -3,8 +3,16 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <lapacke.h>
 
+#include "../../validation/utils/bin/modules/helpers/meshTopology.h"
+#include "../../validation/utils/bin/modules/helpers/arena.h"
+
 /*
 #####################################################
     CONSTANTS
@@ -16,6 +24,11 @@ const double FACTOR = 1 / (4 * PI);
 const int LAYERS = 300;
 const double CTAU_CRIT = 1e-1;
 const int LAMINAR_FLOW = 0;
+const double BL_TOLERANCE = 1e-8;
+const double LINE_SEARCH_MIN_STEP = 5e-2;
+const double PTC_INITIAL_SHIFT = 1.0;
+const double PTC_MIN_SHIFT = 1e-6;
+const double PTC_MAX_SHIFT = 1e6;
 
 /*
 #####################################################
@@ -53,6 +66,7 @@ struct ProfileParameters
     double *S;
     double *T;
     double *R;
+    struct Arena *arena; // scratch for the profile integrands
 };
 
 struct FreestreamParameters
@@ -88,6 +102,10 @@ struct IntegralThicknessParameters
     double C_f_2;
     double theta_11;
     double theta_22;
+    double delta_tau_11;
+    double delta_tau_12;
+    double delta_tau_21;
+    double delta_tau_22;
 };
 
 struct IntegralDefectParameters
@@ -278,188 +296,111 @@ void integrate_trap(int n,
 void calculateVerticesConnection(int nv,
                                  int nf,
                                  double *vertices,
-                                 int *faces,
+                                 struct MeshTopology *topology,
                                  struct VerticeConnection *connection)
 {
 
     /* Parameters */
-    int i, j, k, n, faceLine, verticeLine1, verticeLine2, verticeLine3;
+    int i, k, n, halfEdge, verticeLine1, verticeLine2, verticeLine3;
     int *facesIds;
     double *angles;
     struct Point point1, point2;
-    double angle;
     double sum;
 
     /* Initialize */
-    facesIds = (int *)malloc(50 * sizeof(int));
-    angles = (double *)malloc(50 * sizeof(double));
+    facesIds = (int *)malloc(3 * nf * sizeof(int));
+    angles = (double *)malloc(3 * nf * sizeof(double));
 
     /* Loop over vertices */
     for (i = 0; i < nv; i++)
     {
 
-        // Reset the number of faces and angles
-        n = 0;
+        n = vertexStarSize(topology, i);
         sum = 0.0;
 
-        /* Loop over faces */
-        for (j = 0; j < nf; j++)
-        {
-
-            faceLine = j * 3;
-
-            /* Check if the face contain the vertice */
-            if ((faces[faceLine] == i) || (faces[faceLine + 1] == i) || (faces[faceLine + 2] == i))
-            {
+        connection[i].n = n;
+        connection[i].faces = &facesIds[topology->vertexOffsets[i]];
+        connection[i].coeffs = &angles[topology->vertexOffsets[i]];
 
-                /* Calculate the angle */
-                if (faces[faceLine] == i)
-                {
-                    verticeLine1 = 3 * faces[faceLine];
-                    verticeLine2 = 3 * faces[faceLine + 1];
-                    verticeLine3 = 3 * faces[faceLine + 2];
-                }
-                else if (faces[faceLine + 1] == i)
-                {
-                    verticeLine3 = 3 * faces[faceLine];
-                    verticeLine1 = 3 * faces[faceLine + 1];
-                    verticeLine2 = 3 * faces[faceLine + 2];
-                }
-                else
-                {
-                    verticeLine2 = 3 * faces[faceLine];
-                    verticeLine3 = 3 * faces[faceLine + 1];
-                    verticeLine1 = 3 * faces[faceLine + 2];
-                }
+        /* Angle at the vertex of each face of the star */
+        for (k = 0; k < n; k++)
+        {
 
-                point1.x = vertices[verticeLine2] - vertices[verticeLine1];
-                point1.y = vertices[verticeLine2 + 1] - vertices[verticeLine1 + 1];
-                point1.z = vertices[verticeLine2 + 2] - vertices[verticeLine1 + 2];
+            halfEdge = topology->vertexHalfEdges[topology->vertexOffsets[i] + k];
 
-                point2.x = vertices[verticeLine3] - vertices[verticeLine1];
-                point2.y = vertices[verticeLine3 + 1] - vertices[verticeLine1 + 1];
-                point2.z = vertices[verticeLine3 + 2] - vertices[verticeLine1 + 2];
+            verticeLine1 = 3 * halfEdgeOrigin(topology, halfEdge);
+            verticeLine2 = 3 * halfEdgeTarget(topology, halfEdge);
+            verticeLine3 = 3 * halfEdgeOrigin(topology, halfEdgePrev(halfEdge));
 
-                angle = angleBetweenVectors(point1, point2);
+            point1.x = vertices[verticeLine2] - vertices[verticeLine1];
+            point1.y = vertices[verticeLine2 + 1] - vertices[verticeLine1 + 1];
+            point1.z = vertices[verticeLine2 + 2] - vertices[verticeLine1 + 2];
 
-                /* Increase the number of faces and save the angle */
-                angles[n] = angle;
-                facesIds[n] = j;
-                sum = sum + angle;
+            point2.x = vertices[verticeLine3] - vertices[verticeLine1];
+            point2.y = vertices[verticeLine3 + 1] - vertices[verticeLine1 + 1];
+            point2.z = vertices[verticeLine3 + 2] - vertices[verticeLine1 + 2];
 
-                // Increase the number of faces
-                n++;
-            }
+            connection[i].faces[k] = halfEdgeFace(halfEdge);
+            connection[i].coeffs[k] = angleBetweenVectors(point1, point2);
+            sum = sum + connection[i].coeffs[k];
         }
 
-        /* Save the number of faces, faces id's and angles in connection */
-        connection[i].n = n;
-        connection[i].coeffs = (double *)malloc(n * sizeof(double));
-        connection[i].faces = (int *)malloc(n * sizeof(int));
-
-        for (k = 0; k < n; k++)
-        {
-            connection[i].coeffs[k] = angles[k] / sum;
-            connection[i].faces[k] = facesIds[k];
-        }
+        for (k = 0; k < n; k++) connection[i].coeffs[k] = connection[i].coeffs[k] / sum;
     }
-
-    free(facesIds);
-    free(angles);
 }
 
-void calculateFacesConnection(int nv,
-                              int nf,
-                              int *faces,
-                              struct VerticeConnection *verticesConnection,
+void calculateFacesConnection(int nf,
+                              struct MeshTopology *topology,
                               struct FacesConnection *facesConnection)
+/*
+    Faces sharing at least one vertex with each face, taken from the
+    stars of its three vertices.
+*/
 {
 
     /* Parameters */
-    int i, j, k;
-    int check;
-    int index;
-    int *connectedFaces;
-    int n;
+    int i, j, k, l, n, face;
+    int *mark;
 
     /* Initialize */
-    connectedFaces = (int *)malloc(50 * sizeof(int));
+    mark = (int *)malloc(nf * sizeof(int));
+
+    for (i = 0; i < nf; i++) mark[i] = -1;
 
     for (i = 0; i < nf; i++)
     {
 
-        n = 0;
-
-        // First index
-        index = faces[3 * i];
-
-        for (j = 0; j < verticesConnection[index].n; j++)
-        {
-            if (verticesConnection[index].faces[j] != i)
-            {
-                connectedFaces[n] = verticesConnection[index].faces[j];
-                n = n + 1;
-            }
-        }
-
-        // Second index
-        index = faces[3 * i + 1];
-
-        for (j = 0; j < verticesConnection[index].n; j++)
+        /* Count, then fill */
+        for (l = 0; l < 2; l++)
         {
 
-            check = 0;
+            n = 0;
 
-            for (k = 0; k < n; k++)
+            for (j = 0; j < 3; j++)
             {
-                if (connectedFaces[k] == verticesConnection[index].faces[j])
+                for (k = 0; k < vertexStarSize(topology, topology->faces[3 * i + j]); k++)
                 {
-                    check = 1;
-                    break;
-                }
-            }
-
-            if ((verticesConnection[index].faces[j] != i) && (check == 0))
-            {
-                connectedFaces[n] = verticesConnection[index].faces[j];
-                n = n + 1;
-            }
-        }
-
-        // Second index
-        index = faces[3 * i + 2];
-
-        for (j = 0; j < verticesConnection[index].n; j++)
-        {
 
-            check = 0;
+                    face = vertexStarFace(topology, topology->faces[3 * i + j], k);
 
-            for (k = 0; k < n; k++)
-            {
-                if (connectedFaces[k] == verticesConnection[index].faces[j])
-                {
-                    check = 1;
-                    break;
+                    if ((face != i) && (mark[face] != 2 * i + l))
+                    {
+                        mark[face] = 2 * i + l;
+                        if (l == 1) facesConnection[i].faces[n] = face;
+                        n = n + 1;
+                    }
                 }
             }
 
-            if ((verticesConnection[index].faces[j] != i) && (check == 0))
+            if (l == 0)
             {
-                connectedFaces[n] = verticesConnection[index].faces[j];
-                n = n + 1;
+                facesConnection[i].n = n;
+                facesConnection[i].faces = (int *)malloc(n * sizeof(int));
             }
         }
-
-        facesConnection[i].n = n;
-        facesConnection[i].faces = (int *)malloc(n * sizeof(int));
-
-        for (j = 0; j < n; j++)
-        {
-            facesConnection[i].faces[j] = connectedFaces[j];
-        }
     }
 
-    free(connectedFaces);
+    free(mark);
 }
 
 void calculateVerticesValues(int nv,
@@ -1061,9 +1002,7 @@ void doubletFunc(struct Point p,
 
         double u, v, w;
 
-        double *vel1 = (double *)malloc(3 * sizeof(double *));
-        double *vel2 = (double *)malloc(3 * sizeof(double *));
-        double *vel3 = (double *)malloc(3 * sizeof(double *));
+        double vel1[3], vel2[3], vel3[3];
 
         lineFunc(p, p1, p2, vel1);
         lineFunc(p, p2, p3, vel2);
@@ -1076,10 +1015,6 @@ void doubletFunc(struct Point p,
         vel[0] = u * e1.x + v * e2.x + w * e3.x;
         vel[1] = u * e1.y + v * e2.y + w * e3.y;
         vel[2] = u * e1.z + v * e2.z + w * e3.z;
-
-        free(vel1);
-        free(vel2);
-        free(vel3);
     }
 }
 
@@ -1213,12 +1148,12 @@ void createLinearSystem(int n,
             sourceFunc(pLocal, p1Local, p2Local, p3Local, e1jPoint, e2jPoint, e3jPoint, facesAreas[j], facesMaxDistance[j], sourceVel);
             doubletFunc(pLocal, p1Local, p2Local, p3Local, e1jPoint, e2jPoint, e3jPoint, facesAreas[j], facesMaxDistance[j], doubletVel);
 
-            matrix[i * n + j] = doubletVel[0] * e3iPoint.x + doubletVel[1] * e3iPoint.y + doubletVel[2] * e3iPoint.z;
+            matrix[(size_t)i * n + j] = doubletVel[0] * e3iPoint.x + doubletVel[1] * e3iPoint.y + doubletVel[2] * e3iPoint.z;
             array[i] = array[i] - sigma[j] * (sourceVel[0] * e3iPoint.x + sourceVel[1] * e3iPoint.y + sourceVel[2] * e3iPoint.z);
 
-            matrixVelx[i * n + j] = doubletVel[0];
-            matrixVely[i * n + j] = doubletVel[1];
-            matrixVelz[i * n + j] = doubletVel[2];
+            matrixVelx[(size_t)i * n + j] = doubletVel[0];
+            matrixVely[(size_t)i * n + j] = doubletVel[1];
+            matrixVelz[(size_t)i * n + j] = doubletVel[2];
 
             arrayVel[i * 3] = arrayVel[i * 3] + sigma[j] * sourceVel[0];
             arrayVel[i * 3 + 1] = arrayVel[i * 3 + 1] + sigma[j] * sourceVel[1];
@@ -1258,55 +1193,55 @@ void createLinearSystem(int n,
                 if (k == 0)
                 {
 
-                    matrix[i * n + leftWingFaces[k * 2]] = matrix[i * n + leftWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + leftWingFaces[k * 2 + 1]] = matrix[i * n + leftWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[k * 2]] = matrix[(size_t)i * n + leftWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrix[(size_t)i * n + leftWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + leftWingFaces[k * 2]] = matrixVelx[i * n + leftWingFaces[k * 2]] - lineVel[0];
-                    matrixVely[i * n + leftWingFaces[k * 2]] = matrixVely[i * n + leftWingFaces[k * 2]] - lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[k * 2]] = matrixVelz[i * n + leftWingFaces[k * 2]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[k * 2]] = matrixVelx[(size_t)i * n + leftWingFaces[k * 2]] - lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[k * 2]] = matrixVely[(size_t)i * n + leftWingFaces[k * 2]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[k * 2]] = matrixVelz[(size_t)i * n + leftWingFaces[k * 2]] - lineVel[2];
 
-                    matrixVelx[i * n + leftWingFaces[k * 2 + 1]] = matrixVelx[i * n + leftWingFaces[k * 2 + 1]] + lineVel[0];
-                    matrixVely[i * n + leftWingFaces[k * 2 + 1]] = matrixVely[i * n + leftWingFaces[k * 2 + 1]] + lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[k * 2 + 1]] = matrixVelz[i * n + leftWingFaces[k * 2 + 1]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrixVelx[(size_t)i * n + leftWingFaces[k * 2 + 1]] + lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrixVely[(size_t)i * n + leftWingFaces[k * 2 + 1]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrixVelz[(size_t)i * n + leftWingFaces[k * 2 + 1]] + lineVel[2];
                 }
                 else if (k == nSpanLeftWing - 1)
                 {
 
-                    matrix[i * n + leftWingFaces[(k - 1) * 2]] = matrix[i * n + leftWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrix[i * n + leftWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + leftWingFaces[(k - 1) * 2]] = matrixVelx[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + leftWingFaces[(k - 1) * 2]] = matrixVely[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[(k - 1) * 2]] = matrixVelz[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
                 }
                 else
                 {
 
-                    matrix[i * n + leftWingFaces[(k - 1) * 2]] = matrix[i * n + leftWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrix[i * n + leftWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + leftWingFaces[(k - 1) * 2]] = matrixVelx[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + leftWingFaces[(k - 1) * 2]] = matrixVely[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[(k - 1) * 2]] = matrixVelz[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
 
-                    matrix[i * n + leftWingFaces[k * 2]] = matrix[i * n + leftWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + leftWingFaces[k * 2 + 1]] = matrix[i * n + leftWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[k * 2]] = matrix[(size_t)i * n + leftWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrix[(size_t)i * n + leftWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + leftWingFaces[k * 2]] = matrixVelx[i * n + leftWingFaces[k * 2]] - lineVel[0];
-                    matrixVely[i * n + leftWingFaces[k * 2]] = matrixVely[i * n + leftWingFaces[k * 2]] - lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[k * 2]] = matrixVelz[i * n + leftWingFaces[k * 2]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[k * 2]] = matrixVelx[(size_t)i * n + leftWingFaces[k * 2]] - lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[k * 2]] = matrixVely[(size_t)i * n + leftWingFaces[k * 2]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[k * 2]] = matrixVelz[(size_t)i * n + leftWingFaces[k * 2]] - lineVel[2];
 
-                    matrixVelx[i * n + leftWingFaces[k * 2 + 1]] = matrixVelx[i * n + leftWingFaces[k * 2 + 1]] + lineVel[0];
-                    matrixVely[i * n + leftWingFaces[k * 2 + 1]] = matrixVely[i * n + leftWingFaces[k * 2 + 1]] + lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[k * 2 + 1]] = matrixVelz[i * n + leftWingFaces[k * 2 + 1]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrixVelx[(size_t)i * n + leftWingFaces[k * 2 + 1]] + lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrixVely[(size_t)i * n + leftWingFaces[k * 2 + 1]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[k * 2 + 1]] = matrixVelz[(size_t)i * n + leftWingFaces[k * 2 + 1]] + lineVel[2];
 
                     indexLine1 = leftWingGrid[(k - 1) * nWakeLeftWing] * 3;
                     p1Line.x = leftWingVertices[indexLine1];
@@ -1320,16 +1255,16 @@ void createLinearSystem(int n,
 
                     lineFunc(p, p1Line, p2Line, lineVel);
 
-                    matrix[i * n + leftWingFaces[(k - 1) * 2]] = matrix[i * n + leftWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrix[i * n + leftWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + leftWingFaces[(k - 1) * 2]] = matrixVelx[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + leftWingFaces[(k - 1) * 2]] = matrixVely[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[(k - 1) * 2]] = matrixVelz[i * n + leftWingFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + leftWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
                 }
             }
         }
@@ -1356,55 +1291,55 @@ void createLinearSystem(int n,
                 if (k == 0)
                 {
 
-                    matrix[i * n + rightWingFaces[k * 2]] = matrix[i * n + rightWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + rightWingFaces[k * 2 + 1]] = matrix[i * n + rightWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[k * 2]] = matrix[(size_t)i * n + rightWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrix[(size_t)i * n + rightWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + rightWingFaces[k * 2]] = matrixVelx[i * n + rightWingFaces[k * 2]] - lineVel[0];
-                    matrixVely[i * n + rightWingFaces[k * 2]] = matrixVely[i * n + rightWingFaces[k * 2]] - lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[k * 2]] = matrixVelz[i * n + rightWingFaces[k * 2]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[k * 2]] = matrixVelx[(size_t)i * n + rightWingFaces[k * 2]] - lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[k * 2]] = matrixVely[(size_t)i * n + rightWingFaces[k * 2]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[k * 2]] = matrixVelz[(size_t)i * n + rightWingFaces[k * 2]] - lineVel[2];
 
-                    matrixVelx[i * n + rightWingFaces[k * 2 + 1]] = matrixVelx[i * n + rightWingFaces[k * 2 + 1]] + lineVel[0];
-                    matrixVely[i * n + rightWingFaces[k * 2 + 1]] = matrixVely[i * n + rightWingFaces[k * 2 + 1]] + lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[k * 2 + 1]] = matrixVelz[i * n + rightWingFaces[k * 2 + 1]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrixVelx[(size_t)i * n + rightWingFaces[k * 2 + 1]] + lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrixVely[(size_t)i * n + rightWingFaces[k * 2 + 1]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrixVelz[(size_t)i * n + rightWingFaces[k * 2 + 1]] + lineVel[2];
                 }
                 else if (k == nSpanRightWing - 1)
                 {
 
-                    matrix[i * n + rightWingFaces[(k - 1) * 2]] = matrix[i * n + rightWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrix[i * n + rightWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + rightWingFaces[(k - 1) * 2]] = matrixVelx[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + rightWingFaces[(k - 1) * 2]] = matrixVely[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[(k - 1) * 2]] = matrixVelz[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
                 }
                 else
                 {
 
-                    matrix[i * n + rightWingFaces[(k - 1) * 2]] = matrix[i * n + rightWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrix[i * n + rightWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + rightWingFaces[(k - 1) * 2]] = matrixVelx[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + rightWingFaces[(k - 1) * 2]] = matrixVely[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[(k - 1) * 2]] = matrixVelz[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
 
-                    matrix[i * n + rightWingFaces[k * 2]] = matrix[i * n + rightWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + rightWingFaces[k * 2 + 1]] = matrix[i * n + rightWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[k * 2]] = matrix[(size_t)i * n + rightWingFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrix[(size_t)i * n + rightWingFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + rightWingFaces[k * 2]] = matrixVelx[i * n + rightWingFaces[k * 2]] - lineVel[0];
-                    matrixVely[i * n + rightWingFaces[k * 2]] = matrixVely[i * n + rightWingFaces[k * 2]] - lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[k * 2]] = matrixVelz[i * n + rightWingFaces[k * 2]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[k * 2]] = matrixVelx[(size_t)i * n + rightWingFaces[k * 2]] - lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[k * 2]] = matrixVely[(size_t)i * n + rightWingFaces[k * 2]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[k * 2]] = matrixVelz[(size_t)i * n + rightWingFaces[k * 2]] - lineVel[2];
 
-                    matrixVelx[i * n + rightWingFaces[k * 2 + 1]] = matrixVelx[i * n + rightWingFaces[k * 2 + 1]] + lineVel[0];
-                    matrixVely[i * n + rightWingFaces[k * 2 + 1]] = matrixVely[i * n + rightWingFaces[k * 2 + 1]] + lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[k * 2 + 1]] = matrixVelz[i * n + rightWingFaces[k * 2 + 1]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrixVelx[(size_t)i * n + rightWingFaces[k * 2 + 1]] + lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrixVely[(size_t)i * n + rightWingFaces[k * 2 + 1]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[k * 2 + 1]] = matrixVelz[(size_t)i * n + rightWingFaces[k * 2 + 1]] + lineVel[2];
 
                     indexLine1 = rightWingGrid[(k - 1) * nWakeRightWing] * 3;
                     p1Line.x = rightWingVertices[indexLine1];
@@ -1418,16 +1353,16 @@ void createLinearSystem(int n,
 
                     lineFunc(p, p1Line, p2Line, lineVel);
 
-                    matrix[i * n + rightWingFaces[(k - 1) * 2]] = matrix[i * n + rightWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrix[i * n + rightWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + rightWingFaces[(k - 1) * 2]] = matrixVelx[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + rightWingFaces[(k - 1) * 2]] = matrixVely[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[(k - 1) * 2]] = matrixVelz[i * n + rightWingFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + rightWingFaces[(k - 1) * 2 + 1]] - lineVel[2];
                 }
             }
         }
@@ -1454,55 +1389,55 @@ void createLinearSystem(int n,
                 if (k == 0)
                 {
 
-                    matrix[i * n + tailFaces[k * 2]] = matrix[i * n + tailFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + tailFaces[k * 2 + 1]] = matrix[i * n + tailFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[k * 2]] = matrix[(size_t)i * n + tailFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[k * 2 + 1]] = matrix[(size_t)i * n + tailFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + tailFaces[k * 2]] = matrixVelx[i * n + tailFaces[k * 2]] - lineVel[0];
-                    matrixVely[i * n + tailFaces[k * 2]] = matrixVely[i * n + tailFaces[k * 2]] - lineVel[1];
-                    matrixVelz[i * n + tailFaces[k * 2]] = matrixVelz[i * n + tailFaces[k * 2]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[k * 2]] = matrixVelx[(size_t)i * n + tailFaces[k * 2]] - lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[k * 2]] = matrixVely[(size_t)i * n + tailFaces[k * 2]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[k * 2]] = matrixVelz[(size_t)i * n + tailFaces[k * 2]] - lineVel[2];
 
-                    matrixVelx[i * n + tailFaces[k * 2 + 1]] = matrixVelx[i * n + tailFaces[k * 2 + 1]] + lineVel[0];
-                    matrixVely[i * n + tailFaces[k * 2 + 1]] = matrixVely[i * n + tailFaces[k * 2 + 1]] + lineVel[1];
-                    matrixVelz[i * n + tailFaces[k * 2 + 1]] = matrixVelz[i * n + tailFaces[k * 2 + 1]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[k * 2 + 1]] = matrixVelx[(size_t)i * n + tailFaces[k * 2 + 1]] + lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[k * 2 + 1]] = matrixVely[(size_t)i * n + tailFaces[k * 2 + 1]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[k * 2 + 1]] = matrixVelz[(size_t)i * n + tailFaces[k * 2 + 1]] + lineVel[2];
                 }
                 else if (k == nSpanTail - 1)
                 {
 
-                    matrix[i * n + tailFaces[(k - 1) * 2]] = matrix[i * n + tailFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + tailFaces[(k - 1) * 2 + 1]] = matrix[i * n + tailFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrix[(size_t)i * n + tailFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + tailFaces[(k - 1) * 2]] = matrixVelx[i * n + tailFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + tailFaces[(k - 1) * 2]] = matrixVely[i * n + tailFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + tailFaces[(k - 1) * 2]] = matrixVelz[i * n + tailFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[2];
                 }
                 else
                 {
 
-                    matrix[i * n + tailFaces[(k - 1) * 2]] = matrix[i * n + tailFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + tailFaces[(k - 1) * 2 + 1]] = matrix[i * n + tailFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrix[(size_t)i * n + tailFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + tailFaces[(k - 1) * 2]] = matrixVelx[i * n + tailFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + tailFaces[(k - 1) * 2]] = matrixVely[i * n + tailFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + tailFaces[(k - 1) * 2]] = matrixVelz[i * n + tailFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[2];
 
-                    matrix[i * n + tailFaces[k * 2]] = matrix[i * n + tailFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + tailFaces[k * 2 + 1]] = matrix[i * n + tailFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[k * 2]] = matrix[(size_t)i * n + tailFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[k * 2 + 1]] = matrix[(size_t)i * n + tailFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + tailFaces[k * 2]] = matrixVelx[i * n + tailFaces[k * 2]] - lineVel[0];
-                    matrixVely[i * n + tailFaces[k * 2]] = matrixVely[i * n + tailFaces[k * 2]] - lineVel[1];
-                    matrixVelz[i * n + tailFaces[k * 2]] = matrixVelz[i * n + tailFaces[k * 2]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[k * 2]] = matrixVelx[(size_t)i * n + tailFaces[k * 2]] - lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[k * 2]] = matrixVely[(size_t)i * n + tailFaces[k * 2]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[k * 2]] = matrixVelz[(size_t)i * n + tailFaces[k * 2]] - lineVel[2];
 
-                    matrixVelx[i * n + tailFaces[k * 2 + 1]] = matrixVelx[i * n + tailFaces[k * 2 + 1]] + lineVel[0];
-                    matrixVely[i * n + tailFaces[k * 2 + 1]] = matrixVely[i * n + tailFaces[k * 2 + 1]] + lineVel[1];
-                    matrixVelz[i * n + tailFaces[k * 2 + 1]] = matrixVelz[i * n + tailFaces[k * 2 + 1]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[k * 2 + 1]] = matrixVelx[(size_t)i * n + tailFaces[k * 2 + 1]] + lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[k * 2 + 1]] = matrixVely[(size_t)i * n + tailFaces[k * 2 + 1]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[k * 2 + 1]] = matrixVelz[(size_t)i * n + tailFaces[k * 2 + 1]] + lineVel[2];
 
                     indexLine1 = tailGrid[(k - 1) * nWakeTail] * 3;
                     p1Line.x = tailVertices[indexLine1];
@@ -1516,16 +1451,16 @@ void createLinearSystem(int n,
 
                     lineFunc(p, p1Line, p2Line, lineVel);
 
-                    matrix[i * n + tailFaces[(k - 1) * 2]] = matrix[i * n + tailFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                    matrix[i * n + tailFaces[(k - 1) * 2 + 1]] = matrix[i * n + tailFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrix[(size_t)i * n + tailFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+                    matrix[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrix[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
 
-                    matrixVelx[i * n + tailFaces[(k - 1) * 2]] = matrixVelx[i * n + tailFaces[(k - 1) * 2]] + lineVel[0];
-                    matrixVely[i * n + tailFaces[(k - 1) * 2]] = matrixVely[i * n + tailFaces[(k - 1) * 2]] + lineVel[1];
-                    matrixVelz[i * n + tailFaces[(k - 1) * 2]] = matrixVelz[i * n + tailFaces[(k - 1) * 2]] + lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2]] = matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2]] + lineVel[2];
 
-                    matrixVelx[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelx[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                    matrixVely[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVely[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                    matrixVelz[i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelz[i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[2];
+                    matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelx[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[0];
+                    matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVely[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[1];
+                    matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] = matrixVelz[(size_t)i * n + tailFaces[(k - 1) * 2 + 1]] - lineVel[2];
                 }
             }
         }
@@ -1545,11 +1480,12 @@ void calculateDoubletDistribution(int n,
 
     /* Loop parameter */
     int i;
+    size_t k;
 
     /* Copy the input */
-    double *aux = (double *)malloc(n * n * sizeof(double));
-    for (i = 0; i < n * n; i++)
-        aux[i] = A[i];
+    double *aux = (double *)malloc((size_t)n * n * sizeof(double));
+    for (k = 0; k < (size_t)n * n; k++)
+        aux[k] = A[k];
     for (i = 0; i < n; i++)
         sol[i] = b[i] + transpiration[i];
 
@@ -1574,7 +1510,8 @@ void calculateSurfaceParameters(int n,
 {
 
     /* Loop parameter */
-    int i, j, line1, line2, point;
+    int i, j, line1;
+    size_t line2, point;
 
     /* Calculate parameters */
     for (i = 0; i < n; i++)
@@ -1588,7 +1525,7 @@ void calculateSurfaceParameters(int n,
         velz[i] = arrayVel[line1 + 2];
 
         // Current line
-        line2 = i * n;
+        line2 = (size_t)i * n;
 
         for (j = 0; j < n; j++)
         {
@@ -3357,33 +3294,147 @@ void pmgmres_ilu_cr ( int n, int nz_num, int ia[], int ja[], double a[],
 }
 /******************************************************************************/
 
+void mgmres_mf(int n,
+               void (*matvec)(void *, double *, double *),
+               void (*precond)(void *, double *, double *),
+               void *context,
+               double *x,
+               double *rhs,
+               int itr_max,
+               int mr,
+               double tol_rel,
+               struct Arena *arena)
 /*
-    Solves a sparse linear system using least square error
-    in the form ofa compressed sparse row representation.
-
-    Parameters
-    ----------
-    - n = matrix size (length of rhs)
-    - na = entries size (length of a)
-    - a(k) = value of entry [left hand side]
-    - ia(k) = row of entry
-    - ja(k) = column of entry
-    - rhs = right hand side of the equation
-    - x = solution
+    Restarted GMRES with right preconditioning for an operator that is
+    only available through matvec(context, v, w), w = A v. The
+    preconditioner applies w = M^-1 v. Stops when
+    ||rhs - A x|| <= tol_rel * ||rhs||. The workspace, of at most
+    mgmresWorkspace(n, mr) bytes, is taken from the arena.
 */
-void solveSparseSystem(int n,
-                       int na,
-                       double *a,
-                       int *ia,
-                       int *ja,
-                       double *rhs,
-                       double *x) {
-    
-    int mr = 2000;
-    int inter_max = 1;
-
-    mgmres_st(n, na, ia, ja, a, x, rhs, inter_max, mr, 1e-8, 1e-8);
+{
+
+    /* Parameters */
+    int i, j, k, k_copy, itr;
+    double *c, *g, **h, *r, *s, **v, *y, *z, *w;
+    double av, htmp, mu, rho, rho_tol;
+    double delta = 1.0e-03;
+    size_t mark;
+
+    /* Initialize */
+    mark = arenaMark(arena);
+    c = (double *)arenaAlloc(arena, mr * sizeof(double));
+    g = (double *)arenaAlloc(arena, (mr + 1) * sizeof(double));
+    h = arenaMatrix(arena, mr + 1, mr);
+    r = (double *)arenaAlloc(arena, n * sizeof(double));
+    s = (double *)arenaAlloc(arena, mr * sizeof(double));
+    v = arenaMatrix(arena, mr + 1, n);
+    y = (double *)arenaAlloc(arena, (mr + 1) * sizeof(double));
+    z = (double *)arenaAlloc(arena, n * sizeof(double));
+    w = (double *)arenaAlloc(arena, n * sizeof(double));
+
+    rho_tol = tol_rel * sqrt(r8vec_dot(n, rhs, rhs));
+
+    for (itr = 0; itr < itr_max; itr++)
+    {
+
+        /* Residual */
+        matvec(context, x, r);
+        for (i = 0; i < n; i++) r[i] = rhs[i] - r[i];
+
+        rho = sqrt(r8vec_dot(n, r, r));
+
+        if (rho <= rho_tol) break;
+
+        for (i = 0; i < n; i++) v[0][i] = r[i] / rho;
+
+        g[0] = rho;
+        for (i = 1; i < mr + 1; i++) g[i] = 0.0;
+        for (i = 0; i < mr + 1; i++) for (j = 0; j < mr; j++) h[i][j] = 0.0;
+
+        /* Arnoldi */
+        for (k = 0; k < mr; k++)
+        {
+            k_copy = k;
+
+            precond(context, v[k], z);
+            matvec(context, z, v[k + 1]);
+
+            av = sqrt(r8vec_dot(n, v[k + 1], v[k + 1]));
+
+            for (j = 0; j < k + 1; j++)
+            {
+                h[j][k] = r8vec_dot(n, v[k + 1], v[j]);
+                for (i = 0; i < n; i++) v[k + 1][i] = v[k + 1][i] - h[j][k] * v[j][i];
+            }
+
+            h[k + 1][k] = sqrt(r8vec_dot(n, v[k + 1], v[k + 1]));
+
+            if ((av + delta * h[k + 1][k]) == av)
+            {
+                for (j = 0; j < k + 1; j++)
+                {
+                    htmp = r8vec_dot(n, v[k + 1], v[j]);
+                    h[j][k] = h[j][k] + htmp;
+                    for (i = 0; i < n; i++) v[k + 1][i] = v[k + 1][i] - htmp * v[j][i];
+                }
+                h[k + 1][k] = sqrt(r8vec_dot(n, v[k + 1], v[k + 1]));
+            }
+
+            if (h[k + 1][k] != 0.0)
+            {
+                for (i = 0; i < n; i++) v[k + 1][i] = v[k + 1][i] / h[k + 1][k];
+            }
+
+            if (0 < k)
+            {
+                for (i = 0; i < k + 2; i++) y[i] = h[i][k];
+                for (j = 0; j < k; j++) mult_givens(c[j], s[j], j, y);
+                for (i = 0; i < k + 2; i++) h[i][k] = y[i];
+            }
+
+            mu = sqrt(h[k][k] * h[k][k] + h[k + 1][k] * h[k + 1][k]);
+            c[k] = h[k][k] / mu;
+            s[k] = -h[k + 1][k] / mu;
+            h[k][k] = c[k] * h[k][k] - s[k] * h[k + 1][k];
+            h[k + 1][k] = 0.0;
+            mult_givens(c[k], s[k], k, g);
+
+            rho = fabs(g[k + 1]);
+
+            if (rho <= rho_tol) break;
+        }
+
+        /* Update x = x + M^-1 V y */
+        k = k_copy;
+
+        y[k] = g[k] / h[k][k];
+        for (i = k - 1; 0 <= i; i--)
+        {
+            y[i] = g[i];
+            for (j = i + 1; j < k + 1; j++) y[i] = y[i] - h[i][j] * y[j];
+            y[i] = y[i] / h[i][i];
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            z[i] = 0.0;
+            for (j = 0; j < k + 1; j++) z[i] = z[i] + v[j][i] * y[j];
+        }
+
+        precond(context, z, w);
+        for (i = 0; i < n; i++) x[i] = x[i] + w[i];
+
+        if (rho <= rho_tol) break;
+    }
 
+    /* Free arrays */
+    arenaRelease(arena, mark);
+}
+
+size_t mgmresWorkspace(int n, int mr)
+/* Arena bytes taken by mgmres_mf, alignment padding included */
+{
+    return ((size_t)(mr + 1) * (mr + n + 4) + 3 * (size_t)n + 2 * (size_t)mr) * sizeof(double) + 11 * 64;
 }
 
 void calculateProfiles(double delta,
@@ -3419,6 +3470,7 @@ void calculateProfiles(double delta,
     double a, b, c, t;                 // interpolation parameters
     double exp_ratio;                  // expansion ratio
     double eta2, eta3, eta4, eta5;     // power of eta
+    size_t mark;                       // scratch memory mark
 
     /* Initilize */
     if (sqrt(pow(Ctau1, 2) + pow(Ctau2, 2)) > CTAU_CRIT)
@@ -3430,8 +3482,9 @@ void calculateProfiles(double delta,
         flow_type = 0;
     };
     Re_delta = freestream->velocity * freestream->density * delta / freestream->viscosity;
-    u_plus = (double *)malloc(profiles->n * sizeof(double));
-    y_plus = (double *)malloc(profiles->n * sizeof(double));
+    mark = arenaMark(profiles->arena);
+    u_plus = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
+    y_plus = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
     k = 0.41;
     C = 5.0;
     u_min = 5.0;
@@ -3613,8 +3666,7 @@ void calculateProfiles(double delta,
     }
 
     /* Free arrays */
-    free(u_plus);
-    free(y_plus);
+    arenaRelease(profiles->arena, mark);
 }
 
 void calculateIntegralThickness(struct ProfileParameters *profiles,
@@ -3626,9 +3678,11 @@ void calculateIntegralThickness(struct ProfileParameters *profiles,
     /* Parameters */
     int i;
     double *func;
+    size_t mark;
 
     /* Initialize */
-    func = (double *)malloc(profiles->n * sizeof(double));
+    mark = arenaMark(profiles->arena);
+    func = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
 
     /* Calculate integral */
     for (i = 0; i < profiles->n; i++)
@@ -3708,8 +3762,24 @@ void calculateIntegralThickness(struct ProfileParameters *profiles,
     integralThickness->theta_11 = integralThickness->phi_11 - integralThickness->delta_1_line;
     integralThickness->theta_22 = integralThickness->phi_22 - integralThickness->delta_2_line;
 
+    for (i = 0; i < profiles->n; i++)
+        func[i] = profiles->S[i] * profiles->U[i];
+    integrate_trap(profiles->n, profiles->eta, func, &integralThickness->delta_tau_11, delta);
+
+    for (i = 0; i < profiles->n; i++)
+        func[i] = profiles->S[i] * profiles->W[i];
+    integrate_trap(profiles->n, profiles->eta, func, &integralThickness->delta_tau_12, delta);
+
+    for (i = 0; i < profiles->n; i++)
+        func[i] = profiles->T[i] * profiles->U[i];
+    integrate_trap(profiles->n, profiles->eta, func, &integralThickness->delta_tau_21, delta);
+
+    for (i = 0; i < profiles->n; i++)
+        func[i] = profiles->T[i] * profiles->W[i];
+    integrate_trap(profiles->n, profiles->eta, func, &integralThickness->delta_tau_22, delta);
+
     /* Free arrays */
-    free(func);
+    arenaRelease(profiles->arena, mark);
 }
 
 void calculateIntegralDefect(struct ProfileParameters *profiles,
@@ -3783,10 +3853,12 @@ void calculateIntegralDefect(struct ProfileParameters *profiles,
         double D_tau_x;
         double D_tau_y;
 
-        double *P_tau_x_func = (double *)malloc(profiles->n * sizeof(double));
-        double *P_tau_y_func = (double *)malloc(profiles->n * sizeof(double));
-        double *D_tau_x_func = (double *)malloc(profiles->n * sizeof(double));
-        double *D_tau_y_func = (double *)malloc(profiles->n * sizeof(double));
+        size_t mark = arenaMark(profiles->arena);
+
+        double *P_tau_x_func = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
+        double *P_tau_y_func = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
+        double *D_tau_x_func = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
+        double *D_tau_y_func = (double *)arenaAlloc(profiles->arena, profiles->n * sizeof(double));
 
         double tau_x, tau_y;
 
@@ -3810,199 +3882,684 @@ void calculateIntegralDefect(struct ProfileParameters *profiles,
         integralDefect->S_tau_x = 0.30 * (P_tau_x - D_tau_x);
         integralDefect->S_tau_y = 0.30 * (P_tau_y - D_tau_y);
 
-        free(P_tau_x_func);
-        free(P_tau_y_func);
-        free(D_tau_x_func);
-        free(D_tau_y_func);
+        arenaRelease(profiles->arena, mark);
 
     }
 
-    double *K_tau_xx_func = (double *)malloc(profiles->n * sizeof(double));
-    double *K_tau_xy_func = (double *)malloc(profiles->n * sizeof(double));
-    double *K_tau_yx_func = (double *)malloc(profiles->n * sizeof(double));
-    double *K_tau_yy_func = (double *)malloc(profiles->n * sizeof(double));
-
-    double tau_x, tau_y;
-
-    for (int i = 0; i < profiles->n; i++) {
+    /* Shear stress flux, K_tau = rho * q^3 * int(S U) since tau = q^2 * S / R */
+    integralDefect->K_tau_xx = aux_3 * integralThickness->delta_tau_11;
+    integralDefect->K_tau_xy = aux_3 * integralThickness->delta_tau_12;
+    integralDefect->K_tau_yx = aux_3 * integralThickness->delta_tau_21;
+    integralDefect->K_tau_yy = aux_3 * integralThickness->delta_tau_22;
+}
 
-        tau_x = freestream->velocity * freestream->velocity * profiles->S[i] / profiles->R[i];
-        tau_y = freestream->velocity * freestream->velocity * profiles->T[i] / profiles->R[i];
+/*
+#####################################################
+    CLOSURE TABLE
+#####################################################
 
-        K_tau_xx_func[i] = profiles->R[i] * freestream->density * tau_x * freestream->velocity * profiles->U[i];
-        K_tau_xy_func[i] = profiles->R[i] * freestream->density * tau_x * freestream->velocity * profiles->W[i];
-        K_tau_yx_func[i] = profiles->R[i] * freestream->density * tau_y * freestream->velocity * profiles->U[i];
-        K_tau_yy_func[i] = profiles->R[i] * freestream->density * tau_y * freestream->velocity * profiles->W[i];
-    }
+    Laminar closures tabulated over (A, B, Psi, Mach). The profile
+    velocities do not depend on Re_delta, so thicknesses are stored
+    per unit delta and the shear terms (S and T scale with 1 / Re_delta)
+    are stored multiplied by Re_delta. Turbulent faces and points
+    outside the table fall back to the profile integration.
 
-    integrate_trap(profiles->n, profiles->eta, K_tau_xx_func, &integralDefect->K_tau_xx, delta);
-    integrate_trap(profiles->n, profiles->eta, K_tau_xy_func, &integralDefect->K_tau_xy, delta);
-    integrate_trap(profiles->n, profiles->eta, K_tau_yx_func, &integralDefect->K_tau_yx, delta);
-    integrate_trap(profiles->n, profiles->eta, K_tau_yy_func, &integralDefect->K_tau_yy, delta);
+    File layout: struct ClosureTableHeader followed by
+    n[0] * n[1] * n[2] * n[3] * CLOSURE_TABLE_OUTPUTS doubles, with the
+    outputs of a node contiguous and the last dimension varying fastest.
+*/
+#define CLOSURE_TABLE_DIMS 4
+#define CLOSURE_TABLE_OUTPUTS 23
 
-    free(K_tau_xx_func);
-    free(K_tau_xy_func);
-    free(K_tau_yx_func);
-    free(K_tau_yy_func);
-}
+const char CLOSURE_TABLE_MAGIC[8] = "GEOCLTB";
+const int CLOSURE_TABLE_VERSION = 1;
 
-void calculateEquationsParams(double delta,
-                              double A,
-                              double B,
-                              double Psi,
-                              double Ctau1,
-                              double Ctau2,
-                              struct FreestreamParameters *freestream,
-                              struct ProfileParameters *profiles,
-                              struct IntegralThicknessParameters *integralThickness,
-                              struct IntegralDefectParameters *integralDefect,
-                              struct EquationsParameters *params)
+struct ClosureTableHeader
 {
+    char magic[8];                   // file identifier
+    int version;                     // file version
+    int nDims;                       // number of inputs
+    int nOutputs;                    // number of outputs per node
+    int layers;                      // profile layers used to generate the table
+    int n[CLOSURE_TABLE_DIMS];       // nodes per dimension
+    double min[CLOSURE_TABLE_DIMS];  // lower bound of each dimension
+    double max[CLOSURE_TABLE_DIMS];  // upper bound of each dimension
+};
 
-    /* Profiles */
-    calculateProfiles(delta, A, B, Psi, Ctau1, Ctau2, freestream, profiles);
+struct ClosureTable
+{
+    struct ClosureTableHeader *header;
+    double *values;
+    size_t size;
+};
 
-    /* Integral thickness */
-    calculateIntegralThickness(profiles, integralThickness, delta, Psi);
+struct ClosureTable closureTable = {NULL, NULL, 0};
 
-    /* Integral defect */
-    calculateIntegralDefect(profiles, integralThickness, freestream, integralDefect, delta, A, B, Ctau1, Ctau2);
+void freeClosureTable()
+{
+    if (closureTable.header != NULL) munmap(closureTable.header, closureTable.size);
 
-    /* Assing params */
-    params->D = integralDefect->D;
-    params->D_o = integralDefect->D_o;
-    params->D_x = integralDefect->D_x;
-    params->E_x = integralDefect->E_x;
-    params->E_y = integralDefect->E_y;
-    params->J_xx = integralDefect->J_xx;
-    params->J_xy = integralDefect->J_xy;
-    params->J_yx = integralDefect->J_yx;
-    params->J_yy = integralDefect->J_yy;
-    params->K_o_x = integralDefect->K_o_x;
-    params->K_o_y = integralDefect->K_o_y;
-    params->K_tau_xx = integralDefect->K_tau_xx;
-    params->K_tau_xy = integralDefect->K_tau_xy;
-    params->K_tau_yx = integralDefect->K_tau_yx;
-    params->K_tau_yy = integralDefect->K_tau_yy;
-    params->M_x = integralDefect->M_x;
-    params->M_y = integralDefect->M_y;
-    params->Q_o_x = integralDefect->Q_o_x;
-    params->Q_o_y = integralDefect->Q_o_y;
-    params->Q_x = integralDefect->Q_x;
-    params->Q_y = integralDefect->Q_y;
-    params->S_tau_x = integralDefect->S_tau_x;
-    params->S_tau_y = integralDefect->S_tau_y;
-    params->tau_w_x = integralDefect->tau_w_x;
-    params->tau_w_y = integralDefect->tau_w_y;
-    params->vel = freestream->velocity;
-    params->density = freestream->density;
+    closureTable.header = NULL;
+    closureTable.values = NULL;
+    closureTable.size = 0;
 }
 
-void calculateDivergents(int face,
-                         int *faces,
-                         struct VerticeConnection *vertices_connection,
-                         struct EquationsParameters *params,
-                         double area,
-                         double *p1, double *p2, double *p3) {
+int loadClosureTable(char *path)
+{
 
     /* Parameters */
-    int k; // Counters
-
-    struct Point point_1, point_2, point_3; // Face corners
-    struct Point v_1, v_2, v_3;             // Face corners values
-    struct Point point_lateral;             // Face edge orthogonal vector
-    int index_1, index_2, index_3;          // Vertices indexes
-
-    /* Initialize */
-    point_1.x = p1[face];
-    point_1.y = p1[face + 1];
-    point_1.z = 0.0;
-    point_2.x = p2[face];
-    point_2.y = p2[face + 1];
-    point_2.z = 0.0;
-    point_3.x = p3[face];
-    point_3.y = p3[face + 1];
-    point_3.z = 0.0;
+    int i;
+    int fd;
+    size_t nodes;
+    struct stat info;
+    struct ClosureTableHeader *header;
 
-    v_1.z = 0.0;
-    v_2.z = 0.0;
-    v_3.z = 0.0;
+    freeClosureTable();
 
-    index_1 = faces[3 * face];
-    index_2 = faces[3 * face + 1];
-    index_3 = faces[3 * face + 2];
+    /* Map file */
+    fd = open(path, O_RDONLY);
 
-    /* Div(M) */
-    v_1.x = 0.0;
-    v_1.y = 0.0;
-    v_2.x = 0.0;
-    v_2.y = 0.0;
-    v_3.x = 0.0;
-    v_3.y = 0.0;
+    if (fd < 0)
+    {
+        printf("    > Closure table %s not found\n", path);
+        return 0;
+    }
 
-    for (k = 0; k < vertices_connection[index_1].n; k++)
+    if ((fstat(fd, &info) != 0) || (info.st_size < (off_t)sizeof(struct ClosureTableHeader)))
     {
-        v_1.x = v_1.x + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].M_x;
-        v_1.y = v_1.y + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].M_y;
+        close(fd);
+        printf("    > Closure table %s is invalid\n", path);
+        return 0;
     }
 
-    for (k = 0; k < vertices_connection[index_2].n; k++)
+    header = (struct ClosureTableHeader *)mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (header == MAP_FAILED)
     {
-        v_2.x = v_2.x + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].M_x;
-        v_2.y = v_2.y + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].M_y;
+        printf("    > Closure table %s could not be mapped\n", path);
+        return 0;
     }
 
-    for (k = 0; k < vertices_connection[index_3].n; k++)
+    /* Check header */
+    nodes = 1;
+    for (i = 0; i < CLOSURE_TABLE_DIMS; i++) nodes = nodes * header->n[i];
+
+    if ((memcmp(header->magic, CLOSURE_TABLE_MAGIC, 8) != 0) ||
+        (header->version != CLOSURE_TABLE_VERSION) ||
+        (header->nDims != CLOSURE_TABLE_DIMS) ||
+        (header->nOutputs != CLOSURE_TABLE_OUTPUTS) ||
+        (header->layers != LAYERS) ||
+        (header->n[0] < 2) || (header->n[1] < 2) || (header->n[2] < 2) || (header->n[3] < 2) ||
+        ((size_t)info.st_size != sizeof(struct ClosureTableHeader) + nodes * CLOSURE_TABLE_OUTPUTS * sizeof(double)))
     {
-        v_3.x = v_3.x + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].M_x;
-        v_3.y = v_3.y + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].M_y;
+        munmap(header, info.st_size);
+        printf("    > Closure table %s does not match the solver version\n", path);
+        return 0;
     }
 
-    calculateDivergence(point_1, point_2, point_3, v_1, v_2, v_3, area, &params[face].div_M);
+    madvise(header, info.st_size, MADV_WILLNEED);
 
-    /* Div(Jx) */
-    v_1.x = 0.0;
-    v_1.y = 0.0;
-    v_2.x = 0.0;
-    v_2.y = 0.0;
-    v_3.x = 0.0;
-    v_3.y = 0.0;
+    closureTable.header = header;
+    closureTable.values = (double *)(header + 1);
+    closureTable.size = info.st_size;
 
-    for (k = 0; k < vertices_connection[index_1].n; k++)
-    {
-        v_1.x = v_1.x + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_xx;
-        v_1.y = v_1.y + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_xy;
-    }
+    return 1;
+}
 
-    for (k = 0; k < vertices_connection[index_2].n; k++)
-    {
-        v_2.x = v_2.x + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].J_xx;
-        v_2.y = v_2.y + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].J_xy;
-    }
+void catmullRomWeights(double t,
+                       double *w,
+                       double *dw)
+{
+    double t2 = t * t;
+    double t3 = t2 * t;
+
+    w[0] = 0.5 * (-t3 + 2 * t2 - t);
+    w[1] = 0.5 * (3 * t3 - 5 * t2 + 2);
+    w[2] = 0.5 * (-3 * t3 + 4 * t2 + t);
+    w[3] = 0.5 * (t3 - t2);
+
+    dw[0] = 0.5 * (-3 * t2 + 4 * t - 1);
+    dw[1] = 0.5 * (9 * t2 - 10 * t);
+    dw[2] = 0.5 * (-9 * t2 + 8 * t + 1);
+    dw[3] = 0.5 * (3 * t2 - 2 * t);
+}
 
-    for (k = 0; k < vertices_connection[index_3].n; k++)
-    {
-        v_3.x = v_3.x + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].J_xx;
-        v_3.y = v_3.y + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].J_xy;
-    }
+int interpolateClosureTable(double *x,
+                            double *out,
+                            double *dout)
+/*
+    Cubic (Catmull-Rom) tensor product interpolation. Returns 0 when
+    there is no table or x is outside its domain. dout, if not NULL,
+    receives d(out[k]) / d(x[d]) at dout[d * CLOSURE_TABLE_OUTPUTS + k].
+*/
+{
 
-    calculateDivergence(point_1, point_2, point_3, v_1, v_2, v_3, area, &params[face].div_J_x);
+    /* Parameters */
+    int d, k, m;
+    int node[CLOSURE_TABLE_DIMS][4];
+    int offset;
+    double step;
+    double s;
+    double w[CLOSURE_TABLE_DIMS][4], dw[CLOSURE_TABLE_DIMS][4];
+    double weight, dweight[CLOSURE_TABLE_DIMS];
+    double *value;
+    struct ClosureTableHeader *header = closureTable.header;
 
-    /* Div(Jy) */
-    v_1.x = 0.0;
-    v_1.y = 0.0;
-    v_2.x = 0.0;
-    v_2.y = 0.0;
-    v_3.x = 0.0;
-    v_3.y = 0.0;
+    if (header == NULL) return 0;
 
-    for (k = 0; k < vertices_connection[index_1].n; k++)
+    /* Stencil and weights along each dimension */
+    for (d = 0; d < CLOSURE_TABLE_DIMS; d++)
     {
-        v_1.x = v_1.x + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_yx;
-        v_1.y = v_1.y + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_yy;
+        if ((x[d] < header->min[d]) || (x[d] > header->max[d])) return 0;
+
+        step = (header->max[d] - header->min[d]) / (header->n[d] - 1);
+        s = (x[d] - header->min[d]) / step;
+        k = (int)s;
+        if (k > header->n[d] - 2) k = header->n[d] - 2;
+
+        catmullRomWeights(s - k, w[d], dw[d]);
+
+        for (m = 0; m < 4; m++)
+        {
+            node[d][m] = k - 1 + m;
+            if (node[d][m] < 0) node[d][m] = 0;
+            if (node[d][m] > header->n[d] - 1) node[d][m] = header->n[d] - 1;
+            dw[d][m] = dw[d][m] / step;
+        }
     }
 
-    for (k = 0; k < vertices_connection[index_2].n; k++)
+    for (k = 0; k < CLOSURE_TABLE_OUTPUTS; k++) out[k] = 0.0;
+    if (dout != NULL) for (k = 0; k < CLOSURE_TABLE_DIMS * CLOSURE_TABLE_OUTPUTS; k++) dout[k] = 0.0;
+
+    /* Sum over the 4^4 stencil */
+    for (m = 0; m < 256; m++)
+    {
+        int i0 = m & 3, i1 = (m >> 2) & 3, i2 = (m >> 4) & 3, i3 = (m >> 6) & 3;
+
+        offset = ((node[0][i0] * header->n[1] + node[1][i1]) * header->n[2] + node[2][i2]) * header->n[3] + node[3][i3];
+        value = &closureTable.values[(size_t)offset * CLOSURE_TABLE_OUTPUTS];
+
+        weight = w[0][i0] * w[1][i1] * w[2][i2] * w[3][i3];
+        for (k = 0; k < CLOSURE_TABLE_OUTPUTS; k++) out[k] = out[k] + weight * value[k];
+
+        if (dout != NULL)
+        {
+            dweight[0] = dw[0][i0] * w[1][i1] * w[2][i2] * w[3][i3];
+            dweight[1] = w[0][i0] * dw[1][i1] * w[2][i2] * w[3][i3];
+            dweight[2] = w[0][i0] * w[1][i1] * dw[2][i2] * w[3][i3];
+            dweight[3] = w[0][i0] * w[1][i1] * w[2][i2] * dw[3][i3];
+
+            for (d = 0; d < CLOSURE_TABLE_DIMS; d++)
+                for (k = 0; k < CLOSURE_TABLE_OUTPUTS; k++)
+                    dout[d * CLOSURE_TABLE_OUTPUTS + k] = dout[d * CLOSURE_TABLE_OUTPUTS + k] + dweight[d] * value[k];
+        }
+    }
+
+    return 1;
+}
+
+void closureTableOutputs(struct IntegralThicknessParameters *integralThickness,
+                         double *out)
+{
+    out[0] = integralThickness->delta_1_ast;
+    out[1] = integralThickness->delta_2_ast;
+    out[2] = integralThickness->phi_11;
+    out[3] = integralThickness->phi_12;
+    out[4] = integralThickness->phi_22;
+    out[5] = integralThickness->phi_1_ast;
+    out[6] = integralThickness->phi_2_ast;
+    out[7] = integralThickness->delta_1_line;
+    out[8] = integralThickness->delta_2_line;
+    out[9] = integralThickness->delta_q_o;
+    out[10] = integralThickness->theta_1_o;
+    out[11] = integralThickness->theta_2_o;
+    out[12] = integralThickness->delta_1_o;
+    out[13] = integralThickness->delta_2_o;
+    out[14] = integralThickness->C_D;
+    out[15] = integralThickness->C_D_x;
+    out[16] = integralThickness->C_D_o;
+    out[17] = integralThickness->C_f_1;
+    out[18] = integralThickness->C_f_2;
+    out[19] = integralThickness->delta_tau_11;
+    out[20] = integralThickness->delta_tau_12;
+    out[21] = integralThickness->delta_tau_21;
+    out[22] = integralThickness->delta_tau_22;
+}
+
+int generateClosureTable(char *path,
+                         int nA, int nB, int nPsi, int nMach,
+                         double minA, double maxA,
+                         double minB, double maxB,
+                         double minPsi, double maxPsi,
+                         double minMach, double maxMach)
+/*
+    Offline generation of the laminar closure table. The profiles are
+    evaluated with delta = 1 and Re_delta = 1, which gives the values
+    per unit delta and the shear terms multiplied by Re_delta. Returns 0
+    if an axis has less than 2 nodes or an empty range.
+*/
+{
+
+    /* Parameters */
+    int i, j, k, l;
+    size_t index;
+    double *values;
+    FILE *file;
+    struct ClosureTableHeader header;
+    struct FreestreamParameters freestream;
+    struct ProfileParameters profiles;
+    struct Arena arena;
+    struct IntegralThicknessParameters integralThickness;
+
+    /* Check axes, the node spacing divides by n - 1 */
+    if ((nA < 2) || (nB < 2) || (nPsi < 2) || (nMach < 2) ||
+        (maxA <= minA) || (maxB <= minB) || (maxPsi <= minPsi) || (maxMach <= minMach))
+    {
+        printf("    > Closure table: each axis needs at least 2 nodes and max > min\n");
+        return 0;
+    }
+
+    /* Header */
+    memset(&header, 0, sizeof(struct ClosureTableHeader));
+    memcpy(header.magic, CLOSURE_TABLE_MAGIC, 8);
+    header.version = CLOSURE_TABLE_VERSION;
+    header.nDims = CLOSURE_TABLE_DIMS;
+    header.nOutputs = CLOSURE_TABLE_OUTPUTS;
+    header.layers = LAYERS;
+    header.n[0] = nA; header.min[0] = minA; header.max[0] = maxA;
+    header.n[1] = nB; header.min[1] = minB; header.max[1] = maxB;
+    header.n[2] = nPsi; header.min[2] = minPsi; header.max[2] = maxPsi;
+    header.n[3] = nMach; header.min[3] = minMach; header.max[3] = maxMach;
+
+    /* Initialize */
+    freestream.velocity = 1.0;
+    freestream.density = 1.0;
+    freestream.viscosity = 1.0;
+
+    profiles.n = LAYERS;
+    profiles.eta = (double *)malloc(LAYERS * sizeof(double));
+    profiles.U = (double *)malloc(LAYERS * sizeof(double));
+    profiles.W = (double *)malloc(LAYERS * sizeof(double));
+    profiles.S = (double *)malloc(LAYERS * sizeof(double));
+    profiles.T = (double *)malloc(LAYERS * sizeof(double));
+    profiles.R = (double *)malloc(LAYERS * sizeof(double));
+    profiles.dU_deta = (double *)malloc(LAYERS * sizeof(double));
+    profiles.dW_deta = (double *)malloc(LAYERS * sizeof(double));
+    profiles.arena = &arena;
+
+    arena = getArena(4 * (LAYERS * sizeof(double) + 64));
+
+    values = (double *)malloc((size_t)nA * nB * nPsi * nMach * CLOSURE_TABLE_OUTPUTS * sizeof(double));
+
+    /* Fill nodes */
+    index = 0;
+
+    for (i = 0; i < nA; i++)
+    {
+        for (j = 0; j < nB; j++)
+        {
+            for (k = 0; k < nPsi; k++)
+            {
+                for (l = 0; l < nMach; l++)
+                {
+
+                    double A = minA + i * (maxA - minA) / (nA - 1);
+                    double B = minB + j * (maxB - minB) / (nB - 1);
+                    double Psi = minPsi + k * (maxPsi - minPsi) / (nPsi - 1);
+
+                    freestream.mach = minMach + l * (maxMach - minMach) / (nMach - 1);
+
+                    calculateProfiles(1.0, A, B, Psi, 0.0, 0.0, &freestream, &profiles);
+                    calculateIntegralThickness(&profiles, &integralThickness, 1.0, Psi);
+                    closureTableOutputs(&integralThickness, &values[index]);
+
+                    index = index + CLOSURE_TABLE_OUTPUTS;
+                }
+            }
+        }
+    }
+
+    /* Write */
+    file = fopen(path, "wb");
+
+    if (file != NULL)
+    {
+        fwrite(&header, sizeof(struct ClosureTableHeader), 1, file);
+        fwrite(values, sizeof(double), index, file);
+        fclose(file);
+    }
+
+    /* Free arrays */
+    free(values);
+    free(profiles.eta);
+    free(profiles.U);
+    free(profiles.W);
+    free(profiles.S);
+    free(profiles.T);
+    free(profiles.R);
+    free(profiles.dU_deta);
+    free(profiles.dW_deta);
+    freeArena(&arena);
+
+    return file != NULL;
+}
+
+void closureTableThickness(double *out,
+                           double thicknessScale,
+                           double shearScale,
+                           double tauScale,
+                           struct IntegralThicknessParameters *integralThickness)
+/*
+    Maps the table outputs to the integral thickness. The map is linear,
+    so it also maps the derivatives of the outputs.
+*/
+{
+    integralThickness->delta_1_ast = thicknessScale * out[0];
+    integralThickness->delta_2_ast = thicknessScale * out[1];
+    integralThickness->phi_11 = thicknessScale * out[2];
+    integralThickness->phi_12 = thicknessScale * out[3];
+    integralThickness->phi_21 = integralThickness->phi_12;
+    integralThickness->phi_22 = thicknessScale * out[4];
+    integralThickness->phi_1_ast = thicknessScale * out[5];
+    integralThickness->phi_2_ast = thicknessScale * out[6];
+    integralThickness->delta_1_line = thicknessScale * out[7];
+    integralThickness->delta_2_line = thicknessScale * out[8];
+    integralThickness->delta_q = integralThickness->phi_11 + integralThickness->phi_22;
+    integralThickness->delta_q_o = thicknessScale * out[9];
+    integralThickness->theta_1_o = thicknessScale * out[10];
+    integralThickness->theta_2_o = thicknessScale * out[11];
+    integralThickness->delta_1_o = thicknessScale * out[12];
+    integralThickness->delta_2_o = thicknessScale * out[13];
+    integralThickness->C_D = shearScale * out[14];
+    integralThickness->C_D_x = shearScale * out[15];
+    integralThickness->C_D_o = shearScale * out[16];
+    integralThickness->C_f_1 = shearScale * out[17];
+    integralThickness->C_f_2 = shearScale * out[18];
+    integralThickness->theta_11 = integralThickness->phi_11 - integralThickness->delta_1_line;
+    integralThickness->theta_22 = integralThickness->phi_22 - integralThickness->delta_2_line;
+    integralThickness->delta_tau_11 = tauScale * out[19];
+    integralThickness->delta_tau_12 = tauScale * out[20];
+    integralThickness->delta_tau_21 = tauScale * out[21];
+    integralThickness->delta_tau_22 = tauScale * out[22];
+}
+
+int lookupIntegralThickness(double delta,
+                            double A,
+                            double B,
+                            double Psi,
+                            double Ctau1,
+                            double Ctau2,
+                            struct FreestreamParameters *freestream,
+                            struct IntegralThicknessParameters *integralThickness,
+                            struct IntegralThicknessParameters *dIntegralThickness)
+/*
+    Fills integralThickness from the closure table. Returns 0 when the
+    direct evaluation must be used instead. dIntegralThickness, if not
+    NULL, receives the derivatives with respect to delta, A, B and Psi.
+*/
+{
+
+    /* Parameters */
+    int d;
+    double x[CLOSURE_TABLE_DIMS];
+    double out[CLOSURE_TABLE_OUTPUTS];
+    double dout[CLOSURE_TABLE_DIMS * CLOSURE_TABLE_OUTPUTS];
+    double Re_delta;
+
+    if (closureTable.header == NULL) return 0;
+    if (sqrt(pow(Ctau1, 2) + pow(Ctau2, 2)) > CTAU_CRIT) return 0;
+
+    Re_delta = freestream->velocity * freestream->density * delta / freestream->viscosity;
+    if (Re_delta <= 0.0) return 0;
+
+    x[0] = A;
+    x[1] = B;
+    x[2] = Psi;
+    x[3] = freestream->mach;
+
+    if (interpolateClosureTable(x, out, dIntegralThickness == NULL ? NULL : dout) == 0) return 0;
+
+    /* Thickness scale with delta and shear terms with 1 / Re_delta */
+    closureTableThickness(out, delta, 1 / Re_delta, delta / Re_delta, integralThickness);
+
+    if (dIntegralThickness != NULL)
+    {
+        /* Re_delta is proportional to delta, so delta_tau does not depend on it */
+        closureTableThickness(out, 1.0, - 1 / (Re_delta * delta), 0.0, &dIntegralThickness[0]);
+
+        for (d = 0; d < 3; d++)
+            closureTableThickness(&dout[d * CLOSURE_TABLE_OUTPUTS], delta, 1 / Re_delta, delta / Re_delta, &dIntegralThickness[d + 1]);
+    }
+
+    return 1;
+}
+
+void assignEquationsParams(struct FreestreamParameters *freestream,
+                           struct IntegralDefectParameters *integralDefect,
+                           struct EquationsParameters *params)
+{
+    params->D = integralDefect->D;
+    params->D_o = integralDefect->D_o;
+    params->D_x = integralDefect->D_x;
+    params->E_x = integralDefect->E_x;
+    params->E_y = integralDefect->E_y;
+    params->J_xx = integralDefect->J_xx;
+    params->J_xy = integralDefect->J_xy;
+    params->J_yx = integralDefect->J_yx;
+    params->J_yy = integralDefect->J_yy;
+    params->K_o_x = integralDefect->K_o_x;
+    params->K_o_y = integralDefect->K_o_y;
+    params->K_tau_xx = integralDefect->K_tau_xx;
+    params->K_tau_xy = integralDefect->K_tau_xy;
+    params->K_tau_yx = integralDefect->K_tau_yx;
+    params->K_tau_yy = integralDefect->K_tau_yy;
+    params->M_x = integralDefect->M_x;
+    params->M_y = integralDefect->M_y;
+    params->Q_o_x = integralDefect->Q_o_x;
+    params->Q_o_y = integralDefect->Q_o_y;
+    params->Q_x = integralDefect->Q_x;
+    params->Q_y = integralDefect->Q_y;
+    params->S_tau_x = integralDefect->S_tau_x;
+    params->S_tau_y = integralDefect->S_tau_y;
+    params->tau_w_x = integralDefect->tau_w_x;
+    params->tau_w_y = integralDefect->tau_w_y;
+    params->vel = freestream->velocity;
+    params->density = freestream->density;
+}
+
+void calculateEquationsParams(double delta,
+                              double A,
+                              double B,
+                              double Psi,
+                              double Ctau1,
+                              double Ctau2,
+                              struct FreestreamParameters *freestream,
+                              struct ProfileParameters *profiles,
+                              struct IntegralThicknessParameters *integralThickness,
+                              struct IntegralDefectParameters *integralDefect,
+                              struct EquationsParameters *params)
+{
+
+    /* Integral thickness from the closure table or from the profiles */
+    if (lookupIntegralThickness(delta, A, B, Psi, Ctau1, Ctau2, freestream, integralThickness, NULL) == 0)
+    {
+        calculateProfiles(delta, A, B, Psi, Ctau1, Ctau2, freestream, profiles);
+        calculateIntegralThickness(profiles, integralThickness, delta, Psi);
+    }
+
+    /* Integral defect */
+    calculateIntegralDefect(profiles, integralThickness, freestream, integralDefect, delta, A, B, Ctau1, Ctau2);
+
+    /* Assing params */
+    assignEquationsParams(freestream, integralDefect, params);
+}
+
+int calculateTableEquationsParams(double *x,
+                                  double *steps,
+                                  struct FreestreamParameters *freestream,
+                                  struct ProfileParameters *profiles,
+                                  struct IntegralThicknessParameters *integralThickness,
+                                  struct IntegralDefectParameters *integralDefect,
+                                  struct EquationsParameters *params,
+                                  struct EquationsParameters **params_eps,
+                                  int face)
+/*
+    Params of a face, x = (delta, A, B, Psi, Ctau1, Ctau2), and the params
+    with x[k] + steps[k] for the Jacobian, from a single closure table
+    lookup. The integral thickness of the perturbed states follows from
+    the table derivatives, so they never cross to the profile integration
+    near the table edge. Returns 0, with nothing assigned, when the face
+    or its Ctau steps are not laminar table hits.
+*/
+{
+
+    /* Parameters */
+    int k, l;
+    int n = sizeof(struct IntegralThicknessParameters) / sizeof(double);
+    double y[6];
+    double *value, *value_eps, *dvalue;
+    struct IntegralThicknessParameters dIntegralThickness[4];
+    struct IntegralThicknessParameters integralThickness_eps;
+
+    /* The Ctau steps must stay on the laminar branch of S_tau */
+    if (sqrt(pow(x[4] + steps[4], 2) + pow(x[5], 2)) > CTAU_CRIT) return 0;
+    if (sqrt(pow(x[4], 2) + pow(x[5] + steps[5], 2)) > CTAU_CRIT) return 0;
+
+    if (lookupIntegralThickness(x[0], x[1], x[2], x[3], x[4], x[5], freestream, integralThickness, dIntegralThickness) == 0) return 0;
+
+    calculateIntegralDefect(profiles, integralThickness, freestream, integralDefect, x[0], x[1], x[2], x[4], x[5]);
+    assignEquationsParams(freestream, integralDefect, &params[face]);
+
+    /* Perturbed states */
+    value = (double *)integralThickness;
+    value_eps = (double *)&integralThickness_eps;
+
+    for (k = 0; k < 6; k++) {
+
+        for (l = 0; l < 6; l++) y[l] = x[l];
+        y[k] = y[k] + steps[k];
+
+        /* delta, A, B and Psi move the thickness, Ctau only S_tau */
+        if (k < 4) {
+            dvalue = (double *)&dIntegralThickness[k];
+            for (l = 0; l < n; l++) value_eps[l] = value[l] + steps[k] * dvalue[l];
+        } else {
+            integralThickness_eps = *integralThickness;
+        }
+
+        calculateIntegralDefect(profiles, &integralThickness_eps, freestream, integralDefect, y[0], y[1], y[2], y[4], y[5]);
+        assignEquationsParams(freestream, integralDefect, &params_eps[k][face]);
+    }
+
+    return 1;
+}
+
+void calculateDivergents(int face,
+                         int *faces,
+                         struct VerticeConnection *vertices_connection,
+                         struct EquationsParameters *params,
+                         double area,
+                         double *p1, double *p2, double *p3) {
+
+    /* Parameters */
+    int k; // Counters
+
+    struct Point point_1, point_2, point_3; // Face corners
+    struct Point v_1, v_2, v_3;             // Face corners values
+    struct Point point_lateral;             // Face edge orthogonal vector
+    int index_1, index_2, index_3;          // Vertices indexes
+
+    /* Initialize */
+    point_1.x = p1[2 * face];
+    point_1.y = p1[2 * face + 1];
+    point_1.z = 0.0;
+    point_2.x = p2[2 * face];
+    point_2.y = p2[2 * face + 1];
+    point_2.z = 0.0;
+    point_3.x = p3[2 * face];
+    point_3.y = p3[2 * face + 1];
+    point_3.z = 0.0;
+
+    v_1.z = 0.0;
+    v_2.z = 0.0;
+    v_3.z = 0.0;
+
+    index_1 = faces[3 * face];
+    index_2 = faces[3 * face + 1];
+    index_3 = faces[3 * face + 2];
+
+    /* Div(M) */
+    v_1.x = 0.0;
+    v_1.y = 0.0;
+    v_2.x = 0.0;
+    v_2.y = 0.0;
+    v_3.x = 0.0;
+    v_3.y = 0.0;
+
+    for (k = 0; k < vertices_connection[index_1].n; k++)
+    {
+        v_1.x = v_1.x + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].M_x;
+        v_1.y = v_1.y + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].M_y;
+    }
+
+    for (k = 0; k < vertices_connection[index_2].n; k++)
+    {
+        v_2.x = v_2.x + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].M_x;
+        v_2.y = v_2.y + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].M_y;
+    }
+
+    for (k = 0; k < vertices_connection[index_3].n; k++)
+    {
+        v_3.x = v_3.x + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].M_x;
+        v_3.y = v_3.y + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].M_y;
+    }
+
+    calculateDivergence(point_1, point_2, point_3, v_1, v_2, v_3, area, &params[face].div_M);
+
+    /* Div(Jx) */
+    v_1.x = 0.0;
+    v_1.y = 0.0;
+    v_2.x = 0.0;
+    v_2.y = 0.0;
+    v_3.x = 0.0;
+    v_3.y = 0.0;
+
+    for (k = 0; k < vertices_connection[index_1].n; k++)
+    {
+        v_1.x = v_1.x + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_xx;
+        v_1.y = v_1.y + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_xy;
+    }
+
+    for (k = 0; k < vertices_connection[index_2].n; k++)
+    {
+        v_2.x = v_2.x + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].J_xx;
+        v_2.y = v_2.y + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].J_xy;
+    }
+
+    for (k = 0; k < vertices_connection[index_3].n; k++)
+    {
+        v_3.x = v_3.x + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].J_xx;
+        v_3.y = v_3.y + vertices_connection[index_3].coeffs[k] * params[vertices_connection[index_3].faces[k]].J_xy;
+    }
+
+    calculateDivergence(point_1, point_2, point_3, v_1, v_2, v_3, area, &params[face].div_J_x);
+
+    /* Div(Jy) */
+    v_1.x = 0.0;
+    v_1.y = 0.0;
+    v_2.x = 0.0;
+    v_2.y = 0.0;
+    v_3.x = 0.0;
+    v_3.y = 0.0;
+
+    for (k = 0; k < vertices_connection[index_1].n; k++)
+    {
+        v_1.x = v_1.x + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_yx;
+        v_1.y = v_1.y + vertices_connection[index_1].coeffs[k] * params[vertices_connection[index_1].faces[k]].J_yy;
+    }
+
+    for (k = 0; k < vertices_connection[index_2].n; k++)
     {
         v_2.x = v_2.x + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].J_yx;
         v_2.y = v_2.y + vertices_connection[index_2].coeffs[k] * params[vertices_connection[index_2].faces[k]].J_yy;
@@ -4313,18 +4870,439 @@ void calculateObjectiveFunction(struct EquationsParameters params,
     *kinetic_energy = (params.div_E - params.vel * params.vel * params.div_M - params.density * (params.Q_x * params.grad_q2_x + params.Q_y * params.grad_q2_y) - 2 * params.D) / (params.density * params.vel * params.vel * params.vel);
     *lateral_curvature = (params.div_K_o + (params.E_x * params.grad_phi_x + params.E_y * params.grad_phi_y) + 0.5 * params.density * (params.Q_x * params.grad_q2_y - params.Q_y * params.grad_q2_x) - params.density * (params.Q_o_x * params.grad_q2_x + params.Q_o_y * params.grad_q2_y) + params.D_x - 2 * params.D_o) / (params.density * params.vel * params.vel * params.vel);
     *shear_stress_x = (params.div_K_tau_x - params.S_tau_x) / (params.density * params.vel * params.vel);
-    *shear_stress_y = params.div_K_tau_y - params.S_tau_y / (params.density * params.vel * params.vel);
+    *shear_stress_y = (params.div_K_tau_y - params.S_tau_y) / (params.density * params.vel * params.vel);
+}
+
+/*
+#####################################################
+    BLOCK SPARSE MATRIX
+#####################################################
+
+    6x6 block compressed row (BSR) storage for the boundary layer
+    Jacobian. Each face owns one block row with its own block and the
+    blocks of the faces in its stencil, sorted by column. Blocks are
+    stored row major and contiguous, so the fixed size kernels below
+    vectorize with -Ofast.
+*/
+struct BlockSparseMatrix
+{
+    int nb;          // number of block rows
+    int nnzb;        // number of blocks
+    int *row_ptr;    // first block of each row (nb + 1)
+    int *col_ind;    // block column of each block
+    int *diag;       // diagonal block of each row
+    double *values;  // 36 * nnzb values
+    double *lu;      // 36 * nnzb block ILU(0) factors, diagonal blocks inverted
+};
+
+void invertBlock(double *block)
+/*
+    In place inverse of a 6x6 row major block using Gauss-Jordan with
+    partial pivoting. A singular block is replaced by the identity.
+*/
+{
+
+    int i, j, k, pivot;
+    int perm[6];
+    double aux, max;
+    double lu[36];
+
+    for (i = 0; i < 36; i++) lu[i] = block[i];
+    for (i = 0; i < 6; i++) perm[i] = i;
+
+    for (k = 0; k < 6; k++)
+    {
+
+        /* Pivot */
+        pivot = k;
+        max = absValue(lu[6 * k + k]);
+        for (i = k + 1; i < 6; i++)
+        {
+            if (absValue(lu[6 * i + k]) > max)
+            {
+                max = absValue(lu[6 * i + k]);
+                pivot = i;
+            }
+        }
+
+        if (max < 1e-300)
+        {
+            for (i = 0; i < 36; i++) block[i] = (i % 7 == 0) ? 1.0 : 0.0;
+            return;
+        }
+
+        if (pivot != k)
+        {
+            for (j = 0; j < 6; j++)
+            {
+                aux = lu[6 * k + j];
+                lu[6 * k + j] = lu[6 * pivot + j];
+                lu[6 * pivot + j] = aux;
+            }
+            i = perm[k];
+            perm[k] = perm[pivot];
+            perm[pivot] = i;
+        }
+
+        /* Eliminate */
+        aux = 1.0 / lu[6 * k + k];
+        lu[6 * k + k] = 1.0;
+        for (j = 0; j < 6; j++) lu[6 * k + j] = lu[6 * k + j] * aux;
+
+        for (i = 0; i < 6; i++)
+        {
+            if (i == k) continue;
+            aux = lu[6 * i + k];
+            lu[6 * i + k] = 0.0;
+            for (j = 0; j < 6; j++) lu[6 * i + j] = lu[6 * i + j] - aux * lu[6 * k + j];
+        }
+    }
+
+    /* Undo the row permutation on the columns of the inverse */
+    for (i = 0; i < 6; i++)
+        for (j = 0; j < 6; j++)
+            block[6 * i + perm[j]] = lu[6 * i + j];
+}
+
+void blockMultAdd(const double *restrict a,
+                  const double *restrict x,
+                  double *restrict y,
+                  double sign)
+/* y = y + sign * a x */
+{
+    int k, l;
+    double w[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+    for (l = 0; l < 6; l++)
+        for (k = 0; k < 6; k++)
+            w[k] = w[k] + a[6 * k + l] * x[l];
+
+    for (k = 0; k < 6; k++) y[k] = y[k] + sign * w[k];
+}
+
+void blockMultBlock(const double *restrict a,
+                    const double *restrict b,
+                    double *restrict c)
+/* c = c - a b */
+{
+    int i, j, k;
+
+    for (i = 0; i < 6; i++)
+        for (k = 0; k < 6; k++)
+            for (j = 0; j < 6; j++)
+                c[6 * i + j] = c[6 * i + j] - a[6 * i + k] * b[6 * k + j];
+}
+
+struct BlockSparseMatrix createBlockSparseMatrix(int nf,
+                                                 struct FacesConnection *faces_connection)
+/*
+    Sparsity pattern of the boundary layer Jacobian, computed once and
+    reused by every Newton iteration.
+*/
+{
+
+    /* Parameters */
+    int i, j, k, m, aux;
+    struct BlockSparseMatrix matrix;
+
+    matrix.nb = nf;
+    matrix.row_ptr = (int *)malloc((nf + 1) * sizeof(int));
+
+    matrix.row_ptr[0] = 0;
+    for (i = 0; i < nf; i++) matrix.row_ptr[i + 1] = matrix.row_ptr[i] + 1 + faces_connection[i].n;
+
+    matrix.nnzb = matrix.row_ptr[nf];
+    matrix.col_ind = (int *)malloc(matrix.nnzb * sizeof(int));
+    matrix.diag = (int *)malloc(nf * sizeof(int));
+    matrix.values = (double *)malloc(36 * (size_t)matrix.nnzb * sizeof(double));
+    matrix.lu = (double *)malloc(36 * (size_t)matrix.nnzb * sizeof(double));
+
+    for (i = 0; i < nf; i++)
+    {
+
+        /* Columns, sorted with insertion sort */
+        k = matrix.row_ptr[i];
+        matrix.col_ind[k] = i;
+        for (j = 0; j < faces_connection[i].n; j++) matrix.col_ind[k + 1 + j] = faces_connection[i].faces[j];
+
+        for (j = k + 1; j < matrix.row_ptr[i + 1]; j++)
+        {
+            aux = matrix.col_ind[j];
+            m = j;
+            while ((m > k) && (matrix.col_ind[m - 1] > aux))
+            {
+                matrix.col_ind[m] = matrix.col_ind[m - 1];
+                m--;
+            }
+            matrix.col_ind[m] = aux;
+        }
+
+        for (j = k; j < matrix.row_ptr[i + 1]; j++)
+            if (matrix.col_ind[j] == i) matrix.diag[i] = j;
+    }
+
+    return matrix;
+}
+
+void freeBlockSparseMatrix(struct BlockSparseMatrix *matrix)
+{
+    free(matrix->row_ptr);
+    free(matrix->col_ind);
+    free(matrix->diag);
+    free(matrix->values);
+    free(matrix->lu);
+}
+
+double *blockSparseBlock(struct BlockSparseMatrix *matrix,
+                         int row,
+                         int col)
+/* Values of block (row, col), found by bisection over the row */
+{
+    int low = matrix->row_ptr[row];
+    int high = matrix->row_ptr[row + 1] - 1;
+    int mid;
+
+    while (low <= high)
+    {
+        mid = (low + high) / 2;
+        if (matrix->col_ind[mid] == col) return &matrix->values[36 * (size_t)mid];
+        if (matrix->col_ind[mid] < col) low = mid + 1;
+        else high = mid - 1;
+    }
+
+    return NULL;
+}
+
+void blockSparseMatvec(void *context,
+                       double *x,
+                       double *y)
+/* y = A x */
+{
+    int i, k;
+    struct BlockSparseMatrix *matrix = (struct BlockSparseMatrix *)context;
+
+    for (i = 0; i < matrix->nb; i++)
+    {
+        for (k = 0; k < 6; k++) y[6 * i + k] = 0.0;
+        for (k = matrix->row_ptr[i]; k < matrix->row_ptr[i + 1]; k++)
+            blockMultAdd(&matrix->values[36 * (size_t)k], &x[6 * matrix->col_ind[k]], &y[6 * i], 1.0);
+    }
+}
+
+void blockILU0(struct BlockSparseMatrix *matrix)
+/*
+    Block incomplete LU factorization without fill-in. L has identity
+    diagonal blocks and U keeps its diagonal blocks inverted.
+*/
+{
+
+    /* Parameters */
+    int i, j, k, m;
+    double *a_ik, *a_kj;
+    double aux[36];
+
+    memcpy(matrix->lu, matrix->values, 36 * (size_t)matrix->nnzb * sizeof(double));
+
+    for (i = 0; i < matrix->nb; i++)
+    {
+
+        for (k = matrix->row_ptr[i]; k < matrix->diag[i]; k++)
+        {
+
+            /* L_ik = A_ik U_kk^-1 */
+            a_ik = &matrix->lu[36 * (size_t)k];
+            for (m = 0; m < 36; m++) aux[m] = a_ik[m];
+            for (m = 0; m < 36; m++) a_ik[m] = 0.0;
+            blockMultBlock(aux, &matrix->lu[36 * (size_t)matrix->diag[matrix->col_ind[k]]], a_ik);
+            for (m = 0; m < 36; m++) a_ik[m] = -a_ik[m];
+
+            /* A_ij = A_ij - L_ik U_kj for the (k, j) blocks in the pattern of row i */
+            m = k + 1;
+            for (j = matrix->diag[matrix->col_ind[k]] + 1; j < matrix->row_ptr[matrix->col_ind[k] + 1]; j++)
+            {
+                while ((m < matrix->row_ptr[i + 1]) && (matrix->col_ind[m] < matrix->col_ind[j])) m++;
+                if (m == matrix->row_ptr[i + 1]) break;
+                if (matrix->col_ind[m] != matrix->col_ind[j]) continue;
+
+                a_kj = &matrix->lu[36 * (size_t)j];
+                blockMultBlock(a_ik, a_kj, &matrix->lu[36 * (size_t)m]);
+            }
+        }
+
+        invertBlock(&matrix->lu[36 * (size_t)matrix->diag[i]]);
+    }
+}
+
+void blockILU0Solve(void *context,
+                    double *b,
+                    double *x)
+/* x = (LU)^-1 b */
+{
+
+    int i, k;
+    double aux[6];
+    struct BlockSparseMatrix *matrix = (struct BlockSparseMatrix *)context;
+
+    /* Forward substitution, L y = b */
+    for (i = 0; i < matrix->nb; i++)
+    {
+        for (k = 0; k < 6; k++) x[6 * i + k] = b[6 * i + k];
+        for (k = matrix->row_ptr[i]; k < matrix->diag[i]; k++)
+            blockMultAdd(&matrix->lu[36 * (size_t)k], &x[6 * matrix->col_ind[k]], &x[6 * i], -1.0);
+    }
+
+    /* Backward substitution, U x = y */
+    for (i = matrix->nb - 1; i >= 0; i--)
+    {
+        for (k = matrix->diag[i] + 1; k < matrix->row_ptr[i + 1]; k++)
+            blockMultAdd(&matrix->lu[36 * (size_t)k], &x[6 * matrix->col_ind[k]], &x[6 * i], -1.0);
+
+        for (k = 0; k < 6; k++) aux[k] = 0.0;
+        blockMultAdd(&matrix->lu[36 * (size_t)matrix->diag[i]], &x[6 * i], aux, 1.0);
+        for (k = 0; k < 6; k++) x[6 * i + k] = aux[k];
+    }
+}
+
+/*
+#####################################################
+    BOUNDARY LAYER SYSTEM
+#####################################################
+*/
+struct BoundaryLayerSystem
+{
+    int nf;
+    int *faces;
+    struct VerticeConnection *vertices_connection;
+    double *facesArea;
+    double *e1, *e2, *e3;
+    double *p1, *p2, *p3;
+    double *transpiration;
+    double *velNorm;
+    double *velx, *vely, *velz;
+    double *mach;
+    double scale[6];                                      // norm_delta, norm_A, ..., norm_Ctau2
+    double *vars[6];                                      // norm_delta_list, norm_A_list, ..., norm_Ctau2_list
+    struct FreestreamParameters *freestream;              // freestream parameters
+    struct ProfileParameters *profiles;                   // profiles work arrays
+    struct IntegralThicknessParameters *integralThickness; // integral thickness work parameters
+    struct IntegralDefectParameters *integralDefect;      // integral defect work parameters
+    struct EquationsParameters *params;                   // perturbed state parameters
+    double *blocks;                                       // inverse of the 6x6 diagonal blocks (Jacobian-free)
+    double *residual;                                     // residual at the current state (Jacobian-free)
+    double *residual_aux;                                 // residual at the perturbed state
+    double *shift;                                        // pseudo-transient diagonal shift
+    double eps;                                           // differentiation step
+};
+
+void calculateFaceResidual(struct BoundaryLayerSystem *system,
+                           struct EquationsParameters *params,
+                           int face,
+                           double *residual)
+/*
+    Residual of the six face equations, given the parameters of the
+    face and of its neighbours.
+*/
+{
+    calculateDivergents(face, system->faces, system->vertices_connection, params, system->facesArea[face], system->p1, system->p2, system->p3);
+    calculateGradients(face, system->faces, system->vertices_connection, params, system->e1, system->e2, system->e3, system->p1, system->p2, system->p3, system->velNorm, system->velx, system->vely, system->velz, system->transpiration);
+    calculateObjectiveFunction(params[face], &residual[0], &residual[1], &residual[2], &residual[3], &residual[4], &residual[5], system->velNorm[face]);
+}
+
+void calculateFacesParams(struct BoundaryLayerSystem *system,
+                          double *increase,
+                          double step,
+                          struct EquationsParameters *params)
+/*
+    Equations parameters of all faces at vars + step * increase
+    (increase may be NULL).
+*/
+{
+
+    int j, k;
+    double x[6];
+
+    for (j = 0; j < system->nf; j++)
+    {
+
+        for (k = 0; k < 6; k++)
+        {
+            x[k] = system->vars[k][j];
+            if (increase != NULL) x[k] = x[k] + step * increase[6 * j + k];
+            x[k] = system->scale[k] * x[k];
+        }
+
+        system->freestream->velocity = system->velNorm[j];
+        system->freestream->mach = system->mach[j];
+
+        calculateEquationsParams(x[0], x[1], x[2], x[3], x[4], x[5], system->freestream, system->profiles, system->integralThickness, system->integralDefect, &params[j]);
+    }
 }
 
-void addSparseValue(double *a, int *ia, int *ja, int *index, double value, int row, int col) {
-    a[*index] = value;
-    ia[*index] = row;
-    ja[*index] = col;
-    *index = *index + 1;
+void calculateResidual(struct BoundaryLayerSystem *system,
+                       double *increase,
+                       double step,
+                       struct EquationsParameters *params,
+                       double *residual)
+{
+
+    int j;
+
+    calculateFacesParams(system, increase, step, params);
+
+    for (j = 0; j < system->nf; j++) calculateFaceResidual(system, params, j, &residual[6 * j]);
+}
+
+void jacobianFreeMatvec(void *context,
+                        double *v,
+                        double *w)
+/*
+    w = (J + diag(shift)) v, with J v ~ (F(x + h v) - F(x)) / h
+*/
+{
+
+    int l;
+    double h, v_norm, x_norm;
+    struct BoundaryLayerSystem *system = (struct BoundaryLayerSystem *)context;
+
+    v_norm = sqrt(r8vec_dot(6 * system->nf, v, v));
+
+    if (v_norm == 0.0)
+    {
+        for (l = 0; l < 6 * system->nf; l++) w[l] = 0.0;
+        return;
+    }
+
+    x_norm = 0.0;
+    for (l = 0; l < 6 * system->nf; l++) x_norm = x_norm + pow(system->vars[l % 6][l / 6], 2);
+
+    h = system->eps * (1.0 + sqrt(x_norm)) / v_norm;
+
+    calculateResidual(system, v, h, system->params, system->residual_aux);
+
+    for (l = 0; l < 6 * system->nf; l++) w[l] = (system->residual_aux[l] - system->residual[l]) / h + system->shift[l] * v[l];
+}
+
+void blockDiagonalPreconditioner(void *context,
+                                 double *v,
+                                 double *w)
+{
+
+    int j, k, l;
+    struct BoundaryLayerSystem *system = (struct BoundaryLayerSystem *)context;
+
+    for (j = 0; j < system->nf; j++)
+    {
+        for (k = 0; k < 6; k++)
+        {
+            w[6 * j + k] = 0.0;
+            for (l = 0; l < 6; l++) w[6 * j + k] = w[6 * j + k] + system->blocks[36 * (size_t)j + 6 * k + l] * v[6 * j + l];
+        }
+    }
 }
 
 void solveBoundaryLayer(int nf,
                         int nv,
+                        struct MeshTopology *topology,
                         struct VerticeConnection *vertices_connection,
                         double *vertices,
                         int *faces,
@@ -4351,10 +5329,11 @@ void solveBoundaryLayer(int nf,
                         double *matrix, double *array,
                         double *matrixVelx, double *matrixVely, double *matrixVelz, double *arrayVel,
                         double *doublet,
-                        double freestreamNorm) {
+                        double freestreamNorm,
+                        int jacobianFree) {
 
     /* Parameters */
-    int i, j, k, l; // loop variables
+    int i, j, k, l, m; // loop variables
     int int_max; // maximum interaction
 
     struct EquationsParameters params_aux;        // aux
@@ -4379,6 +5358,7 @@ void solveBoundaryLayer(int nf,
     double norm_Ctau1;       // value to normalize Ctau1
     double norm_Ctau2;       // value to normalize Ctau2
     double eps;              // small value to calculate derivatives
+    double x[6], steps[6];   // face variables and their differentiation steps
 
     struct FreestreamParameters freestream;               // freestream parameters
     struct ProfileParameters profiles;                    // face profiles
@@ -4387,7 +5367,19 @@ void solveBoundaryLayer(int nf,
 
     struct FacesConnection *faces_connection; // faces connection
 
-    double max_error;      // Maximum error
+    struct BoundaryLayerSystem system;                // residual evaluation context
+    struct EquationsParameters *params_eps[6];        // perturbed parameters of each variable
+    double residual_eps[6];                           // face residual with a perturbed variable
+    double value;                                     // Jacobian entry
+    double *block;                                    // Jacobian block of a neighbour face
+    struct BlockSparseMatrix jacobian;                // block sparse Jacobian
+    struct Arena arena;                               // scratch memory, reset every interaction
+    double residual_norm, residual_norm_old;          // residual norms
+    double residual_norm_aux;                         // residual norm along the Newton direction
+    double step;                                      // line search step
+    double ptc;                                       // pseudo-transient shift relative to the diagonal
+    double forcing;                                   // Eisenstat-Walker forcing term
+
     double max_momentum_x, max_momentum_x_aux;
     double max_momentum_y, max_momentum_y_aux;
     double max_kinetic_energy, max_kinetic_energy_aux;
@@ -4437,14 +5429,17 @@ void solveBoundaryLayer(int nf,
     freestream.viscosity = viscosity;
 
     profiles.n = LAYERS;
-    profiles.eta = (double *)malloc(nf * sizeof(double));
-    profiles.U = (double *)malloc(nf * sizeof(double));
-    profiles.W = (double *)malloc(nf * sizeof(double));
-    profiles.S = (double *)malloc(nf * sizeof(double));
-    profiles.T = (double *)malloc(nf * sizeof(double));
-    profiles.R = (double *)malloc(nf * sizeof(double));
-    profiles.dU_deta = (double *)malloc(nf * sizeof(double));
-    profiles.dW_deta = (double *)malloc(nf * sizeof(double));
+    profiles.eta = (double *)malloc(LAYERS * sizeof(double));
+    profiles.U = (double *)malloc(LAYERS * sizeof(double));
+    profiles.W = (double *)malloc(LAYERS * sizeof(double));
+    profiles.S = (double *)malloc(LAYERS * sizeof(double));
+    profiles.T = (double *)malloc(LAYERS * sizeof(double));
+    profiles.R = (double *)malloc(LAYERS * sizeof(double));
+    profiles.dU_deta = (double *)malloc(LAYERS * sizeof(double));
+    profiles.dW_deta = (double *)malloc(LAYERS * sizeof(double));
+    profiles.arena = &arena;
+
+    arena = getArena(mgmresWorkspace(6 * nf, 50) + 4 * (LAYERS * sizeof(double) + 64));
 
     faces_connection = (struct FacesConnection *)malloc(nf * sizeof(struct FacesConnection));
 
@@ -4456,40 +5451,88 @@ void solveBoundaryLayer(int nf,
     double *grad_shear_stress_x = (double *)malloc(300 * sizeof(double));
     double *grad_shear_stress_y = (double *)malloc(300 * sizeof(double));
 
-    double max_sparse_array;
-
     /* Faces connection */
-    calculateFacesConnection(nv, nf, faces, vertices_connection, faces_connection);
+    calculateFacesConnection(nf, topology, faces_connection);
 
-    double *sparse_a;
-    int *sparse_ia;
-    int *sparse_ja;
     double *sparse_array;
-    int index_sparse;
-
-    int size_sparse_a = 0;
 
-    for (i = 0; i < nf; i++) size_sparse_a = size_sparse_a + 1 + faces_connection[i].n;
-    size_sparse_a = size_sparse_a * 36;
+    /* Jacobian sparsity pattern, reused by all interactions */
+    if (jacobianFree == 0) jacobian = createBlockSparseMatrix(nf, faces_connection);
 
-    sparse_a = (double *)malloc(size_sparse_a * sizeof(double));
-    sparse_ia = (int *)malloc(size_sparse_a * sizeof(int));
-    sparse_ja = (int *)malloc(size_sparse_a * sizeof(int));
     sparse_array = (double *)malloc(nf * 6 * sizeof(double));
     double *increase = (double *)malloc(nf * 6 * sizeof(double));
 
+    /* Residual evaluation context */
+    system.nf = nf;
+    system.faces = faces;
+    system.vertices_connection = vertices_connection;
+    system.facesArea = facesArea;
+    system.e1 = e1; system.e2 = e2; system.e3 = e3;
+    system.p1 = p1; system.p2 = p2; system.p3 = p3;
+    system.transpiration = transpiration;
+    system.velNorm = velNorm;
+    system.velx = velx; system.vely = vely; system.velz = velz;
+    system.mach = mach;
+    system.scale[0] = norm_delta; system.vars[0] = norm_delta_list;
+    system.scale[1] = norm_A; system.vars[1] = norm_A_list;
+    system.scale[2] = norm_B; system.vars[2] = norm_B_list;
+    system.scale[3] = norm_Psi; system.vars[3] = norm_Psi_list;
+    system.scale[4] = norm_Ctau1; system.vars[4] = norm_Ctau1_list;
+    system.scale[5] = norm_Ctau2; system.vars[5] = norm_Ctau2_list;
+    system.freestream = &freestream;
+    system.profiles = &profiles;
+    system.integralThickness = &integralThickness;
+    system.integralDefect = &integralDefect;
+    system.params = NULL;
+    system.blocks = NULL;
+    system.residual = NULL;
+    system.residual_aux = NULL;
+    system.eps = sqrt(1e-16);
+
+    system.params = (struct EquationsParameters *)malloc(nf * sizeof(struct EquationsParameters));
+    system.residual_aux = (double *)malloc(6 * nf * sizeof(double));
+    system.shift = (double *)malloc(6 * nf * sizeof(double));
+
+    if (jacobianFree == 1) {
+        system.blocks = (double *)malloc(36 * (size_t)nf * sizeof(double));
+        system.residual = (double *)malloc(6 * nf * sizeof(double));
+    }
+
+    params_eps[0] = params_delta_eps;
+    params_eps[1] = params_A_eps;
+    params_eps[2] = params_B_eps;
+    params_eps[3] = params_Psi_eps;
+    params_eps[4] = params_Ctau1_eps;
+    params_eps[5] = params_Ctau2_eps;
+
+    residual_norm_old = 0.0;
+    forcing = 0.9;
+    ptc = PTC_INITIAL_SHIFT;
+
     /* Print Interactions */
     printf("\n      Interaction   Momentum x       Momentum y    Kinetic Energy    Lateral Curv.   Shear Stress x   Shear Stress y\n");
 
     /* Interaction loop */
     for (i = 0; i < int_max; i++) {
 
+        arenaReset(&arena);
+
         /* Calculate integrals defect of all faces */
         for (j = 0; j < nf; j++) {
 
             freestream.velocity = velNorm[j];
             freestream.mach = mach[j];
 
+            x[0] = norm_delta * norm_delta_list[j]; steps[0] = norm_delta * eps;
+            x[1] = norm_A * norm_A_list[j]; steps[1] = norm_A * eps;
+            x[2] = norm_B * norm_B_list[j]; steps[2] = norm_B * eps;
+            x[3] = norm_Psi * norm_Psi_list[j]; steps[3] = norm_Psi * eps;
+            x[4] = norm_Ctau1 * norm_Ctau1_list[j]; steps[4] = norm_Ctau1 * eps;
+            x[5] = norm_Ctau2 * norm_Ctau2_list[j]; steps[5] = norm_Ctau2 * eps;
+
+            /* Laminar table hits, perturbed states from the table derivatives */
+            if (calculateTableEquationsParams(x, steps, &freestream, &profiles, &integralThickness, &integralDefect, params, params_eps, j) == 1) continue;
+
             calculateEquationsParams(norm_delta * norm_delta_list[j], norm_A * norm_A_list[j], norm_B * norm_B_list[j], norm_Psi * norm_Psi_list[j], norm_Ctau1 * norm_Ctau1_list[j], norm_Ctau2 * norm_Ctau2_list[j], &freestream, &profiles, &integralThickness, &integralDefect, &params[j]);
             calculateEquationsParams(norm_delta * (norm_delta_list[j] + eps), norm_A * norm_A_list[j], norm_B * norm_B_list[j], norm_Psi * norm_Psi_list[j], norm_Ctau1 * norm_Ctau1_list[j], norm_Ctau2 * norm_Ctau2_list[j], &freestream, &profiles, &integralThickness, &integralDefect, &params_delta_eps[j]);
             calculateEquationsParams(norm_delta * norm_delta_list[j], norm_A * (norm_A_list[j] + eps), norm_B * norm_B_list[j], norm_Psi * norm_Psi_list[j], norm_Ctau1 * norm_Ctau1_list[j], norm_Ctau2 * norm_Ctau2_list[j], &freestream, &profiles, &integralThickness, &integralDefect, &params_A_eps[j]);
@@ -4499,29 +5542,24 @@ void solveBoundaryLayer(int nf,
             calculateEquationsParams(norm_delta * norm_delta_list[j], norm_A * norm_A_list[j], norm_B * norm_B_list[j], norm_Psi * norm_Psi_list[j], norm_Ctau1 * norm_Ctau1_list[j], norm_Ctau2 * (norm_Ctau2_list[j] + eps), &freestream, &profiles, &integralThickness, &integralDefect, &params_Ctau2_eps[j]);
         }
 
-        /* Initial system index */
-        index_sparse = 0;
-
         /* Faces loop */
         for (j = 0; j < nf; j++) {
 
-            /* Calculate reference value */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+            /* Ref. obj. func. */
+            calculateFaceResidual(&system, params, j, residual_eps);
 
             /* Surface shear stress */
             tau_x[j] = params[j].tau_w_x;
             tau_y[j] = params[j].tau_w_y;
 
-            /* Ref. obj. func. */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+            max_momentum_x_aux = absValue(residual_eps[0]);
+            max_momentum_y_aux = absValue(residual_eps[1]);
+            max_kinetic_energy_aux = absValue(residual_eps[2]);
+            max_lateral_curvature_aux = absValue(residual_eps[3]);
+            max_shear_stress_x_aux = absValue(residual_eps[4]);
+            max_shear_stress_y_aux = absValue(residual_eps[5]);
 
-            sparse_array[6 * j] = - max_momentum_x_aux;
-            sparse_array[6 * j + 1] = - max_momentum_y_aux;
-            sparse_array[6 * j + 2] = - max_kinetic_energy_aux;
-            sparse_array[6 * j + 3] = - max_lateral_curvature_aux;
-            sparse_array[6 * j + 4] = - max_shear_stress_x_aux;
-            sparse_array[6 * j + 5] = - max_shear_stress_y_aux;
+            for (l = 0; l < 6; l++) sparse_array[6 * j + l] = - residual_eps[l];
 
             /* Asing error */
             if (j == 0) {
@@ -4543,300 +5581,161 @@ void solveBoundaryLayer(int nf,
             /* Save current face params */
             params_aux = params[j];
 
-            //---------------------------//
-            /*          delta            */
-            //---------------------------//
-            /* Add delta eps params */
-            params[j] = params_delta_eps[j];
-
-            /* Calculate divergent and gradient */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
-
-            /* Obj. func. with delta eps */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
-
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * j); // momentum x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * j); // momentum y
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * j); // kinetic energy
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * j); // lateral curvature
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * j); // shear stress x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * j); // shear stress y
-
-            //---------------------------//
-            /*            A              */
-            //---------------------------//
-            /* Add delta eps params */
-            params[j] = params_A_eps[j];
-
-            /* Calculate divergent and gradient */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
-
-            /* Obj. func. with delta eps */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
-
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * j + 1); // momentum x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * j + 1); // momentum y
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * j + 1); // kinetic energy
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * j + 1); // lateral curvature
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * j + 1); // shear stress x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * j + 1); // shear stress y
-
-            //---------------------------//
-            /*            B              */
-            //---------------------------//
-            /* Add delta eps params */
-            params[j] = params_B_eps[j];
-
-            /* Calculate divergent and gradient */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
-
-            /* Obj. func. with delta eps */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
-
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * j + 2); // momentum x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * j + 2); // momentum y
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * j + 2); // kinetic energy
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * j + 2); // lateral curvature
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * j + 2); // shear stress x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * j + 2); // shear stress y
-
-            //---------------------------//
-            /*           Psi             */
-            //---------------------------//
-            /* Add delta eps params */
-            params[j] = params_Psi_eps[j];
-
-            /* Calculate divergent and gradient */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
-
-            /* Obj. func. with delta eps */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
-
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * j + 3); // momentum x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * j + 3); // momentum y
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * j + 3); // kinetic energy
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * j + 3); // lateral curvature
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * j + 3); // shear stress x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * j + 3); // shear stress y
-
-            //---------------------------//
-            /*          Ctau1            */
-            //---------------------------//
-            /* Add delta eps params */
-            params[j] = params_Ctau1_eps[j];
-
-            /* Calculate divergent and gradient */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
-
-            /* Obj. func. with delta eps */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
-
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * j + 4); // momentum x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * j + 4); // momentum y
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * j + 4); // kinetic energy
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * j + 4); // lateral curvature
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * j + 4); // shear stress x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * j + 4); // shear stress y
-
-            //---------------------------//
-            /*          Ctau2            */
-            //---------------------------//
-            /* Add delta eps params */
-            params[j] = params_Ctau2_eps[j];
-
-            /* Calculate divergent and gradient */
-            calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-            calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
-
-            /* Obj. func. with delta eps */
-            calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
-
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * j + 5); // momentum x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * j + 5); // momentum y
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * j + 5); // kinetic energy
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * j + 5); // lateral curvature
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * j + 5); // shear stress x
-            addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * j + 5); // shear stress y
-
-            params[j] = params_aux;
+            /* Face self derivatives: delta, A, B, Psi, Ctau1, Ctau2 */
+            for (k = 0; k < 6; k++) {
 
-            /* Calculate objective function */
-            for (k = 0; k < faces_connection[j].n; k++) {
+                params[j] = params_eps[k][j];
 
-                /* Save current face params */
-                params_aux = params[faces_connection[j].faces[k]];
+                calculateFaceResidual(&system, params, j, residual_eps);
 
-                //---------------------------//
-                /*          delta            */
-                //---------------------------//
+                for (l = 0; l < 6; l++) {
+                    value = (residual_eps[l] + sparse_array[6 * j + l]) / eps;
+                    if (jacobianFree == 1) {
+                        system.blocks[36 * (size_t)j + 6 * l + k] = value;
+                    } else {
+                        jacobian.values[36 * (size_t)jacobian.diag[j] + 6 * l + k] = value;
+                    }
+                }
+            }
 
-                /* Add delta eps params */
-                params[faces_connection[j].faces[k]] = params_delta_eps[faces_connection[j].faces[k]];
+            params[j] = params_aux;
 
-                /* Calculate divergent and gradient */
-                calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-                calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+            /* The Jacobian-free mode only needs the diagonal blocks */
+            if (jacobianFree == 1) continue;
 
-                /* Obj. func. with delta eps */
-                calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+            /* Neighbour faces derivatives */
+            for (m = 0; m < faces_connection[j].n; m++) {
 
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * faces_connection[j].faces[k]); // momentum x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * faces_connection[j].faces[k]); // momentum y
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * faces_connection[j].faces[k]); // kinetic energy
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * faces_connection[j].faces[k]); // lateral curvature
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * faces_connection[j].faces[k]); // shear stress x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * faces_connection[j].faces[k]); // shear stress y
+                /* Save current face params */
+                params_aux = params[faces_connection[j].faces[m]];
+                block = blockSparseBlock(&jacobian, j, faces_connection[j].faces[m]);
 
-                //---------------------------//
-                /*            A              */
-                //---------------------------//
+                for (k = 0; k < 6; k++) {
 
-                /* Add delta eps params */
-                params[faces_connection[j].faces[k]] = params_A_eps[faces_connection[j].faces[k]];
+                    params[faces_connection[j].faces[m]] = params_eps[k][faces_connection[j].faces[m]];
 
-                /* Calculate divergent and gradient */
-                calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-                calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+                    calculateFaceResidual(&system, params, j, residual_eps);
 
-                /* Obj. func. with delta eps */
-                calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+                    for (l = 0; l < 6; l++) {
+                        block[6 * l + k] = (residual_eps[l] + sparse_array[6 * j + l]) / eps;
+                    }
+                }
 
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * faces_connection[j].faces[k] + 1); // momentum x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * faces_connection[j].faces[k] + 1); // momentum y
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * faces_connection[j].faces[k] + 1); // kinetic energy
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * faces_connection[j].faces[k] + 1); // lateral curvature
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * faces_connection[j].faces[k] + 1); // shear stress x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * faces_connection[j].faces[k] + 1); // shear stress y
+                /* Return to previous params */
+                params[faces_connection[j].faces[m]] = params_aux;
+            }
+        }
 
-                //---------------------------//
-                /*            B              */
-                //---------------------------//
+        /* Print error */
+        if (i < 9) {
+            printf("           %d        %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
+        } else if ((i > 8) && (i < 99)) {
+            printf("           %d       %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
+        } else if ((i > 99) && (i < 999)) {
+            printf("           %d      %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
+        } else {
+            printf("           %d     %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
+        }
 
-                /* Add delta eps params */
-                params[faces_connection[j].faces[k]] = params_B_eps[faces_connection[j].faces[k]];
+        /* Convergence */
+        if ((max_momentum_x < BL_TOLERANCE) && (max_momentum_y < BL_TOLERANCE) && (max_kinetic_energy < BL_TOLERANCE) && (max_lateral_curvature < BL_TOLERANCE) && (max_shear_stress_x < BL_TOLERANCE) && (max_shear_stress_y < BL_TOLERANCE)) {
+            printf("    > Boundary layer converged\n");
+            break;
+        }
 
-                /* Calculate divergent and gradient */
-                calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-                calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+        residual_norm = sqrt(r8vec_dot(6 * nf, sparse_array, sparse_array));
 
-                /* Obj. func. with delta eps */
-                calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+        /*
+            Pseudo-transient continuation. The diagonal blocks get a shift
+            proportional to their row size, with the sign of the diagonal
+            entry. It keeps the system solvable where the laminar closure
+            only sees |Ctau| and the Ctau1 and Ctau2 columns are parallel.
+        */
+        for (j = 0; j < nf; j++) {
 
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * faces_connection[j].faces[k] + 2); // momentum x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * faces_connection[j].faces[k] + 2); // momentum y
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * faces_connection[j].faces[k] + 2); // kinetic energy
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * faces_connection[j].faces[k] + 2); // lateral curvature
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * faces_connection[j].faces[k] + 2); // shear stress x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * faces_connection[j].faces[k] + 2); // shear stress y
+            block = (jacobianFree == 1) ? &system.blocks[36 * (size_t)j] : &jacobian.values[36 * (size_t)jacobian.diag[j]];
 
-                //---------------------------//
-                /*           Psi             */
-                //---------------------------//
+            for (l = 0; l < 6; l++) {
+                value = 0.0;
+                for (k = 0; k < 6; k++) if (absValue(block[6 * l + k]) > value) value = absValue(block[6 * l + k]);
+                system.shift[6 * j + l] = (block[7 * l] < 0.0) ? - ptc * value : ptc * value;
+                block[7 * l] = block[7 * l] + system.shift[6 * j + l];
+            }
 
-                /* Add delta eps params */
-                params[faces_connection[j].faces[k]] = params_Psi_eps[faces_connection[j].faces[k]];
+            if (jacobianFree == 1) invertBlock(block);
+        }
 
-                /* Calculate divergent and gradient */
-                calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-                calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+        /* Solve system */
+        if (jacobianFree == 1) {
+
+            /* Eisenstat-Walker forcing term (choice 2) */
+            if (i > 0) {
+                value = 0.9 * pow(forcing, 0.5 * (1 + sqrt(5.0)));
+                forcing = 0.9 * pow(residual_norm / residual_norm_old, 0.5 * (1 + sqrt(5.0)));
+                if (value > 0.1 && forcing < value) forcing = value;
+                if (forcing > 0.9) forcing = 0.9;
+            }
 
-                /* Obj. func. with delta eps */
-                calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+            residual_norm_old = residual_norm;
 
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * faces_connection[j].faces[k] + 3); // momentum x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * faces_connection[j].faces[k] + 3); // momentum y
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * faces_connection[j].faces[k] + 3); // kinetic energy
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * faces_connection[j].faces[k] + 3); // lateral curvature
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * faces_connection[j].faces[k] + 3); // shear stress x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * faces_connection[j].faces[k] + 3); // shear stress y
+            for (l = 0; l < 6 * nf; l++) {
+                system.residual[l] = - sparse_array[l];
+                increase[l] = 0.0;
+            }
 
-                //---------------------------//
-                /*          Ctau1            */
-                //---------------------------//
+            mgmres_mf(6 * nf, jacobianFreeMatvec, blockDiagonalPreconditioner, &system, increase, sparse_array, 5, 30, forcing, &arena);
 
-                /* Add delta eps params */
-                params[faces_connection[j].faces[k]] = params_Ctau1_eps[faces_connection[j].faces[k]];
+        } else {
 
-                /* Calculate divergent and gradient */
-                calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-                calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+            if (i == 0) for (j = 0; j < 6 * nf; j++) increase[j] = 0.0;
 
-                /* Obj. func. with delta eps */
-                calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+            blockILU0(&jacobian);
 
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * faces_connection[j].faces[k] + 4); // momentum x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * faces_connection[j].faces[k] + 4); // momentum y
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * faces_connection[j].faces[k] + 4); // kinetic energy
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * faces_connection[j].faces[k] + 4); // lateral curvature
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * faces_connection[j].faces[k] + 4); // shear stress x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * faces_connection[j].faces[k] + 4); // shear stress y
+            mgmres_mf(6 * nf, blockSparseMatvec, blockILU0Solve, &jacobian, increase, sparse_array, 20, 50, 1e-8, &arena);
+        }
 
-                //---------------------------//
-                /*          Ctau2            */
-                //---------------------------//
+        /* Backtracking line search on ||F|| (Armijo condition) */
+        step = 1.0;
 
-                /* Add delta eps params */
-                params[faces_connection[j].faces[k]] = params_Ctau2_eps[faces_connection[j].faces[k]];
+        while (1) {
 
-                /* Calculate divergent and gradient */
-                calculateDivergents(j, faces, vertices_connection, params, facesArea[j], p1, p2, p3);
-                calculateGradients(j, faces, vertices_connection, params, e1, e2, e3, p1, p2, p3, velNorm, velx, vely, velz, transpiration);
+            calculateResidual(&system, increase, step, system.params, system.residual_aux);
+            residual_norm_aux = sqrt(r8vec_dot(6 * nf, system.residual_aux, system.residual_aux));
 
-                /* Obj. func. with delta eps */
-                calculateObjectiveFunction(params[j], &max_momentum_x_aux, &max_momentum_y_aux, &max_kinetic_energy_aux, &max_lateral_curvature_aux, &max_shear_stress_x_aux, &max_shear_stress_y_aux, velNorm[j]);
+            if (residual_norm_aux <= (1.0 - 1e-4 * step) * residual_norm) break;
+            if (0.5 * step < LINE_SEARCH_MIN_STEP) break;
 
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_x_aux + sparse_array[6 * j]) / eps, 6 * j, 6 * faces_connection[j].faces[k] + 5); // momentum x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_momentum_y_aux + sparse_array[6 * j + 1]) / eps, 6 * j + 1, 6 * faces_connection[j].faces[k] + 5); // momentum y
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_kinetic_energy_aux + sparse_array[6 * j + 2]) / eps, 6 * j + 2, 6 * faces_connection[j].faces[k] + 5); // kinetic energy
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_lateral_curvature_aux + sparse_array[6 * j + 3]) / eps, 6 * j + 3, 6 * faces_connection[j].faces[k] + 5); // lateral curvature
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_x_aux + sparse_array[6 * j + 4]) / eps, 6 * j + 4, 6 * faces_connection[j].faces[k] + 5); // shear stress x
-                addSparseValue(sparse_a, sparse_ia, sparse_ja, &index_sparse, (max_shear_stress_y_aux + sparse_array[6 * j + 5]) / eps, 6 * j + 5, 6 * faces_connection[j].faces[k] + 5); // shear stress y
+            step = 0.5 * step;
+        }
 
-                /* Return to previous params */
-                params[faces_connection[j].faces[k]] = params_aux;
+        /* Rejected step, retry with a smaller pseudo time step */
+        if ((residual_norm_aux > (1.0 - 1e-4 * step) * residual_norm) || (isfinite(residual_norm_aux) == 0)) {
 
+            if (ptc >= PTC_MAX_SHIFT) {
+                printf("    > Boundary layer line search failed\n");
+                break;
             }
-        }
 
-        /* Solve system */
-        if (i == 0) for (j = 0; j < 6 * nf; j++) increase[j] = 0.0;
+            ptc = 10.0 * ptc;
+            if (ptc > PTC_MAX_SHIFT) ptc = PTC_MAX_SHIFT;
 
-        max_sparse_array = 0.0;
-        for (l = 0; l < 6 * nf; l++) max_sparse_array = max_sparse_array + pow(sparse_array[l], 2);
-        max_sparse_array = sqrt(max_sparse_array);
-        for (l = 0; l < 6 * nf; l++) sparse_array[l] = sparse_array[l] / max_sparse_array;
-        for (l = 0; l < size_sparse_a; l++) sparse_a[l] = sparse_a[l] / max_sparse_array;
-        
-        solveSparseSystem(6 * nf, size_sparse_a, sparse_a, sparse_ia, sparse_ja, sparse_array, increase);
+            continue;
+        }
+
+        /* Switched evolution relaxation of the pseudo time step */
+        ptc = ptc * residual_norm_aux / residual_norm;
+        if (ptc < PTC_MIN_SHIFT) ptc = PTC_MIN_SHIFT;
 
         /* Increase parameters */
         for (j = 0; j < nf; j++) {
-            norm_delta_list[j] = norm_delta_list[j] + 0.1 * increase[6 * j];
-            norm_A_list[j] = norm_A_list[j] + 0.1 * increase[6 * j + 1];
-            norm_B_list[j] = norm_B_list[j] + 0.1 * increase[6 * j + 2];
-            norm_Psi_list[j] = norm_Psi_list[j] + 0.1 * increase[6 * j + 3];
-            norm_Ctau1_list[j] = norm_Ctau1_list[j] + 0.1 * increase[6 * j + 4];
-            norm_Ctau2_list[j] = norm_Ctau2_list[j] + 0.1 * increase[6 * j + 5];
+            norm_delta_list[j] = norm_delta_list[j] + step * increase[6 * j];
+            norm_A_list[j] = norm_A_list[j] + step * increase[6 * j + 1];
+            norm_B_list[j] = norm_B_list[j] + step * increase[6 * j + 2];
+            norm_Psi_list[j] = norm_Psi_list[j] + step * increase[6 * j + 3];
+            norm_Ctau1_list[j] = norm_Ctau1_list[j] + step * increase[6 * j + 4];
+            norm_Ctau2_list[j] = norm_Ctau2_list[j] + step * increase[6 * j + 5];
         }
 
-        /* Print error */
-        if (i < 9) {
-            printf("           %d        %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
-        } else if ((i > 8) && (i < 99)) {
-            printf("           %d       %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
-        } else if ((i > 99) && (i < 999)) {
-            printf("           %d      %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
-        } else {
-            printf("           %d     %.4e       %.4e      %.4e       %.4e      %.4e      %.4e\n", i + 1, max_momentum_x, max_momentum_y, max_kinetic_energy, max_lateral_curvature, max_shear_stress_x, max_shear_stress_y);
-        }
-
-        if (i == 10) break;
-        
         /* Calculate inviscid parameters */
         // if (((i + 1) % 5) == 0) {
         if (i > 3000) {
@@ -4896,6 +5795,8 @@ void solveBoundaryLayer(int nf,
         Ctau2[i] = norm_Ctau2 * norm_Ctau2_list[i];
     }
 
+    printf("    > Scratch memory peak: %.2f MB\n", arena.peak / 1048576.0);
+
     /* Free arrays */
     free(params);
     free(params_delta_eps);
@@ -4922,6 +5823,18 @@ void solveBoundaryLayer(int nf,
     free(profiles.dW_deta);
 
     free(faces_connection);
+
+    if (jacobianFree == 0) freeBlockSparseMatrix(&jacobian);
+    free(sparse_array);
+    free(increase);
+
+    free(system.params);
+    free(system.blocks);
+    free(system.residual);
+    free(system.residual_aux);
+    free(system.shift);
+
+    freeArena(&arena);
 }
 
 /*
@@ -4994,11 +5907,11 @@ void solve(int type,
     double freestreamNorm;
 
     /* Initialize */
-    matrix = (double *)malloc(nf * nf * sizeof(double));
+    matrix = (double *)malloc((size_t)nf * nf * sizeof(double));
     array = (double *)malloc(nf * sizeof(double));
-    matrixVelx = (double *)malloc(nf * nf * sizeof(double));
-    matrixVely = (double *)malloc(nf * nf * sizeof(double));
-    matrixVelz = (double *)malloc(nf * nf * sizeof(double));
+    matrixVelx = (double *)malloc((size_t)nf * nf * sizeof(double));
+    matrixVely = (double *)malloc((size_t)nf * nf * sizeof(double));
+    matrixVelz = (double *)malloc((size_t)nf * nf * sizeof(double));
     arrayVel = (double *)malloc(nf * 3 * sizeof(double));
     freestreamNorm = sqrt(freestream[0] * freestream[0] + freestream[1] * freestream[1] + freestream[2] * freestream[2]);
 
@@ -5018,18 +5931,21 @@ void solve(int type,
     /* Boundary layer parameters */
     double *tau_wall_x, *tau_wall_y;
     struct VerticeConnection *vertices_connection;
+    struct MeshTopology topology;
 
     /* Initialize */
     tau_wall_x = (double *)calloc(nf, sizeof(double));
     tau_wall_y = (double *)calloc(nf, sizeof(double));
     vertices_connection = (struct VerticeConnection *)malloc(nv * sizeof(struct VerticeConnection));
 
-    calculateVerticesConnection(nv, nf, vertices, faces, vertices_connection);
+    topology = getMeshTopology(nv, nf, faces);
+
+    calculateVerticesConnection(nv, nf, vertices, &topology, vertices_connection);
 
-    if (type == 1)
+    if ((type == 1) || (type == 2))
     {
         printf("  - Boundary layer correction\n");
-        solveBoundaryLayer(nf, nv, vertices_connection, vertices, faces, facesCenter, facesAreas, e1, e2, e3, p1, p2, p3, transpiration, delta, A, B, Psi, Ctau1, Ctau2, tau_wall_x, tau_wall_y, velNorm, velx, vely, velz, mach, density, viscosity, cp, sound_speed, matrix, array, matrixVelx, matrixVely, matrixVelz, arrayVel, doublet, freestreamNorm);
+        solveBoundaryLayer(nf, nv, &topology, vertices_connection, vertices, faces, facesCenter, facesAreas, e1, e2, e3, p1, p2, p3, transpiration, delta, A, B, Psi, Ctau1, Ctau2, tau_wall_x, tau_wall_y, velNorm, velx, vely, velz, mach, density, viscosity, cp, sound_speed, matrix, array, matrixVelx, matrixVely, matrixVelz, arrayVel, doublet, freestreamNorm, type == 2);
         printf("\n");
     }
 
@@ -5115,4 +6031,9 @@ void solve(int type,
     free(matrixVely);
     free(matrixVelz);
     free(arrayVel);
+
+    free(vertices_connection[0].faces);
+    free(vertices_connection[0].coeffs);
+    free(vertices_connection);
+    freeMeshTopology(topology);
 }
\ No newline at end of file
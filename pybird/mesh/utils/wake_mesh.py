@@ -1,5 +1,6 @@
 from typing import Callable, List
-from numpy import argwhere, array, asarray, cross, deg2rad, dot, ndarray, allclose, zeros
+from numpy import allclose, arange, argsort, argwhere, array, asarray, bincount, concatenate, cross, cumsum, deg2rad, dot, inf, int64, isclose, maximum, minimum, ndarray, ones, searchsorted, zeros
+from numpy.linalg import norm
 from scipy.spatial.transform import Rotation as R
 
 from pybird.geo.geo import Geo
@@ -8,31 +9,62 @@ from pybird.models.types import Point
 from pybird.geo.utils import bezier, vector, circle
 from pybird.models.wake_model import WakeModel
 
-def _find_vertices(vertices: ndarray, edges: ndarray, faces: ndarray, func: Callable[[Point], bool], pInitial: Point, pFinal: Point) -> List[ndarray]:
+def _build_topology(nv: int, edges: ndarray, faces: ndarray) -> List[ndarray]:
+    """Edges of each vertex (compressed rows) and the two faces of each edge"""
+
+    ne = edges.shape[0]
+
+    # Edges of each vertex
+    ends = concatenate([edges[:, 0], edges[:, 1]])
+    vertexEdges = concatenate([arange(ne), arange(ne)])[argsort(ends, kind='stable')]
+    vertexOffsets = concatenate([[0], cumsum(bincount(ends, minlength=nv))])
+
+    # Edge of each face side, found by its sorted vertex pair
+    edgesKeys = edges.min(axis=1).astype(int64) * nv + edges.max(axis=1)
+    edgesOrder = argsort(edgesKeys)
+
+    sidesA = faces.reshape(-1)
+    sidesB = faces[:, [1, 2, 0]].reshape(-1)
+    sidesKeys = minimum(sidesA, sidesB).astype(int64) * nv + maximum(sidesA, sidesB)
+    sidesEdges = edgesOrder[searchsorted(edgesKeys, sidesKeys, sorter=edgesOrder)]
+
+    # Faces of each edge, in ascending order
+    edgeFaces = -ones((ne, 2), dtype=int)
+    sidesOrder = argsort(sidesEdges, kind='stable')
+    sidesFaces = sidesOrder // 3
+    first = concatenate([[True], sidesEdges[sidesOrder[1:]] != sidesEdges[sidesOrder[:-1]]])
+    edgeFaces[sidesEdges[sidesOrder[first]], 0] = sidesFaces[first]
+    edgeFaces[sidesEdges[sidesOrder[~first]], 1] = sidesFaces[~first]
+
+    return [vertexOffsets, vertexEdges, edgeFaces]
+
+def _find_vertices(vertices: ndarray, edges: ndarray, faces: ndarray, func: Callable[[Point], bool], pInitial: Point, pFinal: Point, topology: List[ndarray] = None) -> List[ndarray]:
     """Find the vertices that are contained in the curve"""
 
+    if topology is None:
+        topology = _build_topology(vertices.shape[0], edges, faces)
+
+    vertexOffsets, vertexEdges, edgeFaces = topology
+
     verticesOut = []
     edgesOut = []
     facesOut = []
+    edgesUsed = set()
 
     # Find the start point tag
-    for i in range(len(vertices[:, 0])):
-        if (allclose(vertices[i, :], pInitial)):
-            pTag = i
-            verticesOut.append(pTag)
-            break
+    pTag = argwhere(isclose(vertices, pInitial).all(axis=1))[0, 0]
+    verticesOut.append(pTag)
 
     # Loop until the last point is reached
     while True:
 
-        # Find edges tags that contain pTag
-        edgesTags = argwhere((edges[:, 0] == pTag) | (edges[:, 1] == pTag))
-        edgesTags = edgesTags.reshape(len(edgesTags))
+        # Edges tags that contain pTag
+        edgesTags = vertexEdges[vertexOffsets[pTag]:vertexOffsets[pTag + 1]]
 
         # Find the correct edge
         d = {"edges": [], "edgesTag": [], "dist": []}
         for i in edgesTags:
-            if i not in edgesOut:
+            if i not in edgesUsed:
                 edge = edges[i, :]
                 auxTag = edge[0] if edge[0] != pTag else edge[1]
                 p = vertices[auxTag, :]
@@ -43,15 +75,13 @@ def _find_vertices(vertices: ndarray, edges: ndarray, faces: ndarray, func: Call
         index = d["dist"].index(min(d["dist"]))
         edge = d["edges"][index]
         edgesOut.append(d["edgesTag"][index])
+        edgesUsed.add(d["edgesTag"][index])
         pNewTag = edge[0] if edge[0] != pTag else edge[1]
 
-        # Find the two faces that contain the correct edge
-        facesTag = argwhere(((faces[:, 0] == pTag) | (faces[:, 1] == pTag) | (faces[:, 2] == pTag)) & ((faces[:, 0] == pNewTag) | (faces[:, 1] == pNewTag) | (faces[:, 2] == pNewTag)))
-
-        # Save the vertices, edge and face
+        # Save the vertices, edge and the two faces that contain it
         pTag = pNewTag
         verticesOut.append(pNewTag)
-        facesOut.append([facesTag[0, 0], facesTag[1, 0]] if facesTag[0, 0] < facesTag[1, 0] else [facesTag[1, 0], facesTag[0, 0]])
+        facesOut.append(list(edgeFaces[d["edgesTag"][index], :]))
 
         # Check if new point is equal pFinal
         if allclose(vertices[pNewTag, :], pFinal):
@@ -116,28 +146,20 @@ def _create_arrays(vertices: ndarray, edges: ndarray, faces: ndarray, facesTags:
     return arrays
 
 def _create_grid(vertices: ndarray, verticesTags: ndarray, verticesArray: ndarray, u: ndarray, nWake: int, ds: float, func: Callable[[float], float]) -> List[ndarray]:
-    
-    nSurf = len(verticesTags)
-    gridTags = zeros((nSurf, nWake))
-    gridVertices = zeros((int(nSurf * nWake), 3))
+    """Wake lines marched together, one row of the grid per step"""
 
-    count = 0
-    for i in range(nSurf):
-
-        for j in range(nWake):
-
-            if j == 0:
-                gridVertices[count, :] = vertices[verticesTags[i], :]
-                gridTags[i, j] = count
-            else:
-                factor = func(ds * j)
-                newVertice = gridVertices[count - 1] + ds * vector.unary(factor * verticesArray[i, :] + (1 - factor) * u)
-                gridVertices[count, :] = newVertice
-                gridTags[i, j] = count
+    nSurf = len(verticesTags)
+    gridVertices = zeros((nSurf, nWake, 3))
+    gridVertices[:, 0, :] = vertices[verticesTags, :]
 
-            count += 1
+    for j in range(1, nWake):
+        factor = func(ds * j)
+        w = factor * verticesArray + (1 - factor) * u
+        lenght = norm(w, axis=1)
+        lenght[lenght < 1e-8] = inf
+        gridVertices[:, j, :] = gridVertices[:, j - 1, :] + ds * w / lenght[:, None]
 
-    return [gridVertices, gridTags.astype(int)]
+    return [gridVertices.reshape(nSurf * nWake, 3), arange(nSurf * nWake).reshape(nSurf, nWake)]
 
 def build_wake(vertices: ndarray, edges: ndarray, faces: ndarray, geo: Geo, wake_dist: float, accom_dist: float, alpha: float, beta: float) -> List[WakeModel]:
 
@@ -186,6 +208,9 @@ def build_wake(vertices: ndarray, edges: ndarray, faces: ndarray, geo: Geo, wake
             d2 = vector.norm(cross(x - geo.p47d, x - geo.p51)) / vector.norm(geo.p51 - geo.p47d)
             return min([d1, d2])
 
+    # Mesh topology, shared by the trailing edges
+    topology = _build_topology(vertices.shape[0], edges, faces)
+
     # Wake parameters
     wake_dist = wake_dist if wake_dist is not None else 30 * (geo.data.wing.h1 + geo.data.wing.h7)
     ds = 5e-2
@@ -210,7 +235,7 @@ def build_wake(vertices: ndarray, edges: ndarray, faces: ndarray, geo: Geo, wake
     n = vector.unary(cross(geo.p13e - geo.p1e, geo.p14e - geo.p1e))
     e1 = vector.unary(geo.p13e - geo.p1e)
     e2 = cross(n, e1)
-    curve_vertices_tags, curve_edges_tags, curve_faces_tags = _find_vertices(vertices, edges, faces, func1, geo.p13e, geo.p7e)
+    curve_vertices_tags, curve_edges_tags, curve_faces_tags = _find_vertices(vertices, edges, faces, func1, geo.p13e, geo.p7e, topology)
     curve_array = _create_arrays(vertices, edges, faces, curve_faces_tags, curve_edges_tags, e1, e2, x, z, alignAll=False)
     grid_vertices_list, grid_vertices_tags = _create_grid(vertices, curve_vertices_tags, curve_array, x, nWake, ds, func0)
     
@@ -223,7 +248,7 @@ def build_wake(vertices: ndarray, edges: ndarray, faces: ndarray, geo: Geo, wake
     n = vector.unary(cross(geo.p13d - geo.p1d, geo.p15d - geo.p1d))
     e1 = vector.unary(geo.p13d - geo.p1d)
     e2 = cross(n, e1)
-    curve_vertices_tags, curve_edges_tags, curve_faces_tags = _find_vertices(vertices, edges, faces, func2, geo.p13d, geo.p7d)
+    curve_vertices_tags, curve_edges_tags, curve_faces_tags = _find_vertices(vertices, edges, faces, func2, geo.p13d, geo.p7d, topology)
     curve_array = _create_arrays(vertices, edges, faces, curve_faces_tags, curve_edges_tags, e1, e2, x, z, alignAll=False)
     grid_vertices_list, grid_vertices_tags = _create_grid(vertices, curve_vertices_tags, curve_array, x, nWake, ds, func0)
     
@@ -234,7 +259,7 @@ def build_wake(vertices: ndarray, edges: ndarray, faces: ndarray, geo: Geo, wake
     )
 
     # Wake
-    curve_vertices_tags, curve_edges_tags, curve_faces_tags = _find_vertices(vertices, edges, faces, func3, geo.p47e, geo.p47d)
+    curve_vertices_tags, curve_edges_tags, curve_faces_tags = _find_vertices(vertices, edges, faces, func3, geo.p47e, geo.p47d, topology)
     curve_array = _create_arrays(vertices, edges, faces, curve_faces_tags, curve_edges_tags, None, None, x, z, alignAll=True)
     grid_vertices_list, grid_vertices_tags = _create_grid(vertices, curve_vertices_tags, curve_array, x, nWake, ds, func0)
     
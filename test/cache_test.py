@@ -0,0 +1,54 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import tempfile
+import numpy as np
+
+from utils.bin.wrapper import SolverContext
+from wake_coupling_test import wing
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    # Not a multiple of the tile size, so the last tiles are padded
+    vertices, faces = wing(13, 5, 2.0)
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    mesh = [vertices, faces, None, None, None, None, empty2, empty3, empty2, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+    freestream = np.array([-1.0, 0.0, 0.05])
+
+    files = []
+
+    with tempfile.TemporaryDirectory() as directory:
+
+        # Each run on its own directory, after other contexts and arrays have left stale data on the heap
+        for k in range(3):
+
+            with SolverContext(*mesh) as context:
+                context.solve(freestream, 1.225, 1.5e-5, 340.0)
+
+            stale = [np.full(65536 * (k + 1), np.nan) for _ in range(8)]
+            del stale
+
+            cacheDirectory = os.path.join(directory, str(k))
+
+            with SolverContext(*mesh, cacheDirectory=cacheDirectory) as context:
+                out = context.solve(freestream, 1.225, 1.5e-5, 340.0)
+
+            names = os.listdir(cacheDirectory)
+            assert len(names) == 1 and names[0].startswith('influence_')
+
+            with open(os.path.join(cacheDirectory, names[0]), 'rb') as f:
+                files.append((names[0], f.read()))
+
+        # Cache hit
+        with SolverContext(*mesh, cacheDirectory=os.path.join(directory, '0')) as context:
+            hit = context.solve(freestream, 1.225, 1.5e-5, 340.0)
+
+    assert faces.shape[0] % 256 != 0
+    assert all(file == files[0] for file in files[1:])
+    assert max(np.abs(a - b).max() for a, b in zip(out, hit) if a is not None) == 0.0
+
+    print('cache: ok')
@@ -0,0 +1,136 @@
+import sys
+sys.path.append('./')
+
+import os
+import ctypes
+import subprocess
+import tempfile
+import numpy as np
+
+# Laminar closure table of the development boundary layer solver (dev/test/solver_newton.c)
+LAYERS = 300
+DIMS, OUTPUTS = 4, 23
+THICKNESS = 27
+
+class ARENA(ctypes.Structure):
+    _fields_ = [('data', ctypes.c_void_p), ('size', ctypes.c_size_t), ('offset', ctypes.c_size_t), ('peak', ctypes.c_size_t), ('heap', ctypes.c_void_p)]
+
+class FREESTREAM(ctypes.Structure):
+    _fields_ = [('velocity', ctypes.c_double), ('density', ctypes.c_double), ('viscosity', ctypes.c_double), ('mach', ctypes.c_double)]
+
+class PROFILES(ctypes.Structure):
+    _fields_ = [('n', ctypes.c_int)] + [(name, ctypes.POINTER(ctypes.c_double)) for name in ['eta', 'U', 'W', 'dU_deta', 'dW_deta', 'S', 'T', 'R']] + [('arena', ctypes.POINTER(ARENA))]
+
+ND_POINTER_DOUBLE = np.ctypeslib.ndpointer(dtype=np.double, ndim=1, flags='C')
+
+def build(folder: str) -> ctypes.CDLL:
+    path = os.path.join(folder, 'solver_newton.so')
+    subprocess.run(['gcc', '-fPIC', '-O2', '-shared', 'dev/test/solver_newton.c', '-o', path, '-llapacke', '-lm'], check=True)
+    lib = ctypes.CDLL(path)
+
+    lib.generateClosureTable.argtypes = [ctypes.c_char_p] + 4 * [ctypes.c_int] + 8 * [ctypes.c_double]
+    lib.generateClosureTable.restype = ctypes.c_int
+    lib.loadClosureTable.argtypes = [ctypes.c_char_p]
+    lib.loadClosureTable.restype = ctypes.c_int
+    lib.interpolateClosureTable.argtypes = [ND_POINTER_DOUBLE, ND_POINTER_DOUBLE, ND_POINTER_DOUBLE]
+    lib.interpolateClosureTable.restype = ctypes.c_int
+    lib.lookupIntegralThickness.argtypes = 6 * [ctypes.c_double] + [ctypes.POINTER(FREESTREAM), ND_POINTER_DOUBLE, ND_POINTER_DOUBLE]
+    lib.lookupIntegralThickness.restype = ctypes.c_int
+    lib.closureTableOutputs.argtypes = [ND_POINTER_DOUBLE, ND_POINTER_DOUBLE]
+    lib.closureTableOutputs.restype = None
+    lib.calculateProfiles.argtypes = 6 * [ctypes.c_double] + [ctypes.POINTER(FREESTREAM), ctypes.POINTER(PROFILES)]
+    lib.calculateProfiles.restype = None
+    lib.calculateIntegralThickness.argtypes = [ctypes.POINTER(PROFILES), ND_POINTER_DOUBLE, ctypes.c_double, ctypes.c_double]
+    lib.calculateIntegralThickness.restype = None
+    lib.getArena.argtypes = [ctypes.c_size_t]
+    lib.getArena.restype = ARENA
+    lib.freeArena.argtypes = [ctypes.POINTER(ARENA)]
+    lib.freeArena.restype = None
+    lib.freeClosureTable.argtypes = []
+    lib.freeClosureTable.restype = None
+
+    return lib
+
+def interpolate(lib: ctypes.CDLL, x: np.ndarray):
+    out, dout = np.empty(OUTPUTS), np.empty(DIMS * OUTPUTS)
+    assert lib.interpolateClosureTable(np.ascontiguousarray(x, dtype=np.double), out, dout) == 1
+    return out, dout.reshape(DIMS, OUTPUTS)
+
+if __name__ == '__main__':
+
+    with tempfile.TemporaryDirectory() as folder:
+
+        lib = build(folder)
+
+        # Table over a small laminar domain
+        lower, upper = np.array([0.0, -0.5, -0.5, 0.0]), np.array([2.0, 0.5, 0.5, 0.4])
+        path = os.path.join(folder, 'closures.bin').encode()
+
+        assert lib.generateClosureTable(path, 17, 9, 9, 9, lower[0], upper[0], lower[1], upper[1], lower[2], upper[2], lower[3], upper[3]) == 1
+        assert lib.loadClosureTable(path) == 1
+
+        # Off-node points, inside the cells of every axis
+        rng = np.random.default_rng(0)
+        points = lower + (upper - lower) * rng.uniform(0.1, 0.9, (20, DIMS))
+
+        # Interpolation against the profile integration
+        arena = lib.getArena(4 * (LAYERS * 8 + 64))
+        buffers = [np.zeros(LAYERS) for _ in range(8)]
+        profiles = PROFILES(LAYERS, *[b.ctypes.data_as(ctypes.POINTER(ctypes.c_double)) for b in buffers], ctypes.pointer(arena))
+
+        error = 0.0
+        for x in points:
+            freestream = FREESTREAM(1.0, 1.0, 1.0, x[3])
+            thickness, direct = np.empty(THICKNESS), np.empty(OUTPUTS)
+            lib.calculateProfiles(1.0, x[0], x[1], x[2], 0.0, 0.0, ctypes.byref(freestream), ctypes.byref(profiles))
+            lib.calculateIntegralThickness(ctypes.byref(profiles), thickness, 1.0, x[2])
+            lib.closureTableOutputs(thickness, direct)
+
+            out, _ = interpolate(lib, x)
+            error = max(error, np.abs(out - direct).max() / np.abs(direct).max())
+
+        lib.freeArena(ctypes.byref(arena))
+
+        print('Table max relative error: {:.1e}'.format(error))
+        assert error < 2e-3
+
+        # Derivatives against central differences of the interpolation
+        h = 1e-6 * (upper - lower)
+        error = 0.0
+        for x in points:
+            out, dout = interpolate(lib, x)
+            for d in range(DIMS):
+                e = np.zeros(DIMS)
+                e[d] = h[d]
+                central = (interpolate(lib, x + e)[0] - interpolate(lib, x - e)[0]) / (2 * h[d])
+                error = max(error, np.abs(dout[d] - central).max() / max(np.abs(central).max(), 1e-12))
+
+        print('Table derivatives max relative error: {:.1e}'.format(error))
+        assert error < 1e-6
+
+        # Integral thickness derivatives of the lookup, with respect to delta, A, B and Psi,
+        # field by field except the round-off ones
+        freestream = FREESTREAM(30.0, 1.2, 1.8e-5, 0.2)
+        state = np.array([2e-3, 1.2, 0.1, -0.2])
+        steps = np.array([1e-9, 1e-6, 1e-6, 1e-6])
+
+        def lookup(y: np.ndarray):
+            value, derivatives = np.empty(THICKNESS), np.empty(4 * THICKNESS)
+            assert lib.lookupIntegralThickness(y[0], y[1], y[2], y[3], 0.0, 0.0, ctypes.byref(freestream), value, derivatives) == 1
+            return value, derivatives.reshape(4, THICKNESS)
+
+        _, derivatives = lookup(state)
+        error = 0.0
+        for d in range(4):
+            e = np.zeros(4)
+            e[d] = steps[d]
+            central = (lookup(state + e)[0] - lookup(state - e)[0]) / (2 * steps[d])
+            fields = np.abs(central) > 1e-4 * np.abs(central).max()
+            error = max(error, (np.abs(derivatives[d] - central)[fields] / np.abs(central)[fields]).max())
+
+        print('Lookup derivatives max relative error: {:.1e}'.format(error))
+        assert error < 1e-5
+
+        lib.freeClosureTable()
+
+    print('closure table: ok')
@@ -0,0 +1,44 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import ctypes
+import tempfile
+import numpy as np
+
+from utils.bin.wrapper import load_lib
+
+if __name__ == '__main__':
+
+    # Above 46341 panels nf * nf overflows a 32 bit int
+    n = 50000
+
+    os.chdir('./validation')
+    lib = load_lib()
+
+    # Synthetic influence matrix in a sparse scratch file
+    entries = [(n - 1, n - 2, 1.5), (46341, n - 1, 2.5), (123, 46400, 3.5), (n - 1, 0, 4.5)]
+
+    with tempfile.TemporaryDirectory() as scratch:
+
+        matrix = lib.getTiledMatrix(n, scratch.encode())
+        assert matrix.data, 'Could not create the scratch matrix'
+        assert matrix.bytes >= n * n * 8
+
+        for i, j, value in entries:
+            matrix.data[lib.tiledMatrixIndex(ctypes.byref(matrix), i, j)] = value
+
+        x = np.zeros(n, dtype=np.double)
+        x[[n - 2, n - 1, 46400, 0]] = [1.0, 10.0, 100.0, 1000.0]
+        y = np.empty(n, dtype=np.double)
+
+        lib.tiledMatrixMatvec(ctypes.byref(matrix), x, y)
+        lib.freeTiledMatrix(ctypes.byref(matrix))
+
+    expected = np.zeros(n, dtype=np.double)
+    for i, j, value in entries:
+        expected[i] += value * x[j]
+
+    print('Max error: {}'.format(np.abs(y - expected).max()))
+    assert np.array_equal(y, expected)
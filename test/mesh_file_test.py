@@ -0,0 +1,103 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import ctypes
+import os
+import tempfile
+import numpy as np
+
+from utils.mesh import MeshData
+from utils.meshfile import write_mesh_file, read_mesh_file
+from utils.bin.wrapper import MESH
+
+class MESH_FILE(ctypes.Structure):
+    _fields_ = [
+        ("data", ctypes.c_void_p),
+        ("bytes", ctypes.c_size_t),
+    ]
+
+def as_array(pointer, shape):
+    return np.ctypeslib.as_array(pointer, shape=shape)
+
+if __name__ == '__main__':
+
+    # Random mesh with a wake
+    nv, nf, nSpan, nWake = 50, 96, 7, 5
+    rng = np.random.default_rng(0)
+
+    mesh = MeshData(
+        vertices=rng.random((nv, 3)),
+        edges=rng.integers(0, nv, (140, 2)),
+        faces=rng.integers(0, nv, (nf, 3)),
+        facesCenter=rng.random((nf, 3)),
+        e1=rng.random((nf, 3)),
+        e2=rng.random((nf, 3)),
+        e3=rng.random((nf, 3)),
+        controlPoints=rng.random((nf, 3)),
+        facesAreas=rng.random(nf),
+        facesMaxDistance=rng.random(nf),
+        p1Local=rng.random((nf, 2)),
+        p2Local=rng.random((nf, 2)),
+        p3Local=rng.random((nf, 2)),
+        wake_vertices=rng.random((nSpan * nWake, 3)),
+        wake_grid=np.arange(nSpan * nWake).reshape((nSpan, nWake)),
+        wake_faces=rng.integers(0, nf, (nSpan - 1, 2)),
+    )
+
+    lib = ctypes.CDLL('./validation/utils/bin/libsolver.so')
+
+    lib.loadMeshFile.argtypes = [ctypes.c_char_p, ctypes.POINTER(MESH_FILE), ctypes.POINTER(MESH)]
+    lib.loadMeshFile.restype = ctypes.c_int
+    lib.freeMeshFile.argtypes = [ctypes.POINTER(MESH_FILE)]
+    lib.freeMeshFile.restype = None
+
+    with tempfile.TemporaryDirectory() as directory:
+
+        path = os.path.join(directory, 'mesh.bin')
+        write_mesh_file(path, mesh)
+
+        # Python reader
+        copy = read_mesh_file(path)
+
+        for name in MeshData.__dataclass_fields__:
+            assert np.array_equal(getattr(mesh, name), getattr(copy, name)), name
+
+        # Native reader
+        file = MESH_FILE()
+        native = MESH()
+
+        assert lib.loadMeshFile(path.encode(), ctypes.byref(file), ctypes.byref(native)) == 1
+
+        surface = native.surface
+        tail = native.wake.tail
+
+        assert (surface.nv, surface.nf) == (nv, nf)
+        assert (tail.nSpan, tail.nWake) == (nSpan, nWake)
+        assert native.wake.left.nSpan == 0 and native.wake.right.nSpan == 0
+
+        assert np.array_equal(as_array(surface.vertices, (nv, 3)), mesh.vertices)
+        assert np.array_equal(as_array(surface.faces, (nf, 3)), mesh.faces)
+        assert np.array_equal(as_array(surface.facesAreas, (nf,)), mesh.facesAreas)
+        assert np.array_equal(as_array(surface.p2, (nf, 2)), mesh.p2Local)
+        assert np.array_equal(as_array(surface.e3, (nf, 3)), mesh.e3)
+        assert np.array_equal(as_array(tail.grid, (nSpan, nWake)), mesh.wake_grid)
+        assert np.array_equal(as_array(tail.vertices, (nSpan * nWake, 3)), mesh.wake_vertices)
+        assert np.array_equal(as_array(tail.faces, (nSpan - 1, 2)), mesh.wake_faces)
+
+        lib.freeMeshFile(ctypes.byref(file))
+
+        # Corrupted data is rejected by both readers
+        with open(path, 'r+b') as f:
+            f.seek(-1, os.SEEK_END)
+            f.write(b'\xff')
+
+        assert lib.loadMeshFile(path.encode(), ctypes.byref(file), ctypes.byref(native)) == 0
+
+        try:
+            read_mesh_file(path)
+            assert False
+        except ValueError:
+            pass
+
+    print('mesh file: ok')
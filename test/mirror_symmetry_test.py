@@ -0,0 +1,85 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.bin.wrapper import SolverContext, get_input, load_lib, unfold_half_model, wake_grid
+from wake_coupling_test import wing
+
+def args(vertices: np.ndarray, faces: np.ndarray, grid: np.ndarray, wakeVertices: np.ndarray, wakeFaces: np.ndarray):
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    return [vertices, faces, None, None, None, None, grid, wakeVertices, wakeFaces, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+
+def relative(a: np.ndarray, b: np.ndarray):
+    return np.abs(a - b).max() / np.abs(b).max()
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    # Half wing from the root at y = 0 to the tip at y = span
+    span, angle = 2.0, np.deg2rad(5.0)
+    direction = np.array([-np.cos(angle), 0.0, np.sin(angle)])
+
+    halfVertices, halfFaces = wing(17, 7, span)
+    halfVertices = halfVertices + [0.0, 0.5 * span, 0.0]
+    nv = halfVertices.shape[0]
+
+    halfWake = wake_grid(halfVertices, halfFaces, np.array([-0.5, span, 0.0]), np.array([-0.5, 0.0, 0.0]), direction, 0.1, 20, 10.0, 0.2)[0]
+
+    # Its mirrored full mesh, the root vertices merged
+    vertices, faces = unfold_half_model(halfVertices, halfFaces)
+    root = np.flatnonzero(np.abs(halfVertices[:, 1]) < 1e-12)
+    merged = np.arange(2 * nv)
+    merged[nv + root] = root
+    keep = np.setdiff1d(np.arange(2 * nv), nv + root)
+    outside = np.abs(halfVertices[:, 1]) >= 1e-12
+    renumbered = np.full(2 * nv, -1)
+    renumbered[keep] = np.arange(keep.shape[0])
+    vertices, faces = vertices[keep], renumbered[merged[faces]].astype(np.int32)
+
+    fullMesh = args(vertices, faces, *wake_grid(vertices, faces, np.array([-0.5, span, 0.0]), np.array([-0.5, -span, 0.0]), direction, 0.1, 20, 10.0, 0.2)[0])
+    halfMesh = args(halfVertices, halfFaces, *halfWake)
+
+    rotation = np.array([0.3, 0.1, -0.2])
+    sideslip = direction + [0.0, 0.1, 0.0]
+
+    with SolverContext(*fullMesh) as full:
+
+        # Half models, symmetric and antisymmetric, against the full mesh in the same onset
+        for sign, freestream, halfRotation in ((1, direction, rotation * [0.0, 1.0, 0.0]), (-1, np.array([0.0, 0.1, 0.0]), rotation * [1.0, 0.0, 1.0])):
+
+            expected = full.solve(freestream, 1.2, 1e-5, 340.0, rotation=halfRotation, reference=1.0)
+            expectedForces = full.forces.copy()
+
+            with SolverContext(*halfMesh) as half:
+                half.set_symmetry(sign)
+                out = half.solve(freestream, 1.2, 1e-5, 340.0, rotation=halfRotation, reference=1.0)
+                forces = half.forces.copy()
+
+            # The root vertices of the half average the faces of their side only
+            errors = [relative(forces, expectedForces)] + [relative(out[k][outside], expected[k][:nv][outside]) for k in (1, 2, 3, 6)]
+            print('Half model {:+d}: {:.1e} (forces) {:.1e} (velocity and doublet)'.format(sign, errors[0], max(errors[1:])))
+            assert max(errors) < 1e-7, sign
+
+        # Full solve in sideslip and rotation against the decomposed one of solve()
+        expected = full.solve(sideslip, 1.2, 1e-5, 340.0, rotation=rotation)
+        expectedForces = full.forces.copy()
+
+    lib = load_lib()
+    input = get_input(*fullMesh, sideslip, 1.2, 1e-5, 340.0)
+    outputs = [np.empty(vertices.shape[0]) for _ in range(6)]
+    forces = np.empty(3)
+
+    input.environment.rot_x, input.environment.rot_y, input.environment.rot_z = rotation
+    assert lib.solve(input, *outputs, forces) == 1
+
+    vel_x, vel_y, vel_z, _, _, doublet = outputs
+    errors = [relative(forces, expectedForces)] + [relative(value, expected[k]) for value, k in ((vel_x, 1), (vel_y, 2), (vel_z, 3), (doublet, 6))]
+
+    print('Decomposed solve: {:.1e} (forces) {:.1e} (velocity and doublet)'.format(errors[0], max(errors[1:])))
+    assert max(errors) < 1e-7
+
+    print('mirror symmetry: ok')
@@ -0,0 +1,37 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.bin.wrapper import panel_frames, surface_velocity
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    # One skewed panel, seen from every direction across facesMaxDistance
+    vertices = np.array([[0.0, 0.0, 0.0], [1.0, 0.1, 0.05], [0.3, 0.8, -0.1]])
+    faces = np.array([[0, 1, 2]], dtype=np.int32)
+
+    frames = panel_frames(vertices, faces)
+    center, maxDistance = frames['facesCenter'][0], frames['facesMaxDistance'][0]
+
+    directions = np.random.default_rng(1).normal(size=(50, 3))
+    directions /= np.linalg.norm(directions, axis=1)[:, None]
+
+    near = center + directions * maxDistance * (1 - 1e-9)
+    far = center + directions * maxDistance * (1 + 1e-9)
+
+    # The exact integrals and the point source and dipole differ by the higher moments only
+    for name, sigma, doublet in (('source', np.ones(1), np.zeros(1)), ('doublet', np.zeros(1), np.ones(1))):
+
+        nearVel = surface_velocity(vertices, faces, sigma, doublet, near, theta=0.0)
+        farVel = surface_velocity(vertices, faces, sigma, doublet, far, theta=0.0)
+
+        error = (np.linalg.norm(nearVel - farVel, axis=1) / np.linalg.norm(nearVel, axis=1)).max()
+        print('{}: {:.1e}'.format(name, error))
+        assert error < 1e-2, name
+
+    print('panel far field: ok')
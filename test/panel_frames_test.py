@@ -0,0 +1,26 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.meshfile import read_mesh_file
+from utils.bin.wrapper import panel_frames
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    # Geometry stored with the numpy preprocessing of utils/mesh.py
+    mesh = read_mesh_file('./data/mesh/NACA0012-AoA-0/mesh.bin')
+
+    frames = panel_frames(mesh.vertices, mesh.faces)
+
+    # Same operations, so only rounding differs, depending on the build flags
+    for name, value in frames.items():
+        error = np.abs(value - getattr(mesh, name)).max()
+        print('{}: {:.1e}'.format(name, error))
+        assert error < 1e-14, name
+
+    print('panel frames: ok')
@@ -0,0 +1,69 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.bin.wrapper import SolverContext, panel_frames, surface_velocity, wake_grid
+from wake_coupling_test import wing
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    # Treecode against the direct sum over every panel (theta = 0)
+    vertices, faces = wing(41, 21, 4.0)
+    frames = panel_frames(vertices, faces)
+    centers = frames['facesCenter']
+
+    sigma = -frames['e3'] @ np.array([-1.0, 0.0, 0.1])
+    doublet = np.cos(2 * centers[:, 0]) * (1 - (centers[:, 1] / 2) ** 2) * np.sign(centers[:, 2])
+
+    points = np.random.default_rng(0).uniform([-2.0, -3.0, -1.0], [2.0, 3.0, 1.0], (2000, 3))
+
+    tree = surface_velocity(vertices, faces, sigma, doublet, points)
+    direct = surface_velocity(vertices, faces, sigma, doublet, points, theta=0.0)
+
+    error = np.linalg.norm(tree - direct, axis=1).max() / np.linalg.norm(direct, axis=1).max()
+    print('Treecode max relative error: {:.1e}'.format(error))
+    assert error < 2e-3
+
+    # Wake relaxation from the straight wake at 5 degrees
+    vertices, faces = wing(25, 13, 4.0)
+    angle = np.deg2rad(5.0)
+    freestream = np.array([-np.cos(angle), 0.0, np.sin(angle)])
+
+    (grid, wakeVertices, wakeFaces), = wake_grid(vertices, faces, np.array([-0.5, -2.0, 0.0]), np.array([-0.5, 2.0, 0.0]), freestream, 0.1, 30, 0.0, 0.2)
+
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    mesh = [vertices, faces, None, None, None, None, grid, wakeVertices, wakeFaces, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+
+    with SolverContext(*mesh) as context:
+
+        context.solve(freestream, 1.225, 1.5e-5, 340.0)
+        rigid = context.forces.copy()
+
+        context.relax_wake(freestream, 1.225, 1.5e-5, 340.0, iterations=20, tolerance=1e-3)
+        residuals = np.asarray(context.wake_residuals)
+        relaxed = context.forces.copy()
+
+        # Away from the trailing edge and the semi-infinite end, the wake segments follow the local velocity
+        relaxedGrid, relaxedVertices, _ = context._wake[0]
+        lines = relaxedVertices[relaxedGrid]
+        segments = lines[:, 2:-1] - lines[:, 1:-2]
+        velocity = context.velocities((0.5 * (lines[:, 1:-2] + lines[:, 2:-1])).reshape(-1, 3), 0.05).reshape(segments.shape)
+
+    cosine = np.sum(velocity * segments, axis=2) / np.linalg.norm(velocity, axis=2) / np.linalg.norm(segments, axis=2)
+    misalignment = np.degrees(np.arccos(np.clip(cosine, -1.0, 1.0))).max()
+
+    print('Wake residuals: {}'.format(np.array2string(residuals, precision=4)))
+    print('Max misalignment: {:.2f} deg, lift {:.4f} (rigid {:.4f})'.format(misalignment, relaxed[2], rigid[2]))
+
+    assert residuals[-1] < 1e-3 and residuals.shape[0] < 20
+    assert np.all(np.diff(residuals) < 0.0)
+    assert np.array_equal(lines[:, 0], wakeVertices[grid][:, 0])
+    assert misalignment < 2.0
+    assert abs(relaxed[2] - rigid[2]) < 0.01 * abs(rigid[2])
+
+    print('panel tree: ok')
@@ -0,0 +1,77 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.bin.wrapper import SolverContext, UnsteadySolver, _rotation_matrix
+from wake_coupling_test import wing
+
+def transform(rotation: list, translation: list):
+    return np.concatenate([_rotation_matrix(np.array(rotation)), np.reshape(translation, (3, 1))], axis=1)
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    # Two disjoint wings side by side, one component each
+    wingVertices, wingFaces = wing(14, 6, 2.0)
+    vertices = np.concatenate([wingVertices, wingVertices + [0.0, 2.2, 0.0]])
+    faces = np.concatenate([wingFaces, wingFaces + wingVertices.shape[0]]).astype(np.int32)
+    components = np.repeat([0, 1], wingFaces.shape[0]).astype(np.int32)
+    verticesComponents = np.repeat([0, 1], wingVertices.shape[0])
+
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+
+    def mesh(vertices: np.ndarray):
+        return [vertices, faces, None, None, None, None, empty2, empty3, empty2, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+
+    def run(context: SolverContext):
+        out = context.solve(np.array([-1.0, 0.1, 0.05]), 1.2, 1e-5, 340.0, rotation=np.array([0.1, -0.2, 0.3]))
+        return np.concatenate([out[1], out[6], context.forces])
+
+    cases = [('carried', [transform([0.1, 0.2, -0.3], [0.3, -0.1, 0.2])] * 2),
+             ('one moved', [transform([0.0, 0.0, 0.0], [0.0, 0.0, 0.0]), transform([0.0, 0.0, 0.2], [0.05, 0.1, 0.0])]),
+             ('both moved', [transform([0.05, 0.0, 0.0], [0.0, 0.02, 0.0]), transform([0.0, 0.1, 0.0], [0.1, 0.0, 0.0])])]
+
+    # Moving the components matches a fresh assembly of the moved mesh, to the GMRES tolerance (1e-8)
+    with SolverContext(*mesh(vertices)) as context:
+
+        context.set_components(components)
+        run(context)
+
+        for name, transforms in cases:
+
+            transforms = np.array(transforms)
+            vertices = np.einsum('vij,vj->vi', transforms[verticesComponents, :, :3], vertices) + transforms[verticesComponents, :, 3]
+
+            context.move(transforms, *mesh(vertices))
+            moved = run(context)
+
+            with SolverContext(*mesh(vertices)) as fresh:
+                expected = run(fresh)
+
+            error = np.abs(moved - expected).max() / np.abs(expected).max()
+            print('{}: {:.1e}'.format(name, error))
+            assert error < 1e-8, name
+
+    # Components sharing vertices are rejected: a face across them would deform
+    vertices, faces = wing(14, 6, 2.0)
+    shared = (np.arange(faces.shape[0]) >= faces.shape[0] // 2).astype(np.int32)
+
+    with SolverContext(*mesh(vertices)) as context:
+
+        try:
+            context.set_components(shared)
+            raise AssertionError('shared vertices accepted by set_components')
+        except ValueError:
+            pass
+
+    try:
+        UnsteadySolver(*mesh(vertices), components=shared)
+        raise AssertionError('shared vertices accepted by UnsteadySolver')
+    except ValueError:
+        pass
+
+    print('solver components: ok')
@@ -0,0 +1,50 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.bin.wrapper import SolverContext, UnsteadySolver, wake_grid
+from wake_coupling_test import wing
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    vertices, faces = wing(21, 9, 4.0)
+    angle = np.deg2rad(5.0)
+    freestream = np.array([-np.cos(angle), 0.0, np.sin(angle)])
+
+    (grid, wakeVertices, wakeFaces), = wake_grid(vertices, faces, np.array([-0.5, -2.0, 0.0]), np.array([-0.5, 2.0, 0.0]), freestream, 0.1, 30, 20.0, 0.2)
+
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    mesh = [vertices, faces, None, None, None, None, grid, wakeVertices, wakeFaces, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+
+    with SolverContext(*mesh) as context:
+        context.solve(freestream, 1.225, 1.5e-5, 340.0)
+        steady = context.wake_strengths()
+        steadyLift = context.forces[2]
+
+    # Impulsive start: the circulation shed at the trailing edge grows towards the steady one
+    dt = 0.25
+    ratios = []
+
+    with UnsteadySolver(*mesh) as solver:
+
+        for _ in range(int(round(8.0 / dt))):
+            solver.step(dt, -freestream, np.zeros(3), 1.225, 1.5e-5, 340.0, verticesFields=[])
+            ratios.append(solver.context.wake_strengths().mean() / steady.mean())
+
+        gamma = solver.context.wake_strengths()
+        lift = solver.forces[2]
+
+    ratios = np.array(ratios)
+    print('Circulation ratio after 1, 4 and 8 chords: {:.4f} {:.4f} {:.4f}, lift ratio {:.4f}'.format(ratios[3], ratios[15], ratios[-1], lift / steadyLift))
+
+    assert ratios[3] < 0.9
+    assert np.all(np.diff(ratios[3:]) > 0.0)
+    assert np.abs(gamma - steady).max() < 0.03 * np.abs(steady).max()
+    assert abs(lift / steadyLift - 1) < 0.03
+
+    print('unsteady solver: ok')
@@ -0,0 +1,125 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import re
+import tempfile
+import zlib
+import numpy as np
+
+from utils.bin.wrapper import write_vtk
+
+def plate(nx: int, ny: int):
+    """Flat plate in the z = 0 plane, two triangles per quad"""
+
+    x, y = np.meshgrid(np.linspace(0.0, 1.0, nx), np.linspace(0.0, 2.0, ny), indexing='ij')
+    vertices = np.stack([x.ravel(), y.ravel(), np.zeros(nx * ny)], axis=1)
+    faces = []
+
+    for i in range(nx - 1):
+        for j in range(ny - 1):
+            a, b = i * ny + j, (i + 1) * ny + j
+            faces += [[a, b, b + 1], [a, b + 1, a + 1]]
+
+    return vertices, np.array(faces, dtype=np.int32)
+
+def read_vtk(path: str):
+    """Header arrays (name, type, offset) and the appended section of a .vtp file"""
+
+    with open(path, 'rb') as f:
+        content = f.read()
+
+    start = content.index(b'<AppendedData encoding="raw">\n   _') + len(b'<AppendedData encoding="raw">\n   _')
+    end = content.rindex(b'\n  </AppendedData>')
+    header = content[:start].decode()
+
+    arrays = re.findall(r'<DataArray type="(\w+)" Name="(\w+)"(?: NumberOfComponents="\d")? format="appended" offset="(\d+)"/>', header)
+
+    return header, [(name, dtype, int(offset)) for dtype, name, offset in arrays], content[start:end]
+
+def decode(appended: bytes, offset: int, dtype: str, compressed: bool):
+    """Array at offset of the appended section and the number of bytes it takes"""
+
+    numpyType = {'Float32': np.float32, 'Float64': np.float64, 'Int32': np.int32}[dtype]
+
+    if not compressed:
+        size = int(np.frombuffer(appended, np.uint64, 1, offset)[0])
+        return np.frombuffer(appended, numpyType, size // np.dtype(numpyType).itemsize, offset + 8), 8 + size
+
+    nBlocks, blockSize, lastBlock = np.frombuffer(appended, np.uint64, 3, offset).astype(int)
+    blocksBytes = np.frombuffer(appended, np.uint64, nBlocks, offset + 24).astype(int)
+    position = offset + 24 + 8 * nBlocks
+    data = b''
+
+    for k in range(nBlocks):
+        block = zlib.decompress(appended[position:position + blocksBytes[k]])
+        assert len(block) == (lastBlock if (k == nBlocks - 1 and lastBlock != 0) else blockSize)
+        data += block
+        position += blocksBytes[k]
+
+    return np.frombuffer(data, numpyType), position - offset
+
+if __name__ == '__main__':
+
+    # Points above the 65536 bytes of a compressed block
+    nx, ny, nSpan, nWake = 40, 100, 5, 4
+    vertices, faces = plate(nx, ny)
+    nv, nf = vertices.shape[0], faces.shape[0]
+
+    # Tail wake from the edge x = 1, on vertices of its own
+    trailing = np.arange((nx - 1) * ny, (nx - 1) * ny + nSpan)
+    wakeVertices = np.concatenate([vertices[trailing] + [d, 0.0, 0.0] for d in np.linspace(0.0, 1.0, nWake)])
+    wakeGrid = (np.arange(nWake)[None, :] * nSpan + np.arange(nSpan)[:, None]).astype(np.int32)
+    wakeFaces = np.zeros((nSpan - 1, 2), dtype=np.int32)
+
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    mesh = [vertices, faces, None, None, None, None, empty2, empty3, empty2, empty2, empty3, empty2, wakeGrid, wakeVertices, wakeFaces] + 6 * [None]
+
+    rng = np.random.default_rng(0)
+    pressure = rng.random(nv)
+    velocity = tuple(rng.random(nv) for _ in range(3))
+    sigma = rng.random(nf)
+
+    os.chdir('./validation')
+
+    with tempfile.TemporaryDirectory() as directory:
+
+        for compressed in (False, True):
+
+            path = os.path.join(directory, 'mesh.vtp')
+            write_vtk(path, *mesh, pointFields={'cp': pressure, 'vel': velocity}, cellFields={'sigma': sigma}, wake=True, compressed=compressed)
+
+            header, arrays, appended = read_vtk(path)
+
+            # Header
+            assert header.startswith('<?xml version="1.0"?>\n<VTKFile type="PolyData" version="1.0" byte_order="LittleEndian" header_type="UInt64"')
+            assert ('compressor="vtkZLibDataCompressor"' in header) == compressed
+            assert '<Piece NumberOfPoints="{}" NumberOfVerts="0" NumberOfLines="{}" NumberOfStrips="0" NumberOfPolys="{}">'.format(nv + nSpan * nWake, nSpan, nf) in header
+            assert [name for name, _, _ in arrays] == ['cp', 'vel', 'sigma', 'Points', 'connectivity', 'offsets', 'connectivity', 'offsets']
+
+            # The appended arrays follow each other in the order of their offsets
+            values, end = [], 0
+
+            for name, dtype, offset in sorted(arrays, key=lambda array: array[2]):
+                assert offset == end, name
+                value, size = decode(appended, offset, dtype, compressed)
+                values.append(value)
+                end = offset + size
+
+            assert end == len(appended)
+
+            cp, vel, cellSigma, points, polys, polysOffsets, lines, linesOffsets = values
+
+            # Point data is padded with zeros on the wake points, cell data on the wake lines
+            assert np.array_equal(cp, np.concatenate([pressure, np.zeros(nSpan * nWake)]).astype(np.float32))
+            assert np.array_equal(vel.reshape(-1, 3)[:nv], np.stack(velocity, axis=1).astype(np.float32))
+            assert np.array_equal(cellSigma, np.concatenate([np.zeros(nSpan), sigma]).astype(np.float32))
+
+            assert np.array_equal(points.reshape(-1, 3), np.concatenate([vertices, wakeVertices]))
+            assert np.array_equal(polys.reshape(-1, 3), faces)
+            assert np.array_equal(polysOffsets, 3 * np.arange(1, nf + 1))
+            assert np.array_equal(lines.reshape(nSpan, nWake), nv + wakeGrid)
+            assert np.array_equal(linesOffsets, nWake * np.arange(1, nSpan + 1))
+
+    print('vtk file: ok')
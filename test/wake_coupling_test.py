@@ -0,0 +1,111 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import os
+import numpy as np
+
+from utils.bin.wrapper import SolverContext, panel_frames, wake_grid
+
+def wing(nc: int, ns: int, span: float):
+    """Rectangular wing of NACA 0012 section, leading edge at x = 0.5 and trailing edge at x = -0.5, open at the tips"""
+
+    b = 0.5 * (1 - np.cos(np.linspace(0.0, np.pi, nc)))
+    t = 0.6 * (0.2969 * np.sqrt(b) - 0.1260 * b - 0.3516 * b ** 2 + 0.2843 * b ** 3 - 0.1036 * b ** 4)
+    t[-1] = 0.0
+    x = 0.5 - b
+
+    section = np.concatenate([np.stack([x[::-1], t[::-1]], axis=1), np.stack([x[1:-1], -t[1:-1]], axis=1)])
+    m = section.shape[0]
+
+    vertices = np.array([[px, y, pz] for y in np.linspace(-0.5 * span, 0.5 * span, ns) for px, pz in section])
+    faces = []
+
+    for j in range(ns - 1):
+        for k in range(m):
+            a, b = j * m + k, j * m + (k + 1) % m
+            faces += [[a, b, b + m], [a, b + m, a + m]]
+
+    return vertices, np.array(faces, dtype=np.int32)
+
+def segments_velocity(points: np.ndarray, a: np.ndarray, b: np.ndarray):
+    """Velocity at the points [n x 3] of the segments a[k] -> b[k] [m x 3] with unit circulation, summed"""
+
+    r1 = points[:, None, :] - a[None, :, :]
+    r2 = points[:, None, :] - b[None, :, :]
+    c = np.cross(r1, r2)
+    d = np.sum((b - a)[None, :, :] * (r1 / np.linalg.norm(r1, axis=2)[:, :, None] - r2 / np.linalg.norm(r2, axis=2)[:, :, None]), axis=2)
+
+    return np.sum(c * (d / np.sum(c * c, axis=2))[:, :, None], axis=1) / (4 * np.pi)
+
+def semi_infinite_velocity(points: np.ndarray, a: np.ndarray, direction: np.ndarray):
+    """Velocity at the points [n x 3] of the line from a to infinity along the unit direction, unit circulation"""
+
+    r = points - a
+    c = np.cross(direction, r)
+
+    return c * ((1 + r @ direction / np.linalg.norm(r, axis=1)) / np.sum(c * c, axis=1))[:, None] / (4 * np.pi)
+
+if __name__ == '__main__':
+
+    os.chdir('./validation')
+
+    vertices, faces = wing(21, 9, 4.0)
+    freestream = np.array([-1.0, 0.0, 0.05])
+
+    (grid, wakeVertices, wakeFaces), = wake_grid(vertices, faces, np.array([-0.5, -2.0, 0.0]), np.array([-0.5, 2.0, 0.0]), freestream / np.linalg.norm(freestream), 0.1, 15, 3.0, 0.2)
+
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    mesh = [vertices, faces, None, None, None, None, grid, wakeVertices, wakeFaces, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+
+    with SolverContext(*mesh) as context:
+
+        context.solve(freestream, 1.225, 1.5e-5, 340.0)
+
+        w = context.wake_coupling(0)
+        vel = np.stack([context.wake_coupling(k) for k in (1, 2, 3)], axis=2)
+
+    # Independent Biot-Savart sum: strip s goes along the trailing edge from line s to line s + 1, down line s + 1 and up line s
+    frames = panel_frames(vertices, faces)
+    points = frames['controlPoints']
+    lines = wakeVertices[grid]
+    nSpan = grid.shape[0]
+
+    def line_velocity(k: int):
+        end = lines[k, -1] - lines[k, -2]
+        return segments_velocity(points, lines[k, :-1], lines[k, 1:]) + semi_infinite_velocity(points, lines[k, -1], end / np.linalg.norm(end))
+
+    lineVel = [line_velocity(k) for k in range(nSpan)]
+    expected = np.stack([lineVel[s + 1] - lineVel[s] + segments_velocity(points, lines[s:s + 1, 0], lines[s + 1:s + 2, 0]) for s in range(nSpan - 1)], axis=1)
+
+    assert w.shape == (faces.shape[0], nSpan - 1)
+
+    error = np.abs(vel - expected).max() / np.abs(expected).max()
+    normalError = np.abs(w - np.einsum('ik,isk->is', frames['e3'], expected)).max() / np.abs(w).max()
+
+    print('Max relative error: {:.1e} (velocity) {:.1e} (normal)'.format(error, normalError))
+    assert error < 1e-10 and normalError < 1e-10
+
+    # A one chord near wake closed by the semi-infinite lines against a 20 chords discretized wake
+    vertices, faces = wing(21, 13, 4.0)
+    angle = np.deg2rad(5.0)
+    freestream = np.array([-np.cos(angle), 0.0, np.sin(angle)])
+    results = []
+
+    for nWake in (201, 11):
+
+        (grid, wakeVertices, wakeFaces), = wake_grid(vertices, faces, np.array([-0.5, -2.0, 0.0]), np.array([-0.5, 2.0, 0.0]), freestream, 0.1, nWake, 0.0, 0.2)
+        mesh = [vertices, faces, None, None, None, None, grid, wakeVertices, wakeFaces, empty2, empty3, empty2, empty2, empty3, empty2] + 6 * [None]
+
+        with SolverContext(*mesh) as context:
+            cp = context.solve(freestream, 1.225, 1.5e-5, 340.0)[0].copy()
+            results.append((cp, context.forces.copy()))
+
+    (longCp, longForces), (nearCp, nearForces) = results
+    cpError = np.abs(nearCp - longCp).max()
+    forcesError = np.abs(nearForces - longForces).max() / np.abs(longForces).max()
+
+    print('Near wake against the long wake: {:.1e} (cp) {:.1e} (forces)'.format(cpError, forcesError))
+    assert cpError < 1e-3 and forcesError < 1e-3
+
+    print('wake coupling: ok')
@@ -0,0 +1,80 @@
+import sys
+sys.path.append('./')
+sys.path.append('./validation')
+
+import ctypes
+import numpy as np
+
+from utils.bin.wrapper import ND_POINTER_DOUBLE, ND_POINTER_INT, WAKE_MESH_PART, WAKE_GRID_PARAMETERS
+
+def diamond_wing(nz: int):
+    """Wing of diamond section, leading edge at x = -1 and trailing edge at x = 0, open at the tips"""
+
+    section = np.array([[0.0, 0.0], [-0.5, 0.05], [-1.0, 0.0], [-0.5, -0.05]])
+    z = np.linspace(-1.0, 1.0, nz)
+
+    vertices = np.array([[x, y, zi] for zi in z for x, y in section])
+    faces = []
+
+    for i in range(nz - 1):
+        for k in range(4):
+            a, b = 4 * i + k, 4 * i + (k + 1) % 4
+            faces += [[a, b, b + 4], [a, b + 4, a + 4]]
+
+    return vertices, np.array(faces, dtype=np.int32)
+
+if __name__ == '__main__':
+
+    nz, nWake, ds, length = 9, 12, 0.1, 5.0
+    vertices, faces = diamond_wing(nz)
+
+    lib = ctypes.CDLL('./validation/utils/bin/libsolver.so')
+
+    lib.getWakeMeshParts.argtypes = [ctypes.c_int, ctypes.c_int, ND_POINTER_DOUBLE, ND_POINTER_INT, ctypes.c_int, ND_POINTER_DOUBLE, ND_POINTER_DOUBLE, WAKE_GRID_PARAMETERS, ctypes.POINTER(WAKE_MESH_PART)]
+    lib.getWakeMeshParts.restype = ctypes.c_int
+    lib.freeWakeMeshPart.argtypes = [WAKE_MESH_PART]
+    lib.freeWakeMeshPart.restype = None
+
+    # Both trailing edge directions, slightly off the mesh vertices
+    starts = np.array([[0.01, 0.0, -1.0], [0.0, 0.0, 1.0]])
+    ends = np.array([[0.0, 0.01, 1.0], [0.0, 0.0, -1.0]])
+
+    parameters = WAKE_GRID_PARAMETERS((ctypes.c_double * 3)(1.0, 0.0, 0.0), ds, nWake, length, 0.2)
+    parts = (WAKE_MESH_PART * 2)()
+
+    assert lib.getWakeMeshParts(vertices.shape[0], faces.shape[0], vertices.reshape(-1), faces.reshape(-1), 2, starts.reshape(-1), ends.reshape(-1), parameters, parts) == 1
+
+    for part, direction in zip(parts, [1, -1]):
+
+        assert (part.nSpan, part.nWake) == (nz, nWake)
+
+        grid = np.ctypeslib.as_array(part.grid, shape=(nz, nWake))
+        points = np.ctypeslib.as_array(part.vertices, shape=(nz * nWake, 3))
+        edgeFaces = np.ctypeslib.as_array(part.faces, shape=(nz - 1, 2))
+
+        assert np.array_equal(grid, np.arange(nz * nWake).reshape(nz, nWake))
+
+        # Lines start at the trailing edge vertices, in order
+        first = points[grid[:, 0]]
+        assert np.allclose(first[:, :2], 0.0)
+        assert np.all(direction * np.diff(first[:, 2]) > 0)
+
+        # Faces of each trailing edge: the triangles of the strip meeting at the trailing edge
+        for i in range(nz - 1):
+            strip = nz - 2 - i if direction < 0 else i
+            assert np.array_equal(edgeFaces[i], [8 * strip + 1, 8 * strip + 6])
+
+        # Lines leave along the bisector, downstream and in the plane of the wing, and end with the stretched step
+        lines = points[grid]
+        steps = np.linalg.norm(np.diff(lines, axis=1), axis=2)
+        assert np.allclose(lines[:, :, 1:], lines[:, :1, 1:])
+        assert np.allclose(steps[:, :-1], ds)
+        assert np.allclose(steps[:, -1], length - (nWake - 1) * ds)
+
+        lib.freeWakeMeshPart(part)
+
+    # Invalid grids are rejected
+    parameters.nWake = 1
+    assert lib.getWakeMeshParts(vertices.shape[0], faces.shape[0], vertices.reshape(-1), faces.reshape(-1), 2, starts.reshape(-1), ends.reshape(-1), parameters, parts) == 0
+
+    print('wake grid: ok')
@@ -1,5 +1,7 @@
 import numpy as np
 
+from utils.meshfile import read_mesh_file
+
 if __name__ == '__main__':
 
     area = 10.0
@@ -8,8 +10,9 @@ if __name__ == '__main__':
     y = np.array([0.0, 1.0, 0.0])
     z = np.array([0.0, 0.0, 1.0])
 
-    facesAreas = np.loadtxt('./data/mesh/NACA0012-AoA-0/facesAreas.txt', dtype=np.double)
-    e3 = np.loadtxt('./data/mesh/NACA0012-AoA-0/e3.txt', dtype=np.double)
+    mesh = read_mesh_file('./data/mesh/NACA0012-AoA-0/mesh.bin')
+    facesAreas = mesh.facesAreas
+    e3 = mesh.e3
     cp = np.loadtxt('./data/solution/NACA0012-AoA-0/cp_f.txt', dtype=np.double)
 
     for i in range(cp.size):
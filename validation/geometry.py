@@ -1,6 +1,7 @@
 import numpy as np
 
 from utils.mesh import gen_mesh
+from utils.meshfile import write_mesh_file
 from utils.vtk import gen_vtk_file
 
 
@@ -24,22 +25,7 @@ if __name__ == '__main__':
     path = './data/mesh/NACA0012-AoA-0/'
 
     # Save
-    np.savetxt(path + 'controlPoints.txt', mesh.controlPoints)
-    np.savetxt(path + 'e1.txt', mesh.e1)
-    np.savetxt(path + 'e2.txt', mesh.e2)
-    np.savetxt(path + 'e3.txt', mesh.e3)
-    np.savetxt(path + 'edges.txt', mesh.edges)
-    np.savetxt(path + 'faces.txt', mesh.faces)
-    np.savetxt(path + 'facesAreas.txt', mesh.facesAreas)
-    np.savetxt(path + 'facesCenter.txt', mesh.facesCenter)
-    np.savetxt(path + 'facesMaxDistance.txt', mesh.facesMaxDistance)
-    np.savetxt(path + 'p1Local.txt', mesh.p1Local)
-    np.savetxt(path + 'p2Local.txt', mesh.p2Local)
-    np.savetxt(path + 'p3Local.txt', mesh.p3Local)
-    np.savetxt(path + 'vertices.txt', mesh.vertices)
-    np.savetxt(path + 'wake_faces.txt', mesh.wake_faces)
-    np.savetxt(path + 'wake_grid.txt', mesh.wake_grid)
-    np.savetxt(path + 'wake_vertices.txt', mesh.wake_vertices)
+    write_mesh_file(path + 'mesh.bin', mesh)
 
     # Generate vtk file
     gen_vtk_file('./data/vtk/geometry-NACA0012-AoA-0', mesh, wake=False)
\ No newline at end of file
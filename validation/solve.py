@@ -1,6 +1,6 @@
 import numpy as np
 
-from utils.mesh import MeshData
+from utils.meshfile import read_mesh_file
 from utils.solver import solve
 from utils.vtk import gen_vtk_file
 
@@ -71,24 +71,7 @@ if __name__ == '__main__':
 
     path = './data/mesh/NACA0012-AoA-0/'
 
-    mesh = MeshData(
-        vertices=np.loadtxt(path + 'vertices.txt', dtype=np.double),
-        edges=np.loadtxt(path + 'edges.txt', dtype=np.int32),
-        faces=np.loadtxt(path + 'faces.txt', dtype=np.int32),
-        facesCenter=np.loadtxt(path + 'facesCenter.txt', dtype=np.double),
-        e1=np.loadtxt(path + 'e1.txt', dtype=np.double),
-        e2=np.loadtxt(path + 'e2.txt', dtype=np.double),
-        e3=np.loadtxt(path + 'e3.txt', dtype=np.double),
-        controlPoints=np.loadtxt(path + 'controlPoints.txt', dtype=np.double),
-        facesAreas=np.loadtxt(path + 'facesAreas.txt', dtype=np.double),
-        facesMaxDistance=np.loadtxt(path + 'facesMaxDistance.txt', dtype=np.double),
-        p1Local=np.loadtxt(path + 'p1Local.txt', dtype=np.double),
-        p2Local=np.loadtxt(path + 'p2Local.txt', dtype=np.double),
-        p3Local=np.loadtxt(path + 'p3Local.txt', dtype=np.double),
-        wake_faces=np.loadtxt(path + 'wake_faces.txt', dtype=np.int32),
-        wake_grid=np.loadtxt(path + 'wake_grid.txt', dtype=np.int32),
-        wake_vertices=np.loadtxt(path + 'wake_vertices.txt', dtype=np.double),
-    )
+    mesh = read_mesh_file(path + 'mesh.bin')
 
     sol = solve(mesh, freestream, alpha, density, viscosity, soundSpeed)
 
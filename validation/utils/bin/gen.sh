@@ -1,6 +1,6 @@
 # Generate lib
-gcc -fPIC -Ofast -c solver.c
-gcc -shared -Ofast -o libsolver.so solver.o -lm -lrt -lblas -llapack -llapacke
+gcc -fPIC -Ofast -fopenmp -c solver.c
+gcc -shared -Ofast -fopenmp -o libsolver.so solver.o -lm -lrt -lz -lblas -llapack -llapacke
 
 # Remove intermediate file
 rm solver.o
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "arena.h"
+
+#define ARENA_ALIGNMENT 64
+
+size_t arenaAlign(size_t bytes)
+{
+    return (bytes + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+}
+
+struct Arena getArena(size_t size)
+{
+    struct Arena arena;
+
+    arena.size = arenaAlign(size);
+    arena.data = (arena.size > 0) ? (char *)aligned_alloc(ARENA_ALIGNMENT, arena.size) : NULL;
+    arena.offset = 0;
+    arena.peak = 0;
+    arena.heap = NULL;
+
+    return arena;
+}
+
+void freeArenaHeap(struct Arena *arena)
+{
+    void *block;
+
+    while (arena->heap != NULL)
+    {
+        block = arena->heap;
+        arena->heap = *(void **)block;
+        free(block);
+    }
+}
+
+void freeArena(struct Arena *arena)
+{
+    freeArenaHeap(arena);
+    free(arena->data);
+    arena->data = NULL;
+    arena->size = 0;
+    arena->offset = 0;
+}
+
+void *arenaAlloc(struct Arena *arena, size_t bytes)
+{
+
+    /* Parameters */
+    char *block;
+
+    /* Allocate */
+    bytes = arenaAlign(bytes);
+
+    if (arena->offset + bytes <= arena->size)
+    {
+        block = arena->data + arena->offset;
+    }
+    else
+    {
+        block = (char *)aligned_alloc(ARENA_ALIGNMENT, bytes + ARENA_ALIGNMENT);
+        *(void **)block = arena->heap;
+        arena->heap = block;
+        block = block + ARENA_ALIGNMENT;
+    }
+
+    arena->offset = arena->offset + bytes;
+    if (arena->offset > arena->peak) arena->peak = arena->offset;
+
+    return block;
+}
+
+size_t arenaMark(struct Arena *arena)
+{
+    return arena->offset;
+}
+
+void arenaRelease(struct Arena *arena, size_t mark)
+/* Heap blocks are kept until the next reset */
+{
+    arena->offset = mark;
+}
+
+void arenaReset(struct Arena *arena)
+{
+    freeArenaHeap(arena);
+
+    if (arena->peak > arena->size)
+    {
+        free(arena->data);
+        arena->size = arenaAlign(arena->peak);
+        arena->data = (char *)aligned_alloc(ARENA_ALIGNMENT, arena->size);
+    }
+
+    arena->offset = 0;
+}
+
+double **arenaMatrix(struct Arena *arena, int nrow, int ncol)
+/* Row pointers to a contiguous nrow x ncol block */
+{
+    int i;
+    double **m;
+
+    m = (double **)arenaAlloc(arena, nrow * sizeof(double *));
+    m[0] = (double *)arenaAlloc(arena, (size_t)nrow * ncol * sizeof(double));
+
+    for (i = 1; i < nrow; i++) m[i] = m[i - 1] + ncol;
+
+    return m;
+}
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+
+/*
+    Bump allocator for scratch memory. Blocks are 64 byte aligned and are
+    released all together with arenaReset, or back to a mark taken with
+    arenaMark. When the buffer is full the request is served from the heap
+    and the buffer grows to the peak usage on the next reset, so a repeated
+    workload stops touching the heap after its first pass. An arena is not
+    shared between threads: each solver owns its own.
+*/
+struct Arena
+{
+    char *data;
+    size_t size;           // bytes in data
+    size_t offset;         // bytes in use, including the heap blocks
+    size_t peak;           // largest offset since the arena was created
+    void *heap;            // heap blocks served on overflow, chained through their first bytes
+};
+
+struct Arena getArena(size_t size);
+void freeArena(struct Arena *arena);
+
+void *arenaAlloc(struct Arena *arena, size_t bytes);
+size_t arenaMark(struct Arena *arena);
+void arenaRelease(struct Arena *arena, size_t mark);
+void arenaReset(struct Arena *arena);
+
+double **arenaMatrix(struct Arena *arena, int nrow, int ncol);
+
+#include "arena.c"
+
+#endif
@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "arena.h"
 
 double r8vec_dot ( int n, double a1[], double a2[] )
 /*
@@ -15,53 +16,6 @@ double r8vec_dot ( int n, double a1[], double a2[] )
     return value;
 }
 
-void ax_st ( int n, int nz_num, int ia[], int ja[], double a[], double x[], double w[] )
-/*
-    ax_st computes A*x for a matrix stored in sparse triplet form.
-*/
-{
-    int i;
-    int j;
-    int k;
-
-    for ( i = 0; i < n; i++ ) w[i] = 0.0;
-
-    for ( k = 0; k < nz_num; k++ )
-    {
-        i = ia[k];
-        j = ja[k];
-        w[i] = w[i] + a[k] * x[j];
-    }
-
-    return;
-}
-
-double **dmatrix( int nrl, int nrh, int ncl, int nch )
-/*
-    dmatrix allocates a double matrix.
-*/
-{
-    int i;
-    double **m;
-    int nrow = nrh - nrl + 1;
-    int ncol = nch - ncl + 1;
-
-    /* 
-    Allocate pointers to the rows.
-    */
-    m = ( double ** ) malloc ( (size_t) ( ( nrow + 1 ) * sizeof ( double* ) ) );
-    m = m + 1;
-    m = m - nrl;
-
-    m[nrl] = ( double * ) malloc ( (size_t) ( ( nrow * ncol + 1 ) * sizeof ( double ) ) );
-    m[nrl] = m[nrl] + 1;
-    m[nrl] = m[nrl] - ncl;
-
-    for ( i = nrl + 1; i <= nrh; i++ ) m[i] = m[i-1] + ncol;
-
-    return m;
-}
-
 void mult_givens ( double c, double s, int k, double *g )
 /*
     mult_givens applies a Givens rotation to two vector elements.
@@ -79,20 +33,11 @@ void mult_givens ( double c, double s, int k, double *g )
   return;
 }
 
-void free_dmatrix ( double **m, int nrl, int nrh, int ncl, int nch )
+void mgmres (int n, void (*matvec)(void *, double *, double *), void *context, double x[], double rhs[], int itr_max, int mr, double tol_abs, double tol_rel, struct Arena *arena)
 /*
-    free_dmatrix frees a double matrix allocated by DMATRIX.
-*/
-{
-  free ( ( char * ) ( m[nrl] + ncl - 1 ) );
-  free ( ( char * ) ( m + nrl - 1 ) );
-
-  return;
-}
-
-void mgmres_st (int n, int nz_num, int ia[], int ja[], double a[], double x[], double rhs[], int itr_max, int mr, double tol_abs, double tol_rel)
-/*
-    mgmres_st applies the restarted GMRES algorithm.
+    mgmres applies the restarted GMRES algorithm to an operator given by
+    matvec(context, v, w), w = A v. The workspace is taken from the arena
+    and given back on return.
 */
 {
     double av;
@@ -115,20 +60,23 @@ void mgmres_st (int n, int nz_num, int ia[], int ja[], double a[], double x[], d
     double **v;
     int verbose = 1;
     double *y;
+    size_t mark;
 
     itr_used = 0;
 
-    c = ( double * ) malloc ( mr * sizeof ( double ) );
-    g = ( double * ) malloc ( ( mr + 1 ) * sizeof ( double ) );
-    h = dmatrix(0,mr,0,mr-1);
-    r = ( double * ) malloc ( n * sizeof ( double ) );
-    s = ( double * ) malloc ( mr * sizeof ( double ) );
-    v = dmatrix(0,mr,0,n-1);
-    y = ( double * ) malloc ( ( mr + 1 ) * sizeof ( double ) );
+    mark = arenaMark ( arena );
+
+    c = ( double * ) arenaAlloc ( arena, mr * sizeof ( double ) );
+    g = ( double * ) arenaAlloc ( arena, ( mr + 1 ) * sizeof ( double ) );
+    h = arenaMatrix ( arena, mr + 1, mr );
+    r = ( double * ) arenaAlloc ( arena, n * sizeof ( double ) );
+    s = ( double * ) arenaAlloc ( arena, mr * sizeof ( double ) );
+    v = arenaMatrix ( arena, mr + 1, n );
+    y = ( double * ) arenaAlloc ( arena, ( mr + 1 ) * sizeof ( double ) );
 
     for ( itr = 0; itr < itr_max; itr++ ) 
     {
-        ax_st ( n, nz_num, ia, ja, a, x, r );
+        matvec ( context, x, r );
 
         for ( i = 0; i < n; i++ ) r[i] = rhs[i] - r[i];
 
@@ -138,6 +86,9 @@ void mgmres_st (int n, int nz_num, int ia[], int ja[], double a[], double x[], d
 
         if ( itr == 0 ) rho_tol = rho * tol_rel;
 
+        /* Exact already, e.g. a zero right hand side: the Krylov basis would be 0 / 0 */
+        if ( rho == 0.0 ) break;
+
         for ( i = 0; i < n; i++ ) v[0][i] = r[i] / rho;
 
         g[0] = rho;
@@ -149,7 +100,7 @@ void mgmres_st (int n, int nz_num, int ia[], int ja[], double a[], double x[], d
         {
             k_copy = k;
 
-            ax_st ( n, nz_num, ia, ja, a, v[k], v[k+1] );
+            matvec ( context, v[k], v[k+1] );
 
             av = sqrt ( r8vec_dot ( n, v[k+1], v[k+1] ) );
 
@@ -218,28 +169,22 @@ void mgmres_st (int n, int nz_num, int ia[], int ja[], double a[], double x[], d
     if ( verbose )
     {
         printf ( "\n" );
-        printf ( "MGMRES_ST:\n" );
+        printf ( "MGMRES:\n" );
         printf ( "  Iterations = %d\n", itr_used );
         printf ( "  Final residual = %e\n", rho );
     }
     /*
     Free memory.
     */
-    free ( c );
-    free ( g );
-    free_dmatrix ( h, 0, mr, 0, mr - 1 );
-    free ( r );
-    free ( s );
-    free_dmatrix ( v, 0, mr, 0, n - 1 );
-    free ( y );
+    arenaRelease ( arena, mark );
 
     return;
 }
 
-void solveGMRES(int n, int na, double *a, int *ia, int *ja, double *rhs, double *x)
+void solveGMRES(int n, void (*matvec)(void *, double *, double *), void *context, double *rhs, double *x, struct Arena *arena)
 {
-    int mr = 5000;
+    int mr = (n < 5000) ? n : 5000;
     int inter_max = 10;
 
-    mgmres_st(n, na, ia, ja, a, x, rhs, inter_max, mr, 1e-8, 1e-8);
+    mgmres(n, matvec, context, x, rhs, inter_max, mr, 1e-8, 1e-8, arena);
 }
\ No newline at end of file
@@ -1,21 +1,22 @@
 #ifndef LINEAR_SYSTEM_SOLVER_H
 #define LINEAR_SYSTEM_SOLVER_H
 
+#include "arena.h"
+
 /*
-    Solves a sparse linear system using least square error
-    in the form of a triplet form representation.
+    Solves a linear system using least square error, with the
+    left hand side given by its product with a vector.
 
     Parameters
     ----------
     - n = matrix size (length of rhs)
-    - na = entries size (length of a)
-    - a(k) = value of entry [left hand side]
-    - ia(k) = row of entry
-    - ja(k) = column of entry
+    - matvec(context, v, w) = computes w = A v [left hand side]
+    - context = matrix passed to matvec
     - rhs = right hand side of the equation
-    - x = solution
+    - x = solution (initial guess on input)
+    - arena = scratch memory for the Krylov workspace
 */
-void solveGMRES(int n, int na, double *a, int *ia, int *ja, double *rhs, double *x);
+void solveGMRES(int n, void (*matvec)(void *, double *, double *), void *context, double *rhs, double *x, struct Arena *arena);
 
 #include "linearSystemSolver.c"
 
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "meshFile.h"
+
+const char meshFileMagic[8] = "PBMESH";
+
+uint32_t meshFileChecksum(const unsigned char *data, size_t bytes)
+/* CRC-32 (IEEE 802.3), the one of zlib.crc32 */
+{
+
+    /* Parameters */
+    static uint32_t table[256];
+    static int tableReady = 0;
+    uint32_t crc, c;
+    size_t i;
+    int k;
+
+    /* Table */
+    if (!tableReady)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            c = (uint32_t)i;
+            for (k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        tableReady = 1;
+    }
+
+    /* Checksum */
+    crc = 0xFFFFFFFFu;
+    for (i = 0; i < bytes; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+struct MeshFileSection *getMeshFileSection(struct MeshFile *file, const char *name, uint32_t type, uint32_t ndim, uint64_t cols)
+/* Section called name with the expected type, rank and number of columns, NULL if there is none */
+{
+
+    /* Parameters */
+    struct MeshFileHeader *header = (struct MeshFileHeader *)file->data;
+    struct MeshFileSection *sections = (struct MeshFileSection *)(file->data + sizeof(struct MeshFileHeader));
+    size_t itemBytes = (type == MESH_FILE_INT32) ? sizeof(int) : sizeof(double);
+    uint32_t k;
+
+    /* Search */
+    for (k = 0; k < header->nSections; k++)
+    {
+        if (strncmp(sections[k].name, name, sizeof(sections[k].name)) != 0) continue;
+
+        if ((sections[k].type != type) || (sections[k].ndim != ndim)) break;
+        if ((ndim == 2) && (sections[k].shape[1] != cols)) break;
+        if (sections[k].bytes != sections[k].shape[0] * sections[k].shape[1] * itemBytes) break;
+        if ((sections[k].offset % MESH_FILE_ALIGNMENT != 0) || (sections[k].offset + sections[k].bytes > file->bytes)) break;
+
+        return &sections[k];
+    }
+
+    printf("    > Mesh file section %s is missing or invalid\n", name);
+
+    return NULL;
+}
+
+int getMeshFileSurface(struct MeshFile *file, struct SurfaceMesh *surface)
+{
+
+    /* Parameters */
+    struct MeshFileSection *vertices = getMeshFileSection(file, "vertices", MESH_FILE_FLOAT64, 2, 3);
+    struct MeshFileSection *faces = getMeshFileSection(file, "faces", MESH_FILE_INT32, 2, 3);
+    struct MeshFileSection *sections[10];
+    const char *names[10] = {"facesAreas", "facesMaxDistance", "facesCenter", "controlPoints", "p1Local", "p2Local", "p3Local", "e1", "e2", "e3"};
+    uint32_t ndim[10] = {1, 1, 2, 2, 2, 2, 2, 2, 2, 2};
+    uint64_t cols[10] = {1, 1, 3, 3, 2, 2, 2, 3, 3, 3};
+    double **targets[10] = {&surface->facesAreas, &surface->facesMaxDistance, &surface->facesCenter, &surface->controlPoints, &surface->p1, &surface->p2, &surface->p3, &surface->e1, &surface->e2, &surface->e3};
+    int k;
+
+    if ((vertices == NULL) || (faces == NULL)) return 0;
+    if ((vertices->shape[0] > INT32_MAX) || (faces->shape[0] > INT32_MAX)) return 0;
+
+    surface->nv = (int)vertices->shape[0];
+    surface->nf = (int)faces->shape[0];
+    surface->vertices = (double *)(file->data + vertices->offset);
+    surface->faces = (int *)(file->data + faces->offset);
+
+    /* Faces fields */
+    for (k = 0; k < 10; k++)
+    {
+        sections[k] = getMeshFileSection(file, names[k], MESH_FILE_FLOAT64, ndim[k], cols[k]);
+        if ((sections[k] == NULL) || (sections[k]->shape[0] != faces->shape[0])) return 0;
+        *targets[k] = (double *)(file->data + sections[k]->offset);
+    }
+
+    return 1;
+}
+
+struct WakeMeshPart emptyWakeMeshPart()
+{
+    struct WakeMeshPart part;
+
+    part.nSpan = 0;
+    part.nWake = 0;
+    part.grid = NULL;
+    part.vertices = NULL;
+    part.faces = NULL;
+
+    return part;
+}
+
+int getMeshFileWake(struct MeshFile *file, struct WakeMeshPart *part)
+/* The wake is optional: without a wake_grid section the part is empty */
+{
+
+    /* Parameters */
+    struct MeshFileHeader *header = (struct MeshFileHeader *)file->data;
+    struct MeshFileSection *sections = (struct MeshFileSection *)(file->data + sizeof(struct MeshFileHeader));
+    struct MeshFileSection *grid, *vertices, *faces;
+    uint32_t k;
+
+    /* Initialize */
+    *part = emptyWakeMeshPart();
+
+    for (k = 0; k < header->nSections; k++)
+    {
+        if (strncmp(sections[k].name, "wake_grid", sizeof(sections[k].name)) == 0) break;
+    }
+
+    if (k == header->nSections) return 1;
+
+    /* Sections */
+    grid = getMeshFileSection(file, "wake_grid", MESH_FILE_INT32, 2, sections[k].shape[1]);
+    vertices = getMeshFileSection(file, "wake_vertices", MESH_FILE_FLOAT64, 2, 3);
+    faces = getMeshFileSection(file, "wake_faces", MESH_FILE_INT32, 2, 2);
+
+    if ((grid == NULL) || (vertices == NULL) || (faces == NULL)) return 0;
+    if ((grid->shape[0] > INT32_MAX) || (grid->shape[1] > INT32_MAX)) return 0;
+    if (faces->shape[0] + 1 != grid->shape[0]) return 0;
+
+    part->nSpan = (int)grid->shape[0];
+    part->nWake = (int)grid->shape[1];
+    part->grid = (int *)(file->data + grid->offset);
+    part->vertices = (double *)(file->data + vertices->offset);
+    part->faces = (int *)(file->data + faces->offset);
+
+    return 1;
+}
+
+int loadMeshFile(const char *path, struct MeshFile *file, struct Mesh *mesh)
+/*
+    Maps the mesh file and points mesh into it. The wake goes to the tail
+    part, as in utils/solver.py. Returns 0 if the file cannot be read or
+    is not a valid mesh file.
+*/
+{
+
+    /* Parameters */
+    struct MeshFileHeader *header;
+    struct stat info;
+    void *map;
+    int fd, ok;
+
+    /* Initialize */
+    file->data = NULL;
+    file->bytes = 0;
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        printf("    > Could not open the mesh file %s\n", path);
+        return 0;
+    }
+
+    if ((fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(struct MeshFileHeader)))
+    {
+        printf("    > %s is not a mesh file\n", path);
+        close(fd);
+        return 0;
+    }
+
+    /* Map */
+    map = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        printf("    > Could not map the mesh file %s\n", path);
+        return 0;
+    }
+
+    file->data = (char *)map;
+    file->bytes = (size_t)info.st_size;
+
+    /* Header */
+    header = (struct MeshFileHeader *)file->data;
+
+    ok = memcmp(header->magic, meshFileMagic, sizeof(header->magic)) == 0;
+    ok = ok && (header->version == MESH_FILE_VERSION);
+    ok = ok && (header->byteOrder == MESH_FILE_BYTE_ORDER);
+    ok = ok && (header->fileBytes == file->bytes);
+    ok = ok && (header->dataOffset == sizeof(struct MeshFileHeader) + (uint64_t)header->nSections * sizeof(struct MeshFileSection));
+    ok = ok && (header->dataOffset <= file->bytes);
+
+    if (!ok)
+    {
+        printf("    > %s is not a version %d mesh file\n", path, MESH_FILE_VERSION);
+        freeMeshFile(file);
+        return 0;
+    }
+
+    if (meshFileChecksum((unsigned char *)file->data + header->dataOffset, file->bytes - header->dataOffset) != header->checksum)
+    {
+        printf("    > Checksum mismatch in the mesh file %s\n", path);
+        freeMeshFile(file);
+        return 0;
+    }
+
+    madvise(file->data, file->bytes, MADV_WILLNEED);
+
+    /* Mesh */
+    ok = getMeshFileSurface(file, &mesh->surface);
+    ok = ok && getMeshFileWake(file, &mesh->wake.tail);
+
+    mesh->wake.left = emptyWakeMeshPart();
+    mesh->wake.right = emptyWakeMeshPart();
+
+    if (!ok)
+    {
+        freeMeshFile(file);
+        return 0;
+    }
+
+    return 1;
+}
+
+void freeMeshFile(struct MeshFile *file)
+{
+    if (file->data != NULL) munmap(file->data, file->bytes);
+
+    file->data = NULL;
+    file->bytes = 0;
+}
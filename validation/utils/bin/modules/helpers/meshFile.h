@@ -0,0 +1,57 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "structs.h"
+
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_BYTE_ORDER 0x01020304u
+#define MESH_FILE_ALIGNMENT 64
+
+#define MESH_FILE_INT32 1
+#define MESH_FILE_FLOAT64 2
+
+/*
+    Binary mesh container written by utils/meshfile.py. A 64 byte header is
+    followed by a table of 64 byte section descriptors and by the sections,
+    each one a C ordered array aligned to MESH_FILE_ALIGNMENT bytes. The
+    checksum is the CRC-32 of everything after the section table. The file
+    is mapped copy on write and the mesh points straight into the mapping.
+*/
+struct MeshFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t nSections;
+    uint32_t reserved0;
+    uint64_t fileBytes;
+    uint64_t dataOffset;       // first byte after the section table
+    uint32_t checksum;
+    uint32_t reserved1;
+    char reserved[16];
+};
+
+struct MeshFileSection
+{
+    char name[24];
+    uint32_t type;             // MESH_FILE_INT32 or MESH_FILE_FLOAT64
+    uint32_t ndim;
+    uint64_t shape[2];         // unused dimensions are 1
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+struct MeshFile
+{
+    char *data;                // NULL if nothing is mapped
+    size_t bytes;
+};
+
+int loadMeshFile(const char *path, struct MeshFile *file, struct Mesh *mesh);
+void freeMeshFile(struct MeshFile *file);
+
+#include "meshFile.c"
+
+#endif
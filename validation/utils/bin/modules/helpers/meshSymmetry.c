@@ -0,0 +1,418 @@
+#include <math.h>
+#include <string.h>
+#include "meshSymmetry.h"
+
+struct MirrorVertex
+{
+    double x;
+    int index;
+};
+
+struct MirrorFace
+{
+    int v[3];              // vertices in ascending order
+    int index;
+};
+
+int compareMirrorVertex(const void *a, const void *b)
+{
+    double d = ((const struct MirrorVertex *)a)->x - ((const struct MirrorVertex *)b)->x;
+    return (d > 0) - (d < 0);
+}
+
+int compareMirrorFace(const void *a, const void *b)
+{
+    const int *u = ((const struct MirrorFace *)a)->v;
+    const int *v = ((const struct MirrorFace *)b)->v;
+    int k;
+
+    for (k = 0; k < 3; k++) if (u[k] != v[k]) return (u[k] > v[k]) - (u[k] < v[k]);
+
+    return 0;
+}
+
+void sortMirrorFace(struct MirrorFace *face, int a, int b, int c)
+{
+    int t;
+
+    if (a > b) { t = a; a = b; b = t; }
+    if (b > c) { t = b; b = c; c = t; }
+    if (a > b) { t = a; a = b; b = t; }
+
+    face->v[0] = a;
+    face->v[1] = b;
+    face->v[2] = c;
+}
+
+double getMeshSymmetryTolerance(struct SurfaceMesh surface)
+/* Rounding tolerance of the coordinates: 1e-9 of the largest one */
+{
+    double tolerance = 0.0;
+    int i;
+
+    for (i = 0; i < 3 * surface.nv; i++) tolerance = (fabs(surface.vertices[i]) > tolerance) ? fabs(surface.vertices[i]) : tolerance;
+
+    return 1e-9 * tolerance;
+}
+
+int getImageVertices(struct SurfaceMesh surface, double tolerance, int *image)
+/* Image of each vertex, searched among the vertices of close x. Returns 0 if one has none */
+{
+
+    /* Parameters */
+    struct MirrorVertex *sorted = (struct MirrorVertex *)malloc(((size_t)surface.nv + 1) * sizeof(struct MirrorVertex));
+    double *p, *q;
+    int i, k, m, lo, hi, ok = 1;
+
+    /* Vertices sorted by x */
+    for (i = 0; i < surface.nv; i++) sorted[i] = (struct MirrorVertex){surface.vertices[3 * i], i};
+
+    qsort(sorted, surface.nv, sizeof(struct MirrorVertex), compareMirrorVertex);
+
+    /* Images */
+    for (k = 0; ok && (k < surface.nv); k++)
+    {
+        i = sorted[k].index;
+        p = &surface.vertices[3 * i];
+        image[i] = -1;
+
+        lo = 0;
+        hi = surface.nv;
+
+        while (lo < hi)
+        {
+            m = (lo + hi) / 2;
+            if (sorted[m].x < p[0] - tolerance) lo = m + 1; else hi = m;
+        }
+
+        for (m = lo; (m < surface.nv) && (sorted[m].x <= p[0] + tolerance); m++)
+        {
+            q = &surface.vertices[3 * sorted[m].index];
+
+            if ((fabs(q[1] + p[1]) <= tolerance) && (fabs(q[2] - p[2]) <= tolerance))
+            {
+                image[i] = sorted[m].index;
+                break;
+            }
+        }
+
+        ok = image[i] >= 0;
+    }
+
+    /* Free */
+    free(sorted);
+
+    return ok;
+}
+
+int getImageFaces(struct SurfaceMesh surface, int *imageVertices, int *image)
+/* Image of each face, the face with the images of its vertices. Returns 0 if one has none */
+{
+
+    /* Parameters */
+    struct MirrorFace *sorted = (struct MirrorFace *)malloc(((size_t)surface.nf + 1) * sizeof(struct MirrorFace));
+    struct MirrorFace key, *found;
+    int *f;
+    int i, ok = 1;
+
+    /* Faces sorted by their vertices */
+    for (i = 0; i < surface.nf; i++)
+    {
+        f = &surface.faces[3 * i];
+        sortMirrorFace(&sorted[i], f[0], f[1], f[2]);
+        sorted[i].index = i;
+    }
+
+    qsort(sorted, surface.nf, sizeof(struct MirrorFace), compareMirrorFace);
+
+    /* Images */
+    for (i = 0; ok && (i < surface.nf); i++)
+    {
+        f = &surface.faces[3 * i];
+        sortMirrorFace(&key, imageVertices[f[0]], imageVertices[f[1]], imageVertices[f[2]]);
+
+        found = (struct MirrorFace *)bsearch(&key, sorted, surface.nf, sizeof(struct MirrorFace), compareMirrorFace);
+
+        image[i] = (found != NULL) ? found->index : -1;
+        ok = (image[i] >= 0) && (image[i] != i);
+    }
+
+    /* Free */
+    free(sorted);
+
+    return ok;
+}
+
+double *wakeLinePoint(struct WakeMeshPart part, int k, int w)
+{
+    return &part.vertices[3 * part.grid[k * part.nWake + w]];
+}
+
+int wakeLineSide(struct WakeMeshPart part, int k, double tolerance)
+/* 1 if the line k is on the y >= 0 side, 2 if it is on the plane itself, 0 otherwise */
+{
+    int w, plane = 1;
+
+    for (w = 0; w < part.nWake; w++)
+    {
+        if (wakeLinePoint(part, k, w)[1] < -tolerance) return 0;
+        plane = plane && (wakeLinePoint(part, k, w)[1] <= tolerance);
+    }
+
+    return plane ? 2 : 1;
+}
+
+int wakeLineImage(struct WakeMeshPart part, int k, struct WakeMeshPart other, double tolerance)
+/* Line of other that is the image of the line k of part, -1 if none */
+{
+    double *p, *q;
+    int m, w, same;
+
+    for (m = 0; (m < other.nSpan) && (other.nWake == part.nWake); m++)
+    {
+        same = 1;
+
+        for (w = 0; same && (w < part.nWake); w++)
+        {
+            p = wakeLinePoint(part, k, w);
+            q = wakeLinePoint(other, m, w);
+            same = (fabs(q[0] - p[0]) <= tolerance) && (fabs(q[1] + p[1]) <= tolerance) && (fabs(q[2] - p[2]) <= tolerance);
+        }
+
+        if (same) return m;
+    }
+
+    return -1;
+}
+
+int wakePartsImages(struct WakeMeshPart part, struct WakeMeshPart other, double tolerance)
+/* part is on the y >= 0 side and other is its image */
+{
+    int k, plane, ok = part.nSpan == other.nSpan;
+
+    for (k = 0; ok && (k < part.nSpan); k++)
+    {
+        plane = wakeLineSide(part, k, tolerance);
+        ok = (plane == 2) || ((plane == 1) && (wakeLineImage(part, k, other, tolerance) >= 0));
+    }
+
+    for (k = 0; ok && (k < other.nSpan); k++) ok = wakeLineImage(other, k, part, tolerance) >= 0;
+
+    return ok;
+}
+
+int getHalfWakeLines(struct WakeMeshPart part, double tolerance, int *first, int *nSpan)
+/* Lines of a mirror symmetric wake part on the y >= 0 side, which must follow each other. Returns 0 if the part is not mirror symmetric */
+{
+    int k, plane, ok = 1;
+
+    *first = 0;
+    *nSpan = 0;
+
+    for (k = 0; ok && (k < part.nSpan); k++)
+    {
+        plane = wakeLineSide(part, k, tolerance);
+
+        if (plane)
+        {
+            if (*nSpan == 0) *first = k;
+            ok = (*first + *nSpan == k) && ((plane == 2) || (wakeLineImage(part, k, part, tolerance) >= 0));
+            (*nSpan)++;
+        }
+        else
+        {
+            ok = wakeLineImage(part, k, part, tolerance) >= 0;
+        }
+    }
+
+    return ok;
+}
+
+int getHalfWakeFaces(struct WakeMeshPart part, int first, int nSpan, int *halfFaces, int *faces)
+/* Faces of the strips of the lines first to first + nSpan - 1, as half faces. Returns 0 if one is an image face */
+{
+    int s;
+
+    for (s = 0; s < 2 * (nSpan - 1); s++)
+    {
+        faces[s] = halfFaces[part.faces[2 * first + s]];
+        if (faces[s] < 0) return 0;
+    }
+
+    return 1;
+}
+
+int getMeshSymmetry(struct Mesh mesh, struct MeshSymmetry *symmetry)
+/* Returns 0, with nothing allocated, if the mesh or its wake is not mirror symmetric or a face crosses the plane */
+{
+
+    /* Parameters */
+    struct SurfaceMesh surface = mesh.surface;
+    struct WakeMeshPart parts[3] = {mesh.wake.left, mesh.wake.right, mesh.wake.tail};
+    struct WakeMeshPart *halfParts[3];
+    double tolerance = getMeshSymmetryTolerance(surface);
+    double *frames[10] = {surface.facesAreas, surface.facesMaxDistance, surface.facesCenter, surface.controlPoints, surface.p1, surface.p2, surface.p3, surface.e1, surface.e2, surface.e3};
+    double **halfFrames[10];
+    int strides[10] = {1, 1, 3, 3, 2, 2, 2, 3, 3, 3};
+    int *imageVertices, *imageFaces, *halfVertices, *halfFaces;
+    int nv = surface.nv, nf = surface.nf, nvh = 0, nfh = 0, ok;
+    int firsts[3] = {0, 0, 0}, nSpans[3] = {0, 0, 0};
+    int i, k;
+    size_t nDoubles, nInts;
+    double *doubles;
+    int *ints, *f;
+
+    /* Initialize */
+    imageVertices = (int *)malloc(((size_t)nv + 1) * sizeof(int));
+    imageFaces = (int *)malloc(((size_t)nf + 1) * sizeof(int));
+    halfVertices = (int *)malloc(((size_t)nv + 1) * sizeof(int));
+    halfFaces = (int *)malloc(((size_t)nf + 1) * sizeof(int));
+
+    /* Images of the vertices and faces */
+    ok = getImageVertices(surface, tolerance, imageVertices) && getImageFaces(surface, imageVertices, imageFaces);
+
+    /* Half: the faces with their center on the y > 0 side, none crossing the plane */
+    for (i = 0; i < nv; i++) halfVertices[i] = -1;
+
+    for (i = 0; ok && (i < nf); i++)
+    {
+        f = &surface.faces[3 * i];
+        halfFaces[i] = -1;
+
+        if (surface.vertices[3 * f[0] + 1] + surface.vertices[3 * f[1] + 1] + surface.vertices[3 * f[2] + 1] <= 0.0) continue;
+
+        for (k = 0; k < 3; k++)
+        {
+            ok = ok && (surface.vertices[3 * f[k] + 1] >= -tolerance);
+            halfVertices[f[k]] = 0;
+        }
+
+        halfFaces[i] = nfh++;
+    }
+
+    ok = ok && (2 * nfh == nf);
+
+    for (i = 0; ok && (i < nv); i++) if (halfVertices[i] == 0) halfVertices[i] = nvh++;
+
+    /* Wakes: the left and right ones images of each other, or each mirror symmetric as the tail one */
+    if (ok && wakePartsImages(mesh.wake.left, mesh.wake.right, tolerance))
+    {
+        nSpans[0] = mesh.wake.left.nSpan;
+    }
+    else if (ok && wakePartsImages(mesh.wake.right, mesh.wake.left, tolerance))
+    {
+        parts[0] = mesh.wake.right;
+        parts[1] = mesh.wake.left;
+        nSpans[0] = mesh.wake.right.nSpan;
+    }
+    else
+    {
+        ok = ok && getHalfWakeLines(parts[0], tolerance, &firsts[0], &nSpans[0]) && getHalfWakeLines(parts[1], tolerance, &firsts[1], &nSpans[1]);
+    }
+
+    ok = ok && getHalfWakeLines(parts[2], tolerance, &firsts[2], &nSpans[2]);
+
+    if (!ok)
+    {
+        free(imageVertices);
+        free(imageFaces);
+        free(halfVertices);
+        free(halfFaces);
+        return 0;
+    }
+
+    /* Half mesh */
+    nDoubles = 3 * (size_t)nvh + ((surface.e1 != NULL) ? 23 * (size_t)nfh : 0);
+    nInts = (size_t)nvh + 5 * (size_t)nfh + 2 * ((size_t)nSpans[0] + nSpans[1] + nSpans[2]);
+
+    symmetry->data = malloc(nDoubles * sizeof(double) + nInts * sizeof(int));
+    doubles = (double *)symmetry->data;
+    ints = (int *)(doubles + nDoubles);
+
+    symmetry->vertices = ints;
+    symmetry->faces = symmetry->vertices + nvh;
+    symmetry->imageFaces = symmetry->faces + nfh;
+    symmetry->mesh = mesh;
+    symmetry->mesh.surface.nv = nvh;
+    symmetry->mesh.surface.nf = nfh;
+    symmetry->mesh.surface.vertices = doubles;
+    symmetry->mesh.surface.faces = symmetry->imageFaces + nfh;
+
+    for (i = 0; i < nv; i++)
+    {
+        if (halfVertices[i] < 0) continue;
+
+        symmetry->vertices[halfVertices[i]] = i;
+        for (k = 0; k < 3; k++) symmetry->mesh.surface.vertices[3 * halfVertices[i] + k] = surface.vertices[3 * i + k];
+    }
+
+    for (i = 0; i < nf; i++)
+    {
+        if (halfFaces[i] < 0) continue;
+
+        symmetry->faces[halfFaces[i]] = i;
+        symmetry->imageFaces[halfFaces[i]] = imageFaces[i];
+        for (k = 0; k < 3; k++) symmetry->mesh.surface.faces[3 * halfFaces[i] + k] = halfVertices[surface.faces[3 * i + k]];
+    }
+
+    // Panel geometry of the half faces, when the full mesh brings its own
+    if (surface.e1 != NULL)
+    {
+        struct SurfaceMesh *half = &symmetry->mesh.surface;
+
+        halfFrames[0] = &half->facesAreas;
+        halfFrames[1] = &half->facesMaxDistance;
+        halfFrames[2] = &half->facesCenter;
+        halfFrames[3] = &half->controlPoints;
+        halfFrames[4] = &half->p1;
+        halfFrames[5] = &half->p2;
+        halfFrames[6] = &half->p3;
+        halfFrames[7] = &half->e1;
+        halfFrames[8] = &half->e2;
+        halfFrames[9] = &half->e3;
+
+        doubles = doubles + 3 * (size_t)nvh;
+
+        for (k = 0; k < 10; k++)
+        {
+            *halfFrames[k] = doubles;
+
+            for (i = 0; i < nfh; i++) memcpy(&doubles[(size_t)strides[k] * i], &frames[k][(size_t)strides[k] * symmetry->faces[i]], strides[k] * sizeof(double));
+
+            doubles = doubles + (size_t)strides[k] * nfh;
+        }
+    }
+
+    // Wakes, sharing the grids and vertices of the full mesh
+    halfParts[0] = &symmetry->mesh.wake.left;
+    halfParts[1] = &symmetry->mesh.wake.right;
+    halfParts[2] = &symmetry->mesh.wake.tail;
+
+    ints = symmetry->mesh.surface.faces + 3 * (size_t)nfh;
+
+    for (k = 0; k < 3; k++)
+    {
+        *halfParts[k] = parts[k];
+        halfParts[k]->nSpan = nSpans[k];
+        halfParts[k]->grid = (nSpans[k] > 0) ? parts[k].grid + (size_t)firsts[k] * parts[k].nWake : parts[k].grid;
+        halfParts[k]->faces = ints;
+
+        ok = ok && getHalfWakeFaces(parts[k], firsts[k], nSpans[k], halfFaces, ints);
+        ints = ints + 2 * (size_t)nSpans[k];
+    }
+
+    /* Free */
+    free(imageVertices);
+    free(imageFaces);
+    free(halfVertices);
+    free(halfFaces);
+
+    if (!ok) free(symmetry->data);
+
+    return ok;
+}
+
+void freeMeshSymmetry(struct MeshSymmetry symmetry)
+{
+    free(symmetry.data);
+}
@@ -0,0 +1,33 @@
+#ifndef MESH_SYMMETRY_H
+#define MESH_SYMMETRY_H
+
+#include <stdlib.h>
+#include "structs.h"
+
+/*
+    Mirror symmetry of a mesh about the y = 0 plane. The half is the y >= 0
+    side: its vertices and faces are vertices[i] and faces[i] of the full
+    mesh, and the image of its face i is imageFaces[i]. mesh is the half on
+    its own, with the panel geometry of its faces when the full mesh has
+    one. Its wake is the one on the y >= 0 side: the left part when the
+    right one is its image (the parts are swapped if needed), otherwise
+    the lines of each part on that side. The wake grids and vertices of the
+    full mesh are shared, only the wake faces are owned.
+*/
+struct MeshSymmetry
+{
+    int *vertices;
+    int *faces;
+    int *imageFaces;
+    struct Mesh mesh;
+    void *data;
+};
+
+double getMeshSymmetryTolerance(struct SurfaceMesh surface);
+
+int getMeshSymmetry(struct Mesh mesh, struct MeshSymmetry *symmetry);
+void freeMeshSymmetry(struct MeshSymmetry symmetry);
+
+#include "meshSymmetry.c"
+
+#endif
@@ -0,0 +1,152 @@
+#include "meshTopology.h"
+
+int halfEdgeFace(int halfEdge)
+{
+    return halfEdge / 3;
+}
+
+int halfEdgeNext(int halfEdge)
+{
+    return (halfEdge % 3 == 2) ? halfEdge - 2 : halfEdge + 1;
+}
+
+int halfEdgePrev(int halfEdge)
+{
+    return (halfEdge % 3 == 0) ? halfEdge + 2 : halfEdge - 1;
+}
+
+int halfEdgeOrigin(struct MeshTopology *topology, int halfEdge)
+{
+    return topology->faces[halfEdge];
+}
+
+int halfEdgeTarget(struct MeshTopology *topology, int halfEdge)
+{
+    return topology->faces[halfEdgeNext(halfEdge)];
+}
+
+int vertexStarSize(struct MeshTopology *topology, int vertex)
+{
+    return topology->vertexOffsets[vertex + 1] - topology->vertexOffsets[vertex];
+}
+
+int vertexStarFace(struct MeshTopology *topology, int vertex, int k)
+{
+    return topology->vertexHalfEdges[topology->vertexOffsets[vertex] + k] / 3;
+}
+
+int edgeNeighbour(struct MeshTopology *topology, int face, int edge)
+{
+    int twin = topology->twin[3 * face + edge];
+    return (twin < 0) ? -1 : twin / 3;
+}
+
+struct MeshTopology getMeshTopology(int nv, int nf, int *faces)
+{
+
+    /* Parameters */
+    int i, j, k, h, n, nBoundary;
+    int *cursor;
+    char *used;
+    struct MeshTopology topology;
+
+    /* Initialize */
+    topology.nv = nv;
+    topology.nf = nf;
+    topology.faces = faces;
+
+    topology.data = malloc((3 * (size_t)nf + (size_t)nv + 1 + 3 * (size_t)nf) * sizeof(int));
+    topology.twin = (int *)topology.data;
+    topology.vertexOffsets = topology.twin + 3 * (size_t)nf;
+    topology.vertexHalfEdges = topology.vertexOffsets + nv + 1;
+
+    cursor = (int *)malloc(nv * sizeof(int));
+
+    /* Outgoing half edges of each vertex */
+    for (i = 0; i <= nv; i++) topology.vertexOffsets[i] = 0;
+    for (h = 0; h < 3 * nf; h++) topology.vertexOffsets[faces[h] + 1]++;
+
+    for (i = 0; i < nv; i++) {
+        topology.vertexOffsets[i + 1] = topology.vertexOffsets[i + 1] + topology.vertexOffsets[i];
+        cursor[i] = topology.vertexOffsets[i];
+    }
+
+    for (h = 0; h < 3 * nf; h++) topology.vertexHalfEdges[cursor[faces[h]]++] = h;
+
+    /* Twins, searched among the outgoing half edges of the target vertex */
+    nBoundary = 0;
+
+    for (h = 0; h < 3 * nf; h++) {
+
+        topology.twin[h] = -1;
+
+        j = halfEdgeTarget(&topology, h);
+
+        for (k = topology.vertexOffsets[j]; k < topology.vertexOffsets[j + 1]; k++) {
+            if (halfEdgeTarget(&topology, topology.vertexHalfEdges[k]) == faces[h]) {
+                topology.twin[h] = topology.vertexHalfEdges[k];
+                break;
+            }
+        }
+
+        /* Neighbour with the opposite orientation */
+        if (topology.twin[h] < 0) {
+            j = faces[h];
+            for (k = topology.vertexOffsets[j]; k < topology.vertexOffsets[j + 1]; k++) {
+                if ((topology.vertexHalfEdges[k] != h) && (halfEdgeTarget(&topology, topology.vertexHalfEdges[k]) == halfEdgeTarget(&topology, h))) {
+                    topology.twin[h] = topology.vertexHalfEdges[k];
+                    break;
+                }
+            }
+        }
+
+        if (topology.twin[h] < 0) nBoundary++;
+    }
+
+    /* Boundary loops, chaining each boundary half edge to the next one leaving its target */
+    topology.loopData = malloc(((size_t)2 * nBoundary + 1) * sizeof(int));
+    topology.loopHalfEdges = (int *)topology.loopData;
+    topology.loopOffsets = topology.loopHalfEdges + nBoundary;
+    topology.nLoops = 0;
+    topology.loopOffsets[0] = 0;
+
+    used = (char *)calloc(3 * (size_t)nf, sizeof(char));
+    n = 0;
+
+    for (h = 0; h < 3 * nf; h++) {
+
+        if ((topology.twin[h] >= 0) || (used[h] == 1)) continue;
+
+        i = h;
+
+        while (i >= 0) {
+
+            topology.loopHalfEdges[n++] = i;
+            used[i] = 1;
+
+            j = halfEdgeTarget(&topology, i);
+            i = -1;
+
+            for (k = topology.vertexOffsets[j]; k < topology.vertexOffsets[j + 1]; k++) {
+                if ((topology.twin[topology.vertexHalfEdges[k]] < 0) && (used[topology.vertexHalfEdges[k]] == 0)) {
+                    i = topology.vertexHalfEdges[k];
+                    break;
+                }
+            }
+        }
+
+        topology.nLoops++;
+        topology.loopOffsets[topology.nLoops] = n;
+    }
+
+    free(used);
+    free(cursor);
+
+    return topology;
+}
+
+void freeMeshTopology(struct MeshTopology topology)
+{
+    free(topology.data);
+    free(topology.loopData);
+}
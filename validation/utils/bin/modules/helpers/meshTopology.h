@@ -0,0 +1,41 @@
+#ifndef MESH_TOPOLOGY_H
+#define MESH_TOPOLOGY_H
+
+#include <stdlib.h>
+
+/*
+    Half edge topology of a triangle mesh. The half edge h = 3 * face + k
+    goes from faces[h] to faces[3 * face + (k + 1) % 3], so only the twins,
+    the outgoing half edges of each vertex and the boundary loops are stored.
+*/
+struct MeshTopology
+{
+    int nv;
+    int nf;
+    int *faces;            // 3 vertices per face (not owned)
+    int *twin;             // half edge of the neighbour face on the same edge, -1 on boundary edges
+    int *vertexOffsets;    // outgoing half edges of vertex i are vertexHalfEdges[vertexOffsets[i]] ... vertexHalfEdges[vertexOffsets[i + 1] - 1]
+    int *vertexHalfEdges;  // in ascending face order
+    int nLoops;
+    int *loopOffsets;      // half edges of loop i are loopHalfEdges[loopOffsets[i]] ... loopHalfEdges[loopOffsets[i + 1] - 1]
+    int *loopHalfEdges;    // boundary half edges, chained head to tail
+    void *data;
+    void *loopData;
+};
+
+struct MeshTopology getMeshTopology(int nv, int nf, int *faces);
+void freeMeshTopology(struct MeshTopology topology);
+
+int halfEdgeFace(int halfEdge);
+int halfEdgeNext(int halfEdge);
+int halfEdgePrev(int halfEdge);
+int halfEdgeOrigin(struct MeshTopology *topology, int halfEdge);
+int halfEdgeTarget(struct MeshTopology *topology, int halfEdge);
+
+int vertexStarSize(struct MeshTopology *topology, int vertex);
+int vertexStarFace(struct MeshTopology *topology, int vertex, int k);
+int edgeNeighbour(struct MeshTopology *topology, int face, int edge);
+
+#include "meshTopology.c"
+
+#endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef PANEL_FRAMES_H
+#define PANEL_FRAMES_H
+
+#include "structs.h"
+
+#define CONTROL_POINT_OFFSET 1e-8
+
+/*
+    Geometry of the panels derived from the vertices and faces: center,
+    local frame (e1 towards the second vertex, e3 normal), control point,
+    area, far field distance and vertices in local coordinates. The arrays
+    have the layout of SurfaceMesh, which can point straight into them.
+*/
+struct PanelFrames
+{
+    int nf;
+    double *facesAreas;
+    double *facesMaxDistance;
+    double *facesCenter;
+    double *controlPoints;
+    double *p1;
+    double *p2;
+    double *p3;
+    double *e1;
+    double *e2;
+    double *e3;
+};
+
+struct PanelFrames getPanelFramesData(int nf);
+void freePanelFramesData(struct PanelFrames frames);
+
+void getPanelFrames(int nf, double *vertices, int *faces, double controlPointOffset, struct PanelFrames frames);
+void setSurfaceMeshFrames(struct SurfaceMesh *surface, struct PanelFrames frames);
+
+#include "panelFrames.c"
+
+#endif
@@ -49,6 +49,7 @@ struct Environment {
     double density;
     double viscosity;
     double soundSpeed;
+    double rot_x, rot_y, rot_z;     // body rotation rate: the onset at x is vel - rot x x
 };
 
 struct Input {
@@ -74,9 +75,11 @@ struct Point {
 };
 
 struct VerticesConnection {
-    int n;
-    double *coeffs;
+    int nv;
+    int *offsets;     // faces of vertex i are faces[offsets[i]] ... faces[offsets[i + 1] - 1]
     int *faces;
+    double *coeffs;
+    void *data;       // single allocation holding coeffs, offsets and faces
 };
 
 struct FacesConnection {
@@ -84,10 +87,22 @@ struct FacesConnection {
     int *faces;
 };
 
-struct VerticesConnection* getVerticesConnectionData(int nv) {
-    struct VerticesConnection *verticesConnection;
-    verticesConnection = (struct VerticesConnection*)malloc(nv * sizeof(struct VerticesConnection));
+struct VerticesConnection getVerticesConnectionData(int nv, int nf) {
+
+    struct VerticesConnection verticesConnection;
+
+    /* Each face adds three entries */
+    verticesConnection.nv = nv;
+    verticesConnection.data = malloc(3 * (size_t)nf * sizeof(double) + ((size_t)nv + 1 + 3 * (size_t)nf) * sizeof(int));
+    verticesConnection.coeffs = (double*)verticesConnection.data;
+    verticesConnection.offsets = (int*)(verticesConnection.coeffs + 3 * (size_t)nf);
+    verticesConnection.faces = verticesConnection.offsets + nv + 1;
+
     return verticesConnection;
 }
 
+void freeVerticesConnectionData(struct VerticesConnection verticesConnection) {
+    free(verticesConnection.data);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "tiledMatrix.h"
+
+int getTiledMatrixScratch(struct TiledMatrix *matrix, const char *scratchDirectory)
+/* Maps data to an anonymous scratch file in scratchDirectory */
+{
+
+    /* Parameters */
+    char path[4096];
+    void *map;
+
+    /* Create */
+    snprintf(path, sizeof(path), "%s/tiledMatrixXXXXXX", scratchDirectory);
+
+    matrix->fd = mkstemp(path);
+    if (matrix->fd < 0) return 0;
+    unlink(path);
+
+    if (ftruncate(matrix->fd, (off_t)matrix->bytes) != 0)
+    {
+        close(matrix->fd);
+        matrix->fd = -1;
+        return 0;
+    }
+
+    map = mmap(NULL, matrix->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, matrix->fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+        close(matrix->fd);
+        matrix->fd = -1;
+        return 0;
+    }
+
+    matrix->data = (double *)map;
+
+    posix_fadvise(matrix->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    madvise(matrix->data, matrix->bytes, MADV_SEQUENTIAL);
+
+    return 1;
+}
+
+struct TiledMatrix getTiledMatrix(int n, const char *scratchDirectory)
+/*
+    scratchDirectory = NULL keeps the matrix on the heap, falling back to a
+    scratch file in TMPDIR when the allocation fails.
+*/
+{
+
+    /* Parameters */
+    struct TiledMatrix matrix;
+    const char *tmp;
+
+    /* Initialize */
+    matrix.n = n;
+    matrix.nTiles = (n + TILE_SIZE - 1) / TILE_SIZE;
+    matrix.bytes = (size_t)matrix.nTiles * matrix.nTiles * TILE_SIZE * TILE_SIZE * sizeof(double);
+    matrix.data = NULL;
+    matrix.fd = -1;
+
+    /* Storage, zeroed so that the padding of the last tiles, never assembled, is deterministic in the cache files (scratch files start zeroed) */
+    if (scratchDirectory == NULL)
+    {
+        matrix.data = (double *)calloc(matrix.bytes, 1);
+        if (matrix.data != NULL) return matrix;
+
+        tmp = getenv("TMPDIR");
+        scratchDirectory = (tmp != NULL) ? tmp : "/tmp";
+        printf("    > Not enough memory for a %d x %d matrix, using a scratch file in %s\n", n, n, scratchDirectory);
+    }
+
+    if (!getTiledMatrixScratch(&matrix, scratchDirectory))
+    {
+        printf("    > Could not create a %.1f GB scratch file in %s\n", matrix.bytes / 1073741824.0, scratchDirectory);
+    }
+
+    return matrix;
+}
+
+struct TiledMatrix getTiledMatrixMap(int n, int fd, off_t offset)
+/*
+    Copy on write mapping of a matrix stored at a page aligned offset of an
+    open file. The matrix keeps its own descriptor, so fd can be closed
+    afterwards. data is NULL if the mapping fails.
+*/
+{
+
+    /* Parameters */
+    struct TiledMatrix matrix;
+    void *map;
+
+    /* Initialize */
+    matrix.n = n;
+    matrix.nTiles = (n + TILE_SIZE - 1) / TILE_SIZE;
+    matrix.bytes = (size_t)matrix.nTiles * matrix.nTiles * TILE_SIZE * TILE_SIZE * sizeof(double);
+    matrix.data = NULL;
+    matrix.fd = dup(fd);
+
+    if (matrix.fd < 0) return matrix;
+
+    /* Map */
+    map = mmap(NULL, matrix.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, matrix.fd, offset);
+
+    if (map == MAP_FAILED)
+    {
+        close(matrix.fd);
+        matrix.fd = -1;
+        return matrix;
+    }
+
+    matrix.data = (double *)map;
+
+    madvise(matrix.data, matrix.bytes, MADV_SEQUENTIAL);
+
+    return matrix;
+}
+
+void freeTiledMatrix(struct TiledMatrix *matrix)
+{
+    if (matrix->fd < 0)
+    {
+        free(matrix->data);
+    }
+    else
+    {
+        if (matrix->data != NULL) munmap(matrix->data, matrix->bytes);
+        close(matrix->fd);
+    }
+
+    matrix->data = NULL;
+    matrix->fd = -1;
+}
+
+size_t tiledMatrixIndex(struct TiledMatrix *matrix, int i, int j)
+{
+    return (((size_t)(i / TILE_SIZE) * matrix->nTiles + j / TILE_SIZE) * TILE_SIZE + i % TILE_SIZE) * TILE_SIZE + j % TILE_SIZE;
+}
+
+void tiledMatrixRowsDone(struct TiledMatrix *matrix, int tileRow)
+/* Starts the write back of an assembled tile row of a scratch file */
+{
+    size_t bytes = (size_t)matrix->nTiles * TILE_SIZE * TILE_SIZE * sizeof(double);
+
+    if (matrix->fd >= 0) msync((char *)matrix->data + tileRow * bytes, bytes, MS_ASYNC);
+}
+
+void tiledMatrixMatvec(void *context, double *x, double *y)
+/* y = A x, one tile row per thread at a time */
+{
+
+    /* Parameters */
+    struct TiledMatrix *matrix = (struct TiledMatrix *)context;
+    size_t tileRowBytes = (size_t)matrix->nTiles * TILE_SIZE * TILE_SIZE * sizeof(double);
+    int I;
+
+    /* Multiply */
+    #pragma omp parallel for schedule(static)
+    for (I = 0; I < matrix->nTiles; I++)
+    {
+
+        int J, ii, jj;
+        int rows = (I == matrix->nTiles - 1) ? matrix->n - I * TILE_SIZE : TILE_SIZE;
+        int cols;
+        double sum;
+        double *tile;
+        double *xTile;
+
+        // Read ahead the next tile row of this thread
+        if ((matrix->fd >= 0) && (I + 1 < matrix->nTiles))
+        {
+            madvise((char *)matrix->data + (I + 1) * tileRowBytes, tileRowBytes, MADV_WILLNEED);
+        }
+
+        for (ii = 0; ii < rows; ii++) y[I * TILE_SIZE + ii] = 0.0;
+
+        for (J = 0; J < matrix->nTiles; J++)
+        {
+            tile = matrix->data + ((size_t)I * matrix->nTiles + J) * TILE_SIZE * TILE_SIZE;
+            xTile = x + J * TILE_SIZE;
+            cols = (J == matrix->nTiles - 1) ? matrix->n - J * TILE_SIZE : TILE_SIZE;
+
+            for (ii = 0; ii < rows; ii++)
+            {
+                sum = 0.0;
+                for (jj = 0; jj < cols; jj++) sum = sum + tile[ii * TILE_SIZE + jj] * xTile[jj];
+                y[I * TILE_SIZE + ii] = y[I * TILE_SIZE + ii] + sum;
+            }
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef TILED_MATRIX_H
+#define TILED_MATRIX_H
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+#define TILE_SIZE 256
+
+/*
+    Dense n x n matrix stored as TILE_SIZE x TILE_SIZE tiles. The tiles of a
+    tile row are contiguous and each tile is row major, so a tile row is a
+    single block that assembly fills in one pass and the matvec streams
+    sequentially. The storage is either heap memory or, for operators
+    larger than the RAM, a memory mapped scratch file that is unlinked as
+    soon as it is created. Edge tiles are padded to the full tile size.
+*/
+struct TiledMatrix
+{
+    int n;
+    int nTiles;            // tiles per row and column
+    size_t bytes;          // size of data
+    double *data;          // NULL if the storage could not be created
+    int fd;                // scratch file, -1 for heap storage
+};
+
+struct TiledMatrix getTiledMatrix(int n, const char *scratchDirectory);
+struct TiledMatrix getTiledMatrixMap(int n, int fd, off_t offset);
+void freeTiledMatrix(struct TiledMatrix *matrix);
+
+size_t tiledMatrixIndex(struct TiledMatrix *matrix, int i, int j);
+void tiledMatrixRowsDone(struct TiledMatrix *matrix, int tileRow);
+void tiledMatrixMatvec(void *matrix, double *x, double *y);
+
+#include "tiledMatrix.c"
+
+#endif
@@ -1,110 +1,108 @@
 #include "verticesConnection.h"
 #include "structs.h"
 #include "customMath.h"
+#include "meshTopology.h"
 
-void getVerticesConnection(struct Input input, struct VerticesConnection *verticesConnection)
+void getVerticesConnection(struct Input input, struct MeshTopology *topology, struct VerticesConnection *verticesConnection)
 {
 
     /* Parameters */
-    int i, j, k, n, faceLine, verticeLine1, verticeLine2, verticeLine3;
-    int *facesIds;
-    double *angles;
+    int i, k, halfEdge, verticeLine1, verticeLine2, verticeLine3;
     struct Point point1, point2;
-    double angle;
     double sum;
 
-    /* Initialize */
-    facesIds = (int *)malloc(50 * sizeof(int));
-    angles = (double *)malloc(50 * sizeof(double));
+    /* Faces of each vertex, taken from the outgoing half edges */
+    for (i = 0; i <= input.mesh.surface.nv; i++) verticesConnection->offsets[i] = topology->vertexOffsets[i];
 
-    /* Loop over vertices */
+    /* Angle of each face at the vertex, normalized by the sum around the vertex */
+    #pragma omp parallel for private(k, halfEdge, verticeLine1, verticeLine2, verticeLine3, point1, point2, sum)
     for (i = 0; i < input.mesh.surface.nv; i++) {
 
-        // Reset the number of faces and angles
-        n = 0;
         sum = 0.0;
 
-        /* Loop over faces */
-        for (j = 0; j < input.mesh.surface.nf; j++) {
-
-            faceLine = j * 3;
-
-            /* Check if the face contain the vertice */
-            if ((input.mesh.surface.faces[faceLine] == i) || (input.mesh.surface.faces[faceLine + 1] == i) || (input.mesh.surface.faces[faceLine + 2] == i)) {
-
-                /* Calculate the angle */
-                if (input.mesh.surface.faces[faceLine] == i)
-                {
-                    verticeLine1 = 3 * input.mesh.surface.faces[faceLine];
-                    verticeLine2 = 3 * input.mesh.surface.faces[faceLine + 1];
-                    verticeLine3 = 3 * input.mesh.surface.faces[faceLine + 2];
-                }
-                else if (input.mesh.surface.faces[faceLine + 1] == i)
-                {
-                    verticeLine3 = 3 * input.mesh.surface.faces[faceLine];
-                    verticeLine1 = 3 * input.mesh.surface.faces[faceLine + 1];
-                    verticeLine2 = 3 * input.mesh.surface.faces[faceLine + 2];
-                }
-                else
-                {
-                    verticeLine2 = 3 * input.mesh.surface.faces[faceLine];
-                    verticeLine3 = 3 * input.mesh.surface.faces[faceLine + 1];
-                    verticeLine1 = 3 * input.mesh.surface.faces[faceLine + 2];
-                }
-
-                point1.x = input.mesh.surface.vertices[verticeLine2] - input.mesh.surface.vertices[verticeLine1];
-                point1.y = input.mesh.surface.vertices[verticeLine2 + 1] - input.mesh.surface.vertices[verticeLine1 + 1];
-                point1.z = input.mesh.surface.vertices[verticeLine2 + 2] - input.mesh.surface.vertices[verticeLine1 + 2];
-
-                point2.x = input.mesh.surface.vertices[verticeLine3] - input.mesh.surface.vertices[verticeLine1];
-                point2.y = input.mesh.surface.vertices[verticeLine3 + 1] - input.mesh.surface.vertices[verticeLine1 + 1];
-                point2.z = input.mesh.surface.vertices[verticeLine3 + 2] - input.mesh.surface.vertices[verticeLine1 + 2];
-
-                angle = angleBetweenVectors(point1, point2);
-
-                /* Increase the number of faces and save the angle */
-                angles[n] = angle;
-                facesIds[n] = j;
-                sum = sum + angle;
-
-                // Increase the number of faces
-                n++;
-            }
-        }
+        for (k = verticesConnection->offsets[i]; k < verticesConnection->offsets[i + 1]; k++) {
+
+            halfEdge = topology->vertexHalfEdges[k];
+
+            verticeLine1 = 3 * halfEdgeOrigin(topology, halfEdge);
+            verticeLine2 = 3 * halfEdgeTarget(topology, halfEdge);
+            verticeLine3 = 3 * halfEdgeOrigin(topology, halfEdgePrev(halfEdge));
+
+            point1.x = input.mesh.surface.vertices[verticeLine2] - input.mesh.surface.vertices[verticeLine1];
+            point1.y = input.mesh.surface.vertices[verticeLine2 + 1] - input.mesh.surface.vertices[verticeLine1 + 1];
+            point1.z = input.mesh.surface.vertices[verticeLine2 + 2] - input.mesh.surface.vertices[verticeLine1 + 2];
 
-        /* Save the number of faces, faces id's and angles in connection */
-        verticesConnection[i].n = n;
-        verticesConnection[i].coeffs = (double *)malloc(n * sizeof(double));
-        verticesConnection[i].faces = (int *)malloc(n * sizeof(int));
+            point2.x = input.mesh.surface.vertices[verticeLine3] - input.mesh.surface.vertices[verticeLine1];
+            point2.y = input.mesh.surface.vertices[verticeLine3 + 1] - input.mesh.surface.vertices[verticeLine1 + 1];
+            point2.z = input.mesh.surface.vertices[verticeLine3 + 2] - input.mesh.surface.vertices[verticeLine1 + 2];
 
-        for (k = 0; k < n; k++)
-        {
-            verticesConnection[i].coeffs[k] = angles[k] / sum;
-            verticesConnection[i].faces[k] = facesIds[k];
+            verticesConnection->faces[k] = halfEdgeFace(halfEdge);
+            verticesConnection->coeffs[k] = angleBetweenVectors(point1, point2);
+            sum = sum + verticesConnection->coeffs[k];
         }
 
+        for (k = verticesConnection->offsets[i]; k < verticesConnection->offsets[i + 1]; k++) verticesConnection->coeffs[k] = verticesConnection->coeffs[k] / sum;
     }
 
-    free(facesIds);
-    free(angles);
-
 }
 
-void getVerticesValues(struct Input input, struct VerticesConnection *verticesConnection, double *facesvalues, double *verticesValues)
+void getVerticesValuesBlock(struct Input input, struct VerticesConnection *verticesConnection, int n, double **facesValues, double **verticesValues)
 {
 
-    int i, j;
+    /* Parameters */
+    int i, j, k, m;
+    int *fields;
+    double *facesBlock, *verticesBlock;
+    const double *row;
+    double coeff;
+
+    /* Selected fields, the ones without output are skipped */
+    fields = (int *)malloc(n * sizeof(int));
 
-    for (i = 0; i < input.mesh.surface.nv; i++)
-    {
-        
-        verticesValues[i] = 0.0;
-        
-        for (j = 0; j < verticesConnection[i].n; j++)
-        {
-            verticesValues[i] = verticesValues[i] + facesvalues[verticesConnection[i].faces[j]] * verticesConnection[i].coeffs[j];
-        }
+    m = 0;
+    for (k = 0; k < n; k++) if (verticesValues[k] != NULL) fields[m++] = k;
 
+    if (m == 0) {
+        free(fields);
+        return;
     }
 
+    /* Faces values as a nf x m block, row major */
+    facesBlock = (double *)malloc((size_t)input.mesh.surface.nf * m * sizeof(double));
+    verticesBlock = (double *)malloc((size_t)input.mesh.surface.nv * m * sizeof(double));
+
+    #pragma omp parallel for private(k)
+    for (i = 0; i < input.mesh.surface.nf; i++)
+        for (k = 0; k < m; k++)
+            facesBlock[(size_t)i * m + k] = facesValues[fields[k]][i];
+
+    /* Vertices block = W * faces block, W in compressed rows */
+    #pragma omp parallel for private(j, k, row, coeff)
+    for (i = 0; i < input.mesh.surface.nv; i++) {
+
+        for (k = 0; k < m; k++) verticesBlock[(size_t)i * m + k] = 0.0;
+
+        for (j = verticesConnection->offsets[i]; j < verticesConnection->offsets[i + 1]; j++) {
+
+            row = &facesBlock[(size_t)verticesConnection->faces[j] * m];
+            coeff = verticesConnection->coeffs[j];
+
+            for (k = 0; k < m; k++) verticesBlock[(size_t)i * m + k] = verticesBlock[(size_t)i * m + k] + coeff * row[k];
+        }
+    }
+
+    #pragma omp parallel for private(k)
+    for (i = 0; i < input.mesh.surface.nv; i++)
+        for (k = 0; k < m; k++)
+            verticesValues[fields[k]][i] = verticesBlock[(size_t)i * m + k];
+
+    free(fields);
+    free(facesBlock);
+    free(verticesBlock);
+
+}
+
+void getVerticesValues(struct Input input, struct VerticesConnection *verticesConnection, double *facesvalues, double *verticesValues)
+{
+    getVerticesValuesBlock(input, verticesConnection, 1, &facesvalues, &verticesValues);
 }
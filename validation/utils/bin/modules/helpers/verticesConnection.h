@@ -2,9 +2,11 @@
 #define VERTICES_CONNECTION_H
 
 #include "structs.h"
+#include "meshTopology.h"
 
-void getVerticesConnection(struct Input input, struct VerticesConnection *verticesConnection);
+void getVerticesConnection(struct Input input, struct MeshTopology *topology, struct VerticesConnection *verticesConnection);
 void getVerticesValues(struct Input input, struct VerticesConnection *verticesConnection, double *facesvalues, double *verticesValues);
+void getVerticesValuesBlock(struct Input input, struct VerticesConnection *verticesConnection, int n, double **facesValues, double **verticesValues);
 
 #include "verticesConnection.c"
 
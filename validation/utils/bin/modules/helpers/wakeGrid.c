@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <math.h>
+#include "wakeGrid.h"
+#include "customMath.h"
+
+struct Point wakeVertex(double *vertices, int i)
+{
+    struct Point p = {vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]};
+    return p;
+}
+
+struct Point wakeUnary(struct Point p)
+{
+    double n = norm(p);
+    struct Point zero = {0.0, 0.0, 0.0};
+    struct Point out = {p.x / n, p.y / n, p.z / n};
+    return (n < 1e-8) ? zero : out;
+}
+
+struct Point wakeFaceNormal(struct MeshTopology *topology, double *vertices, int face)
+{
+    struct Point v1 = wakeVertex(vertices, topology->faces[3 * face]);
+    struct Point v2 = wakeVertex(vertices, topology->faces[3 * face + 1]);
+    struct Point v3 = wakeVertex(vertices, topology->faces[3 * face + 2]);
+    struct Point a = {v2.x - v1.x, v2.y - v1.y, v2.z - v1.z};
+    struct Point b = {v3.x - v1.x, v3.y - v1.y, v3.z - v1.z};
+    return cross(a, b);
+}
+
+int nearestVertex(int nv, double *vertices, double *p)
+{
+
+    /* Parameters */
+    int i, nearest;
+    double d, dMin;
+
+    /* Initialize */
+    nearest = 0;
+    dMin = INFINITY;
+
+    for (i = 0; i < nv; i++) {
+        d = (vertices[3 * i] - p[0]) * (vertices[3 * i] - p[0]) + (vertices[3 * i + 1] - p[1]) * (vertices[3 * i + 1] - p[1]) + (vertices[3 * i + 2] - p[2]) * (vertices[3 * i + 2] - p[2]);
+        if (d < dMin) {
+            dMin = d;
+            nearest = i;
+        }
+    }
+
+    return nearest;
+}
+
+int findTrailingEdge(struct MeshTopology *topology, double *vertices, double *start, double *end, int *edgeVertices, int *edgeHalfEdges)
+/*
+    Walks from the vertex nearest to start to the vertex nearest to end,
+    each step along the sharpest interior edge that gets closer to the end.
+    Returns the number of trailing edge vertices, 0 if the walk is broken.
+*/
+{
+
+    /* Parameters */
+    int i, k, h, c, n, current, last, other, best;
+    double score, bestScore, d;
+    struct Point p, n1, n2;
+
+    /* Initialize */
+    current = nearestVertex(topology->nv, vertices, start);
+    last = nearestVertex(topology->nv, vertices, end);
+    p = wakeVertex(vertices, last);
+
+    n = 0;
+    edgeVertices[n++] = current;
+
+    while (current != last) {
+
+        best = -1;
+        bestScore = 2.0;
+        d = norm((struct Point){vertices[3 * current] - p.x, vertices[3 * current + 1] - p.y, vertices[3 * current + 2] - p.z});
+
+        /* Edges of the vertex star, leaving (h) and reaching (prev(h)) the vertex */
+        for (k = topology->vertexOffsets[current]; k < topology->vertexOffsets[current + 1]; k++) {
+
+            h = topology->vertexHalfEdges[k];
+
+            for (i = 0; i < 2; i++) {
+
+                c = (i == 0) ? h : halfEdgePrev(h);
+
+                if (topology->twin[c] < 0) continue;
+
+                other = (i == 0) ? halfEdgeTarget(topology, c) : halfEdgeOrigin(topology, c);
+
+                if (norm((struct Point){vertices[3 * other] - p.x, vertices[3 * other + 1] - p.y, vertices[3 * other + 2] - p.z}) >= d) continue;
+
+                n1 = wakeUnary(wakeFaceNormal(topology, vertices, halfEdgeFace(c)));
+                n2 = wakeUnary(wakeFaceNormal(topology, vertices, halfEdgeFace(topology->twin[c])));
+                score = dot(n1, n2);
+
+                if (score < bestScore) {
+                    bestScore = score;
+                    best = c;
+                }
+            }
+        }
+
+        if (best < 0) {
+            printf("    > Trailing edge broken at vertex %d\n", current);
+            return 0;
+        }
+
+        current = (halfEdgeOrigin(topology, best) == current) ? halfEdgeTarget(topology, best) : halfEdgeOrigin(topology, best);
+        edgeHalfEdges[n - 1] = best;
+        edgeVertices[n++] = current;
+    }
+
+    return n;
+}
+
+void getWakeDirections(struct MeshTopology *topology, double *vertices, int nSpan, int *edgeVertices, int *edgeHalfEdges, double *direction, double *directions)
+/* Bisector of the two faces of each trailing edge, averaged at the vertices and pointing downstream */
+{
+
+    /* Parameters */
+    int i, k;
+    struct Point t, w1, w2, u, *edgeDirections;
+
+    /* Initialize */
+    u = (struct Point){direction[0], direction[1], direction[2]};
+    edgeDirections = (struct Point *)malloc((nSpan - 1) * sizeof(struct Point));
+
+    /* Edges */
+    for (i = 0; i < nSpan - 1; i++) {
+
+        t = wakeVertex(vertices, edgeVertices[i + 1]);
+        w1 = wakeVertex(vertices, edgeVertices[i]);
+        t = (struct Point){t.x - w1.x, t.y - w1.y, t.z - w1.z};
+
+        w1 = wakeUnary(cross(t, wakeFaceNormal(topology, vertices, halfEdgeFace(edgeHalfEdges[i]))));
+        w2 = wakeUnary(cross(t, wakeFaceNormal(topology, vertices, halfEdgeFace(topology->twin[edgeHalfEdges[i]]))));
+
+        if (dot(w1, u) < 0) w1 = (struct Point){-w1.x, -w1.y, -w1.z};
+        if (dot(w2, u) < 0) w2 = (struct Point){-w2.x, -w2.y, -w2.z};
+
+        edgeDirections[i] = wakeUnary((struct Point){w1.x + w2.x, w1.y + w2.y, w1.z + w2.z});
+    }
+
+    /* Vertices */
+    for (i = 0; i < nSpan; i++) {
+
+        if (i == 0) {
+            w1 = edgeDirections[0];
+        } else if (i == nSpan - 1) {
+            w1 = edgeDirections[nSpan - 2];
+        } else {
+            w1 = wakeUnary((struct Point){edgeDirections[i - 1].x + edgeDirections[i].x, edgeDirections[i - 1].y + edgeDirections[i].y, edgeDirections[i - 1].z + edgeDirections[i].z});
+        }
+
+        k = 3 * i;
+        directions[k] = w1.x; directions[k + 1] = w1.y; directions[k + 2] = w1.z;
+    }
+
+    free(edgeDirections);
+}
+
+void getWakeLines(double *vertices, int nSpan, int *edgeVertices, double *directions, struct WakeGridParameters parameters, struct WakeMeshPart part)
+{
+
+    int i;
+    int nWake = parameters.nWake;
+    struct Point u = wakeUnary((struct Point){parameters.direction[0], parameters.direction[1], parameters.direction[2]});
+
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < nSpan; i++) {
+
+        /* Parameters */
+        int j, k;
+        double factor, step;
+        double *p;
+        struct Point w, v;
+
+        /* Initialize */
+        v = wakeVertex(vertices, edgeVertices[i]);
+
+        for (j = 0; j < nWake; j++) {
+
+            k = i * nWake + j;
+            p = &part.vertices[3 * k];
+            part.grid[k] = k;
+
+            if (j > 0) {
+                if (j == nWake - 1) {
+                    step = (parameters.length > 0) ? parameters.length - (nWake - 1) * parameters.ds : parameters.ds;
+                    w = u;
+                } else {
+                    step = parameters.ds;
+                    factor = parameters.accommodation / (parameters.accommodation + parameters.ds * j);
+                    w = wakeUnary((struct Point){factor * directions[3 * i] + (1 - factor) * u.x, factor * directions[3 * i + 1] + (1 - factor) * u.y, factor * directions[3 * i + 2] + (1 - factor) * u.z});
+                }
+                v = (struct Point){v.x + step * w.x, v.y + step * w.y, v.z + step * w.z};
+            }
+
+            p[0] = v.x; p[1] = v.y; p[2] = v.z;
+        }
+    }
+}
+
+void freeWakeMeshPart(struct WakeMeshPart part)
+{
+    free(part.grid);
+    free(part.vertices);
+    free(part.faces);
+}
+
+int getWakeMeshParts(int nv, int nf, double *vertices, int *faces, int nParts, double *starts, double *ends, struct WakeGridParameters parameters, struct WakeMeshPart *parts)
+/*
+    Trailing edges (from starts[3 * i] to ends[3 * i]) and wake grids of
+    nParts wake parts sharing one mesh topology. The parts are allocated
+    here and released with freeWakeMeshPart. Returns 0 on failure, with
+    no part left allocated.
+*/
+{
+
+    /* Parameters */
+    int i, k, n, f1, f2;
+    int *edgeVertices, *edgeHalfEdges;
+    double *directions;
+    struct MeshTopology topology;
+
+    if ((parameters.nWake < 2) || (parameters.ds <= 0)) {
+        printf("    > Invalid wake grid: %d vertices per line with step %g\n", parameters.nWake, parameters.ds);
+        return 0;
+    }
+
+    /* Initialize */
+    topology = getMeshTopology(nv, nf, faces);
+    edgeVertices = (int *)malloc(nv * sizeof(int));
+    edgeHalfEdges = (int *)malloc(nv * sizeof(int));
+
+    for (i = 0; i < nParts; i++) {
+
+        n = findTrailingEdge(&topology, vertices, &starts[3 * i], &ends[3 * i], edgeVertices, edgeHalfEdges);
+
+        if (n < 2) {
+            if (n == 1) printf("    > Trailing edge %d has a single vertex\n", i);
+            for (k = 0; k < i; k++) freeWakeMeshPart(parts[k]);
+            freeMeshTopology(topology);
+            free(edgeVertices);
+            free(edgeHalfEdges);
+            return 0;
+        }
+
+        parts[i].nSpan = n;
+        parts[i].nWake = parameters.nWake;
+        parts[i].grid = (int *)malloc((size_t)n * parameters.nWake * sizeof(int));
+        parts[i].vertices = (double *)malloc(3 * (size_t)n * parameters.nWake * sizeof(double));
+        parts[i].faces = (int *)malloc(2 * (size_t)(n - 1) * sizeof(int));
+
+        /* Faces of each trailing edge, in ascending order */
+        for (k = 0; k < n - 1; k++) {
+            f1 = halfEdgeFace(edgeHalfEdges[k]);
+            f2 = halfEdgeFace(topology.twin[edgeHalfEdges[k]]);
+            parts[i].faces[2 * k] = (f1 < f2) ? f1 : f2;
+            parts[i].faces[2 * k + 1] = (f1 < f2) ? f2 : f1;
+        }
+
+        directions = (double *)malloc(3 * (size_t)n * sizeof(double));
+
+        getWakeDirections(&topology, vertices, n, edgeVertices, edgeHalfEdges, parameters.direction, directions);
+        getWakeLines(vertices, n, edgeVertices, directions, parameters, parts[i]);
+
+        free(directions);
+    }
+
+    /* Free */
+    freeMeshTopology(topology);
+    free(edgeVertices);
+    free(edgeHalfEdges);
+
+    return 1;
+}
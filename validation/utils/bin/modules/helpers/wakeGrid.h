@@ -0,0 +1,31 @@
+#ifndef WAKE_GRID_H
+#define WAKE_GRID_H
+
+#include "structs.h"
+#include "meshTopology.h"
+
+/*
+    Wake lines shed from the trailing edge. Each line starts at a trailing
+    edge vertex along the bisector of the two faces of the edge and turns
+    towards the freestream as accommodation / (accommodation + s), s being
+    the distance along the line. The last step is along the freestream,
+    which the solver continues to infinity.
+*/
+struct WakeGridParameters
+{
+    double direction[3];    // freestream direction, pointing downstream
+    double ds;              // step along the wake lines
+    int nWake;              // vertices of each wake line
+    double length;          // the last step is length - (nWake - 1) * ds long (<= 0 keeps it ds)
+    double accommodation;
+};
+
+int findTrailingEdge(struct MeshTopology *topology, double *vertices, double *start, double *end, int *edgeVertices, int *edgeHalfEdges);
+void getWakeDirections(struct MeshTopology *topology, double *vertices, int nSpan, int *edgeVertices, int *edgeHalfEdges, double *direction, double *directions);
+
+int getWakeMeshParts(int nv, int nf, double *vertices, int *faces, int nParts, double *starts, double *ends, struct WakeGridParameters parameters, struct WakeMeshPart *parts);
+void freeWakeMeshPart(struct WakeMeshPart part);
+
+#include "wakeGrid.c"
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+#include "vtkFile.h"
+
+/*
+    VTK XML PolyData with every array in the appended section as raw
+    binary. Compressed arrays are split in VTK_BLOCK_SIZE blocks that are
+    deflated in parallel, with the block header of vtkZLibDataCompressor.
+*/
+struct VtkBlob
+{
+    unsigned char *data;
+    size_t bytes;
+};
+
+struct VtkBlob getVtkBlob(const void *data, size_t bytes, int compressed)
+/* Encoded array: UInt64 size followed by the data, or the zlib block header followed by the blocks */
+{
+
+    /* Parameters */
+    struct VtkBlob blob;
+    uint64_t nBlocks, lastBlock, *header;
+    unsigned char **blocks;
+    uLongf *blocksBytes;
+    size_t offset;
+    uint64_t k;
+    int ok = 1;
+
+    /* Raw */
+    if (!compressed)
+    {
+        blob.bytes = sizeof(uint64_t) + bytes;
+        blob.data = (unsigned char *)malloc(blob.bytes);
+        if (blob.data == NULL) return blob;
+        *(uint64_t *)blob.data = bytes;
+        memcpy(blob.data + sizeof(uint64_t), data, bytes);
+        return blob;
+    }
+
+    /* Compressed blocks */
+    nBlocks = (bytes + VTK_BLOCK_SIZE - 1) / VTK_BLOCK_SIZE;
+    lastBlock = bytes % VTK_BLOCK_SIZE;
+
+    blocks = (unsigned char **)calloc(nBlocks + 1, sizeof(unsigned char *));
+    blocksBytes = (uLongf *)calloc(nBlocks + 1, sizeof(uLongf));
+
+    #pragma omp parallel for schedule(dynamic) reduction(&&: ok)
+    for (k = 0; k < nBlocks; k++)
+    {
+        uLong size = ((k == nBlocks - 1) && (lastBlock != 0)) ? lastBlock : VTK_BLOCK_SIZE;
+
+        blocksBytes[k] = compressBound(size);
+        blocks[k] = (unsigned char *)malloc(blocksBytes[k]);
+
+        ok = (blocks[k] != NULL) && (compress2(blocks[k], &blocksBytes[k], (const Bytef *)data + k * VTK_BLOCK_SIZE, size, Z_BEST_SPEED) == Z_OK) && ok;
+    }
+
+    /* Header and blocks */
+    blob.bytes = (3 + nBlocks) * sizeof(uint64_t);
+    for (k = 0; k < nBlocks; k++) blob.bytes = blob.bytes + blocksBytes[k];
+
+    blob.data = ok ? (unsigned char *)malloc(blob.bytes) : NULL;
+
+    if (blob.data != NULL)
+    {
+        header = (uint64_t *)blob.data;
+        header[0] = nBlocks;
+        header[1] = VTK_BLOCK_SIZE;
+        header[2] = lastBlock;
+
+        offset = (3 + nBlocks) * sizeof(uint64_t);
+
+        for (k = 0; k < nBlocks; k++)
+        {
+            header[3 + k] = blocksBytes[k];
+            memcpy(blob.data + offset, blocks[k], blocksBytes[k]);
+            offset = offset + blocksBytes[k];
+        }
+    }
+
+    /* Free */
+    for (k = 0; k < nBlocks; k++) free(blocks[k]);
+    free(blocks);
+    free(blocksBytes);
+
+    return blob;
+}
+
+int getWakeMeshPartPoints(struct WakeMeshPart part)
+/* The wake vertices array has no size of its own: it ends at the last vertex of the grid */
+{
+    int i, n = 0;
+
+    for (i = 0; i < part.nSpan * part.nWake; i++) n = (part.grid[i] + 1 > n) ? part.grid[i] + 1 : n;
+
+    return n;
+}
+
+int writeVtkFile(const char *file, struct Mesh mesh, int wake, int compressed, int nFields, struct VtkField *fields)
+/* Returns 0 if the file could not be written */
+{
+
+    /* Parameters */
+    struct SurfaceMesh surface = mesh.surface;
+    struct WakeMeshPart parts[3] = {mesh.wake.left, mesh.wake.right, mesh.wake.tail};
+    int partPoints[3] = {0, 0, 0};
+    int nPoints, nLines, nLinePoints, nCells, nBlobs;
+    int i, j, k, c, p, n, ok;
+    struct VtkBlob *blobs;
+    uint64_t offset, *blobOffsets;
+    double *points;
+    int *connectivity, *offsets;
+    float *values;
+    FILE *fp;
+
+    /* Initialize */
+    nPoints = surface.nv;
+    nLines = 0;
+    nLinePoints = 0;
+
+    if (wake)
+    {
+        for (p = 0; p < 3; p++)
+        {
+            if (parts[p].nSpan == 0) continue;
+            partPoints[p] = getWakeMeshPartPoints(parts[p]);
+            nPoints = nPoints + partPoints[p];
+            nLines = nLines + parts[p].nSpan;
+            nLinePoints = nLinePoints + parts[p].nSpan * parts[p].nWake;
+        }
+    }
+
+    nCells = nLines + surface.nf;
+    nBlobs = nFields + 1 + 2 + ((nLines > 0) ? 2 : 0);
+    blobs = (struct VtkBlob *)calloc(nBlobs, sizeof(struct VtkBlob));
+
+    /* Fields */
+    for (k = 0; k < nFields; k++)
+    {
+        n = fields[k].cells ? nCells : nPoints;
+        values = (float *)calloc((size_t)n * fields[k].components, sizeof(float));
+
+        if (values == NULL) continue;
+
+        // Faces come after the wake lines, vertices before the wake points
+        j = fields[k].cells ? nLines : 0;
+        n = fields[k].cells ? surface.nf : surface.nv;
+
+        for (c = 0; c < fields[k].components; c++)
+        {
+            for (i = 0; i < n; i++) values[(size_t)(j + i) * fields[k].components + c] = (float)fields[k].data[c][i];
+        }
+
+        blobs[k] = getVtkBlob(values, (size_t)(fields[k].cells ? nCells : nPoints) * fields[k].components * sizeof(float), compressed);
+        free(values);
+    }
+
+    /* Points */
+    points = (double *)malloc(3 * (size_t)nPoints * sizeof(double));
+
+    if (points != NULL)
+    {
+        memcpy(points, surface.vertices, 3 * (size_t)surface.nv * sizeof(double));
+
+        n = surface.nv;
+        for (p = 0; p < 3; p++)
+        {
+            if (partPoints[p] == 0) continue;
+            memcpy(points + 3 * (size_t)n, parts[p].vertices, 3 * (size_t)partPoints[p] * sizeof(double));
+            n = n + partPoints[p];
+        }
+
+        blobs[nFields] = getVtkBlob(points, 3 * (size_t)nPoints * sizeof(double), compressed);
+        free(points);
+    }
+
+    /* Polys */
+    offsets = (int *)malloc((size_t)surface.nf * sizeof(int));
+
+    if (offsets != NULL)
+    {
+        for (i = 0; i < surface.nf; i++) offsets[i] = 3 * (i + 1);
+        blobs[nFields + 1] = getVtkBlob(surface.faces, 3 * (size_t)surface.nf * sizeof(int), compressed);
+        blobs[nFields + 2] = getVtkBlob(offsets, (size_t)surface.nf * sizeof(int), compressed);
+        free(offsets);
+    }
+
+    /* Lines */
+    if (nLines > 0)
+    {
+        connectivity = (int *)malloc((size_t)nLinePoints * sizeof(int));
+        offsets = (int *)malloc((size_t)nLines * sizeof(int));
+
+        if ((connectivity != NULL) && (offsets != NULL))
+        {
+            n = surface.nv;
+            j = 0;
+            c = 0;
+
+            for (p = 0; p < 3; p++)
+            {
+                if (partPoints[p] == 0) continue;
+
+                for (i = 0; i < parts[p].nSpan * parts[p].nWake; i++) connectivity[c + i] = n + parts[p].grid[i];
+                for (i = 0; i < parts[p].nSpan; i++) offsets[j + i] = c + (i + 1) * parts[p].nWake;
+
+                c = c + parts[p].nSpan * parts[p].nWake;
+                j = j + parts[p].nSpan;
+                n = n + partPoints[p];
+            }
+
+            blobs[nFields + 3] = getVtkBlob(connectivity, (size_t)nLinePoints * sizeof(int), compressed);
+            blobs[nFields + 4] = getVtkBlob(offsets, (size_t)nLines * sizeof(int), compressed);
+        }
+
+        free(connectivity);
+        free(offsets);
+    }
+
+    ok = 1;
+    for (k = 0; k < nBlobs; k++) ok = ok && (blobs[k].data != NULL);
+
+    fp = ok ? fopen(file, "wb") : NULL;
+
+    if (fp == NULL)
+    {
+        printf("    > Could not write the vtk file %s\n", file);
+        for (k = 0; k < nBlobs; k++) free(blobs[k].data);
+        free(blobs);
+        return 0;
+    }
+
+    /* Header */
+    blobOffsets = (uint64_t *)malloc(nBlobs * sizeof(uint64_t));
+
+    offset = 0;
+    for (k = 0; k < nBlobs; k++)
+    {
+        blobOffsets[k] = offset;
+        offset = offset + blobs[k].bytes;
+    }
+
+    fprintf(fp, "<?xml version=\"1.0\"?>\n");
+    fprintf(fp, "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\"%s>\n", compressed ? " compressor=\"vtkZLibDataCompressor\"" : "");
+    fprintf(fp, "  <PolyData>\n");
+    fprintf(fp, "    <Piece NumberOfPoints=\"%d\" NumberOfVerts=\"0\" NumberOfLines=\"%d\" NumberOfStrips=\"0\" NumberOfPolys=\"%d\">\n", nPoints, nLines, surface.nf);
+
+    for (c = 0; c < 2; c++)
+    {
+        fprintf(fp, (c == 0) ? "      <PointData>\n" : "      <CellData>\n");
+
+        for (k = 0; k < nFields; k++)
+        {
+            if (fields[k].cells != c) continue;
+            fprintf(fp, "        <DataArray type=\"Float32\" Name=\"%s\" NumberOfComponents=\"%d\" format=\"appended\" offset=\"%llu\"/>\n", fields[k].name, fields[k].components, (unsigned long long)blobOffsets[k]);
+        }
+
+        fprintf(fp, (c == 0) ? "      </PointData>\n" : "      </CellData>\n");
+    }
+
+    fprintf(fp, "      <Points>\n");
+    fprintf(fp, "        <DataArray type=\"Float64\" Name=\"Points\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%llu\"/>\n", (unsigned long long)blobOffsets[nFields]);
+    fprintf(fp, "      </Points>\n");
+
+    fprintf(fp, "      <Polys>\n");
+    fprintf(fp, "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"%llu\"/>\n", (unsigned long long)blobOffsets[nFields + 1]);
+    fprintf(fp, "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"%llu\"/>\n", (unsigned long long)blobOffsets[nFields + 2]);
+    fprintf(fp, "      </Polys>\n");
+
+    if (nLines > 0)
+    {
+        fprintf(fp, "      <Lines>\n");
+        fprintf(fp, "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"%llu\"/>\n", (unsigned long long)blobOffsets[nFields + 3]);
+        fprintf(fp, "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"%llu\"/>\n", (unsigned long long)blobOffsets[nFields + 4]);
+        fprintf(fp, "      </Lines>\n");
+    }
+
+    fprintf(fp, "    </Piece>\n");
+    fprintf(fp, "  </PolyData>\n");
+    fprintf(fp, "  <AppendedData encoding=\"raw\">\n   _");
+
+    /* Appended data */
+    for (k = 0; k < nBlobs; k++) ok = ok && (fwrite(blobs[k].data, 1, blobs[k].bytes, fp) == blobs[k].bytes);
+
+    fprintf(fp, "\n  </AppendedData>\n");
+    fprintf(fp, "</VTKFile>\n");
+
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok) printf("    > Could not write the vtk file %s\n", file);
+
+    /* Free */
+    for (k = 0; k < nBlobs; k++) free(blobs[k].data);
+    free(blobs);
+    free(blobOffsets);
+
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef VTK_FILE_H
+#define VTK_FILE_H
+
+#include "../helpers/structs.h"
+
+#define VTK_BLOCK_SIZE 65536
+
+/*
+    Field written to a VTK file. Vector fields give one array per
+    component. Face values are written as cell data and vertices values
+    as point data; the wake points and lines are padded with zeros.
+*/
+struct VtkField
+{
+    const char *name;
+    int components;            // 1 or 3
+    int cells;                 // 1 for face values, 0 for vertices values
+    double *data[3];
+};
+
+int writeVtkFile(const char *file, struct Mesh mesh, int wake, int compressed, int nFields, struct VtkField *fields);
+
+#include "vtkFile.c"
+
+#endif
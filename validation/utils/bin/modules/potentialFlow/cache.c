@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+const char potentialFlowCacheMagic[8] = "PFCACHE";
+
+uint64_t hashBytes(uint64_t hash, const void *data, size_t bytes)
+/* FNV-1a */
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i;
+
+    for (i = 0; i < bytes; i++)
+    {
+        hash = hash ^ p[i];
+        hash = hash * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+uint64_t getMeshHash(struct Input input)
+{
+
+    /* Parameters */
+    struct SurfaceMesh surface = input.mesh.surface;
+    size_t nf = (size_t)surface.nf;
+    uint64_t hash = 14695981039346656037ULL;
+    int version = POTENTIAL_FLOW_CACHE_VERSION;
+
+    /* Surface */
+    hash = hashBytes(hash, &version, sizeof(int));
+    hash = hashBytes(hash, &surface.nv, sizeof(int));
+    hash = hashBytes(hash, &surface.nf, sizeof(int));
+    hash = hashBytes(hash, surface.vertices, 3 * (size_t)surface.nv * sizeof(double));
+    hash = hashBytes(hash, surface.faces, 3 * nf * sizeof(int));
+    hash = hashBytes(hash, surface.facesAreas, nf * sizeof(double));
+    hash = hashBytes(hash, surface.facesMaxDistance, nf * sizeof(double));
+    hash = hashBytes(hash, surface.facesCenter, 3 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.controlPoints, 3 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.p1, 2 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.p2, 2 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.p3, 2 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.e1, 3 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.e2, 3 * nf * sizeof(double));
+    hash = hashBytes(hash, surface.e3, 3 * nf * sizeof(double));
+
+    return hash;
+}
+
+int getPotentialFlowCachePath(char *path, size_t size, const char *directory, uint64_t hash)
+/* Returns 0 if the path does not fit in size bytes */
+{
+    int n = snprintf(path, size, "%s/influence_%016llx.bin", directory, (unsigned long long)hash);
+
+    return (n >= 0) && ((size_t)n < size);
+}
+
+int readCacheBlock(int fd, void *data, size_t bytes, off_t offset)
+{
+    ssize_t done;
+
+    while (bytes > 0)
+    {
+        done = pread(fd, data, bytes, offset);
+        if (done <= 0) return 0;
+        data = (char *)data + done;
+        bytes = bytes - done;
+        offset = offset + done;
+    }
+
+    return 1;
+}
+
+int writeCacheBlock(int fd, const void *data, size_t bytes, off_t offset)
+{
+    ssize_t done;
+
+    while (bytes > 0)
+    {
+        done = pwrite(fd, data, bytes, offset);
+        if (done <= 0) return 0;
+        data = (const char *)data + done;
+        bytes = bytes - done;
+        offset = offset + done;
+    }
+
+    return 1;
+}
+
+int loadPotentialFlowCache(const char *directory, uint64_t hash, struct PotentialFlowData *data)
+/*
+    Replaces the influence matrices by private mappings of the cache file
+    and reads the freestream and rotation sensitivities. Returns 0, with data untouched,
+    if there is no valid cache file for the hash.
+*/
+{
+
+    /* Parameters */
+    char path[4096];
+    struct PotentialFlowCacheHeader header;
+    struct TiledMatrix matrices[4];
+    struct TiledMatrix *targets[4] = {&data->a, &data->a_vel_x, &data->a_vel_y, &data->a_vel_z};
+    double *b[8] = {data->b, data->b_vel_x, data->b_vel_y, data->b_vel_z, data->b_rot, data->b_rot_vel_x, data->b_rot_vel_y, data->b_rot_vel_z};
+    size_t vectorBytes = 3 * (size_t)data->n * sizeof(double);
+    struct stat info;
+    off_t offset;
+    int fd, k, ok;
+
+    /* Initialize */
+    if (directory == NULL) return 0;
+
+    if (!getPotentialFlowCachePath(path, sizeof(path), directory, hash)) return 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    /* Header */
+    ok = readCacheBlock(fd, &header, sizeof(header), 0) && (fstat(fd, &info) == 0);
+
+    ok = ok && (memcmp(header.magic, potentialFlowCacheMagic, sizeof(header.magic)) == 0);
+    ok = ok && (header.version == POTENTIAL_FLOW_CACHE_VERSION);
+    ok = ok && (header.tileSize == TILE_SIZE);
+    ok = ok && (header.nf == data->n);
+    ok = ok && (header.doubleBytes == (int)sizeof(double));
+    ok = ok && (header.hash == hash);
+    ok = ok && (header.matrixBytes == data->a.bytes);
+    ok = ok && ((size_t)info.st_size == POTENTIAL_FLOW_CACHE_HEADER_BYTES + 4 * data->a.bytes + 8 * vectorBytes);
+
+    if (!ok)
+    {
+        printf("    > Ignoring the invalid cache file %s\n", path);
+        close(fd);
+        return 0;
+    }
+
+    /* Matrices */
+    for (k = 0; k < 4; k++)
+    {
+        offset = (off_t)(POTENTIAL_FLOW_CACHE_HEADER_BYTES + k * data->a.bytes);
+        matrices[k] = getTiledMatrixMap(data->n, fd, offset);
+        ok = ok && (matrices[k].data != NULL);
+    }
+
+    if (!ok)
+    {
+        for (k = 0; k < 4; k++) freeTiledMatrix(&matrices[k]);
+        close(fd);
+        return 0;
+    }
+
+    /* Freestream and rotation sensitivities */
+    offset = (off_t)(POTENTIAL_FLOW_CACHE_HEADER_BYTES + 4 * data->a.bytes);
+
+    for (k = 0; k < 8; k++)
+    {
+        ok = ok && readCacheBlock(fd, b[k], vectorBytes, offset + k * vectorBytes);
+    }
+
+    close(fd);
+
+    if (!ok)
+    {
+        for (k = 0; k < 4; k++) freeTiledMatrix(&matrices[k]);
+        return 0;
+    }
+
+    for (k = 0; k < 4; k++)
+    {
+        freeTiledMatrix(targets[k]);
+        *targets[k] = matrices[k];
+    }
+
+    printf("    * Influence matrices loaded from %s\n", path);
+
+    return 1;
+}
+
+void savePotentialFlowCache(const char *directory, uint64_t hash, struct PotentialFlowData *data)
+/* Written to a temporary file and renamed, so readers never see a partial file */
+{
+
+    /* Parameters */
+    char path[4096], tmp[sizeof(path) + 8];           // path and the mkstemp suffix
+    struct PotentialFlowCacheHeader header;
+    struct TiledMatrix *matrices[4] = {&data->a, &data->a_vel_x, &data->a_vel_y, &data->a_vel_z};
+    double *b[8] = {data->b, data->b_vel_x, data->b_vel_y, data->b_vel_z, data->b_rot, data->b_rot_vel_x, data->b_rot_vel_y, data->b_rot_vel_z};
+    size_t vectorBytes = 3 * (size_t)data->n * sizeof(double);
+    off_t offset;
+    int fd, k, ok;
+
+    /* Initialize */
+    if (directory == NULL) return;
+
+    if (!getPotentialFlowCachePath(path, sizeof(path), directory, hash) || (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp)))
+    {
+        printf("    > Cache directory path too long: %s\n", directory);
+        return;
+    }
+
+    fd = mkstemp(tmp);
+
+    if (fd < 0)
+    {
+        printf("    > Could not create a cache file in %s\n", directory);
+        return;
+    }
+
+    /* Header */
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, potentialFlowCacheMagic, sizeof(header.magic));
+    header.version = POTENTIAL_FLOW_CACHE_VERSION;
+    header.tileSize = TILE_SIZE;
+    header.nf = data->n;
+    header.doubleBytes = (int)sizeof(double);
+    header.hash = hash;
+    header.matrixBytes = data->a.bytes;
+
+    ok = writeCacheBlock(fd, &header, sizeof(header), 0);
+    ok = ok && (ftruncate(fd, (off_t)POTENTIAL_FLOW_CACHE_HEADER_BYTES) == 0);
+
+    /* Matrices, freestream and rotation sensitivities */
+    offset = (off_t)POTENTIAL_FLOW_CACHE_HEADER_BYTES;
+
+    for (k = 0; k < 4; k++)
+    {
+        ok = ok && writeCacheBlock(fd, matrices[k]->data, matrices[k]->bytes, offset);
+        offset = offset + matrices[k]->bytes;
+    }
+
+    for (k = 0; k < 8; k++)
+    {
+        ok = ok && writeCacheBlock(fd, b[k], vectorBytes, offset);
+        offset = offset + vectorBytes;
+    }
+
+    ok = (close(fd) == 0) && ok;
+    ok = ok && (rename(tmp, path) == 0);
+
+    if (!ok)
+    {
+        printf("    > Could not write the cache file %s\n", path);
+        unlink(tmp);
+        return;
+    }
+
+    printf("    * Influence matrices saved to %s\n", path);
+}
@@ -0,0 +1,37 @@
+#ifndef CACHE_POTENTIAL_FLOW_H
+#define CACHE_POTENTIAL_FLOW_H
+
+#include <stdint.h>
+#include "../helpers/structs.h"
+#include "data.h"
+
+#define POTENTIAL_FLOW_CACHE_VERSION 4
+#define POTENTIAL_FLOW_CACHE_HEADER_BYTES 65536        // keeps the matrices page aligned
+
+/*
+    On disk cache of the influence matrices. Everything the assembly reads
+    from the surface mesh is hashed, and the four tiled matrices are stored
+    with the freestream and rotation sensitivities of the right hand side
+    in <directory>/influence_<hash>.bin. A later run with the same mesh
+    maps the matrices from that file instead of assembling them. The wake
+    coupling is not cached. The files are in the native byte order: they
+    are a cache, not an exchange format.
+*/
+struct PotentialFlowCacheHeader
+{
+    char magic[8];
+    int version;
+    int tileSize;
+    int nf;
+    int doubleBytes;
+    uint64_t hash;
+    uint64_t matrixBytes;
+};
+
+uint64_t getMeshHash(struct Input input);
+int loadPotentialFlowCache(const char *directory, uint64_t hash, struct PotentialFlowData *data);
+void savePotentialFlowCache(const char *directory, uint64_t hash, struct PotentialFlowData *data);
+
+#include "cache.c"
+
+#endif
@@ -2,98 +2,207 @@
 #define DATA_POTENTIAL_FLOW_H
 
 #include <stdlib.h>
+#include <string.h>
+#include "../helpers/tiledMatrix.h"
+
+/*
+    Wake influence kept apart from the body matrices. Strip s is a vortex
+    ring of strength doublet[faces[2 * s]] - doublet[faces[2 * s + 1]] (the
+    sparse map K) and w[i * nStrips + s] its normal velocity at the control
+    point i, so the system matrix is A x = A_body x + W (K x) and a new wake
+    only recomputes W. w_vel_* are the velocity components.
+*/
+struct WakeCoupling
+{
+    int nStrips;
+    int *faces;                                     // 2 faces per strip
+    double *w;                                      // [nf x nStrips]
+    double *w_vel_x;
+    double *w_vel_y;
+    double *w_vel_z;
+};
+
+/*
+    Rigid components: faces[i] is the component of the face i. The right
+    hand side sensitivities are also kept per row and source component,
+    partials[(i * n + c) * COMPONENT_PARTIAL_SIZE ...] being the sums over
+    the faces j of c of e3_j s_ij, (c_j x e3_j) s_ij, v_ij e3_j^T and
+    v_ij (c_j x e3_j)^T, s_ij and v_ij the normal velocity and velocity of
+    the source j at the control point i. transforms [n x 12] are the
+    rotations (row major) and translations, x -> R x + t, of the components
+    since the last assembly; moved is set when one is not the identity.
+*/
+#define COMPONENT_PARTIAL_SIZE 24
+
+struct ComponentBlocks
+{
+    int n;                                          // 0 for a single rigid body
+    int moved;
+    int *faces;                                     // [nf]
+    double *partials;                               // [nf x n x COMPONENT_PARTIAL_SIZE]
+    double *transforms;                             // [n x 12]
+};
 
 struct PotentialFlowData
 {
     double *sigma;
     double *doublet;
     int n;
-    int na;
-    double *a;
-    int *ia;
-    int *ja;
+    struct TiledMatrix a;
     double *rhs;
-    double *a_vel_x;
-    double *a_vel_y;
-    double *a_vel_z;
+    struct TiledMatrix a_vel_x;
+    struct TiledMatrix a_vel_y;
+    struct TiledMatrix a_vel_z;
     double *rhs_vel_x;
     double *rhs_vel_y;
     double *rhs_vel_z;
+    double *b;                                      // rhs sensitivity to the freestream [nf x 3]
+    double *b_vel_x;                                // rhs_vel_x sensitivity to the freestream [nf x 3]
+    double *b_vel_y;                                // rhs_vel_y sensitivity to the freestream [nf x 3]
+    double *b_vel_z;                                // rhs_vel_z sensitivity to the freestream [nf x 3]
+    double *b_rot;                                  // rhs sensitivity to the body rotation rate [nf x 3]
+    double *b_rot_vel_x;                            // rhs_vel_x sensitivity to the body rotation rate [nf x 3]
+    double *b_rot_vel_y;                            // rhs_vel_y sensitivity to the body rotation rate [nf x 3]
+    double *b_rot_vel_z;                            // rhs_vel_z sensitivity to the body rotation rate [nf x 3]
+    double *onset;                                  // other onset velocity at the control points, e.g. deformation [nf x 3]
+    double *induced;                                // velocity induced at the control points outside the system, e.g. frozen wake rows [nf x 3]
+    double *doubletRate;                            // time derivative of the doublet [nf], 0 in steady solves
+    double *inducedRate;                            // time derivative, following the surface, of the potential of the induced velocities [nf]
     double *cp;
     double *vel_x, *vel_y, *vel_z;
     double *transpiration;
+    struct WakeCoupling wake;
+    struct ComponentBlocks components;
+    int closedWake;                                 // wake rings closed at the end of the wake grid (time marching)
+    int symmetric;                                  // half model: the images across the y = 0 plane, of sign 1 or -1 (antisymmetric flow), are folded into the influences
 };
 
-struct PotentialFlowData getPotentialFlowData(int nf, double *e3, double vel_x, double vel_y, double vel_z) {
+struct WakeCoupling getWakeCouplingData(int nf, int nStrips) {
+
+    struct WakeCoupling wake;
+
+    wake.nStrips = nStrips;
+    wake.faces = (int*)malloc((2 * (size_t)nStrips + 1) * sizeof(int));
+    wake.w = (double*)malloc((4 * (size_t)nf * nStrips + 1) * sizeof(double));
+    wake.w_vel_x = wake.w + (size_t)nf * nStrips;
+    wake.w_vel_y = wake.w_vel_x + (size_t)nf * nStrips;
+    wake.w_vel_z = wake.w_vel_y + (size_t)nf * nStrips;
+
+    return wake;
+}
+
+void freeWakeCouplingData(struct WakeCoupling wake) {
+    free(wake.faces);
+    free(wake.w);
+}
+
+void resetComponentBlocksMotion(struct ComponentBlocks *components) {
+
+    double identity[12] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0};
+    int c;
+
+    for (c = 0; c < components->n; c++) memcpy(&components->transforms[12 * c], identity, 12 * sizeof(double));
+
+    components->moved = 0;
+}
+
+struct ComponentBlocks getComponentBlocksData(int nf, int n) {
+
+    struct ComponentBlocks components;
+
+    components.n = n;
+    components.faces = (int*)malloc(((size_t)nf + 1) * sizeof(int));
+    components.partials = (double*)malloc(((size_t)nf * n * COMPONENT_PARTIAL_SIZE + 1) * sizeof(double));
+    components.transforms = (double*)malloc((12 * (size_t)n + 1) * sizeof(double));
+
+    resetComponentBlocksMotion(&components);
+
+    return components;
+}
+
+void freeComponentBlocksData(struct ComponentBlocks components) {
+    free(components.faces);
+    free(components.partials);
+    free(components.transforms);
+}
+
+struct PotentialFlowData getPotentialFlowData(int nf, const char *scratchDirectory) {
 
     struct PotentialFlowData data;
 
     data.sigma = (double*)malloc(nf * sizeof(double));
     data.doublet = (double*)malloc(nf * sizeof(double));
     data.n = nf;
-    data.na = nf * nf;
-    data.a = (double*)malloc(nf * nf * sizeof(double));
-    data.ia = (int*)malloc(nf * nf * sizeof(int));
-    data.ja = (int*)malloc(nf * nf * sizeof(int));
+    data.a = getTiledMatrix(nf, scratchDirectory);
     data.rhs = (double*)malloc(nf * sizeof(double));
-    data.a_vel_x = (double*)malloc(nf * nf * sizeof(double));
-    data.a_vel_y = (double*)malloc(nf * nf * sizeof(double));
-    data.a_vel_z = (double*)malloc(nf * nf * sizeof(double));
+    data.a_vel_x = getTiledMatrix(nf, scratchDirectory);
+    data.a_vel_y = getTiledMatrix(nf, scratchDirectory);
+    data.a_vel_z = getTiledMatrix(nf, scratchDirectory);
     data.rhs_vel_x = (double*)malloc(nf * sizeof(double));
     data.rhs_vel_y = (double*)malloc(nf * sizeof(double));
     data.rhs_vel_z = (double*)malloc(nf * sizeof(double));
+    data.b = (double*)malloc(3 * nf * sizeof(double));
+    data.b_vel_x = (double*)malloc(3 * nf * sizeof(double));
+    data.b_vel_y = (double*)malloc(3 * nf * sizeof(double));
+    data.b_vel_z = (double*)malloc(3 * nf * sizeof(double));
+    data.b_rot = (double*)malloc(3 * nf * sizeof(double));
+    data.b_rot_vel_x = (double*)malloc(3 * nf * sizeof(double));
+    data.b_rot_vel_y = (double*)malloc(3 * nf * sizeof(double));
+    data.b_rot_vel_z = (double*)malloc(3 * nf * sizeof(double));
+    data.onset = (double*)calloc(3 * nf, sizeof(double));
+    data.induced = (double*)calloc(3 * nf, sizeof(double));
+    data.doubletRate = (double*)calloc(nf, sizeof(double));
+    data.inducedRate = (double*)calloc(nf, sizeof(double));
     data.cp = (double*)malloc(nf * sizeof(double));
     data.vel_x = (double*)malloc(nf * sizeof(double));
     data.vel_y = (double*)malloc(nf * sizeof(double));
     data.vel_z = (double*)malloc(nf * sizeof(double));
     data.transpiration = (double*)malloc(nf * sizeof(double));
+    data.wake = getWakeCouplingData(nf, 0);
+    data.components = getComponentBlocksData(nf, 0);
+    data.closedWake = 0;
+    data.symmetric = 0;
 
-    int i, j;
-
-    for (i = 0; i < nf; i++)
-    {
-        data.sigma[i] = -(e3[3 * i] * vel_x + e3[3 * i + 1] * vel_y + e3[3 * i + 2] * vel_z);
-    }
+    // Initial guess of the first solve; later solves restart from the previous one
+    for (int i = 0; i < nf; i++) data.doublet[i] = 0.0;
 
     return data;
 }
 
+int checkPotentialFlowData(struct PotentialFlowData data) {
+    return (data.a.data != NULL) && (data.a_vel_x.data != NULL) && (data.a_vel_y.data != NULL) && (data.a_vel_z.data != NULL);
+}
+
 void freePotentialFlowData(struct PotentialFlowData data) {
-    printf("> 0\n");
     free(data.sigma);
-    printf("> 1\n");
     free(data.doublet);
-    printf("> 2\n");
-    free(data.a);
-    printf("> 3\n");
-    free(data.ia);
-    printf("> 4\n");
-    free(data.ja);
-    printf("> 5\n");
+    freeTiledMatrix(&data.a);
     free(data.rhs);
-    printf("> 6\n");
-    free(data.a_vel_x);
-    printf("> 7\n");
-    free(data.a_vel_y);
-    printf("> 8\n");
-    free(data.a_vel_z);
-    printf("> 9\n");
+    freeTiledMatrix(&data.a_vel_x);
+    freeTiledMatrix(&data.a_vel_y);
+    freeTiledMatrix(&data.a_vel_z);
     free(data.rhs_vel_x);
-    printf("> 10\n");
     free(data.rhs_vel_y);
-    printf("> 11\n");
     free(data.rhs_vel_z);
-    printf("> 12\n");
+    free(data.b);
+    free(data.b_vel_x);
+    free(data.b_vel_y);
+    free(data.b_vel_z);
+    free(data.b_rot);
+    free(data.b_rot_vel_x);
+    free(data.b_rot_vel_y);
+    free(data.b_rot_vel_z);
+    free(data.onset);
+    free(data.induced);
+    free(data.doubletRate);
+    free(data.inducedRate);
     free(data.cp);
-    printf("> 13\n");
     free(data.vel_x);
-    printf("> 14\n");
     free(data.vel_y);
-    printf("> 15\n");
     free(data.vel_z);
-    printf("> 16\n");
     free(data.transpiration);
-    printf("> 17\n");
+    freeWakeCouplingData(data.wake);
+    freeComponentBlocksData(data.components);
 }
 
 #endif
\ No newline at end of file
@@ -1,8 +1,7 @@
 #include "../helpers/linearSystemSolver.h"
 #include "data.h"
 
-void getDoubleDistributionImp(struct PotentialFlowData data)
+void getDoubleDistributionImp(struct PotentialFlowData data, struct Arena *arena)
 {
-    for (int i = 0; i < data.n; i++) data.doublet[i] = 0.0;
-    solveGMRES(data.n, data.na, data.a, data.ia, data.ja, data.rhs, data.doublet);
+    solveGMRES(data.n, potentialFlowMatvec, &data, data.rhs, data.doublet, arena);
 }
\ No newline at end of file
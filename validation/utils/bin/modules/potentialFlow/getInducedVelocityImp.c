@@ -0,0 +1,650 @@
+#include "../helpers/structs.h"
+#include "../helpers/customMath.h"
+#include "data.h"
+#include <math.h>
+
+#define PANEL_TREE_LEAF_SIZE 16
+#define PANEL_TREE_THETA 0.3            // a node is expanded when its radius is below THETA times its distance
+
+/*
+    Binary tree of the surface panels, split at the median of the longest
+    side of the bounding box of the centers. The panels of node k are
+    order[first] ... order[first + count - 1]; children come after their
+    parent, so a reverse sweep visits them first.
+*/
+struct PanelTreeNode
+{
+    double center[3];
+    double radius;              // of the sphere holding every vertex of the node
+    int first, count;
+    int left, right;            // -1 for leaves
+};
+
+struct PanelTree
+{
+    int nNodes;
+    double theta;               // PANEL_TREE_THETA, 0 sums every panel exactly
+    int *order;
+    struct PanelTreeNode *nodes;
+    double *source;             // [nNodes] sum of sigma * area
+    double *sourceDipole;       // [nNodes x 3] sum of sigma * area * d, d = center of the face - center of the node
+    double *sourceQuadrupole;   // [nNodes x 9] sum of sigma * area * d d
+    double *dipole;             // [nNodes x 3] sum of doublet * area * e3
+    double *dipoleMoment;       // [nNodes x 9] sum of doublet * area * d e3
+};
+
+int buildPanelTreeNode(struct SurfaceMesh surface, struct PanelTree *tree, int first, int count)
+{
+
+    /* Parameters */
+    int i, j, k, axis, node, half;
+    double lo[3], hi[3], c, d;
+    struct PanelTreeNode *n;
+
+    /* Initialize */
+    node = tree->nNodes++;
+    n = &tree->nodes[node];
+    n->first = first;
+    n->count = count;
+    n->left = -1;
+    n->right = -1;
+
+    for (k = 0; k < 3; k++) {
+        lo[k] = INFINITY;
+        hi[k] = -INFINITY;
+    }
+
+    for (i = first; i < first + count; i++) {
+        for (k = 0; k < 3; k++) {
+            c = surface.facesCenter[3 * tree->order[i] + k];
+            lo[k] = (c < lo[k]) ? c : lo[k];
+            hi[k] = (c > hi[k]) ? c : hi[k];
+        }
+    }
+
+    for (k = 0; k < 3; k++) n->center[k] = 0.5 * (lo[k] + hi[k]);
+
+    n->radius = 0.0;
+
+    for (i = first; i < first + count; i++) {
+        for (j = 0; j < 3; j++) {
+            double *v = &surface.vertices[3 * surface.faces[3 * tree->order[i] + j]];
+            d = sqrt((v[0] - n->center[0]) * (v[0] - n->center[0]) + (v[1] - n->center[1]) * (v[1] - n->center[1]) + (v[2] - n->center[2]) * (v[2] - n->center[2]));
+            n->radius = (d > n->radius) ? d : n->radius;
+        }
+    }
+
+    if (count <= PANEL_TREE_LEAF_SIZE) return node;
+
+    /* Partial sort around the median of the longest axis */
+    axis = 0;
+    for (k = 1; k < 3; k++) if (hi[k] - lo[k] > hi[axis] - lo[axis]) axis = k;
+
+    half = count / 2;
+
+    {
+        int l = first, r = first + count - 1, m = first + half;
+
+        while (l < r) {
+
+            double pivot = surface.facesCenter[3 * tree->order[m] + axis];
+            int a = l, b = r;
+
+            while (a <= b) {
+                while (surface.facesCenter[3 * tree->order[a] + axis] < pivot) a++;
+                while (surface.facesCenter[3 * tree->order[b] + axis] > pivot) b--;
+                if (a <= b) {
+                    k = tree->order[a]; tree->order[a] = tree->order[b]; tree->order[b] = k;
+                    a++; b--;
+                }
+            }
+
+            if (m <= b) r = b;
+            else if (m >= a) l = a;
+            else break;
+        }
+    }
+
+    tree->nodes[node].left = buildPanelTreeNode(surface, tree, first, half);
+    tree->nodes[node].right = buildPanelTreeNode(surface, tree, first + half, count - half);
+
+    return node;
+}
+
+struct PanelTree getPanelTreeData(struct SurfaceMesh surface, double *sigma, double *doublet)
+/* Tree of the surface and its moments for the given sigma and doublet distributions */
+{
+
+    /* Parameters */
+    int i, j, k, l, face;
+    double area, d[3];
+    struct PanelTree tree;
+    struct PanelTreeNode *n, *c;
+
+    /* Initialize */
+    tree.nNodes = 0;
+    tree.theta = PANEL_TREE_THETA;
+    tree.order = (int *)malloc(surface.nf * sizeof(int));
+    tree.nodes = (struct PanelTreeNode *)malloc(2 * (size_t)surface.nf * sizeof(struct PanelTreeNode));
+
+    for (i = 0; i < surface.nf; i++) tree.order[i] = i;
+
+    buildPanelTreeNode(surface, &tree, 0, surface.nf);
+
+    tree.source = (double *)calloc(25 * (size_t)tree.nNodes, sizeof(double));
+    tree.sourceDipole = tree.source + tree.nNodes;
+    tree.sourceQuadrupole = tree.sourceDipole + 3 * (size_t)tree.nNodes;
+    tree.dipole = tree.sourceQuadrupole + 9 * (size_t)tree.nNodes;
+    tree.dipoleMoment = tree.dipole + 3 * (size_t)tree.nNodes;
+
+    /* Moments, leaves from their panels and nodes from their children moved to their center */
+    for (i = tree.nNodes - 1; i >= 0; i--) {
+
+        n = &tree.nodes[i];
+
+        if (n->left < 0) {
+            for (j = n->first; j < n->first + n->count; j++) {
+
+                face = tree.order[j];
+                area = surface.facesAreas[face];
+
+                for (k = 0; k < 3; k++) d[k] = surface.facesCenter[3 * face + k] - n->center[k];
+
+                tree.source[i] += sigma[face] * area;
+
+                for (k = 0; k < 3; k++) {
+                    tree.sourceDipole[3 * i + k] += sigma[face] * area * d[k];
+                    tree.dipole[3 * i + k] += doublet[face] * area * surface.e3[3 * face + k];
+                    for (l = 0; l < 3; l++) {
+                        tree.sourceQuadrupole[9 * i + 3 * k + l] += sigma[face] * area * d[k] * d[l];
+                        tree.dipoleMoment[9 * i + 3 * k + l] += doublet[face] * area * d[k] * surface.e3[3 * face + l];
+                    }
+                }
+            }
+        } else {
+            for (j = 0; j < 2; j++) {
+
+                int child = (j == 0) ? n->left : n->right;
+                double *s = &tree.sourceDipole[3 * child];
+                double *m = &tree.dipole[3 * child];
+
+                c = &tree.nodes[child];
+
+                for (k = 0; k < 3; k++) d[k] = c->center[k] - n->center[k];
+
+                tree.source[i] += tree.source[child];
+
+                for (k = 0; k < 3; k++) {
+                    tree.sourceDipole[3 * i + k] += s[k] + tree.source[child] * d[k];
+                    tree.dipole[3 * i + k] += m[k];
+                    for (l = 0; l < 3; l++) {
+                        tree.sourceQuadrupole[9 * i + 3 * k + l] += tree.sourceQuadrupole[9 * child + 3 * k + l] + d[k] * s[l] + s[k] * d[l] + tree.source[child] * d[k] * d[l];
+                        tree.dipoleMoment[9 * i + 3 * k + l] += tree.dipoleMoment[9 * child + 3 * k + l] + d[k] * m[l];
+                    }
+                }
+            }
+        }
+    }
+
+    return tree;
+}
+
+void freePanelTreeData(struct PanelTree tree)
+{
+    free(tree.order);
+    free(tree.nodes);
+    free(tree.source);
+}
+
+void panelVelocity(struct SurfaceMesh surface, double *sigma, double *doublet, int face, double *x, double *vel)
+/* Adds the exact velocity of one panel, as in the assembly of the influence matrices */
+{
+
+    /* Parameters */
+    int k;
+    double sourceVel[3], doubletVel[3];
+    struct Point p, pLocal, p1, p2, p3, e1, e2, e3;
+
+    /* Initialize */
+    e1 = (struct Point){surface.e1[3 * face], surface.e1[3 * face + 1], surface.e1[3 * face + 2]};
+    e2 = (struct Point){surface.e2[3 * face], surface.e2[3 * face + 1], surface.e2[3 * face + 2]};
+    e3 = (struct Point){surface.e3[3 * face], surface.e3[3 * face + 1], surface.e3[3 * face + 2]};
+
+    p = (struct Point){x[0] - surface.facesCenter[3 * face], x[1] - surface.facesCenter[3 * face + 1], x[2] - surface.facesCenter[3 * face + 2]};
+    pLocal = (struct Point){dot(p, e1), dot(p, e2), dot(p, e3)};
+
+    p1 = (struct Point){surface.p1[2 * face], surface.p1[2 * face + 1], 0.0};
+    p2 = (struct Point){surface.p2[2 * face], surface.p2[2 * face + 1], 0.0};
+    p3 = (struct Point){surface.p3[2 * face], surface.p3[2 * face + 1], 0.0};
+
+    /* Velocity */
+    sourceFunc(pLocal, p1, p2, p3, e1, e2, e3, surface.facesAreas[face], surface.facesMaxDistance[face], sourceVel);
+    doubletFunc(pLocal, p1, p2, p3, e1, e2, e3, surface.facesAreas[face], surface.facesMaxDistance[face], doubletVel);
+
+    for (k = 0; k < 3; k++) vel[k] += sigma[face] * sourceVel[k] + doublet[face] * doubletVel[k];
+}
+
+void panelTreeVelocity(struct SurfaceMesh surface, struct PanelTree *tree, double *sigma, double *doublet, double *x, double *vel)
+/*
+    Adds the velocity of the surface at x: the far nodes by their source
+    monopole and dipole and their doublet dipole, the near leaves panel by
+    panel.
+*/
+{
+
+    /* Parameters */
+    int i, k, node, top;
+    int stack[128];
+    double r[3], r2, r3, r5, sr, mr;
+    struct PanelTreeNode *n;
+
+    /* Initialize */
+    top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+
+        node = stack[--top];
+        n = &tree->nodes[node];
+
+        for (k = 0; k < 3; k++) r[k] = x[k] - n->center[k];
+
+        r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+
+        if (n->radius * n->radius < tree->theta * tree->theta * r2) {
+
+            double *s = &tree->sourceDipole[3 * node];
+            double *q = &tree->sourceQuadrupole[9 * node];
+            double *m = &tree->dipole[3 * node];
+            double *t = &tree->dipoleMoment[9 * node];
+            double qr[3], tr[3], trT[3], rqr, rtr, qTrace, tTrace;
+
+            r3 = r2 * sqrt(r2);
+            r5 = r3 * r2;
+            sr = s[0] * r[0] + s[1] * r[1] + s[2] * r[2];
+            mr = m[0] * r[0] + m[1] * r[1] + m[2] * r[2];
+
+            for (k = 0; k < 3; k++) {
+                qr[k] = q[3 * k] * r[0] + q[3 * k + 1] * r[1] + q[3 * k + 2] * r[2];
+                tr[k] = t[3 * k] * r[0] + t[3 * k + 1] * r[1] + t[3 * k + 2] * r[2];
+                trT[k] = t[k] * r[0] + t[3 + k] * r[1] + t[6 + k] * r[2];
+            }
+
+            rqr = r[0] * qr[0] + r[1] * qr[1] + r[2] * qr[2];
+            rtr = r[0] * tr[0] + r[1] * tr[1] + r[2] * tr[2];
+            qTrace = q[0] + q[4] + q[8];
+            tTrace = t[0] + t[4] + t[8];
+
+            /* Source monopole, dipole and quadrupole, doublet dipole and its first moment */
+            for (k = 0; k < 3; k++) {
+                vel[k] += FACTOR * (tree->source[node] * r[k] / r3 + 3 * (sr + mr) * r[k] / r5 - (s[k] + m[k]) / r3
+                                    - 3 * qr[k] / r5 - 1.5 * qTrace * r[k] / r5 + 7.5 * rqr * r[k] / (r5 * r2)
+                                    - 3 * (tTrace * r[k] + tr[k] + trT[k]) / r5 + 15 * rtr * r[k] / (r5 * r2));
+            }
+
+        } else if (n->left < 0) {
+
+            for (i = n->first; i < n->first + n->count; i++) panelVelocity(surface, sigma, doublet, tree->order[i], x, vel);
+
+        } else {
+
+            stack[top++] = n->left;
+            stack[top++] = n->right;
+        }
+    }
+}
+
+void getSurfaceVelocityImp(struct SurfaceMesh surface, double *sigma, double *doublet, int n, double *points, double theta, double *vel)
+/* Velocity of the surface alone at n points through the tree, with the opening angle theta (0 for the exact sum) */
+{
+    int i;
+    struct PanelTree tree = getPanelTreeData(surface, sigma, doublet);
+
+    tree.theta = theta;
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (i = 0; i < n; i++) {
+        vel[3 * i] = 0.0;
+        vel[3 * i + 1] = 0.0;
+        vel[3 * i + 2] = 0.0;
+        panelTreeVelocity(surface, &tree, sigma, doublet, &points[3 * i], &vel[3 * i]);
+    }
+
+    freePanelTreeData(tree);
+}
+
+void coreLineVelocity(double px, double py, double pz, double *x, double *y, double *z, int n, double *end, double core, double *vel)
+/*
+    Velocity induced by a wake line with unit circulation, its n - 1
+    segments and its semi-infinite end (none if end is NULL), with a
+    vortex core of radius core (h^2 / (h^2 + core^2) at a distance h of the
+    line), so the wake vertices can be evaluated on the lines themselves.
+*/
+{
+
+    /* Parameters */
+    int l;
+    double u = 0.0, v = 0.0, w = 0.0;
+
+    for (l = 0; l < n - 1; l++) {
+
+        double r1x = x[l] - px, r1y = y[l] - py, r1z = z[l] - pz;
+        double r2x = x[l + 1] - px, r2y = y[l + 1] - py, r2z = z[l + 1] - pz;
+        double r0x = r1x - r2x, r0y = r1y - r2y, r0z = r1z - r2z;
+
+        double cx = r1y * r2z - r1z * r2y;
+        double cy = r1z * r2x - r1x * r2z;
+        double cz = r1x * r2y - r1y * r2x;
+
+        double r1Norm = sqrt(r1x * r1x + r1y * r1y + r1z * r1z);
+        double r2Norm = sqrt(r2x * r2x + r2y * r2y + r2z * r2z);
+
+        if ((r1Norm < 1e-12) || (r2Norm < 1e-12)) continue;
+
+        double d = (r0x * (r1x / r1Norm - r2x / r2Norm) + r0y * (r1y / r1Norm - r2y / r2Norm) + r0z * (r1z / r1Norm - r2z / r2Norm)) / (cx * cx + cy * cy + cz * cz + core * core * (r0x * r0x + r0y * r0y + r0z * r0z));
+
+        u += cx * d;
+        v += cy * d;
+        w += cz * d;
+    }
+
+    if (end != NULL) {
+
+        double rx = x[n - 1] - px, ry = y[n - 1] - py, rz = z[n - 1] - pz;
+        double rNorm = sqrt(rx * rx + ry * ry + rz * rz);
+
+        double cx = ry * end[2] - rz * end[1];
+        double cy = rz * end[0] - rx * end[2];
+        double cz = rx * end[1] - ry * end[0];
+
+        if (rNorm > 1e-12) {
+            double d = (1 - (end[0] * rx + end[1] * ry + end[2] * rz) / rNorm) / (cx * cx + cy * cy + cz * cz + core * core);
+            u += cx * d;
+            v += cy * d;
+            w += cz * d;
+        }
+    }
+
+    vel[0] = FACTOR * u;
+    vel[1] = FACTOR * v;
+    vel[2] = FACTOR * w;
+}
+
+void wakeLinesVelocity(struct WakeLines lines, double *doublet, double *x, double core, double *lineVel, double *vel)
+/* Adds the velocity of the strips of one wake part at x. lineVel holds 3 * nSpan doubles */
+{
+
+    /* Parameters */
+    int k, s;
+    double gamma, teVel[3], endVel[3] = {0.0, 0.0, 0.0};
+
+    if (lines.nSpan < 2) return;
+
+    /* Lines */
+    for (k = 0; k < lines.nSpan; k++) {
+        coreLineVelocity(x[0], x[1], x[2], &lines.x[k * lines.nWake], &lines.y[k * lines.nWake], &lines.z[k * lines.nWake], lines.nWake, ((lines.nWake > 1) && !lines.closed) ? &lines.ends[3 * k] : NULL, core, &lineVel[3 * k]);
+    }
+
+    /* Strips */
+    for (s = 0; s < lines.nSpan - 1; s++) {
+
+        double tx[2] = {lines.x[s * lines.nWake], lines.x[(s + 1) * lines.nWake]};
+        double ty[2] = {lines.y[s * lines.nWake], lines.y[(s + 1) * lines.nWake]};
+        double tz[2] = {lines.z[s * lines.nWake], lines.z[(s + 1) * lines.nWake]};
+
+        double ex[2] = {lines.x[(s + 2) * lines.nWake - 1], lines.x[(s + 1) * lines.nWake - 1]};
+        double ey[2] = {lines.y[(s + 2) * lines.nWake - 1], lines.y[(s + 1) * lines.nWake - 1]};
+        double ez[2] = {lines.z[(s + 2) * lines.nWake - 1], lines.z[(s + 1) * lines.nWake - 1]};
+
+        coreLineVelocity(x[0], x[1], x[2], tx, ty, tz, 2, NULL, core, teVel);
+        if (lines.closed) coreLineVelocity(x[0], x[1], x[2], ex, ey, ez, 2, NULL, core, endVel);
+
+        gamma = doublet[lines.faces[2 * s]] - doublet[lines.faces[2 * s + 1]];
+
+        for (k = 0; k < 3; k++) vel[k] += gamma * (lineVel[3 * (s + 1) + k] - lineVel[3 * s + k] + teVel[k] + endVel[k]);
+    }
+}
+
+void getInducedVelocityImp(struct Input input, struct PotentialFlowData data, int n, double *points, double core, double *vel)
+/*
+    Velocity at n points (onset of the freestream and body rotation,
+    surface and wake, and their images in a half model) of the last solved
+    distributions. The surface goes through a tree, so each point costs
+    O(log nf) nodes plus its near panels instead of nf panels.
+*/
+{
+
+    /* Parameters */
+    int k, nSpan;
+    struct WakeMeshPart parts[3] = {input.mesh.wake.left, input.mesh.wake.right, input.mesh.wake.tail};
+    struct WakeLines lines[3];
+    struct PanelTree tree;
+
+    /* Initialize */
+    tree = getPanelTreeData(input.mesh.surface, data.sigma, data.doublet);
+    nSpan = 0;
+
+    for (k = 0; k < 3; k++) {
+        lines[k] = getWakeLinesData(input.mesh.surface, parts[k], data.closedWake);
+        nSpan = (parts[k].nSpan > nSpan) ? parts[k].nSpan : nSpan;
+    }
+
+    /* Velocities */
+    #pragma omp parallel
+    {
+
+        int i, j;
+        double *lineVel = (double *)malloc(3 * ((size_t)nSpan + 1) * sizeof(double));
+
+        #pragma omp for schedule(dynamic, 64)
+        for (i = 0; i < n; i++) {
+
+            double *v = &vel[3 * i];
+
+            v[0] = input.environment.vel_x - (input.environment.rot_y * points[3 * i + 2] - input.environment.rot_z * points[3 * i + 1]);
+            v[1] = input.environment.vel_y - (input.environment.rot_z * points[3 * i] - input.environment.rot_x * points[3 * i + 2]);
+            v[2] = input.environment.vel_z - (input.environment.rot_x * points[3 * i + 1] - input.environment.rot_y * points[3 * i]);
+
+            panelTreeVelocity(input.mesh.surface, &tree, data.sigma, data.doublet, &points[3 * i], v);
+
+            for (j = 0; j < 3; j++) wakeLinesVelocity(lines[j], data.doublet, &points[3 * i], core, lineVel, v);
+
+            // Half model: the images act at the point as the body and wake at its image, mirrored, with their sign
+            if (data.symmetric) {
+
+                double image[3] = {points[3 * i], -points[3 * i + 1], points[3 * i + 2]};
+                double imageVel[3] = {0.0, 0.0, 0.0};
+
+                panelTreeVelocity(input.mesh.surface, &tree, data.sigma, data.doublet, image, imageVel);
+
+                for (j = 0; j < 3; j++) wakeLinesVelocity(lines[j], data.doublet, image, core, lineVel, imageVel);
+
+                v[0] += data.symmetric * imageVel[0];
+                v[1] -= data.symmetric * imageVel[1];
+                v[2] += data.symmetric * imageVel[2];
+            }
+        }
+
+        free(lineVel);
+    }
+
+    /* Free */
+    freePanelTreeData(tree);
+    for (k = 0; k < 3; k++) freeWakeLinesData(lines[k]);
+}
+
+void getOnsetRightHandSideImp(struct Input input, struct PotentialFlowData data)
+/*
+    Adds the onset and induced velocities at the control points to the
+    right hand side. Their normal part goes into the sources, as the one
+    of the freestream does, so the inside of the body stays at rest, and
+    the velocity of these extra sources at the control points comes from
+    the tree instead of a stored influence matrix. Nothing to do while
+    both are zero, as in steady solves.
+*/
+{
+
+    /* Parameters */
+    int i, any;
+    double *sigma, *doublet;
+    struct PanelTree tree;
+
+    any = 0;
+
+    for (i = 0; (i < 3 * data.n) && !any; i++) any = (data.onset[i] != 0.0) || (data.induced[i] != 0.0);
+
+    if (!any) return;
+
+    /* Initialize */
+    sigma = (double *)malloc(data.n * sizeof(double));
+    doublet = (double *)calloc(data.n, sizeof(double));
+
+    for (i = 0; i < data.n; i++) {
+        sigma[i] = -(input.mesh.surface.e3[3 * i] * (data.onset[3 * i] + data.induced[3 * i]) + input.mesh.surface.e3[3 * i + 1] * (data.onset[3 * i + 1] + data.induced[3 * i + 1]) + input.mesh.surface.e3[3 * i + 2] * (data.onset[3 * i + 2] + data.induced[3 * i + 2]));
+    }
+
+    tree = getPanelTreeData(input.mesh.surface, sigma, doublet);
+
+    /* Right hand side */
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (i = 0; i < data.n; i++) {
+
+        double *e3 = &input.mesh.surface.e3[3 * i];
+        double v[3] = {data.onset[3 * i] + data.induced[3 * i], data.onset[3 * i + 1] + data.induced[3 * i + 1], data.onset[3 * i + 2] + data.induced[3 * i + 2]};
+
+        panelTreeVelocity(input.mesh.surface, &tree, sigma, doublet, &input.mesh.surface.controlPoints[3 * i], v);
+
+        if (data.symmetric) {
+
+            double image[3] = {input.mesh.surface.controlPoints[3 * i], -input.mesh.surface.controlPoints[3 * i + 1], input.mesh.surface.controlPoints[3 * i + 2]};
+            double imageVel[3] = {0.0, 0.0, 0.0};
+
+            panelTreeVelocity(input.mesh.surface, &tree, sigma, doublet, image, imageVel);
+
+            v[0] += data.symmetric * imageVel[0];
+            v[1] -= data.symmetric * imageVel[1];
+            v[2] += data.symmetric * imageVel[2];
+        }
+
+        data.sigma[i] = data.sigma[i] + sigma[i];
+        data.rhs[i] = data.rhs[i] - (e3[0] * v[0] + e3[1] * v[1] + e3[2] * v[2]);
+        data.rhs_vel_x[i] = data.rhs_vel_x[i] + v[0];
+        data.rhs_vel_y[i] = data.rhs_vel_y[i] + v[1];
+        data.rhs_vel_z[i] = data.rhs_vel_z[i] + v[2];
+    }
+
+    /* Free */
+    freePanelTreeData(tree);
+    free(sigma);
+    free(doublet);
+}
+
+double triangleSolidAngle(double *x, double *a, double *b, double *c)
+/* Solid angle of the triangle abc seen from x, positive on the side of (b - a) x (c - a) (Van Oosterom and Strackee) */
+{
+    double r1[3] = {a[0] - x[0], a[1] - x[1], a[2] - x[2]};
+    double r2[3] = {b[0] - x[0], b[1] - x[1], b[2] - x[2]};
+    double r3[3] = {c[0] - x[0], c[1] - x[1], c[2] - x[2]};
+
+    double n1 = sqrt(r1[0] * r1[0] + r1[1] * r1[1] + r1[2] * r1[2]);
+    double n2 = sqrt(r2[0] * r2[0] + r2[1] * r2[1] + r2[2] * r2[2]);
+    double n3 = sqrt(r3[0] * r3[0] + r3[1] * r3[1] + r3[2] * r3[2]);
+
+    double triple = r1[0] * (r2[1] * r3[2] - r2[2] * r3[1]) + r1[1] * (r2[2] * r3[0] - r2[0] * r3[2]) + r1[2] * (r2[0] * r3[1] - r2[1] * r3[0]);
+    double den = n1 * n2 * n3 + (r1[0] * r2[0] + r1[1] * r2[1] + r1[2] * r2[2]) * n3 + (r1[0] * r3[0] + r1[1] * r3[1] + r1[2] * r3[2]) * n2 + (r2[0] * r3[0] + r2[1] * r3[1] + r2[2] * r3[2]) * n1;
+
+    return -2 * atan2(triple, den);
+}
+
+void getVortexLatticeVelocityImp(int nSpan, int nRows, double *lattice, double *gamma, int n, double *points, double core, double *vel, double *potential)
+/*
+    Velocity at n points of a lattice of closed vortex rings, for example
+    the wake rows shed in the previous time steps. lattice holds
+    (nRows + 1) x nSpan vertices [x, y, z], row 0 upstream, and ring (r, s)
+    of circulation gamma[r * (nSpan - 1) + s] goes round lattice[r][s],
+    lattice[r][s + 1], lattice[r + 1][s + 1] and lattice[r + 1][s], as the
+    strips of the wake coupling. Each segment is evaluated once, with the
+    difference of the circulations of the rings on its sides. potential
+    (NULL to skip it) gets the potential of the rings in the convention of
+    the surface doublets, -gamma times the solid angle over 4 pi.
+*/
+{
+
+    /* Parameters */
+    int r, s, k;
+    int nLines = nSpan * nRows;
+    double *x, *y, *z, *lineGamma;
+
+    if ((nSpan < 2) || (nRows < 1)) {
+        for (k = 0; k < 3 * n; k++) vel[k] = 0.0;
+        for (k = 0; (k < n) && (potential != NULL); k++) potential[k] = 0.0;
+        return;
+    }
+
+    /* Segments: spanwise ones first, then the chordwise ones */
+    x = (double *)malloc(6 * ((size_t)(nSpan - 1) * (nRows + 1) + nLines) * sizeof(double));
+    y = x + 2 * ((size_t)(nSpan - 1) * (nRows + 1) + nLines);
+    z = y + 2 * ((size_t)(nSpan - 1) * (nRows + 1) + nLines);
+    lineGamma = (double *)malloc(((size_t)(nSpan - 1) * (nRows + 1) + nLines) * sizeof(double));
+
+    k = 0;
+
+    for (r = 0; r <= nRows; r++) {
+        for (s = 0; s < nSpan - 1; s++) {
+            lineGamma[k] = ((r < nRows) ? gamma[r * (nSpan - 1) + s] : 0.0) - ((r > 0) ? gamma[(r - 1) * (nSpan - 1) + s] : 0.0);
+            x[2 * k] = lattice[3 * (r * nSpan + s)]; x[2 * k + 1] = lattice[3 * (r * nSpan + s + 1)];
+            y[2 * k] = lattice[3 * (r * nSpan + s) + 1]; y[2 * k + 1] = lattice[3 * (r * nSpan + s + 1) + 1];
+            z[2 * k] = lattice[3 * (r * nSpan + s) + 2]; z[2 * k + 1] = lattice[3 * (r * nSpan + s + 1) + 2];
+            k++;
+        }
+    }
+
+    for (r = 0; r < nRows; r++) {
+        for (s = 0; s < nSpan; s++) {
+            lineGamma[k] = ((s > 0) ? gamma[r * (nSpan - 1) + s - 1] : 0.0) - ((s < nSpan - 1) ? gamma[r * (nSpan - 1) + s] : 0.0);
+            x[2 * k] = lattice[3 * (r * nSpan + s)]; x[2 * k + 1] = lattice[3 * ((r + 1) * nSpan + s)];
+            y[2 * k] = lattice[3 * (r * nSpan + s) + 1]; y[2 * k + 1] = lattice[3 * ((r + 1) * nSpan + s) + 1];
+            z[2 * k] = lattice[3 * (r * nSpan + s) + 2]; z[2 * k + 1] = lattice[3 * ((r + 1) * nSpan + s) + 2];
+            k++;
+        }
+    }
+
+    /* Velocities */
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+
+        int l;
+        double segmentVel[3];
+        double *v = &vel[3 * i];
+
+        v[0] = 0.0; v[1] = 0.0; v[2] = 0.0;
+
+        for (l = 0; l < k; l++) {
+            if (lineGamma[l] == 0.0) continue;
+            coreLineVelocity(points[3 * i], points[3 * i + 1], points[3 * i + 2], &x[2 * l], &y[2 * l], &z[2 * l], 2, NULL, core, segmentVel);
+            v[0] += lineGamma[l] * segmentVel[0];
+            v[1] += lineGamma[l] * segmentVel[1];
+            v[2] += lineGamma[l] * segmentVel[2];
+        }
+
+        if (potential == NULL) continue;
+
+        potential[i] = 0.0;
+
+        for (l = 0; l < nRows * (nSpan - 1); l++) {
+
+            double *p0 = &lattice[3 * ((l / (nSpan - 1)) * nSpan + l % (nSpan - 1))];
+            double *p1 = p0 + 3;
+            double *p2 = p1 + 3 * nSpan;
+            double *p3 = p0 + 3 * nSpan;
+
+            if (gamma[l] == 0.0) continue;
+
+            potential[i] -= FACTOR * gamma[l] * (triangleSolidAngle(&points[3 * i], p0, p1, p2) + triangleSolidAngle(&points[3 * i], p0, p2, p3));
+        }
+    }
+
+    /* Free */
+    free(x);
+    free(lineGamma);
+}
\ No newline at end of file
@@ -97,13 +97,14 @@ void doubletFunc(struct Point p, struct Point p1, struct Point p2, struct Point
 
     if (distance > maxDistance) {
 
-        double pxLocal = p.x * e1.x + p.y * e1.y + p.z * e1.z;
-        double pyLocal = p.x * e2.x + p.y * e2.y + p.z * e2.z;
-        double pzLocal = p.x * e3.x + p.y * e3.y + p.z * e3.z;
+        // Dipole of moment area e3, p being already in the panel axes
+        double pxLocal = p.x;
+        double pyLocal = p.y;
+        double pzLocal = p.z;
         double den = pow(pxLocal * pxLocal + pyLocal * pyLocal + pzLocal * pzLocal, 2.5);
 
-        double u = 0.75 * FACTOR * area * pzLocal * pxLocal / den;
-        double v = 0.75 * FACTOR * area * pzLocal * pyLocal / den;
+        double u = 3 * FACTOR * area * pzLocal * pxLocal / den;
+        double v = 3 * FACTOR * area * pzLocal * pyLocal / den;
         double w = -FACTOR * area * (pxLocal * pxLocal + pyLocal * pyLocal - 2 * pzLocal * pzLocal) / den;
 
         vel[0] = u * e1.x + v * e2.x + w * e3.x;
@@ -114,9 +115,7 @@ void doubletFunc(struct Point p, struct Point p1, struct Point p2, struct Point
 
         double u, v, w;
 
-        double *vel1 = (double *)malloc(3 * sizeof(double *));
-        double *vel2 = (double *)malloc(3 * sizeof(double *));
-        double *vel3 = (double *)malloc(3 * sizeof(double *));
+        double vel1[3], vel2[3], vel3[3];
 
         lineFunc(p, p1, p2, vel1);
         lineFunc(p, p2, p3, vel2);
@@ -130,230 +129,410 @@ void doubletFunc(struct Point p, struct Point p1, struct Point p2, struct Point
         vel[1] = u * e1.y + v * e2.y + w * e3.y;
         vel[2] = u * e1.z + v * e2.z + w * e3.z;
 
-        free(vel1);
-        free(vel2);
-        free(vel3);
-
     }
 
 }
 
-void addWakeCoefficients(struct Input input, double *lineVel, struct Point e3iPoint, int face, int nWake, int nSpanWake, double *wakeVertices, int *wakeGrid, int *wakeFaces, struct PotentialFlowData data)
+void panelInfluence(struct SurfaceMesh surface, int j, double *x, double *sourceVel, double *doubletVel)
+/* Velocities at x of unit source and doublet distributions over the face j */
 {
-
-    int k, l;
-    int indexLine1, indexLine2;
-    struct Point p1Line;
-    struct Point p2Line;
+    /* Parameters */
     struct Point p;
+    struct Point pLocal;
+    struct Point p1Local, p2Local, p3Local;
+    struct Point e1jPoint, e2jPoint, e3jPoint;
+
+    /* Points */
+    e1jPoint = (struct Point){surface.e1[j * 3], surface.e1[j * 3 + 1], surface.e1[j * 3 + 2]};
+    e2jPoint = (struct Point){surface.e2[j * 3], surface.e2[j * 3 + 1], surface.e2[j * 3 + 2]};
+    e3jPoint = (struct Point){surface.e3[j * 3], surface.e3[j * 3 + 1], surface.e3[j * 3 + 2]};
 
-    // Wake
-    p.x = input.mesh.surface.controlPoints[3 * face];
-    p.y = input.mesh.surface.controlPoints[3 * face + 1];
-    p.z = input.mesh.surface.controlPoints[3 * face + 2];
+    p.x = x[0] - surface.facesCenter[j * 3];
+    p.y = x[1] - surface.facesCenter[j * 3 + 1];
+    p.z = x[2] - surface.facesCenter[j * 3 + 2];
 
-    // Left wing
-    for (k = 0; k < nSpanWake; k++) {
+    pLocal.x = p.x * e1jPoint.x + p.y * e1jPoint.y + p.z * e1jPoint.z;
+    pLocal.y = p.x * e2jPoint.x + p.y * e2jPoint.y + p.z * e2jPoint.z;
+    pLocal.z = p.x * e3jPoint.x + p.y * e3jPoint.y + p.z * e3jPoint.z;
 
-        for (l = 0; l < nWake - 1; l++) {
+    p1Local = (struct Point){surface.p1[j * 2], surface.p1[j * 2 + 1], 0.0};
+    p2Local = (struct Point){surface.p2[j * 2], surface.p2[j * 2 + 1], 0.0};
+    p3Local = (struct Point){surface.p3[j * 2], surface.p3[j * 2 + 1], 0.0};
 
-            indexLine1 = wakeGrid[k * nWake + l] * 3;
-            p1Line.x = wakeVertices[indexLine1];
-            p1Line.y = wakeVertices[indexLine1 + 1];
-            p1Line.z = wakeVertices[indexLine1 + 2];
+    sourceFunc(pLocal, p1Local, p2Local, p3Local, e1jPoint, e2jPoint, e3jPoint, surface.facesAreas[j], surface.facesMaxDistance[j], sourceVel);
+    doubletFunc(pLocal, p1Local, p2Local, p3Local, e1jPoint, e2jPoint, e3jPoint, surface.facesAreas[j], surface.facesMaxDistance[j], doubletVel);
+}
 
-            indexLine2 = wakeGrid[k * nWake + l + 1] * 3;
-            p2Line.x = wakeVertices[indexLine2];
-            p2Line.y = wakeVertices[indexLine2 + 1];
-            p2Line.z = wakeVertices[indexLine2 + 2];
+void addComponentPartial(double *partial, double *sourceVel, double sourceNormalVel, struct Point e3jPoint, struct Point cje3jPoint)
+/* Right hand side sensitivities of one source, of normal e3_j and moment arm c_j x e3_j, added to partial */
+{
+    int m;
 
-            lineFunc(p, p1Line, p2Line, lineVel);
+    partial[0] = partial[0] + e3jPoint.x * sourceNormalVel;
+    partial[1] = partial[1] + e3jPoint.y * sourceNormalVel;
+    partial[2] = partial[2] + e3jPoint.z * sourceNormalVel;
 
-            if (k == 0) {
+    partial[3] = partial[3] + cje3jPoint.x * sourceNormalVel;
+    partial[4] = partial[4] + cje3jPoint.y * sourceNormalVel;
+    partial[5] = partial[5] + cje3jPoint.z * sourceNormalVel;
 
-                data.a[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a[face * input.mesh.surface.nf + wakeFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                data.a[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+    for (m = 0; m < 3; m++)
+    {
+        partial[6 + 3 * m] = partial[6 + 3 * m] + sourceVel[m] * e3jPoint.x;
+        partial[7 + 3 * m] = partial[7 + 3 * m] + sourceVel[m] * e3jPoint.y;
+        partial[8 + 3 * m] = partial[8 + 3 * m] + sourceVel[m] * e3jPoint.z;
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2]] - lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2]] - lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2]] - lineVel[2];
+        partial[15 + 3 * m] = partial[15 + 3 * m] + sourceVel[m] * cje3jPoint.x;
+        partial[16 + 3 * m] = partial[16 + 3 * m] + sourceVel[m] * cje3jPoint.y;
+        partial[17 + 3 * m] = partial[17 + 3 * m] + sourceVel[m] * cje3jPoint.z;
+    }
+}
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + lineVel[2];
-            } else if (k == nSpanWake - 1) {
+void influenceEntry(struct Input input, struct PotentialFlowData data, int i, int j, struct Point e3iPoint, double *partial)
+/* Effect of the face j on the control point i: the matrices entries, and the right hand side sensitivities added to partial */
+{
+    /* Parameters */
+    double x[3] = {input.mesh.surface.controlPoints[i * 3], input.mesh.surface.controlPoints[i * 3 + 1], input.mesh.surface.controlPoints[i * 3 + 2]};
+    double sourceVel[3], doubletVel[3];
+    double imageSourceVel[3], imageDoubletVel[3];
+    double sourceNormalVel;
+    struct Point e3jPoint, cjPoint, cje3jPoint;
 
-                data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+    /* Face */
+    panelInfluence(input.mesh.surface, j, x, sourceVel, doubletVel);
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[2];
+    // sigma_j = -e3_j . freestream + rotation . (c_j x e3_j)
+    e3jPoint = (struct Point){input.mesh.surface.e3[j * 3], input.mesh.surface.e3[j * 3 + 1], input.mesh.surface.e3[j * 3 + 2]};
+    cjPoint = (struct Point){input.mesh.surface.facesCenter[j * 3], input.mesh.surface.facesCenter[j * 3 + 1], input.mesh.surface.facesCenter[j * 3 + 2]};
+    cje3jPoint = cross(cjPoint, e3jPoint);
+
+    sourceNormalVel = sourceVel[0] * e3iPoint.x + sourceVel[1] * e3iPoint.y + sourceVel[2] * e3iPoint.z;
+    addComponentPartial(partial, sourceVel, sourceNormalVel, e3jPoint, cje3jPoint);
+
+    /* Image across y = 0: the velocity of the face at the image of the control point, mirrored */
+    if (data.symmetric)
+    {
+        x[1] = -x[1];
+        panelInfluence(input.mesh.surface, j, x, imageSourceVel, imageDoubletVel);
+
+        imageSourceVel[1] = -imageSourceVel[1];
+        imageDoubletVel[1] = -imageDoubletVel[1];
+
+        doubletVel[0] = doubletVel[0] + data.symmetric * imageDoubletVel[0];
+        doubletVel[1] = doubletVel[1] + data.symmetric * imageDoubletVel[1];
+        doubletVel[2] = doubletVel[2] + data.symmetric * imageDoubletVel[2];
+
+        // Image face: e3 mirrored, and c x e3 mirrored with the opposite sign. Its source follows the onset, which has the parity of the images
+        sourceNormalVel = imageSourceVel[0] * e3iPoint.x + imageSourceVel[1] * e3iPoint.y + imageSourceVel[2] * e3iPoint.z;
+        addComponentPartial(partial, imageSourceVel, sourceNormalVel, (struct Point){e3jPoint.x, -e3jPoint.y, e3jPoint.z}, (struct Point){-cje3jPoint.x, cje3jPoint.y, -cje3jPoint.z});
+    }
+
+    /* Matrices */
+    data.a.data[tiledMatrixIndex(&data.a, i, j)] = doubletVel[0] * e3iPoint.x + doubletVel[1] * e3iPoint.y + doubletVel[2] * e3iPoint.z;
+    data.a_vel_x.data[tiledMatrixIndex(&data.a_vel_x, i, j)] = doubletVel[0];
+    data.a_vel_y.data[tiledMatrixIndex(&data.a_vel_y, i, j)] = doubletVel[1];
+    data.a_vel_z.data[tiledMatrixIndex(&data.a_vel_z, i, j)] = doubletVel[2];
+}
+
+void getLinearSystemRow(struct Input input, struct PotentialFlowData data, int i, int nComponents, double *partials)
+/* Right hand side sensitivities of the control point i from the partials of its row */
+{
+    /* Parameters */
+    int c, k;
+    double *partial;
+    double *b_vel[3] = {&data.b_vel_x[3 * i], &data.b_vel_y[3 * i], &data.b_vel_z[3 * i]};
+    double *b_rot_vel[3] = {&data.b_rot_vel_x[3 * i], &data.b_rot_vel_y[3 * i], &data.b_rot_vel_z[3 * i]};
+    struct Point ciPoint, e3iPoint, cie3iPoint;
+
+    /* Sources */
+    for (k = 0; k < 3; k++)
+    {
+        data.b[3 * i + k] = 0.0;
+        data.b_rot[3 * i + k] = 0.0;
+        b_vel[0][k] = 0.0;
+        b_vel[1][k] = 0.0;
+        b_vel[2][k] = 0.0;
+        b_rot_vel[0][k] = 0.0;
+        b_rot_vel[1][k] = 0.0;
+        b_rot_vel[2][k] = 0.0;
+    }
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[2];
-            } else {
+    for (c = 0; c < nComponents; c++)
+    {
+        partial = &partials[c * COMPONENT_PARTIAL_SIZE];
 
-                data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+        for (k = 0; k < 3; k++)
+        {
+            data.b[3 * i + k] = data.b[3 * i + k] + partial[k];
+            data.b_rot[3 * i + k] = data.b_rot[3 * i + k] - partial[3 + k];
+            b_vel[0][k] = b_vel[0][k] - partial[6 + k];
+            b_vel[1][k] = b_vel[1][k] - partial[9 + k];
+            b_vel[2][k] = b_vel[2][k] - partial[12 + k];
+            b_rot_vel[0][k] = b_rot_vel[0][k] + partial[15 + k];
+            b_rot_vel[1][k] = b_rot_vel[1][k] + partial[18 + k];
+            b_rot_vel[2][k] = b_rot_vel[2][k] + partial[21 + k];
+        }
+    }
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[2];
+    /* Onset at the control point */
+    ciPoint = (struct Point){input.mesh.surface.controlPoints[i * 3], input.mesh.surface.controlPoints[i * 3 + 1], input.mesh.surface.controlPoints[i * 3 + 2]};
+    e3iPoint = (struct Point){input.mesh.surface.e3[i * 3], input.mesh.surface.e3[i * 3 + 1], input.mesh.surface.e3[i * 3 + 2]};
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[2];
+    data.b[3 * i] = data.b[3 * i] - e3iPoint.x;
+    data.b[3 * i + 1] = data.b[3 * i + 1] - e3iPoint.y;
+    data.b[3 * i + 2] = data.b[3 * i + 2] - e3iPoint.z;
 
-                data.a[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a[face * input.mesh.surface.nf + wakeFaces[k * 2]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                data.a[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+    data.b_vel_x[3 * i] = data.b_vel_x[3 * i] + 1.0;
+    data.b_vel_y[3 * i + 1] = data.b_vel_y[3 * i + 1] + 1.0;
+    data.b_vel_z[3 * i + 2] = data.b_vel_z[3 * i + 2] + 1.0;
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2]] - lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2]] - lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2]] - lineVel[2];
+    // Rotation, -rotation x point
+    cie3iPoint = cross(ciPoint, e3iPoint);
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[k * 2 + 1]] + lineVel[2];
+    data.b_rot[3 * i] = data.b_rot[3 * i] + cie3iPoint.x;
+    data.b_rot[3 * i + 1] = data.b_rot[3 * i + 1] + cie3iPoint.y;
+    data.b_rot[3 * i + 2] = data.b_rot[3 * i + 2] + cie3iPoint.z;
 
-                indexLine1 = wakeGrid[(k - 1) * nWake] * 3;
-                p1Line.x = wakeVertices[indexLine1];
-                p1Line.y = wakeVertices[indexLine1 + 1];
-                p1Line.z = wakeVertices[indexLine1 + 2];
+    data.b_rot_vel_x[3 * i + 1] = data.b_rot_vel_x[3 * i + 1] - ciPoint.z;
+    data.b_rot_vel_x[3 * i + 2] = data.b_rot_vel_x[3 * i + 2] + ciPoint.y;
 
-                indexLine2 = wakeGrid[k * nWake] * 3;
-                p2Line.x = wakeVertices[indexLine2];
-                p2Line.y = wakeVertices[indexLine2 + 1];
-                p2Line.z = wakeVertices[indexLine2 + 2];
+    data.b_rot_vel_y[3 * i] = data.b_rot_vel_y[3 * i] + ciPoint.z;
+    data.b_rot_vel_y[3 * i + 2] = data.b_rot_vel_y[3 * i + 2] - ciPoint.x;
 
-                lineFunc(p, p1Line, p2Line, lineVel);
+    data.b_rot_vel_z[3 * i] = data.b_rot_vel_z[3 * i] - ciPoint.y;
+    data.b_rot_vel_z[3 * i + 1] = data.b_rot_vel_z[3 * i + 1] + ciPoint.x;
+}
 
-                data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
-                data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - (e3iPoint.x * lineVel[0] + e3iPoint.y * lineVel[1] + e3iPoint.z * lineVel[2]);
+void moveComponentPartial(double *partial, double *transform)
+/* Partial of a pair of faces moved together by x -> R x + t: the vectors turn with R, and c_j x e3_j gains t x e3_j */
+{
+    /* Parameters */
+    double *r = transform;
+    double *t = &transform[9];
+    double moved[COMPONENT_PARTIAL_SIZE];
+    double rq[9];
+    int m, k, l, v;
+
+    /* Vectors */
+    for (v = 0; v < 2; v++)
+    {
+        for (k = 0; k < 3; k++)
+        {
+            moved[3 * v + k] = r[3 * k] * partial[3 * v] + r[3 * k + 1] * partial[3 * v + 1] + r[3 * k + 2] * partial[3 * v + 2];
+        }
+    }
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2]] + lineVel[2];
+    /* Tensors, R Q R^T */
+    for (v = 0; v < 2; v++)
+    {
+        for (m = 0; m < 3; m++)
+        {
+            for (k = 0; k < 3; k++)
+            {
+                rq[3 * m + k] = 0.0;
+                for (l = 0; l < 3; l++) rq[3 * m + k] = rq[3 * m + k] + r[3 * m + l] * partial[6 + 9 * v + 3 * l + k];
+            }
+        }
 
-                data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_x[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[0];
-                data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_y[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[1];
-                data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] = data.a_vel_z[face * input.mesh.surface.nf + wakeFaces[(k - 1) * 2 + 1]] - lineVel[2];
+        for (m = 0; m < 3; m++)
+        {
+            for (k = 0; k < 3; k++)
+            {
+                moved[6 + 9 * v + 3 * m + k] = rq[3 * m] * r[3 * k] + rq[3 * m + 1] * r[3 * k + 1] + rq[3 * m + 2] * r[3 * k + 2];
             }
         }
     }
 
+    /* Translation */
+    for (v = 0; v < 4; v++)
+    {
+        double *q = &moved[(v == 0) ? 0 : 6 + 3 * (v - 1)];
+        double *qc = &moved[(v == 0) ? 3 : 15 + 3 * (v - 1)];
+
+        qc[0] = qc[0] + t[1] * q[2] - t[2] * q[1];
+        qc[1] = qc[1] + t[2] * q[0] - t[0] * q[2];
+        qc[2] = qc[2] + t[0] * q[1] - t[1] * q[0];
+    }
+
+    memcpy(partial, moved, COMPONENT_PARTIAL_SIZE * sizeof(double));
 }
 
 void getLinearSystemImp(struct Input input, struct PotentialFlowData data)
 {
     /* Parameters */
-
-    // Loops
     int i, j;
-
-    // Point
-    struct Point p;
-    struct Point p1Line;
-    struct Point p2Line;
-    struct Point pLocal;
-    struct Point p1Local;
-    p1Local.z = 0.0;
-    struct Point p2Local;
-    p2Local.z = 0.0;
-    struct Point p3Local;
-    p3Local.z = 0.0;
-
-    // Base vectors
+    int nComponents = (data.components.n > 0) ? data.components.n : 1;
+    double *row = (data.components.n > 0) ? NULL : (double *)malloc(COMPONENT_PARTIAL_SIZE * sizeof(double));
+    double *partials;
     struct Point e3iPoint;
 
-    struct Point e1jPoint;
-    struct Point e2jPoint;
-    struct Point e3jPoint;
-
-    // Velocities
-    double *sourceVel = (double *)malloc(3 * sizeof(double));
-    double *doubletVel = (double *)malloc(3 * sizeof(double));
-    double *lineVel = (double *)malloc(3 * sizeof(double));
-
     /* Create */
     for (i = 0; i < input.mesh.surface.nf; i++)
     {
 
-        e3iPoint.x = input.mesh.surface.e3[i * 3];
-        e3iPoint.y = input.mesh.surface.e3[i * 3 + 1];
-        e3iPoint.z = input.mesh.surface.e3[i * 3 + 2];
+        e3iPoint = (struct Point){input.mesh.surface.e3[i * 3], input.mesh.surface.e3[i * 3 + 1], input.mesh.surface.e3[i * 3 + 2]};
 
-        data.rhs[i] = 0.0;
-        data.rhs_vel_x[i] = 0.0;
-        data.rhs_vel_y[i] = 0.0;
-        data.rhs_vel_z[i] = 0.0;
+        partials = (data.components.n > 0) ? &data.components.partials[(size_t)i * nComponents * COMPONENT_PARTIAL_SIZE] : row;
+        memset(partials, 0, nComponents * COMPONENT_PARTIAL_SIZE * sizeof(double));
 
         /* Surface */
         for (j = 0; j < input.mesh.surface.nf; j++) // Effect of j on i
         {
+            influenceEntry(input, data, i, j, e3iPoint, (data.components.n > 0) ? &partials[data.components.faces[j] * COMPONENT_PARTIAL_SIZE] : partials);
+        }
 
-            // Points
-            e1jPoint.x = input.mesh.surface.e1[j * 3];
-            e1jPoint.y = input.mesh.surface.e1[j * 3 + 1];
-            e1jPoint.z = input.mesh.surface.e1[j * 3 + 2];
+        getLinearSystemRow(input, data, i, nComponents, partials);
 
-            e2jPoint.x = input.mesh.surface.e2[j * 3];
-            e2jPoint.y = input.mesh.surface.e2[j * 3 + 1];
-            e2jPoint.z = input.mesh.surface.e2[j * 3 + 2];
+        /* Tile row assembled */
+        if (((i + 1) % TILE_SIZE == 0) || (i == input.mesh.surface.nf - 1))
+        {
+            tiledMatrixRowsDone(&data.a, i / TILE_SIZE);
+            tiledMatrixRowsDone(&data.a_vel_x, i / TILE_SIZE);
+            tiledMatrixRowsDone(&data.a_vel_y, i / TILE_SIZE);
+            tiledMatrixRowsDone(&data.a_vel_z, i / TILE_SIZE);
+        }
 
-            e3jPoint.x = input.mesh.surface.e3[j * 3];
-            e3jPoint.y = input.mesh.surface.e3[j * 3 + 1];
-            e3jPoint.z = input.mesh.surface.e3[j * 3 + 2];
+    }
 
-            p.x = input.mesh.surface.controlPoints[i * 3] - input.mesh.surface.facesCenter[j * 3];
-            p.y = input.mesh.surface.controlPoints[i * 3 + 1] - input.mesh.surface.facesCenter[j * 3 + 1];
-            p.z = input.mesh.surface.controlPoints[i * 3 + 2] - input.mesh.surface.facesCenter[j * 3 + 2];
+    /* Free */
+    free(row);
+}
 
-            pLocal.x = p.x * e1jPoint.x + p.y * e1jPoint.y + p.z * e1jPoint.z;
-            pLocal.y = p.x * e2jPoint.x + p.y * e2jPoint.y + p.z * e2jPoint.z;
-            pLocal.z = p.x * e3jPoint.x + p.y * e3jPoint.y + p.z * e3jPoint.z;
+int symmetricRigidMotion(double *transform)
+/* The motion is its own image across y = 0: it does not couple y to x and z */
+{
+    return (fabs(transform[1]) < ZERO_ERROR) && (fabs(transform[3]) < ZERO_ERROR) && (fabs(transform[5]) < ZERO_ERROR) && (fabs(transform[7]) < ZERO_ERROR) && (fabs(transform[10]) < ZERO_ERROR);
+}
 
-            p1Local.x = input.mesh.surface.p1[j * 2];
-            p1Local.y = input.mesh.surface.p1[j * 2 + 1];
+int sameRigidMotion(double *transform1, double *transform2)
+{
+    int k;
 
-            p2Local.x = input.mesh.surface.p2[j * 2];
-            p2Local.y = input.mesh.surface.p2[j * 2 + 1];
+    for (k = 0; k < 12; k++)
+    {
+        if (fabs(transform1[k] - transform2[k]) > ZERO_ERROR * (1.0 + fabs(transform1[k]))) return 0;
+    }
 
-            p3Local.x = input.mesh.surface.p3[j * 2];
-            p3Local.y = input.mesh.surface.p3[j * 2 + 1];
+    return 1;
+}
 
-            sourceFunc(pLocal, p1Local, p2Local, p3Local, e1jPoint, e2jPoint, e3jPoint, input.mesh.surface.facesAreas[j], input.mesh.surface.facesMaxDistance[j], sourceVel);
-            doubletFunc(pLocal, p1Local, p2Local, p3Local, e1jPoint, e2jPoint, e3jPoint, input.mesh.surface.facesAreas[j], input.mesh.surface.facesMaxDistance[j], doubletVel);
+void getLinearSystemUpdateImp(struct Input input, struct PotentialFlowData data)
+/*
+    The components moved rigidly by their transforms and input is the moved
+    mesh. The blocks between two components that moved together are carried
+    by their common motion: the normal influence is unchanged and the
+    velocities and partials turn with it. Only the blocks between components
+    that moved relative to each other are integrated again, and in a half
+    model also those moved out of the symmetry.
+*/
+{
+    /* Parameters */
+    int i, j, a, c;
+    int n = data.components.n;
+    double identity[12] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0};
+    char *pairs = (char *)malloc((size_t)n * n);       // 0 kept, 1 moved together, 2 integrated again
+    double *partials, *r, vel[3];
+    size_t index;
+    struct Point e3iPoint;
 
-            data.a[i * input.mesh.surface.nf + j] = doubletVel[0] * e3iPoint.x + doubletVel[1] * e3iPoint.y + doubletVel[2] * e3iPoint.z;
-            data.rhs[i] = data.rhs[i] - data.sigma[j] * (sourceVel[0] * e3iPoint.x + sourceVel[1] * e3iPoint.y + sourceVel[2] * e3iPoint.z);
+    /* Pairs */
+    for (a = 0; a < n; a++)
+    {
+        for (c = 0; c < n; c++)
+        {
+            // In a half model the images move with the mirrored motions
+            if (!sameRigidMotion(&data.components.transforms[12 * a], &data.components.transforms[12 * c]) || (data.symmetric && !symmetricRigidMotion(&data.components.transforms[12 * a])))
+            {
+                pairs[a * n + c] = 2;
+            }
+            else
+            {
+                pairs[a * n + c] = sameRigidMotion(&data.components.transforms[12 * a], identity) ? 0 : 1;
+            }
+        }
+    }
 
-            data.a_vel_x[i * input.mesh.surface.nf + j] = doubletVel[0];
-            data.a_vel_y[i * input.mesh.surface.nf + j] = doubletVel[1];
-            data.a_vel_z[i * input.mesh.surface.nf + j] = doubletVel[2];
-            
-            data.rhs_vel_x[i] = data.rhs_vel_x[i] + data.sigma[j] * sourceVel[0];
-            data.rhs_vel_y[i] = data.rhs_vel_y[i] + data.sigma[j] * sourceVel[1];
-            data.rhs_vel_z[i] = data.rhs_vel_z[i] + data.sigma[j] * sourceVel[2];
+    /* Update */
+    for (i = 0; i < input.mesh.surface.nf; i++)
+    {
 
-            data.ia[i * input.mesh.surface.nf + j] = i;
-            data.ja[i * input.mesh.surface.nf + j] = j;
+        a = data.components.faces[i];
+        r = &data.components.transforms[12 * a];
+        e3iPoint = (struct Point){input.mesh.surface.e3[i * 3], input.mesh.surface.e3[i * 3 + 1], input.mesh.surface.e3[i * 3 + 2]};
+        partials = &data.components.partials[(size_t)i * n * COMPONENT_PARTIAL_SIZE];
+
+        for (c = 0; c < n; c++)
+        {
+            if (pairs[a * n + c] == 1) moveComponentPartial(&partials[c * COMPONENT_PARTIAL_SIZE], r);
+            if (pairs[a * n + c] == 2) memset(&partials[c * COMPONENT_PARTIAL_SIZE], 0, COMPONENT_PARTIAL_SIZE * sizeof(double));
         }
 
-        data.rhs[i] = data.rhs[i] - (input.environment.vel_x * e3iPoint.x + input.environment.vel_y * e3iPoint.y + input.environment.vel_z * e3iPoint.z);
+        for (j = 0; j < input.mesh.surface.nf; j++)
+        {
+            c = data.components.faces[j];
+
+            if (pairs[a * n + c] == 1)
+            {
+                index = tiledMatrixIndex(&data.a, i, j);
+                vel[0] = data.a_vel_x.data[index];
+                vel[1] = data.a_vel_y.data[index];
+                vel[2] = data.a_vel_z.data[index];
+
+                data.a_vel_x.data[index] = r[0] * vel[0] + r[1] * vel[1] + r[2] * vel[2];
+                data.a_vel_y.data[index] = r[3] * vel[0] + r[4] * vel[1] + r[5] * vel[2];
+                data.a_vel_z.data[index] = r[6] * vel[0] + r[7] * vel[1] + r[8] * vel[2];
+            }
+            else if (pairs[a * n + c] == 2)
+            {
+                influenceEntry(input, data, i, j, e3iPoint, &partials[c * COMPONENT_PARTIAL_SIZE]);
+            }
+        }
 
-        data.rhs_vel_x[i] = data.rhs_vel_x[i] + input.environment.vel_x;
-        data.rhs_vel_y[i] = data.rhs_vel_y[i] + input.environment.vel_y;
-        data.rhs_vel_z[i] = data.rhs_vel_z[i] + input.environment.vel_z;
+        getLinearSystemRow(input, data, i, n, partials);
 
-        /* Wake */
-        // addWakeCoefficients(input, lineVel, e3iPoint, i, input.mesh.wake.tail.nWake, input.mesh.wake.tail.nSpan, input.mesh.wake.tail.vertices, input.mesh.wake.tail.grid, input.mesh.wake.tail.faces, data);
+        /* Tile row assembled */
+        if (((i + 1) % TILE_SIZE == 0) || (i == input.mesh.surface.nf - 1))
+        {
+            tiledMatrixRowsDone(&data.a, i / TILE_SIZE);
+            tiledMatrixRowsDone(&data.a_vel_x, i / TILE_SIZE);
+            tiledMatrixRowsDone(&data.a_vel_y, i / TILE_SIZE);
+            tiledMatrixRowsDone(&data.a_vel_z, i / TILE_SIZE);
+        }
 
     }
 
     /* Free */
-    free(sourceVel);
-    free(doubletVel);
-    free(lineVel);
+    free(pairs);
+}
+
+void getRightHandSideImp(struct Input input, struct PotentialFlowData data)
+{
+    /* Parameters */
+    int i;
+    double vel_x = input.environment.vel_x;
+    double vel_y = input.environment.vel_y;
+    double vel_z = input.environment.vel_z;
+    double rot[3] = {input.environment.rot_x, input.environment.rot_y, input.environment.rot_z};
+    struct Point c, e3, ce3;
+
+    /* Create */
+    for (i = 0; i < data.n; i++)
+    {
+        c = (struct Point){input.mesh.surface.facesCenter[3 * i], input.mesh.surface.facesCenter[3 * i + 1], input.mesh.surface.facesCenter[3 * i + 2]};
+        e3 = (struct Point){input.mesh.surface.e3[3 * i], input.mesh.surface.e3[3 * i + 1], input.mesh.surface.e3[3 * i + 2]};
+        ce3 = cross(c, e3);
+
+        data.sigma[i] = -(e3.x * vel_x + e3.y * vel_y + e3.z * vel_z) + rot[0] * ce3.x + rot[1] * ce3.y + rot[2] * ce3.z;
+
+        data.rhs[i] = data.b[3 * i] * vel_x + data.b[3 * i + 1] * vel_y + data.b[3 * i + 2] * vel_z;
+        data.rhs_vel_x[i] = data.b_vel_x[3 * i] * vel_x + data.b_vel_x[3 * i + 1] * vel_y + data.b_vel_x[3 * i + 2] * vel_z;
+        data.rhs_vel_y[i] = data.b_vel_y[3 * i] * vel_x + data.b_vel_y[3 * i + 1] * vel_y + data.b_vel_y[3 * i + 2] * vel_z;
+        data.rhs_vel_z[i] = data.b_vel_z[3 * i] * vel_x + data.b_vel_z[3 * i + 1] * vel_y + data.b_vel_z[3 * i + 2] * vel_z;
+
+        // Rotation
+        data.rhs[i] = data.rhs[i] + data.b_rot[3 * i] * rot[0] + data.b_rot[3 * i + 1] * rot[1] + data.b_rot[3 * i + 2] * rot[2];
+        data.rhs_vel_x[i] = data.rhs_vel_x[i] + data.b_rot_vel_x[3 * i] * rot[0] + data.b_rot_vel_x[3 * i + 1] * rot[1] + data.b_rot_vel_x[3 * i + 2] * rot[2];
+        data.rhs_vel_y[i] = data.rhs_vel_y[i] + data.b_rot_vel_y[3 * i] * rot[0] + data.b_rot_vel_y[3 * i + 1] * rot[1] + data.b_rot_vel_y[3 * i + 2] * rot[2];
+        data.rhs_vel_z[i] = data.rhs_vel_z[i] + data.b_rot_vel_z[3 * i] * rot[0] + data.b_rot_vel_z[3 * i + 1] * rot[1] + data.b_rot_vel_z[3 * i + 2] * rot[2];
+    }
 }
\ No newline at end of file
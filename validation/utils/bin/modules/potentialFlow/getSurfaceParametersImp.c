@@ -1,26 +1,51 @@
 #include "../helpers/structs.h"
 #include "data.h"
 
+void onsetVelocity(struct Environment environment, double *c, double *onset, double *u)
+/* Onset at the point c, minus the velocity of the surface: freestream, rotation and the other onset (NULL for none), not the induced velocities */
+{
+    u[0] = environment.vel_x - (environment.rot_y * c[2] - environment.rot_z * c[1]) + ((onset != NULL) ? onset[0] : 0.0);
+    u[1] = environment.vel_y - (environment.rot_z * c[0] - environment.rot_x * c[2]) + ((onset != NULL) ? onset[1] : 0.0);
+    u[2] = environment.vel_z - (environment.rot_x * c[1] - environment.rot_y * c[0]) + ((onset != NULL) ? onset[2] : 0.0);
+}
+
+double getPressureCoefficientImp(struct Environment environment, double *controlPoint, double *onset, double velX, double velY, double velZ, double rate)
+/* Unsteady Bernoulli in the body frame: onset at the control point, surface velocity and time derivative of the perturbation potential */
+{
+    double u[3];
+
+    onsetVelocity(environment, controlPoint, onset, u);
+
+    return (u[0] * u[0] + u[1] * u[1] + u[2] * u[2] - velX * velX - velY * velY - velZ * velZ - 2 * rate) / pow(environment.velNorm, 2);
+}
+
+double potentialRate(struct PotentialFlowData data, int i)
+/* Time derivative of the perturbation potential following the surface: -doublet for the system, plus the singularities outside it */
+{
+    return -data.doubletRate[i] + data.inducedRate[i];
+}
+
 void getSurfaceParametersImp(struct Input input, struct PotentialFlowData data)
 {
     
-    int i, j;
+    int i;
+
+    tiledMatrixMatvec(&data.a_vel_x, data.doublet, data.vel_x);
+    tiledMatrixMatvec(&data.a_vel_y, data.doublet, data.vel_y);
+    tiledMatrixMatvec(&data.a_vel_z, data.doublet, data.vel_z);
+
+    addWakeCouplingProduct(&data.wake, data.n, data.wake.w_vel_x, data.doublet, data.vel_x);
+    addWakeCouplingProduct(&data.wake, data.n, data.wake.w_vel_y, data.doublet, data.vel_y);
+    addWakeCouplingProduct(&data.wake, data.n, data.wake.w_vel_z, data.doublet, data.vel_z);
 
     for (i = 0; i < input.mesh.surface.nf; i++)
     {
 
-        data.vel_x[i] = data.rhs_vel_x[i];
-        data.vel_y[i] = data.rhs_vel_y[i];
-        data.vel_z[i] = data.rhs_vel_z[i];
-
-        for (j = 0; j < input.mesh.surface.nf; j++)
-        {
-            data.vel_x[i] = data.vel_x[i] + data.a_vel_x[i * input.mesh.surface.nf + j] * data.doublet[j];
-            data.vel_y[i] = data.vel_y[i] + data.a_vel_y[i * input.mesh.surface.nf + j] * data.doublet[j];
-            data.vel_z[i] = data.vel_z[i] + data.a_vel_z[i * input.mesh.surface.nf + j] * data.doublet[j];
-        }
+        data.vel_x[i] = data.rhs_vel_x[i] + data.vel_x[i];
+        data.vel_y[i] = data.rhs_vel_y[i] + data.vel_y[i];
+        data.vel_z[i] = data.rhs_vel_z[i] + data.vel_z[i];
 
-        data.cp[i] = 1 - (pow(data.vel_x[i], 2) + pow(data.vel_y[i], 2) + pow(data.vel_z[i], 2)) / pow(input.environment.velNorm, 2);
+        data.cp[i] = getPressureCoefficientImp(input.environment, &input.mesh.surface.controlPoints[3 * i], &data.onset[3 * i], data.vel_x[i], data.vel_y[i], data.vel_z[i], potentialRate(data, i));
         
         data.transpiration[i] = data.vel_x[i] * input.mesh.surface.e3[3 * i] + data.vel_y[i] * input.mesh.surface.e3[3 * i + 1] + data.vel_z[i] * input.mesh.surface.e3[3 * i + 2];
     
@@ -0,0 +1,314 @@
+#include "../helpers/structs.h"
+#include "../helpers/customMath.h"
+#include "data.h"
+#include <math.h>
+#include <string.h>
+
+/*
+    Wake part copied line by line, so the segments of each wake line are
+    contiguous in x, y and z. Strip s, between the lines s and s + 1, is a
+    vortex ring of strength doublet[faces[2 * s]] - doublet[faces[2 * s + 1]]:
+    trailing edge segment, line s + 1 downstream and line s upstream. Each
+    line continues to infinity along its last segment (ends), so the rings
+    are closed far downstream whatever the length of the wake grid. Closed
+    lines (time marching) stop at the end of the grid instead, where the
+    ring is closed by a segment from the end of line s + 1 to the end of
+    line s: the wake grid is then the row shed in the last step, the older
+    rows being outside the system. The faces of each strip are ordered so
+    that the first one faces the side the ring normal points to, whatever
+    the order given in the mesh.
+*/
+struct WakeLines
+{
+    int nSpan;
+    int nWake;
+    int closed;
+    double *x;
+    double *y;
+    double *z;
+    double *ends;       // unit direction of the semi-infinite end of each line, none if nWake < 2
+    int *faces;         // 2 faces per strip
+};
+
+struct WakeLines getWakeLinesData(struct SurfaceMesh surface, struct WakeMeshPart part, int closed)
+{
+
+    /* Parameters */
+    int i, k, a, b;
+    struct Point t, d, n;
+    struct WakeLines lines;
+
+    /* Initialize */
+    lines.nSpan = part.nSpan;
+    lines.nWake = part.nWake;
+    lines.closed = closed;
+    lines.x = (double *)malloc(3 * (size_t)part.nSpan * part.nWake * sizeof(double));
+    lines.y = lines.x + (size_t)part.nSpan * part.nWake;
+    lines.z = lines.y + (size_t)part.nSpan * part.nWake;
+    lines.ends = (double *)malloc(3 * (size_t)part.nSpan * sizeof(double));
+    lines.faces = (int *)malloc(2 * (size_t)part.nSpan * sizeof(int));
+
+    for (i = 0; i < part.nSpan * part.nWake; i++) {
+        k = 3 * part.grid[i];
+        lines.x[i] = part.vertices[k];
+        lines.y[i] = part.vertices[k + 1];
+        lines.z[i] = part.vertices[k + 2];
+    }
+
+    /* Semi-infinite ends, along the last segment */
+    for (i = 0; (i < part.nSpan) && (part.nWake > 1); i++) {
+        b = (i + 1) * part.nWake - 1;
+        d = (struct Point){lines.x[b] - lines.x[b - 1], lines.y[b] - lines.y[b - 1], lines.z[b] - lines.z[b - 1]};
+        lines.ends[3 * i] = d.x / norm(d);
+        lines.ends[3 * i + 1] = d.y / norm(d);
+        lines.ends[3 * i + 2] = d.z / norm(d);
+    }
+
+    /* Ring normal: trailing edge segment x first wake segment */
+    for (i = 0; i < part.nSpan - 1; i++) {
+
+        a = i * part.nWake;
+        b = (i + 1) * part.nWake;
+
+        t = (struct Point){lines.x[b] - lines.x[a], lines.y[b] - lines.y[a], lines.z[b] - lines.z[a]};
+        d = (part.nWake > 1) ? (struct Point){lines.x[a + 1] + lines.x[b + 1] - lines.x[a] - lines.x[b], lines.y[a + 1] + lines.y[b + 1] - lines.y[a] - lines.y[b], lines.z[a + 1] + lines.z[b + 1] - lines.z[a] - lines.z[b]} : (struct Point){0.0, 0.0, 0.0};
+        n = cross(t, d);
+
+        a = part.faces[2 * i];
+        b = part.faces[2 * i + 1];
+
+        if (n.x * (surface.e3[3 * a] - surface.e3[3 * b]) + n.y * (surface.e3[3 * a + 1] - surface.e3[3 * b + 1]) + n.z * (surface.e3[3 * a + 2] - surface.e3[3 * b + 2]) < 0) {
+            k = a; a = b; b = k;
+        }
+
+        lines.faces[2 * i] = a;
+        lines.faces[2 * i + 1] = b;
+    }
+
+    return lines;
+}
+
+void freeWakeLinesData(struct WakeLines lines)
+{
+    free(lines.x);
+    free(lines.ends);
+    free(lines.faces);
+}
+
+void polylineVelocity(double px, double py, double pz, double *x, double *y, double *z, int n, double *vel)
+/* Velocity induced by the n - 1 segments of a polyline with unit circulation (lineFunc of each segment, summed) */
+{
+
+    int l;
+    double u = 0.0, v = 0.0, w = 0.0;
+
+    #pragma omp simd reduction(+:u, v, w)
+    for (l = 0; l < n - 1; l++) {
+
+        double r1x = x[l] - px, r1y = y[l] - py, r1z = z[l] - pz;
+        double r2x = x[l + 1] - px, r2y = y[l + 1] - py, r2z = z[l + 1] - pz;
+
+        double cx = r1y * r2z - r1z * r2y;
+        double cy = r1z * r2x - r1x * r2z;
+        double cz = r1x * r2y - r1y * r2x;
+
+        double r1Norm = sqrt(r1x * r1x + r1y * r1y + r1z * r1z);
+        double r2Norm = sqrt(r2x * r2x + r2y * r2y + r2z * r2z);
+
+        double d = ((r1x - r2x) * (r1x / r1Norm - r2x / r2Norm) + (r1y - r2y) * (r1y / r1Norm - r2y / r2Norm) + (r1z - r2z) * (r1z / r1Norm - r2z / r2Norm)) / (cx * cx + cy * cy + cz * cz);
+
+        u += cx * d;
+        v += cy * d;
+        w += cz * d;
+    }
+
+    vel[0] = FACTOR * u;
+    vel[1] = FACTOR * v;
+    vel[2] = FACTOR * w;
+}
+
+void semiInfiniteLineVelocity(double px, double py, double pz, double x, double y, double z, double *d, double *vel)
+/*
+    Adds the velocity induced by a vortex line with unit circulation from
+    (x, y, z) to infinity along the unit vector d: the limit of lineFunc
+    for a segment of infinite length, (r x d) (1 - d . r / |r|) / |r x d|^2
+    with r from the point to the start of the line.
+*/
+{
+    double rx = x - px, ry = y - py, rz = z - pz;
+
+    double cx = ry * d[2] - rz * d[1];
+    double cy = rz * d[0] - rx * d[2];
+    double cz = rx * d[1] - ry * d[0];
+
+    double f = FACTOR * (1 - (d[0] * rx + d[1] * ry + d[2] * rz) / sqrt(rx * rx + ry * ry + rz * rz)) / (cx * cx + cy * cy + cz * cz);
+
+    vel[0] += f * cx;
+    vel[1] += f * cy;
+    vel[2] += f * cz;
+}
+
+void getWakeLinesCoupling(struct Input input, struct WakeLines lines, int face, int column, double *lineVel, struct WakeCoupling wake, int image)
+/* Row face of the strips of one wake part, starting at column. lineVel holds 3 * nSpan doubles. image (1 or -1) adds the strips mirrored across y = 0 with that sign */
+{
+
+    /* Parameters */
+    int k, s;
+    double p[3], e3[3], teVel[3], endVel[3], vel[3];
+    size_t index;
+
+    if (lines.nSpan < 2) return;
+
+    /* Initialize */
+    for (k = 0; k < 3; k++) {
+        p[k] = input.mesh.surface.controlPoints[3 * face + k];
+        e3[k] = input.mesh.surface.e3[3 * face + k];
+    }
+
+    // The image strips act at the control point as the strips at its image, mirrored
+    if (image) p[1] = -p[1];
+
+    /* Each wake line once, with its semi-infinite end */
+    for (k = 0; k < lines.nSpan; k++) {
+        polylineVelocity(p[0], p[1], p[2], &lines.x[k * lines.nWake], &lines.y[k * lines.nWake], &lines.z[k * lines.nWake], lines.nWake, &lineVel[3 * k]);
+        if ((lines.nWake > 1) && !lines.closed) semiInfiniteLineVelocity(p[0], p[1], p[2], lines.x[(k + 1) * lines.nWake - 1], lines.y[(k + 1) * lines.nWake - 1], lines.z[(k + 1) * lines.nWake - 1], &lines.ends[3 * k], &lineVel[3 * k]);
+    }
+
+    /* Strips, with their trailing edge segment and closing segment */
+    for (s = 0; s < lines.nSpan - 1; s++) {
+
+        double x[2] = {lines.x[s * lines.nWake], lines.x[(s + 1) * lines.nWake]};
+        double y[2] = {lines.y[s * lines.nWake], lines.y[(s + 1) * lines.nWake]};
+        double z[2] = {lines.z[s * lines.nWake], lines.z[(s + 1) * lines.nWake]};
+
+        double xEnd[2] = {lines.x[(s + 2) * lines.nWake - 1], lines.x[(s + 1) * lines.nWake - 1]};
+        double yEnd[2] = {lines.y[(s + 2) * lines.nWake - 1], lines.y[(s + 1) * lines.nWake - 1]};
+        double zEnd[2] = {lines.z[(s + 2) * lines.nWake - 1], lines.z[(s + 1) * lines.nWake - 1]};
+
+        polylineVelocity(p[0], p[1], p[2], x, y, z, 2, teVel);
+
+        if (lines.closed) {
+            polylineVelocity(p[0], p[1], p[2], xEnd, yEnd, zEnd, 2, endVel);
+        } else {
+            endVel[0] = 0.0; endVel[1] = 0.0; endVel[2] = 0.0;
+        }
+
+        for (k = 0; k < 3; k++) vel[k] = lineVel[3 * (s + 1) + k] - lineVel[3 * s + k] + teVel[k] + endVel[k];
+
+        index = (size_t)face * wake.nStrips + column + s;
+
+        if (image) {
+            wake.w_vel_x[index] += image * vel[0];
+            wake.w_vel_y[index] -= image * vel[1];
+            wake.w_vel_z[index] += image * vel[2];
+        } else {
+            wake.w_vel_x[index] = vel[0];
+            wake.w_vel_y[index] = vel[1];
+            wake.w_vel_z[index] = vel[2];
+        }
+
+        wake.w[index] = e3[0] * wake.w_vel_x[index] + e3[1] * wake.w_vel_y[index] + e3[2] * wake.w_vel_z[index];
+    }
+}
+
+void getWakeCouplingImp(struct Input input, struct PotentialFlowData *data)
+/* W and K of the three wake parts, one row per thread at a time. Reallocated only if the number of strips changed */
+{
+
+    /* Parameters */
+    int k, nSpan, nStrips;
+    int columns[3];
+    struct WakeMeshPart parts[3] = {input.mesh.wake.left, input.mesh.wake.right, input.mesh.wake.tail};
+    struct WakeLines lines[3];
+
+    /* Initialize */
+    nSpan = 0;
+    nStrips = 0;
+
+    for (k = 0; k < 3; k++) {
+        columns[k] = nStrips;
+        nStrips = nStrips + ((parts[k].nSpan > 1) ? parts[k].nSpan - 1 : 0);
+        nSpan = (parts[k].nSpan > nSpan) ? parts[k].nSpan : nSpan;
+    }
+
+    if (nStrips != data->wake.nStrips) {
+        freeWakeCouplingData(data->wake);
+        data->wake = getWakeCouplingData(data->n, nStrips);
+    }
+
+    if (nStrips == 0) return;
+
+    /* K */
+    for (k = 0; k < 3; k++) {
+        lines[k] = getWakeLinesData(input.mesh.surface, parts[k], data->closedWake);
+        if (parts[k].nSpan > 1) memcpy(&data->wake.faces[2 * columns[k]], lines[k].faces, 2 * (size_t)(parts[k].nSpan - 1) * sizeof(int));
+    }
+
+    /* W */
+    #pragma omp parallel
+    {
+
+        int face, j;
+        double *lineVel = (double *)malloc(3 * (size_t)nSpan * sizeof(double));
+
+        #pragma omp for schedule(static)
+        for (face = 0; face < data->n; face++) {
+            for (j = 0; j < 3; j++) getWakeLinesCoupling(input, lines[j], face, columns[j], lineVel, data->wake, 0);
+            for (j = 0; (j < 3) && data->symmetric; j++) getWakeLinesCoupling(input, lines[j], face, columns[j], lineVel, data->wake, data->symmetric);
+        }
+
+        free(lineVel);
+    }
+
+    /* Free */
+    for (k = 0; k < 3; k++) freeWakeLinesData(lines[k]);
+}
+
+void addWakeCouplingProduct(struct WakeCoupling *wake, int n, double *w, double *x, double *y)
+/* y = y + W (K x), W being wake->w or one of wake->w_vel_* */
+{
+
+    /* Parameters */
+    int i, s;
+    double *kx;
+
+    if (wake->nStrips == 0) return;
+
+    /* K x */
+    kx = (double *)malloc(wake->nStrips * sizeof(double));
+
+    for (s = 0; s < wake->nStrips; s++) kx[s] = x[wake->faces[2 * s]] - x[wake->faces[2 * s + 1]];
+
+    /* W (K x) */
+    #pragma omp parallel for schedule(static) private(s)
+    for (i = 0; i < n; i++) {
+
+        double sum = 0.0;
+        double *row = &w[(size_t)i * wake->nStrips];
+
+        for (s = 0; s < wake->nStrips; s++) sum += row[s] * kx[s];
+
+        y[i] += sum;
+    }
+
+    free(kx);
+}
+
+void potentialFlowMatvec(void *context, double *x, double *y)
+/* y = (A_body + W K) x, context being the PotentialFlowData */
+{
+    struct PotentialFlowData *data = (struct PotentialFlowData *)context;
+
+    tiledMatrixMatvec(&data->a, x, y);
+    addWakeCouplingProduct(&data->wake, data->n, data->wake.w, x, y);
+}
+
+int getWakeStrengthsImp(struct PotentialFlowData data, double *gamma)
+/* Circulation of the wake strips, K doublet, in the order of W. Returns the number of strips */
+{
+    int s;
+
+    for (s = 0; s < data.wake.nStrips; s++) gamma[s] = data.doublet[data.wake.faces[2 * s]] - data.doublet[data.wake.faces[2 * s + 1]];
+
+    return data.wake.nStrips;
+}
@@ -1,19 +1,62 @@
 #include "potentialFlow.h"
+#include "getWakeCouplingImp.c"
 #include "getLinearSystemImp.c"
 #include "getDoubletDistributionImp.c"
 #include "getSurfaceParametersImp.c"
+#include "getInducedVelocityImp.c"
 
 void getLinearSystem(struct Input input, struct PotentialFlowData data)
 {
     getLinearSystemImp(input, data);
 }
 
-void getDoubleDistribution(struct PotentialFlowData data)
+void getLinearSystemUpdate(struct Input input, struct PotentialFlowData data)
 {
-    getDoubleDistributionImp(data);
+    getLinearSystemUpdateImp(input, data);
+}
+
+void getWakeCoupling(struct Input input, struct PotentialFlowData *data)
+{
+    getWakeCouplingImp(input, data);
+}
+
+void getRightHandSide(struct Input input, struct PotentialFlowData data)
+{
+    getRightHandSideImp(input, data);
+    getOnsetRightHandSideImp(input, data);
+}
+
+void getDoubleDistribution(struct PotentialFlowData data, struct Arena *arena)
+{
+    getDoubleDistributionImp(data, arena);
 }
 
 void getSurfaceParameters(struct Input input, struct PotentialFlowData data)
 {
     getSurfaceParametersImp(input, data);
+}
+
+double getPressureCoefficient(struct Environment environment, double *controlPoint, double *onset, double velX, double velY, double velZ, double rate)
+{
+    return getPressureCoefficientImp(environment, controlPoint, onset, velX, velY, velZ, rate);
+}
+
+void getInducedVelocity(struct Input input, struct PotentialFlowData data, int n, double *points, double core, double *vel)
+{
+    getInducedVelocityImp(input, data, n, points, core, vel);
+}
+
+void getSurfaceVelocity(struct SurfaceMesh surface, double *sigma, double *doublet, int n, double *points, double theta, double *vel)
+{
+    getSurfaceVelocityImp(surface, sigma, doublet, n, points, theta, vel);
+}
+
+void getVortexLatticeVelocity(int nSpan, int nRows, double *lattice, double *gamma, int n, double *points, double core, double *vel, double *potential)
+{
+    getVortexLatticeVelocityImp(nSpan, nRows, lattice, gamma, n, points, core, vel, potential);
+}
+
+int getWakeStrengths(struct PotentialFlowData data, double *gamma)
+{
+    return getWakeStrengthsImp(data, gamma);
 }
\ No newline at end of file
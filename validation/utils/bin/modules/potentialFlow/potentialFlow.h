@@ -2,11 +2,20 @@
 #define POTENTIAL_FLOW_H
 
 #include "../helpers/structs.h"
+#include "../helpers/arena.h"
 #include "data.h"
 
 void getLinearSystem(struct Input input, struct PotentialFlowData data);
-void getDoubleDistribution(struct PotentialFlowData data);
+void getLinearSystemUpdate(struct Input input, struct PotentialFlowData data);
+void getWakeCoupling(struct Input input, struct PotentialFlowData *data);
+void getRightHandSide(struct Input input, struct PotentialFlowData data);
+void getDoubleDistribution(struct PotentialFlowData data, struct Arena *arena);
 void getSurfaceParameters(struct Input input, struct PotentialFlowData data);
+double getPressureCoefficient(struct Environment environment, double *controlPoint, double *onset, double velX, double velY, double velZ, double rate);
+void getInducedVelocity(struct Input input, struct PotentialFlowData data, int n, double *points, double core, double *vel);
+void getSurfaceVelocity(struct SurfaceMesh surface, double *sigma, double *doublet, int n, double *points, double theta, double *vel);
+void getVortexLatticeVelocity(int nSpan, int nRows, double *lattice, double *gamma, int n, double *points, double core, double *vel, double *potential);
+int getWakeStrengths(struct PotentialFlowData data, double *gamma);
 
 #include "potentialFlow.c"
 
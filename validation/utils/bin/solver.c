@@ -1,39 +1,908 @@
+#include <string.h>
 #include "./modules/helpers/warnings.h"
 #include "./modules/helpers/structs.h"
+#include "./modules/helpers/arena.h"
+#include "./modules/helpers/meshTopology.h"
+#include "./modules/helpers/meshFile.h"
+#include "./modules/helpers/panelFrames.h"
+#include "./modules/helpers/wakeGrid.h"
 #include "./modules/helpers/verticesConnection.h"
+#include "./modules/helpers/meshSymmetry.h"
 #include "./modules/potentialFlow/potentialFlow.h"
 #include "./modules/potentialFlow/data.h"
+#include "./modules/potentialFlow/cache.h"
 #include "./modules/posproc/posproc.h"
+#include "./modules/posproc/vtkFile.h"
 
-void solve(struct Input input, double *vel_x_v, double *vel_y_v, double *vel_z_v, double *transpiration_v, double *sigma_v, double *doublet_v, double *forces)
-{   
+/*
+ * Solver context
+ *
+ * Owns everything that depends only on the surface mesh: panel frames,
+ * topology, vertices interpolation weights and influence matrices. The
+ * frames are derived from the vertices and faces unless the input brings
+ * its own (surface.e1 != NULL).
+ *
+ * A freestream sweep only rebuilds the right hand side and restarts GMRES
+ * from the previous doublet distribution. Scratch memory comes from the
+ * context arena, reset at the start of every solve. Contexts share no
+ * state, so several can live in the same process.
+ *
+ * Scratch directory: the influence matrices live in memory mapped files
+ * there, for cases larger than the RAM.
+ *
+ * Cache directory: the assembled matrices are stored there, keyed by a
+ * hash of the mesh, and mapped back by any later context on the same mesh.
+ *
+ * Wake: it only enters the low rank wake coupling, so a new wake
+ * (updateSolverContextWake) rebuilds that and keeps the body matrices.
+ *
+ * Components: faces split in rigid components (setSolverContextComponents),
+ * which share no vertices, can be moved (moveSolverContextComponents). The
+ * next solve only integrates again the blocks between components that
+ * moved relative to each other.
+ *
+ * Time marching (setSolverContextTimeStep): the wake is the row shed in
+ * the last step, closed at its end. cp has the time derivative of the
+ * potential from the previous solve. The older rows enter through the
+ * induced velocities.
+ *
+ * Half model (setSolverContextSymmetry): the images across y = 0 are
+ * folded into the influences and the unknowns are the ones of the half.
+ */
+struct SolverContext
+{
+    int nv, nf;
+    int assembled;                                      // influence matrices match the current mesh
+    int wakeAssembled;                                  // wake coupling matches the current wake
+    int cached;                                         // influence matrices are mapped from the cache
+    double timeStep;                                    // 0 in steady solves
+    struct PotentialFlowData potentialFlowData;
+    struct PanelFrames frames;
+    struct MeshTopology topology;
+    struct VerticesConnection verticesConnection;
+    struct Arena arena;
+    double *outputs;                                    // library owned vertices values [6 x nv] and forces [3]
+    char *scratchDirectory;                             // NULL keeps the influence matrices in memory
+    char *cacheDirectory;                               // NULL disables the cache
+};
+
+int checkSolverInputWake(struct WakeMeshPart part, int nf, const char *name)
+{
+    int i;
+
+    if ((part.nSpan < 0) || (part.nWake < 0))
+    {
+        printf("    > Invalid mesh: negative %s wake size\n", name);
+        return 0;
+    }
+
+    for (i = 0; i < part.nSpan * part.nWake; i++)
+    {
+        if (part.grid[i] < 0)
+        {
+            printf("    > Invalid mesh: %s wake grid references vertex %d\n", name, part.grid[i]);
+            return 0;
+        }
+    }
+
+    for (i = 0; i < 2 * (part.nSpan - 1); i++)
+    {
+        if ((part.faces[i] < 0) || (part.faces[i] >= nf))
+        {
+            printf("    > Invalid mesh: %s wake references face %d\n", name, part.faces[i]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int checkSolverInput(struct Input input)
+/* Returns 0 if an index of the mesh is out of range. The array shapes are checked by the caller */
+{
 
     /* Parameters */
-    struct PotentialFlowData potentialFlowData = getPotentialFlowData(input.mesh.surface.nf, input.mesh.surface.e3, input.environment.vel_x, input.environment.vel_y, input.environment.vel_z);
-    struct VerticesConnection *verticesConnetion = getVerticesConnectionData(input.mesh.surface.nv);
+    struct SurfaceMesh surface = input.mesh.surface;
+    int i;
+
+    /* Surface */
+    if ((surface.nv <= 0) || (surface.nf <= 0) || (surface.vertices == NULL) || (surface.faces == NULL))
+    {
+        printf("    > Invalid mesh: no vertices or faces\n");
+        return 0;
+    }
+
+    for (i = 0; i < 3 * surface.nf; i++)
+    {
+        if ((surface.faces[i] < 0) || (surface.faces[i] >= surface.nv))
+        {
+            printf("    > Invalid mesh: face %d references vertex %d\n", i / 3, surface.faces[i]);
+            return 0;
+        }
+    }
+
+    /* Wake */
+    return checkSolverInputWake(input.mesh.wake.left, surface.nf, "left") &&
+           checkSolverInputWake(input.mesh.wake.right, surface.nf, "right") &&
+           checkSolverInputWake(input.mesh.wake.tail, surface.nf, "tail");
+}
+
+int checkSolverInputHalfModel(struct Input input)
+/* A half model lies on the y >= 0 side, wake included, up to a rounding tolerance */
+{
+    struct WakeMeshPart parts[3] = {input.mesh.wake.left, input.mesh.wake.right, input.mesh.wake.tail};
+    const char *names[3] = {"left", "right", "tail"};
+    double tolerance = getMeshSymmetryTolerance(input.mesh.surface);
+    int i, p;
+
+    for (i = 0; i < input.mesh.surface.nv; i++)
+    {
+        if (input.mesh.surface.vertices[3 * i + 1] < -tolerance)
+        {
+            printf("    > Invalid half model: vertex %d is at y = %.6e < 0\n", i, input.mesh.surface.vertices[3 * i + 1]);
+            return 0;
+        }
+    }
+
+    for (p = 0; p < 3; p++)
+    {
+        for (i = 0; i < parts[p].nSpan; i++)
+        {
+            if (!wakeLineSide(parts[p], i, tolerance))
+            {
+                printf("    > Invalid half model: line %d of the %s wake goes to the y < 0 side\n", i, names[p]);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+struct Environment getMirrorEnvironment(struct Environment environment, int sign)
+/* Symmetric (sign 1) or antisymmetric (sign -1) part about y = 0 of the freestream and rotation; the reference velocity is kept */
+{
+    if (sign > 0)
+    {
+        environment.vel_y = 0.0;
+        environment.rot_x = 0.0;
+        environment.rot_z = 0.0;
+    }
+    else
+    {
+        environment.vel_x = 0.0;
+        environment.vel_z = 0.0;
+        environment.rot_y = 0.0;
+    }
+
+    return environment;
+}
+
+struct Input getSolverContextInput(struct SolverContext *context, struct Input input)
+/* Input with the panel frames of the context where the caller gave none, and in a half model only the onset of the parity of its images */
+{
+    if (input.mesh.surface.e1 == NULL) setSurfaceMeshFrames(&input.mesh.surface, context->frames);
+
+    if (context->potentialFlowData.symmetric) input.environment = getMirrorEnvironment(input.environment, context->potentialFlowData.symmetric);
+
+    return input;
+}
+
+void buildSolverContextMesh(struct SolverContext *context, struct Input input)
+/* The panel frames are allocated when the context first derives them, or when the number of faces changed */
+{
+    if (input.mesh.surface.e1 == NULL)
+    {
+        if (context->frames.nf != input.mesh.surface.nf)
+        {
+            freePanelFramesData(context->frames);
+            context->frames = getPanelFramesData(input.mesh.surface.nf);
+        }
+
+        getPanelFrames(input.mesh.surface.nf, input.mesh.surface.vertices, input.mesh.surface.faces, CONTROL_POINT_OFFSET, context->frames);
+    }
+
+    context->topology = getMeshTopology(input.mesh.surface.nv, input.mesh.surface.nf, input.mesh.surface.faces);
+    getVerticesConnection(input, &context->topology, &context->verticesConnection);
+}
+
+void destroySolverContext(struct SolverContext *context)
+{
+    if (context == NULL) return;
+
+    freePotentialFlowData(context->potentialFlowData);
+    freePanelFramesData(context->frames);
+    freeVerticesConnectionData(context->verticesConnection);
+    freeMeshTopology(context->topology);
+    freeArena(&context->arena);
+    free(context->outputs);
+    free(context->scratchDirectory);
+    free(context->cacheDirectory);
+    free(context);
+}
+
+struct SolverContext *createSolverContext(struct Input input, const char *scratchDirectory, const char *cacheDirectory)
+/* Returns NULL if the influence matrices do not fit */
+{
+    struct SolverContext *context = (struct SolverContext*)malloc(sizeof(struct SolverContext));
+
+    context->nv = input.mesh.surface.nv;
+    context->nf = input.mesh.surface.nf;
+    context->scratchDirectory = (scratchDirectory != NULL) ? strdup(scratchDirectory) : NULL;
+    context->cacheDirectory = (cacheDirectory != NULL) ? strdup(cacheDirectory) : NULL;
+    context->cached = 0;
+    context->timeStep = 0.0;
+    context->potentialFlowData = getPotentialFlowData(context->nf, context->scratchDirectory);
+    context->frames = getPanelFramesData(0);
+    context->verticesConnection = getVerticesConnectionData(context->nv, context->nf);
+    context->arena = getArena(0);
+    context->outputs = (double*)malloc((6 * (size_t)context->nv + 3) * sizeof(double));
+
+    buildSolverContextMesh(context, input);
+    context->assembled = 0;
+    context->wakeAssembled = 0;
+
+    if (!checkPotentialFlowData(context->potentialFlowData) || (context->outputs == NULL))
+    {
+        destroySolverContext(context);
+        return NULL;
+    }
+
+    return context;
+}
+
+int updateSolverContext(struct SolverContext *context, struct Input input)
+/*
+ * The surface mesh changed: buffers are reallocated only if its size did,
+ * or if the matrices are mapped from the cache, which must not be written.
+ * A half model stays one. Returns 0 if the new influence matrices do not
+ * fit or the mesh is no longer a half model.
+ */
+{
+    int resizeFaces = input.mesh.surface.nf != context->nf;
+    int resizeVertices = resizeFaces || (input.mesh.surface.nv != context->nv);
+    int symmetric = context->potentialFlowData.symmetric;
+
+    if (symmetric && !checkSolverInputHalfModel(input)) return 0;
+
+    freeMeshTopology(context->topology);
+
+    if (resizeFaces || context->cached)
+    {
+        freePotentialFlowData(context->potentialFlowData);
+        context->potentialFlowData = getPotentialFlowData(input.mesh.surface.nf, context->scratchDirectory);
+        context->potentialFlowData.symmetric = symmetric;
+        context->cached = 0;
+    }
+
+    if (resizeVertices)
+    {
+        freeVerticesConnectionData(context->verticesConnection);
+        context->verticesConnection = getVerticesConnectionData(input.mesh.surface.nv, input.mesh.surface.nf);
+        free(context->outputs);
+        context->outputs = (double*)malloc((6 * (size_t)input.mesh.surface.nv + 3) * sizeof(double));
+    }
+
+    context->nv = input.mesh.surface.nv;
+    context->nf = input.mesh.surface.nf;
+
+    buildSolverContextMesh(context, input);
+    context->assembled = 0;
+    context->wakeAssembled = 0;
+
+    return checkPotentialFlowData(context->potentialFlowData) && (context->outputs != NULL);
+}
+
+int setSolverContextComponents(struct SolverContext *context, struct Input input, int nComponents, int *components)
+/*
+ * Splits the faces in rigid components, components[i] (0 to nComponents -
+ * 1) being the one of the face i, for moveSolverContextComponents. The
+ * next solve assembles in full, without the cache, which does not keep
+ * the blocks of the components. nComponents = 0 goes back to a single
+ * body. The components must not share vertices: a face across two of
+ * them would deform without being integrated again. Returns 0 if a
+ * component is out of range or shares a vertex.
+ */
+{
+    struct PotentialFlowData *data = &context->potentialFlowData;
+    int i, k, *verticesComponents;
+
+    for (i = 0; (nComponents > 0) && (i < context->nf); i++)
+    {
+        if ((components[i] < 0) || (components[i] >= nComponents))
+        {
+            printf("    > Invalid components: face %d is in component %d\n", i, components[i]);
+            return 0;
+        }
+    }
+
+    if (nComponents > 1)
+    {
+        verticesComponents = (int*)malloc(context->nv * sizeof(int));
+        if (verticesComponents == NULL) return 0;
+
+        for (i = 0; i < context->nv; i++) verticesComponents[i] = -1;
+
+        for (i = 0; i < context->nf; i++)
+        {
+            for (k = 0; k < 3; k++)
+            {
+                int v = input.mesh.surface.faces[3 * i + k];
+
+                if ((verticesComponents[v] >= 0) && (verticesComponents[v] != components[i]))
+                {
+                    printf("    > Invalid components: vertex %d is shared by components %d and %d\n", v, verticesComponents[v], components[i]);
+                    free(verticesComponents);
+                    return 0;
+                }
+
+                verticesComponents[v] = components[i];
+            }
+        }
+
+        free(verticesComponents);
+    }
+
+    // The matrices mapped from the cache are not assembled again in place
+    if (context->cached)
+    {
+        int symmetric = data->symmetric;
+
+        freePotentialFlowData(*data);
+        *data = getPotentialFlowData(context->nf, context->scratchDirectory);
+        data->symmetric = symmetric;
+        context->cached = 0;
+        context->wakeAssembled = 0;
+    }
+
+    freeComponentBlocksData(data->components);
+    data->components = getComponentBlocksData(context->nf, (nComponents > 0) ? nComponents : 0);
+    if (nComponents > 0) memcpy(data->components.faces, components, context->nf * sizeof(int));
+
+    context->assembled = 0;
+
+    return checkPotentialFlowData(*data);
+}
+
+int setSolverContextSymmetry(struct SolverContext *context, struct Input input, int symmetric)
+/*
+ * symmetric = 1 takes the mesh as the y >= 0 half of a model symmetric
+ * about the y = 0 plane: every influence adds the one of the image of its
+ * panel or wake line, so the system keeps the size of the half. The
+ * freestream and rotation are reduced to their symmetric part, the forces
+ * are the ones of the full model and the vtk file is unfolded. The
+ * vertices values stay on the half. symmetric = -1 solves the
+ * antisymmetric flow instead (sideslip, roll and yaw rates), the images
+ * having the opposite sign. Returns 0 if the mesh is not a half model.
+ */
+{
+    struct PotentialFlowData *data = &context->potentialFlowData;
+
+    symmetric = (symmetric > 0) - (symmetric < 0);
+
+    if (symmetric && !checkSolverInputHalfModel(input)) return 0;
+
+    if (symmetric == data->symmetric) return 1;
+
+    // The matrices mapped from the cache are not assembled again in place
+    if (context->cached)
+    {
+        freePotentialFlowData(*data);
+        *data = getPotentialFlowData(context->nf, context->scratchDirectory);
+        context->cached = 0;
+    }
+
+    data->symmetric = symmetric;
+    context->assembled = 0;
+    context->wakeAssembled = 0;
+
+    return checkPotentialFlowData(*data);
+}
+
+int moveSolverContextComponents(struct SolverContext *context, struct Input input, double *transforms)
+/*
+ * The components moved rigidly: input is the moved mesh, with the same
+ * faces, and transforms [nComponents x 12] the rotation (row major) and
+ * translation of each component, x -> R x + t, from the mesh of the last
+ * update or move. The motions are composed until the next solve, which
+ * updates the influence blocks (getLinearSystemUpdate) and rebuilds the
+ * wake coupling. Without components it is an update. Returns 0 as
+ * updateSolverContext does.
+ */
+{
+    struct ComponentBlocks *components = &context->potentialFlowData.components;
+    double composed[12];
+    int c, m, k;
+
+    if ((components->n == 0) || (input.mesh.surface.nf != context->nf) || (input.mesh.surface.nv != context->nv)) return updateSolverContext(context, input);
+
+    freeMeshTopology(context->topology);
+    buildSolverContextMesh(context, input);
+    context->wakeAssembled = 0;
+
+    // Motions since the last assembly: the new one after the pending one
+    for (c = 0; c < components->n; c++)
+    {
+        double *pending = &components->transforms[12 * c];
+        double *r = &transforms[12 * c];
+
+        for (m = 0; m < 3; m++)
+        {
+            for (k = 0; k < 3; k++) composed[3 * m + k] = r[3 * m] * pending[k] + r[3 * m + 1] * pending[3 + k] + r[3 * m + 2] * pending[6 + k];
+
+            composed[9 + m] = r[3 * m] * pending[9] + r[3 * m + 1] * pending[10] + r[3 * m + 2] * pending[11] + r[9 + m];
+        }
+
+        memcpy(pending, composed, 12 * sizeof(double));
+    }
+
+    components->moved = 1;
+
+    return 1;
+}
+
+int updateSolverContextWake(struct SolverContext *context, struct Input input)
+/* Only the wake changed: the body matrices are kept. Returns 0 if the new wake is invalid */
+{
+    if (!checkSolverInput(input)) return 0;
+    if (context->potentialFlowData.symmetric && !checkSolverInputHalfModel(input)) return 0;
+
+    context->wakeAssembled = 0;
+
+    return 1;
+}
+
+void setSolverContextTimeStep(struct SolverContext *context, double timeStep)
+/* timeStep > 0 marches in time from the previous solve, 0 goes back to steady solves */
+{
+    if ((timeStep > 0) != (context->timeStep > 0)) context->wakeAssembled = 0;
+
+    context->timeStep = (timeStep > 0) ? timeStep : 0.0;
+}
+
+double *getSolverContextOnset(struct SolverContext *context, int field)
+/*
+ * Library owned values at the control points for the next solves, zero
+ * until written and valid until the next update or destroy. Field 0 is
+ * the onset of the surface itself [nf x 3] (minus its deformation
+ * velocity), added to the one of the freestream and body rotation; 1 the
+ * velocity [nf x 3] induced by singularities outside the system (older
+ * wake rows) and 2 the time derivative of their potential [nf], following
+ * the surface, for cp.
+ */
+{
+    if (field == 0) return context->potentialFlowData.onset;
+    if (field == 1) return context->potentialFlowData.induced;
+
+    return context->potentialFlowData.inducedRate;
+}
+
+int getSolverContextWakeStrengths(struct SolverContext *context, double *gamma)
+/* Circulation of the wake strips of the last solve, left, right and tail parts. Returns the number of strips, 0 before the first solve */
+{
+    if (!context->assembled || !context->wakeAssembled) return 0;
+
+    return getWakeStrengths(context->potentialFlowData, gamma);
+}
+
+double *getSolverContextWakeCoupling(struct SolverContext *context, int field)
+/*
+ * Library owned wake coupling of the last solve, valid until the next
+ * update or new wake: field 0 is W [nf x nStrips], the normal velocity at
+ * the control points of each strip with unit circulation, and 1 to 3 its
+ * velocity components. NULL before the first solve.
+ */
+{
+    double *w[4] = {context->potentialFlowData.wake.w, context->potentialFlowData.wake.w_vel_x, context->potentialFlowData.wake.w_vel_y, context->potentialFlowData.wake.w_vel_z};
+
+    if (!context->assembled || !context->wakeAssembled) return NULL;
+
+    return w[field];
+}
+
+double *getSolverContextOutput(struct SolverContext *context, int field)
+/*
+ * Library owned output buffers, valid until the next update or destroy:
+ * field 0 to 5 are the vertices values in the order of solveSolverContext
+ * (vel_x, vel_y, vel_z, transpiration, sigma, doublet) and 6 the forces.
+ */
+{
+    return context->outputs + (size_t)field * context->nv;
+}
+
+void solveSolverContext(struct SolverContext *context, struct Input input, double *vel_x_v, double *vel_y_v, double *vel_z_v, double *transpiration_v, double *sigma_v, double *doublet_v, double *forces)
+{
+
+    /* Parameters */
+    struct PotentialFlowData potentialFlowData;
+    uint64_t hash;
+    const char *cacheDirectory;
+    double *previousDoublet = NULL;
+    int i;
+
+    /* Initialize */
+    if (!checkPotentialFlowData(context->potentialFlowData)) return;
+
+    // The images only carry the flow of their parity about y = 0
+    if (context->potentialFlowData.symmetric > 0 && ((fabs(input.environment.vel_y) > ZERO_ERROR) || (fabs(input.environment.rot_x) > ZERO_ERROR) || (fabs(input.environment.rot_z) > ZERO_ERROR)))
+    {
+        printf("    > Half model: the sideslip and the roll and yaw rates are dropped\n");
+    }
+    if (context->potentialFlowData.symmetric < 0 && ((fabs(input.environment.vel_x) > ZERO_ERROR) || (fabs(input.environment.vel_z) > ZERO_ERROR) || (fabs(input.environment.rot_y) > ZERO_ERROR)))
+    {
+        printf("    > Antisymmetric half model: the axial and normal freestream and the pitch rate are dropped\n");
+    }
+
+    input = getSolverContextInput(context, input);
+
+    arenaReset(&context->arena);
 
     /* Potential flow */
     warnings(1);
     warnings(2);
-    getLinearSystem(input, potentialFlowData);
+    if (!context->assembled)
+    {
+        cacheDirectory = (context->potentialFlowData.components.n == 0) ? context->cacheDirectory : NULL;
+        hash = (cacheDirectory != NULL) ? hashBytes(getMeshHash(input), &context->potentialFlowData.symmetric, sizeof(int)) : 0;
+        context->cached = loadPotentialFlowCache(cacheDirectory, hash, &context->potentialFlowData);
+
+        if (!context->cached)
+        {
+            getLinearSystem(input, context->potentialFlowData);
+            savePotentialFlowCache(cacheDirectory, hash, &context->potentialFlowData);
+        }
+
+        context->assembled = 1;
+    }
+    else if (context->potentialFlowData.components.moved)
+    {
+        getLinearSystemUpdate(input, context->potentialFlowData);
+    }
+    if (context->potentialFlowData.components.moved)
+    {
+        resetComponentBlocksMotion(&context->potentialFlowData.components);
+    }
+    if (!context->wakeAssembled)
+    {
+        context->potentialFlowData.closedWake = context->timeStep > 0;
+        getWakeCoupling(input, &context->potentialFlowData);
+        context->wakeAssembled = 1;
+    }
+    potentialFlowData = context->potentialFlowData;
+    getRightHandSide(input, potentialFlowData);
+    if (context->timeStep > 0)
+    {
+        previousDoublet = (double *)arenaAlloc(&context->arena, potentialFlowData.n * sizeof(double));
+        memcpy(previousDoublet, potentialFlowData.doublet, potentialFlowData.n * sizeof(double));
+    }
     warnings(3);
-    getDoubleDistribution(potentialFlowData);
+    getDoubleDistribution(potentialFlowData, &context->arena);
     warnings(4);
+    for (i = 0; i < potentialFlowData.n; i++)
+    {
+        potentialFlowData.doubletRate[i] = (previousDoublet != NULL) ? (potentialFlowData.doublet[i] - previousDoublet[i]) / context->timeStep : 0.0;
+    }
     getSurfaceParameters(input, potentialFlowData);
     getForces(input, potentialFlowData.cp, forces);
+    if (potentialFlowData.symmetric)
+    {
+        forces[0] = 2 * forces[0];
+        forces[1] = 0.0;
+        forces[2] = 2 * forces[2];
+    }
 
     /* Vertices values */
     warnings(5);
-    getVerticesConnection(input, verticesConnetion);
-    
-    getVerticesValues(input, verticesConnetion, potentialFlowData.vel_x, vel_x_v);
-    getVerticesValues(input, verticesConnetion, potentialFlowData.vel_y, vel_y_v);
-    getVerticesValues(input, verticesConnetion, potentialFlowData.vel_z, vel_z_v);
-    getVerticesValues(input, verticesConnetion, potentialFlowData.sigma, sigma_v);
-    getVerticesValues(input, verticesConnetion, potentialFlowData.doublet, doublet_v);
-    getVerticesValues(input, verticesConnetion, potentialFlowData.transpiration, transpiration_v);
+    double *facesFields[6] = {potentialFlowData.vel_x, potentialFlowData.vel_y, potentialFlowData.vel_z, potentialFlowData.sigma, potentialFlowData.doublet, potentialFlowData.transpiration};
+    double *verticesFields[6] = {vel_x_v, vel_y_v, vel_z_v, sigma_v, doublet_v, transpiration_v};
+
+    getVerticesValuesBlock(input, &context->verticesConnection, 6, facesFields, verticesFields);
+
+    printf("    * Scratch memory peak: %.2f MB\n", context->arena.peak / 1048576.0);
+
+}
+
+struct WakeMeshPart getImageWakeMeshPart(struct WakeMeshPart part, int merged, struct Arena *arena)
+/* Image of a wake part across y = 0; merged keeps the part and appends its image lines */
+{
+    struct WakeMeshPart image = part;
+    int n = getWakeMeshPartPoints(part);
+    int offset = merged ? n : 0;
+    int size = part.nSpan * part.nWake;
+    int i;
+
+    if (part.nSpan == 0) return part;
+
+    image.nSpan = (merged ? 2 : 1) * part.nSpan;
+    image.grid = (int *)arenaAlloc(arena, (size_t)image.nSpan * part.nWake * sizeof(int));
+    image.vertices = (double *)arenaAlloc(arena, 3 * (size_t)(offset + n) * sizeof(double));
+    image.faces = NULL;
+
+    memcpy(image.vertices, part.vertices, 3 * (size_t)offset * sizeof(double));
+    memcpy(image.grid, part.grid, (size_t)(merged ? size : 0) * sizeof(int));
+
+    for (i = 0; i < n; i++)
+    {
+        image.vertices[3 * (offset + i)] = part.vertices[3 * i];
+        image.vertices[3 * (offset + i) + 1] = -part.vertices[3 * i + 1];
+        image.vertices[3 * (offset + i) + 2] = part.vertices[3 * i + 2];
+    }
+
+    for (i = 0; i < size; i++) image.grid[(merged ? size : 0) + i] = offset + part.grid[i];
+
+    return image;
+}
+
+struct Mesh getUnfoldedMesh(struct Mesh mesh, struct Arena *arena)
+/*
+ * Full model of a half one: the image faces follow the half ones, with
+ * their vertices after the half ones and in the reverse order so their
+ * normals point out. Without a right wake the image of the left one is
+ * the right one, otherwise each wake part gets the image lines of its own.
+ */
+{
+    struct Mesh full = mesh;
+    int nv = mesh.surface.nv, nf = mesh.surface.nf;
+    int i;
+
+    full.surface.nv = 2 * nv;
+    full.surface.nf = 2 * nf;
+    full.surface.vertices = (double *)arenaAlloc(arena, 6 * (size_t)nv * sizeof(double));
+    full.surface.faces = (int *)arenaAlloc(arena, 6 * (size_t)nf * sizeof(int));
+
+    memcpy(full.surface.vertices, mesh.surface.vertices, 3 * (size_t)nv * sizeof(double));
+    memcpy(full.surface.faces, mesh.surface.faces, 3 * (size_t)nf * sizeof(int));
+
+    for (i = 0; i < nv; i++)
+    {
+        full.surface.vertices[3 * (nv + i)] = mesh.surface.vertices[3 * i];
+        full.surface.vertices[3 * (nv + i) + 1] = -mesh.surface.vertices[3 * i + 1];
+        full.surface.vertices[3 * (nv + i) + 2] = mesh.surface.vertices[3 * i + 2];
+    }
+
+    for (i = 0; i < nf; i++)
+    {
+        full.surface.faces[3 * (nf + i)] = nv + mesh.surface.faces[3 * i];
+        full.surface.faces[3 * (nf + i) + 1] = nv + mesh.surface.faces[3 * i + 2];
+        full.surface.faces[3 * (nf + i) + 2] = nv + mesh.surface.faces[3 * i + 1];
+    }
+
+    if (mesh.wake.right.nSpan == 0)
+    {
+        full.wake.right = getImageWakeMeshPart(mesh.wake.left, 0, arena);
+    }
+    else
+    {
+        full.wake.left = getImageWakeMeshPart(mesh.wake.left, 1, arena);
+        full.wake.right = getImageWakeMeshPart(mesh.wake.right, 1, arena);
+    }
+    full.wake.tail = getImageWakeMeshPart(mesh.wake.tail, 1, arena);
+
+    return full;
+}
+
+int writeSolverContextVtk(struct SolverContext *context, struct Input input, const char *file, int wake, int compressed)
+/*
+ * Writes the mesh with the faces and vertices values of the last solve,
+ * unfolded to the full model in a half one. Returns 0 if the file could
+ * not be written.
+ */
+{
+
+    /* Parameters */
+    struct PotentialFlowData data = context->potentialFlowData;
+    double *verticesFields[6];
+    double *facesFields[6] = {data.vel_x, data.vel_y, data.vel_z, data.sigma, data.doublet, data.transpiration};
+    double *cp_v;
+    double velNorm2 = input.environment.velNorm * input.environment.velNorm;
+    size_t mark = arenaMark(&context->arena);
+    int i, k, ok;
+
+    input = getSolverContextInput(context, input);
+
+    /* Vertices values */
+    for (k = 0; k < 6; k++) verticesFields[k] = (double *)arenaAlloc(&context->arena, context->nv * sizeof(double));
+    cp_v = (double *)arenaAlloc(&context->arena, context->nv * sizeof(double));
+
+    getVerticesValuesBlock(input, &context->verticesConnection, 6, facesFields, verticesFields);
+
+    for (i = 0; i < context->nv; i++) cp_v[i] = 1 - (verticesFields[0][i] * verticesFields[0][i] + verticesFields[1][i] * verticesFields[1][i] + verticesFields[2][i] * verticesFields[2][i]) / velNorm2;
+
+    /* Fields */
+    struct VtkField fields[10] = {
+        {"Cp", 1, 0, {cp_v, NULL, NULL}},
+        {"Velocity", 3, 0, {verticesFields[0], verticesFields[1], verticesFields[2]}},
+        {"Transpiration", 1, 0, {verticesFields[5], NULL, NULL}},
+        {"Sigma", 1, 0, {verticesFields[3], NULL, NULL}},
+        {"Doublet", 1, 0, {verticesFields[4], NULL, NULL}},
+        {"Cp", 1, 1, {data.cp, NULL, NULL}},
+        {"Velocity", 3, 1, {data.vel_x, data.vel_y, data.vel_z}},
+        {"Transpiration", 1, 1, {data.transpiration, NULL, NULL}},
+        {"Sigma", 1, 1, {data.sigma, NULL, NULL}},
+        {"Doublet", 1, 1, {data.doublet, NULL, NULL}},
+    };
+
+    // Half model: the image values follow the half ones with the sign of the images, cp being even and vel_y reversed
+    if (data.symmetric)
+    {
+        for (k = 0; k < 10; k++)
+        {
+            int n = fields[k].cells ? context->nf : context->nv;
+
+            for (i = 0; i < fields[k].components; i++)
+            {
+                double *values = (double *)arenaAlloc(&context->arena, 2 * (size_t)n * sizeof(double));
+                double sign = (k % 5 == 0) ? 1.0 : (((fields[k].components == 3) && (i == 1)) ? -data.symmetric : data.symmetric);
+                int j;
+
+                for (j = 0; j < n; j++)
+                {
+                    values[j] = fields[k].data[i][j];
+                    values[n + j] = sign * fields[k].data[i][j];
+                }
+
+                fields[k].data[i] = values;
+            }
+        }
+
+        input.mesh = getUnfoldedMesh(input.mesh, &context->arena);
+    }
+
+    ok = writeVtkFile(file, input.mesh, wake, compressed, 10, fields);
+
+    /* Free */
+    arenaRelease(&context->arena, mark);
+
+    return ok;
+}
+
+int getSolverContextVelocities(struct SolverContext *context, struct Input input, int n, double *points, double core, double *vel)
+/*
+ * Velocity at n points [n x 3] of the last solve, for example on the wake
+ * to relax it. core is the vortex core radius of the wake lines. Returns 0
+ * if the context has not been solved since its last update.
+ */
+{
+    if (!context->assembled || !context->wakeAssembled) return 0;
+
+    input = getSolverContextInput(context, input);
+
+    getInducedVelocity(input, context->potentialFlowData, n, points, core, vel);
+
+    return 1;
+}
+
+int solveMirrorSymmetric(struct Input input, struct MeshSymmetry *symmetry, double *vel_x_v, double *vel_y_v, double *vel_z_v, double *transpiration_v, double *sigma_v, double *doublet_v, double *forces)
+/*
+ * Mirror symmetric mesh: the flow is the sum of a symmetric and an
+ * antisymmetric one, each solved on the half with the images of its sign
+ * and its part of the onset. The faces values are unfolded and summed on
+ * the full mesh before cp, which is quadratic in the velocity. The
+ * antisymmetric half is skipped without sideslip, roll or yaw rate.
+ * Returns 0 if the faces values or the influence matrices of a half do
+ * not fit.
+ */
+{
+
+    /* Parameters */
+    struct Input half = input;
+    struct SolverContext *context;
+    struct PotentialFlowData data;
+    struct PanelFrames frames;
+    struct MeshTopology topology;
+    struct VerticesConnection verticesConnection;
+    int nf = input.mesh.surface.nf, nh = symmetry->mesh.surface.nf;
+    double *facesValues, *facesFields[6], *halfFields[6], *cp;
+    double halfForces[3], parity;
+    int sign, i, k;
+
+    /* Initialize */
+    facesValues = (double *)calloc(7 * (size_t)nf, sizeof(double));
+    if (facesValues == NULL) return 0;
+
+    for (k = 0; k < 6; k++) facesFields[k] = facesValues + (size_t)k * nf;
+    cp = facesValues + 6 * (size_t)nf;
+
+    half.mesh = symmetry->mesh;
+
+    printf("    * Mirror symmetric mesh: symmetric and antisymmetric halves of %d faces\n", nh);
+
+    /* Halves */
+    for (sign = 1; sign >= -1; sign = sign - 2)
+    {
+        if ((sign < 0) && (fabs(input.environment.vel_y) <= ZERO_ERROR) && (fabs(input.environment.rot_x) <= ZERO_ERROR) && (fabs(input.environment.rot_z) <= ZERO_ERROR)) continue;
+
+        half.environment = getMirrorEnvironment(input.environment, sign);
+
+        context = createSolverContext(half, NULL, NULL);
+
+        if ((context == NULL) || !setSolverContextSymmetry(context, half, sign))
+        {
+            destroySolverContext(context);
+            free(facesValues);
+            return 0;
+        }
+
+        solveSolverContext(context, half, NULL, NULL, NULL, NULL, NULL, NULL, halfForces);
+
+        data = context->potentialFlowData;
+        halfFields[0] = data.vel_x;
+        halfFields[1] = data.vel_y;
+        halfFields[2] = data.vel_z;
+        halfFields[3] = data.sigma;
+        halfFields[4] = data.doublet;
+        halfFields[5] = data.transpiration;
+
+        // The image faces take the values with the sign of the images, vel_y reversed
+        for (k = 0; k < 6; k++)
+        {
+            parity = (k == 1) ? -sign : sign;
+
+            for (i = 0; i < nh; i++)
+            {
+                facesFields[k][symmetry->faces[i]] += halfFields[k][i];
+                facesFields[k][symmetry->imageFaces[i]] += parity * halfFields[k][i];
+            }
+        }
+
+        destroySolverContext(context);
+    }
+
+    /* Full mesh */
+    frames = getPanelFramesData((input.mesh.surface.e1 == NULL) ? nf : 0);
+
+    if (input.mesh.surface.e1 == NULL)
+    {
+        getPanelFrames(nf, input.mesh.surface.vertices, input.mesh.surface.faces, CONTROL_POINT_OFFSET, frames);
+        setSurfaceMeshFrames(&input.mesh.surface, frames);
+    }
+
+    // A single solve has no other onset and no time derivative of the potential
+    for (i = 0; i < nf; i++) cp[i] = getPressureCoefficient(input.environment, &input.mesh.surface.controlPoints[3 * i], NULL, facesFields[0][i], facesFields[1][i], facesFields[2][i], 0.0);
+
+    getForces(input, cp, forces);
+
+    /* Vertices values */
+    double *verticesFields[6] = {vel_x_v, vel_y_v, vel_z_v, sigma_v, doublet_v, transpiration_v};
+
+    topology = getMeshTopology(input.mesh.surface.nv, nf, input.mesh.surface.faces);
+    verticesConnection = getVerticesConnectionData(input.mesh.surface.nv, nf);
+    getVerticesConnection(input, &topology, &verticesConnection);
+    getVerticesValuesBlock(input, &verticesConnection, 6, facesFields, verticesFields);
 
     /* Free */
-    // freePotentialFlowData(potentialFlowData);
+    freeVerticesConnectionData(verticesConnection);
+    freeMeshTopology(topology);
+    freePanelFramesData(frames);
+    free(facesValues);
+
+    return 1;
+}
+
+int solve(struct Input input, double *vel_x_v, double *vel_y_v, double *vel_z_v, double *transpiration_v, double *sigma_v, double *doublet_v, double *forces)
+/*
+ * Single solve. A mesh mirror symmetric about y = 0, wake included, is
+ * solved as a symmetric and an antisymmetric half (solveMirrorSymmetric).
+ * Returns 0 if the influence matrices do not fit.
+ */
+{
+    struct SolverContext *context;
+    struct MeshSymmetry symmetry;
+    int ok;
+
+    if (checkSolverInput(input) && getMeshSymmetry(input.mesh, &symmetry))
+    {
+        ok = solveMirrorSymmetric(input, &symmetry, vel_x_v, vel_y_v, vel_z_v, transpiration_v, sigma_v, doublet_v, forces);
+        freeMeshSymmetry(symmetry);
+        return ok;
+    }
+
+    context = createSolverContext(input, NULL, NULL);
+
+    if (context == NULL) return 0;
+
+    solveSolverContext(context, input, vel_x_v, vel_y_v, vel_z_v, transpiration_v, sigma_v, doublet_v, forces);
+    destroySolverContext(context);
 
-}
\ No newline at end of file
+    return 1;
+}
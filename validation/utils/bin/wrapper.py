@@ -1,8 +1,21 @@
 from math import sqrt
+import os
 import numpy as np
 import ctypes
 
 ND_POINTER_DOUBLE = np.ctypeslib.ndpointer(dtype=np.double, ndim=1, flags="C")
+ND_POINTER_INT = np.ctypeslib.ndpointer(dtype=np.int32, ndim=1, flags="C")
+
+class ND_POINTER_DOUBLE_OR_NULL(ND_POINTER_DOUBLE):
+    """Array argument that also accepts None, passed as NULL"""
+
+    @classmethod
+    def from_param(cls, obj):
+        if obj is None:
+            return None
+        return super().from_param(obj)
+
+VERTICES_FIELDS = ['vel_x', 'vel_y', 'vel_z', 'transpiration', 'sigma', 'doublet']
 
 #---------------------------------------------#
 #                    Input                    #
@@ -56,6 +69,50 @@ class ENVIRONMENT(ctypes.Structure):
         ("density", ctypes.c_double),
         ("viscosity", ctypes.c_double),
         ("soundSpeed", ctypes.c_double),
+        ("rot_x", ctypes.c_double),
+        ("rot_y", ctypes.c_double),
+        ("rot_z", ctypes.c_double),
+    ]
+
+class VTK_FIELD(ctypes.Structure):
+    _fields_ = [
+        ("name", ctypes.c_char_p),
+        ("components", ctypes.c_int),
+        ("cells", ctypes.c_int),
+        ("data", ctypes.POINTER(ctypes.c_double) * 3),
+    ]
+
+class PANEL_FRAMES(ctypes.Structure):
+    _fields_ = [
+        ("nf", ctypes.c_int),
+        ("facesAreas", ctypes.POINTER(ctypes.c_double)),
+        ("facesMaxDistance", ctypes.POINTER(ctypes.c_double)),
+        ("facesCenter", ctypes.POINTER(ctypes.c_double)),
+        ("controlPoints", ctypes.POINTER(ctypes.c_double)),
+        ("p1", ctypes.POINTER(ctypes.c_double)),
+        ("p2", ctypes.POINTER(ctypes.c_double)),
+        ("p3", ctypes.POINTER(ctypes.c_double)),
+        ("e1", ctypes.POINTER(ctypes.c_double)),
+        ("e2", ctypes.POINTER(ctypes.c_double)),
+        ("e3", ctypes.POINTER(ctypes.c_double)),
+    ]
+
+class WAKE_GRID_PARAMETERS(ctypes.Structure):
+    _fields_ = [
+        ("direction", ctypes.c_double * 3),
+        ("ds", ctypes.c_double),
+        ("nWake", ctypes.c_int),
+        ("length", ctypes.c_double),
+        ("accommodation", ctypes.c_double),
+    ]
+
+class TILED_MATRIX(ctypes.Structure):
+    _fields_ = [
+        ("n", ctypes.c_int),
+        ("nTiles", ctypes.c_int),
+        ("bytes", ctypes.c_size_t),
+        ("data", ctypes.POINTER(ctypes.c_double)),
+        ("fd", ctypes.c_int),
     ]
 
 class INPUT(ctypes.Structure):
@@ -65,6 +122,908 @@ class INPUT(ctypes.Structure):
         ("environment", ENVIRONMENT),
     ]
 
+#---------------------------------------------#
+#                   LIBRARY                   #
+#---------------------------------------------#
+OUTPUT_ARGTYPES = [
+    ND_POINTER_DOUBLE_OR_NULL,
+    ND_POINTER_DOUBLE_OR_NULL,
+    ND_POINTER_DOUBLE_OR_NULL,
+    ND_POINTER_DOUBLE_OR_NULL,
+    ND_POINTER_DOUBLE_OR_NULL,
+    ND_POINTER_DOUBLE_OR_NULL,
+    ND_POINTER_DOUBLE,
+]
+
+def load_lib():
+
+    lib = ctypes.CDLL('./utils/bin/libsolver.so')
+
+    lib.solve.argtypes = [INPUT] + OUTPUT_ARGTYPES
+    lib.solve.restype = ctypes.c_int
+
+    lib.createSolverContext.argtypes = [INPUT, ctypes.c_char_p, ctypes.c_char_p]
+    lib.createSolverContext.restype = ctypes.c_void_p
+
+    lib.updateSolverContext.argtypes = [ctypes.c_void_p, INPUT]
+    lib.updateSolverContext.restype = ctypes.c_int
+
+    lib.updateSolverContextWake.argtypes = [ctypes.c_void_p, INPUT]
+    lib.updateSolverContextWake.restype = ctypes.c_int
+
+    lib.setSolverContextComponents.argtypes = [ctypes.c_void_p, INPUT, ctypes.c_int, ND_POINTER_INT]
+    lib.setSolverContextComponents.restype = ctypes.c_int
+
+    lib.setSolverContextSymmetry.argtypes = [ctypes.c_void_p, INPUT, ctypes.c_int]
+    lib.setSolverContextSymmetry.restype = ctypes.c_int
+
+    lib.moveSolverContextComponents.argtypes = [ctypes.c_void_p, INPUT, ND_POINTER_DOUBLE]
+    lib.moveSolverContextComponents.restype = ctypes.c_int
+
+    lib.solveSolverContext.argtypes = [ctypes.c_void_p, INPUT] + OUTPUT_ARGTYPES
+    lib.solveSolverContext.restype = None
+
+    lib.getSolverContextVelocities.argtypes = [ctypes.c_void_p, INPUT, ctypes.c_int, ND_POINTER_DOUBLE, ctypes.c_double, ND_POINTER_DOUBLE]
+    lib.getSolverContextVelocities.restype = ctypes.c_int
+
+    lib.setSolverContextTimeStep.argtypes = [ctypes.c_void_p, ctypes.c_double]
+    lib.setSolverContextTimeStep.restype = None
+
+    lib.getSolverContextOnset.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.getSolverContextOnset.restype = ctypes.POINTER(ctypes.c_double)
+
+    lib.getSolverContextWakeStrengths.argtypes = [ctypes.c_void_p, ND_POINTER_DOUBLE]
+    lib.getSolverContextWakeStrengths.restype = ctypes.c_int
+
+    lib.getSurfaceVelocity.argtypes = [SURFACE_MESH, ND_POINTER_DOUBLE, ND_POINTER_DOUBLE, ctypes.c_int, ND_POINTER_DOUBLE, ctypes.c_double, ND_POINTER_DOUBLE]
+    lib.getSurfaceVelocity.restype = None
+
+    lib.getVortexLatticeVelocity.argtypes = [ctypes.c_int, ctypes.c_int, ND_POINTER_DOUBLE, ND_POINTER_DOUBLE, ctypes.c_int, ND_POINTER_DOUBLE, ctypes.c_double, ND_POINTER_DOUBLE, ND_POINTER_DOUBLE_OR_NULL]
+    lib.getVortexLatticeVelocity.restype = None
+
+    lib.destroySolverContext.argtypes = [ctypes.c_void_p]
+    lib.destroySolverContext.restype = None
+
+    lib.checkSolverInput.argtypes = [INPUT]
+    lib.checkSolverInput.restype = ctypes.c_int
+
+    lib.getSolverContextWakeCoupling.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.getSolverContextWakeCoupling.restype = ctypes.POINTER(ctypes.c_double)
+
+    lib.getSolverContextOutput.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.getSolverContextOutput.restype = ctypes.POINTER(ctypes.c_double)
+
+    lib.writeSolverContextVtk.argtypes = [ctypes.c_void_p, INPUT, ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+    lib.writeSolverContextVtk.restype = ctypes.c_int
+
+    lib.writeVtkFile.argtypes = [ctypes.c_char_p, MESH, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.POINTER(VTK_FIELD)]
+    lib.writeVtkFile.restype = ctypes.c_int
+
+    lib.getTiledMatrix.argtypes = [ctypes.c_int, ctypes.c_char_p]
+    lib.getTiledMatrix.restype = TILED_MATRIX
+
+    lib.tiledMatrixIndex.argtypes = [ctypes.POINTER(TILED_MATRIX), ctypes.c_int, ctypes.c_int]
+    lib.tiledMatrixIndex.restype = ctypes.c_size_t
+
+    lib.tiledMatrixMatvec.argtypes = [ctypes.POINTER(TILED_MATRIX), ND_POINTER_DOUBLE, ND_POINTER_DOUBLE]
+    lib.tiledMatrixMatvec.restype = None
+
+    lib.freeTiledMatrix.argtypes = [ctypes.POINTER(TILED_MATRIX)]
+    lib.freeTiledMatrix.restype = None
+
+    lib.getPanelFrames.argtypes = [ctypes.c_int, ND_POINTER_DOUBLE, ND_POINTER_INT, ctypes.c_double, PANEL_FRAMES]
+    lib.getPanelFrames.restype = None
+
+    lib.getWakeMeshParts.argtypes = [ctypes.c_int, ctypes.c_int, ND_POINTER_DOUBLE, ND_POINTER_INT, ctypes.c_int, ND_POINTER_DOUBLE, ND_POINTER_DOUBLE, WAKE_GRID_PARAMETERS, ctypes.POINTER(WAKE_MESH_PART)]
+    lib.getWakeMeshParts.restype = ctypes.c_int
+
+    lib.freeWakeMeshPart.argtypes = [WAKE_MESH_PART]
+    lib.freeWakeMeshPart.restype = None
+
+    return lib
+
+#---------------------------------------------#
+#                    INPUT                    #
+#---------------------------------------------#
+def _bind(arrays: list, x: np.ndarray, dtype, shape: tuple, name: str):
+    """
+    Pointer to the data of x, checked against shape (None for a free size).
+    Arrays that are already C contiguous with the native dtype are passed
+    without a copy, the others are converted once. The bound array is kept
+    in arrays, which must outlive the pointer.
+    """
+
+    if x is None:
+        return None
+
+    x = np.asarray(x)
+
+    if x.ndim != len(shape) or any(n is not None and n != m for n, m in zip(shape, x.shape)):
+        raise ValueError('{} has shape {}, expected {}'.format(name, x.shape, tuple('n' if n is None else n for n in shape)))
+
+    x = np.require(x, dtype, ['C_CONTIGUOUS', 'ALIGNED'])
+    arrays.append(x)
+
+    return x.ctypes.data_as(ctypes.POINTER(ctypes.c_double if dtype == np.double else ctypes.c_int))
+
+def _bind_wake_part(arrays: list, grid: np.ndarray, vertices: np.ndarray, faces: np.ndarray, name: str) -> WAKE_MESH_PART:
+    return WAKE_MESH_PART(
+        grid.shape[0],
+        grid.shape[1],
+        _bind(arrays, grid, np.int32, (None, None), name + ' wake grid'),
+        _bind(arrays, vertices, np.double, (None, 3), name + ' wake vertices'),
+        _bind(arrays, faces, np.int32, (None, 2), name + ' wake faces'),
+    )
+
+def get_environment(freestream: np.ndarray, density: float, viscosity: float, soundSpeed: float, rotation: np.ndarray = None, reference: float = None) -> ENVIRONMENT:
+    """
+    rotation is the body rotation rate, the onset at x being freestream -
+    rotation x x. reference is the velocity of cp and of the forces, the
+    freestream norm by default.
+    """
+
+    rotation = np.zeros(3) if rotation is None else rotation
+
+    return ENVIRONMENT(
+        freestream[0],
+        freestream[1],
+        freestream[2],
+        sqrt(freestream[0] * freestream[0] + freestream[1] * freestream[1] + freestream[2] * freestream[2]) if reference is None else reference,
+        density,
+        viscosity,
+        soundSpeed,
+        rotation[0],
+        rotation[1],
+        rotation[2],
+    )
+
+def get_input(vertices: np.ndarray,
+              faces: np.ndarray,
+              facesAreas: np.ndarray,
+              facesMaxDistance: np.ndarray,
+              facesCenter: np.ndarray,
+              controlPoints: np.ndarray,
+              gridWakeLeft: np.ndarray,
+              verticesWakeLeft: np.ndarray,
+              facesWakeLeft: np.ndarray,
+              gridWakeRight: np.ndarray,
+              verticesWakeRight: np.ndarray,
+              facesWakeRight: np.ndarray,
+              gridWakeTail: np.ndarray,
+              verticesWakeTail: np.ndarray,
+              facesWakeTail: np.ndarray,
+              p1: np.ndarray, p2: np.ndarray, p3: np.ndarray,
+              e1: np.ndarray, e2: np.ndarray, e3: np.ndarray,
+              freestream: np.ndarray,
+              density: float,
+              viscosity: float,
+              soundSpeed: float) -> INPUT:
+    """
+    The panel geometry (facesAreas, facesMaxDistance, facesCenter,
+    controlPoints, p1-p3 and e1-e3) may all be None: the solver then
+    derives it from the vertices and faces. The arrays are shape checked
+    and bound without copies when they already have the native layout;
+    the input keeps them alive.
+    """
+
+    nv = vertices.shape[0]
+    nf = faces.shape[0]
+
+    frames = [facesAreas, facesMaxDistance, facesCenter, controlPoints, p1, p2, p3, e1, e2, e3]
+
+    if any(x is None for x in frames) and not all(x is None for x in frames):
+        raise ValueError('The panel geometry must be given in full or not at all')
+
+    # Counts are C ints and 3 * count indexes the coordinates; matrix sizes are 64 bit
+    if 3 * max(nv, nf) > np.iinfo(np.int32).max:
+        raise ValueError('Meshes are limited to {} vertices and faces'.format(np.iinfo(np.int32).max // 3))
+
+    arrays = []
+
+    surfaceMesh = SURFACE_MESH(
+        nv,
+        nf,
+        _bind(arrays, vertices, np.double, (nv, 3), 'vertices'),
+        _bind(arrays, faces, np.int32, (nf, 3), 'faces'),
+        _bind(arrays, facesAreas, np.double, (nf,), 'facesAreas'),
+        _bind(arrays, facesMaxDistance, np.double, (nf,), 'facesMaxDistance'),
+        _bind(arrays, facesCenter, np.double, (nf, 3), 'facesCenter'),
+        _bind(arrays, controlPoints, np.double, (nf, 3), 'controlPoints'),
+        _bind(arrays, p1, np.double, (nf, 2), 'p1'),
+        _bind(arrays, p2, np.double, (nf, 2), 'p2'),
+        _bind(arrays, p3, np.double, (nf, 2), 'p3'),
+        _bind(arrays, e1, np.double, (nf, 3), 'e1'),
+        _bind(arrays, e2, np.double, (nf, 3), 'e2'),
+        _bind(arrays, e3, np.double, (nf, 3), 'e3'),
+    )
+
+    wakeMesh = WAKE_MESH(
+        _bind_wake_part(arrays, gridWakeLeft, verticesWakeLeft, facesWakeLeft, 'left'),
+        _bind_wake_part(arrays, gridWakeRight, verticesWakeRight, facesWakeRight, 'right'),
+        _bind_wake_part(arrays, gridWakeTail, verticesWakeTail, facesWakeTail, 'tail'),
+    )
+
+    input = INPUT(
+        1,
+        MESH(surfaceMesh, wakeMesh),
+        get_environment(freestream, density, viscosity, soundSpeed)
+    )
+
+    input._arrays = arrays
+
+    return input
+
+#---------------------------------------------#
+#                   CONTEXT                   #
+#---------------------------------------------#
+class SolverContext:
+    """
+    Keeps the native solver context alive between calls. The mesh arguments
+    are the ones of get_input; the influence matrices are assembled on the
+    first solve and reused until update() is called with a new mesh.
+
+    update_wake() only replaces the wake: the body matrices are kept and
+    the low rank wake coupling is rebuilt on the next solve. relax_wake()
+    relies on it to let the wake follow the flow.
+
+    onset and induced are library owned velocities at the control points,
+    added to the freestream in the next solves; inducedRate is the time
+    derivative of the potential of induced. All are zero unless written.
+    set_time_step() switches to time marching (see UnsteadySolver).
+
+    scratchDirectory stores the influence matrices in memory mapped files
+    there instead of the RAM. cacheDirectory keeps the assembled matrices
+    on disk, keyed by a hash of the mesh, so a later run on the same mesh
+    skips the assembly.
+
+    set_components() and move() move rigid parts of the mesh;
+    set_symmetry() solves half models.
+    """
+
+    def __init__(self, *mesh, scratchDirectory: str = None, cacheDirectory: str = None):
+        self._lib = load_lib()
+        self._context = None
+        self._solved = False
+        self._nComponents = 0
+        self._input = self._get_mesh_input(mesh)
+
+        if cacheDirectory is not None:
+            os.makedirs(cacheDirectory, exist_ok=True)
+
+        self._context = self._lib.createSolverContext(self._input,
+                                                      None if scratchDirectory is None else scratchDirectory.encode(),
+                                                      None if cacheDirectory is None else cacheDirectory.encode())
+
+        if self._context is None:
+            raise MemoryError('Influence matrices of {} faces do not fit'.format(self._input.mesh.surface.nf))
+
+        self._bind_outputs()
+
+    def _get_mesh_input(self, mesh: tuple) -> INPUT:
+        """The mesh is bound once; solves only change the environment"""
+
+        input = get_input(*mesh, np.zeros(3), 0.0, 0.0, 0.0)
+
+        if self._lib.checkSolverInput(input) == 0:
+            raise ValueError('Invalid mesh, see the message above')
+
+        self._wake = [tuple(mesh[k:k + 3]) for k in (6, 9, 12)]
+
+        return input
+
+    def _bind_outputs(self):
+        """Views of the library owned output buffers"""
+
+        nv = self._input.mesh.surface.nv
+        nf = self._input.mesh.surface.nf
+
+        self._outputs = [np.ctypeslib.as_array(self._lib.getSolverContextOutput(self._context, k), shape=(nv,)) for k in range(len(VERTICES_FIELDS))]
+        self._forces = np.ctypeslib.as_array(self._lib.getSolverContextOutput(self._context, len(VERTICES_FIELDS)), shape=(3,))
+        self.onset = np.ctypeslib.as_array(self._lib.getSolverContextOnset(self._context, 0), shape=(nf, 3))
+        self.induced = np.ctypeslib.as_array(self._lib.getSolverContextOnset(self._context, 1), shape=(nf, 3))
+        self.inducedRate = np.ctypeslib.as_array(self._lib.getSolverContextOnset(self._context, 2), shape=(nf,))
+
+    def update(self, *mesh):
+        nf = self._input.mesh.surface.nf
+        self._input = self._get_mesh_input(mesh)
+        self._solved = False
+
+        # A new number of faces drops the components
+        if self._input.mesh.surface.nf != nf:
+            self._nComponents = 0
+
+        if self._lib.updateSolverContext(self._context, self._input) == 0:
+            raise MemoryError('Influence matrices of {} faces do not fit'.format(self._input.mesh.surface.nf))
+
+        self._bind_outputs()
+
+    def set_components(self, components: np.ndarray):
+        """
+        Splits the faces in rigid components, components[i] being the one
+        of the face i (0, 1, ...), for move(). None goes back to a single
+        body. The components must not share vertices. The next solve
+        assembles in full, without the cache.
+        """
+
+        nf = self._input.mesh.surface.nf
+        nComponents = 0 if components is None else int(np.max(components)) + 1
+        components = np.zeros(nf, dtype=np.int32) if components is None else np.ascontiguousarray(components, dtype=np.int32)
+
+        if components.shape != (nf,):
+            raise ValueError('components has shape {}, expected ({},)'.format(components.shape, nf))
+
+        if self._lib.setSolverContextComponents(self._context, self._input, nComponents, components) == 0:
+            raise ValueError('Invalid components, see the message above')
+
+        self._nComponents = nComponents
+
+    def set_symmetry(self, symmetric: int):
+        """
+        Takes the mesh as the y >= 0 half of a model symmetric about the
+        y = 0 plane, wake included: the images are folded into the
+        influences, so the system keeps the size of the half. Solves drop
+        the sideslip and the roll and yaw rates, forces are the ones of the
+        full model and write_vtk() unfolds it; the vertices values are the
+        ones of the half (see unfold_half_model). symmetric = -1 solves the
+        antisymmetric flow (sideslip, roll and yaw rates only) with images
+        of the opposite sign; 0 or False goes back to the mesh alone.
+        """
+
+        if self._lib.setSolverContextSymmetry(self._context, self._input, int(symmetric)) == 0:
+            raise ValueError('Invalid half model, see the message above')
+
+        self._solved = False
+
+    def move(self, transforms: np.ndarray, *mesh):
+        """
+        The components moved rigidly to the new mesh (same faces), with
+        transforms [nComponents x 3 x 4] the rotation and translation of
+        each one, x -> R x + t, since the last update() or move(). The
+        next solve only integrates again the blocks between components
+        that moved relative to each other; the others are carried by their
+        common motion. Without components it is an update().
+        """
+
+        transforms = np.ascontiguousarray(transforms, dtype=np.double)
+
+        if transforms.shape != (self._nComponents, 3, 4):
+            raise ValueError('transforms has shape {}, expected ({}, 3, 4)'.format(transforms.shape, self._nComponents))
+
+        transforms = np.concatenate([transforms[:, :, :3].reshape(-1, 9), transforms[:, :, 3]], axis=1).ravel()
+
+        self._input = self._get_mesh_input(mesh)
+        self._solved = False
+
+        if self._lib.moveSolverContextComponents(self._context, self._input, transforms if transforms.size > 0 else np.zeros(1)) == 0:
+            raise MemoryError('Influence matrices of {} faces do not fit'.format(self._input.mesh.surface.nf))
+
+        self._bind_outputs()
+
+    def update_wake(self,
+                    gridWakeLeft: np.ndarray, verticesWakeLeft: np.ndarray, facesWakeLeft: np.ndarray,
+                    gridWakeRight: np.ndarray, verticesWakeRight: np.ndarray, facesWakeRight: np.ndarray,
+                    gridWakeTail: np.ndarray, verticesWakeTail: np.ndarray, facesWakeTail: np.ndarray):
+        """New wake for the same surface mesh, for example aligned with a new freestream"""
+
+        arrays = []
+
+        self._input.mesh.wake = WAKE_MESH(
+            _bind_wake_part(arrays, gridWakeLeft, verticesWakeLeft, facesWakeLeft, 'left'),
+            _bind_wake_part(arrays, gridWakeRight, verticesWakeRight, facesWakeRight, 'right'),
+            _bind_wake_part(arrays, gridWakeTail, verticesWakeTail, facesWakeTail, 'tail'),
+        )
+        self._input._wakeArrays = arrays
+        self._wake = [(gridWakeLeft, verticesWakeLeft, facesWakeLeft), (gridWakeRight, verticesWakeRight, facesWakeRight), (gridWakeTail, verticesWakeTail, facesWakeTail)]
+        self._solved = False
+
+        if self._lib.updateSolverContextWake(self._context, self._input) == 0:
+            raise ValueError('Invalid wake, see the message above')
+
+    def solve(self,
+              freestream: np.ndarray,
+              density: float,
+              viscosity: float,
+              soundSpeed: float,
+              verticesFields: list = None,
+              views: bool = False,
+              rotation: np.ndarray = None,
+              reference: float = None):
+        """
+        verticesFields selects the fields interpolated to the vertices (a
+        subset of VERTICES_FIELDS, all by default). The others are returned
+        as None, as is cp_v unless the three velocity components are selected.
+        views returns the library owned buffers themselves instead of copies:
+        nothing is allocated, but they are overwritten by the next solve and
+        invalid after update() or close(). rotation and reference are the
+        ones of get_environment; cp_v is the steady cp of the vertices
+        velocities, the forces use the full cp of the faces.
+        """
+
+        verticesFields = VERTICES_FIELDS if verticesFields is None else verticesFields
+
+        self._input.environment = get_environment(freestream, density, viscosity, soundSpeed, rotation, reference)
+
+        outputs = [x if name in verticesFields else None for name, x in zip(VERTICES_FIELDS, self._outputs)]
+
+        self._lib.solveSolverContext(self._context, self._input, *outputs, self._forces)
+        self._solved = True
+
+        print('Forces: {}'.format(self._forces))
+
+        if not views:
+            outputs = [None if x is None else x.copy() for x in outputs]
+
+        vel_x_v, vel_y_v, vel_z_v, transpiration_v, sigma_v, doublet_v = outputs
+
+        cp_v = None
+
+        if (vel_x_v is not None) and (vel_y_v is not None) and (vel_z_v is not None):
+            cp_v = 1 - (vel_x_v * vel_x_v + vel_y_v * vel_y_v + vel_z_v * vel_z_v) / self._input.environment.velNorm ** 2
+
+        return [
+            cp_v,
+            vel_x_v,
+            vel_y_v,
+            vel_z_v,
+            transpiration_v,
+            sigma_v,
+            doublet_v,
+        ]
+
+    def velocities(self, points: np.ndarray, core: float = 0.0) -> np.ndarray:
+        """
+        Velocity [n x 3] of the last solve at the points [n x 3]. The
+        surface is evaluated through a tree of far field expansions; core is
+        the vortex core radius of the wake lines.
+        """
+
+        if not self._solved:
+            raise RuntimeError('No velocities before the first solve')
+
+        points = np.ascontiguousarray(points, dtype=np.double).reshape(-1, 3)
+        vel = np.empty_like(points)
+
+        self._lib.getSolverContextVelocities(self._context, self._input, points.shape[0], points.reshape(-1), core, vel.reshape(-1))
+
+        return vel
+
+    def relax_wake(self,
+                   freestream: np.ndarray,
+                   density: float,
+                   viscosity: float,
+                   soundSpeed: float,
+                   iterations: int = 10,
+                   tolerance: float = 1e-3,
+                   relaxation: float = 0.5,
+                   core: float = None,
+                   verticesFields: list = None,
+                   views: bool = False):
+        """
+        Free wake: solves, moves the wake along the velocity at its vertices
+        and solves again, until the largest move is below tolerance times
+        the shortest wake step or after iterations moves. Each line is
+        rebuilt from the trailing edge with its own step lengths, along the
+        mean velocity of each step; its last step stays along the freestream,
+        towards the semi-infinite end. The vertices move relaxation of the
+        way there. core (half the shortest step by default) is the vortex
+        core radius of the wake lines. Only the wake coupling is rebuilt
+        between solves. Returns the last solve, as solve() does;
+        wake_residuals holds the largest move of each step.
+        """
+
+        u = np.asarray(freestream, dtype=np.double) / np.linalg.norm(freestream)
+
+        parts = [(grid, np.array(vertices, dtype=np.double), faces) for grid, vertices, faces in self._wake]
+        active = [k for k, (grid, _, _) in enumerate(parts) if (grid.ndim == 2) and (grid.shape[0] > 1) and (grid.shape[1] > 1)]
+
+        if len(active) == 0:
+            return self.solve(freestream, density, viscosity, soundSpeed, verticesFields=verticesFields, views=views)
+
+        shortest = min(np.linalg.norm(np.diff(parts[k][1][parts[k][0]], axis=1), axis=2).min() for k in active)
+        core = 0.5 * shortest if core is None else core
+
+        self.wake_residuals = []
+
+        for _ in range(iterations):
+
+            self.solve(freestream, density, viscosity, soundSpeed, verticesFields=[])
+
+            # The trailing edge row lies on the surface panels and is not evaluated
+            lines = [parts[k][1][parts[k][0]] for k in active]
+            vel = self.velocities(np.concatenate([x[:, 1:].reshape(-1, 3) for x in lines]), core)
+
+            residual = 0.0
+            first = 0
+
+            for k, p in zip(active, lines):
+
+                grid, vertices, _ = parts[k]
+
+                v = vel[first:first + p.shape[0] * (p.shape[1] - 1)].reshape(p.shape[0], p.shape[1] - 1, 3)
+                first = first + p.shape[0] * (p.shape[1] - 1)
+
+                # Steps along the mean velocity, the trailing edge and the last direction kept
+                directions = np.concatenate([v[:, :1], 0.5 * (v[:, :-1] + v[:, 1:])], axis=1)
+                directions = directions / np.linalg.norm(directions, axis=2, keepdims=True)
+                directions[:, -1] = u
+
+                steps = np.linalg.norm(np.diff(p, axis=1), axis=2)
+                q = np.concatenate([p[:, :1], p[:, :1] + np.cumsum(steps[:, :, None] * directions, axis=1)], axis=1)
+
+                move = relaxation * (q - p)
+                vertices[grid] = p + move
+
+                residual = max(residual, np.linalg.norm(move, axis=2).max())
+
+            self.update_wake(*[x for part in parts for x in part])
+            self.wake_residuals.append(residual / shortest)
+
+            if self.wake_residuals[-1] < tolerance:
+                break
+
+        return self.solve(freestream, density, viscosity, soundSpeed, verticesFields=verticesFields, views=views)
+
+    def set_time_step(self, timeStep: float):
+        """
+        timeStep > 0 marches in time from the previous solve: the wake is
+        the row shed in the last step, closed at its end, and cp has the
+        time derivative of the potential. 0 goes back to steady solves.
+        """
+        self._lib.setSolverContextTimeStep(self._context, timeStep)
+
+    def wake_strengths(self) -> np.ndarray:
+        """Circulation of the wake strips of the last solve, left, right and tail parts in turn"""
+
+        if not self._solved:
+            raise RuntimeError('No wake strengths before the first solve')
+
+        gamma = np.empty(sum(max(grid.shape[0] - 1, 0) for grid, _, _ in self._wake if np.ndim(grid) == 2), dtype=np.double)
+
+        n = self._lib.getSolverContextWakeStrengths(self._context, gamma if gamma.size > 0 else np.empty(1))
+
+        return gamma[:n]
+
+    def wake_coupling(self, field: int = 0) -> np.ndarray:
+        """
+        Wake coupling of the last solve [nf x nStrips], strips in the order
+        of wake_strengths(): 0 the normal velocity at the control points of
+        each strip with unit circulation, 1 to 3 its velocity components
+        """
+
+        nf = self._input.mesh.surface.nf
+        nStrips = self.wake_strengths().size
+
+        if nStrips == 0:
+            return np.zeros((nf, 0))
+
+        return np.ctypeslib.as_array(self._lib.getSolverContextWakeCoupling(self._context, field), shape=(nf, nStrips)).copy()
+
+    @property
+    def forces(self) -> np.ndarray:
+        """Forces of the last solve (a view of the library owned buffer)"""
+        return self._forces
+
+    def write_vtk(self, file: str, wake: bool = False, compressed: bool = True):
+        """Writes the faces and vertices values of the last solve to a VTK PolyData (.vtp) file"""
+
+        if not self._solved:
+            raise RuntimeError('Nothing to write before the first solve')
+
+        if self._lib.writeSolverContextVtk(self._context, self._input, file.encode(), int(wake), int(compressed)) == 0:
+            raise IOError('Could not write {}'.format(file))
+
+    def close(self):
+        if self._context is not None:
+            self._lib.destroySolverContext(self._context)
+            self._context = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+#---------------------------------------------#
+#                  UNSTEADY                   #
+#---------------------------------------------#
+def vortex_lattice_velocity(lattice: np.ndarray, gamma: np.ndarray, points: np.ndarray, core: float = 0.0, potential: bool = False):
+    """
+    Velocity [n x 3] at the points [n x 3] of a lattice of closed vortex
+    rings: lattice [nRows + 1 x nSpan x 3], row 0 upstream, and ring (r, s)
+    of circulation gamma[r, s] [nRows x nSpan - 1] goes round lattice[r, s],
+    lattice[r, s + 1], lattice[r + 1, s + 1] and lattice[r + 1, s], as the
+    wake strips of the solver. core is the vortex core radius. potential
+    also returns the potential [n] of the rings, in the convention of the
+    surface doublets.
+    """
+
+    lib = load_lib()
+
+    lattice = np.ascontiguousarray(lattice, dtype=np.double)
+    gamma = np.ascontiguousarray(gamma, dtype=np.double)
+    points = np.ascontiguousarray(points, dtype=np.double).reshape(-1, 3)
+    vel = np.zeros_like(points)
+    phi = np.zeros(points.shape[0]) if potential else None
+
+    if lattice.shape[0] > 1 and lattice.shape[1] > 1 and points.shape[0] > 0:
+        lib.getVortexLatticeVelocity(lattice.shape[1], lattice.shape[0] - 1, lattice.reshape(-1), gamma.reshape(-1), points.shape[0], points.reshape(-1), core, vel.reshape(-1), phi)
+
+    return (vel, phi) if potential else vel
+
+def surface_velocity(vertices: np.ndarray, faces: np.ndarray, sigma: np.ndarray, doublet: np.ndarray, points: np.ndarray, theta: float = 0.3):
+    """
+    Velocity [n x 3] at the points [n x 3] of the surface alone, with the
+    faces values sigma and doublet, through the panel tree of the solver.
+    Nodes smaller than theta times their distance act by their moments;
+    theta = 0 sums every panel exactly.
+    """
+
+    lib = load_lib()
+
+    frames = panel_frames(vertices, faces)
+    empty2, empty3 = np.zeros((0, 2), dtype=np.int32), np.zeros((0, 3))
+    input = get_input(vertices, faces, frames['facesAreas'], frames['facesMaxDistance'], frames['facesCenter'], frames['controlPoints'],
+                      empty2, empty3, empty2, empty2, empty3, empty2, empty2, empty3, empty2,
+                      frames['p1Local'], frames['p2Local'], frames['p3Local'], frames['e1'], frames['e2'], frames['e3'],
+                      np.zeros(3), 0.0, 0.0, 0.0)
+
+    points = np.ascontiguousarray(points, dtype=np.double).reshape(-1, 3)
+    vel = np.zeros_like(points)
+
+    if points.shape[0] > 0:
+        lib.getSurfaceVelocity(input.mesh.surface, np.ascontiguousarray(sigma, dtype=np.double), np.ascontiguousarray(doublet, dtype=np.double), points.shape[0], points.reshape(-1), theta, vel.reshape(-1))
+
+    return vel
+
+def _rotation_matrix(rotation: np.ndarray) -> np.ndarray:
+    """Rotation by the vector rotation (Rodrigues)"""
+
+    angle = np.linalg.norm(rotation)
+
+    if angle == 0.0:
+        return np.eye(3)
+
+    k = rotation / angle
+    K = np.array([[0.0, -k[2], k[1]], [k[2], 0.0, -k[0]], [-k[1], k[0], 0.0]])
+
+    return np.eye(3) + np.sin(angle) * K + (1 - np.cos(angle)) * K @ K
+
+class UnsteadySolver:
+    """
+    Time marching of a body in arbitrary motion, solved in the body frame.
+    The mesh (the arguments of get_input) is given in body axes and its
+    wake parts only give the trailing edges, the first vertex of each wake
+    line. Each step() moves the body, sheds one wake row from the trailing
+    edges and solves: the row between the trailing edges of this step and
+    of the previous one is the wake of the system, a closed ring per strip
+    with the circulation of the Kutta condition. The older rows stay where
+    they were shed, in the inertial frame, with the circulation they had;
+    they enter through their velocity at the control points, so only the
+    new row is integrated in the system. Under rigid motion the body
+    matrices are assembled once; a deformation (new vertices, same faces)
+    reassembles them and its velocity enters the onset. cp has the time
+    derivative of the potential, the one of the older rows included.
+    position and attitude (body to inertial axes) give the initial pose.
+    core is the vortex core radius of the older rows at the control points.
+    components splits the faces in rigid components (see
+    SolverContext.set_components) moved by the transforms of step(), for
+    example flapping wings on a fuselage; they must not share vertices.
+    symmetric solves the mesh as the y >= 0 half of the body (see
+    SolverContext.set_symmetry), the older rows acting with their images;
+    the motion must keep the symmetry.
+    """
+
+    def __init__(self, *mesh, position: np.ndarray = None, attitude: np.ndarray = None, core: float = 0.0, components: np.ndarray = None, symmetric: bool = False, scratchDirectory: str = None, cacheDirectory: str = None):
+
+        self._mesh = list(mesh)
+        self.position = np.zeros(3) if position is None else np.array(position, dtype=np.double)
+        self.attitude = np.eye(3) if attitude is None else np.array(attitude, dtype=np.double)
+        self.time = 0.0
+        self.core = core
+
+        vertices = np.asarray(mesh[0], dtype=np.double)
+
+        # Trailing edges: the surface vertices at the start of the wake lines
+        self._edges = []
+
+        for k in range(3):
+
+            grid, wakeVertices, faces = mesh[6 + 3 * k:9 + 3 * k]
+
+            if np.ndim(grid) != 2 or grid.shape[0] < 2 or grid.shape[1] < 1:
+                continue
+
+            starts = np.asarray(wakeVertices)[np.asarray(grid)[:, 0]]
+            nearest = np.argmin(np.linalg.norm(vertices[None, :, :] - starts[:, None, :], axis=2), axis=1)
+
+            self._edges.append((k, nearest, np.asarray(faces)))
+
+        # Rows shed in the inertial frame, the trailing edge of each step, and their circulations
+        self._rows = [[self._inertial(vertices[edge])] for _, edge, _ in self._edges]
+        self._gammas = [[] for _ in self._edges]
+        self._potential = np.zeros(np.asarray(mesh[1]).shape[0])
+
+        self._controlPoints = panel_frames(vertices, mesh[1])['controlPoints'] if mesh[5] is None else np.asarray(mesh[5], dtype=np.double)
+
+        # Component of each vertex, from the faces using it: a vertex shared by two components has no single transform
+        self._verticesComponents = None
+
+        if components is not None:
+            facesComponents = np.repeat(np.asarray(components, dtype=np.int32)[:, None], 3, axis=1)
+            lowest = np.full(vertices.shape[0], np.iinfo(np.int32).max, dtype=np.int32)
+            self._verticesComponents = np.full(vertices.shape[0], -1, dtype=np.int32)
+
+            np.minimum.at(lowest, np.asarray(mesh[1]), facesComponents)
+            np.maximum.at(self._verticesComponents, np.asarray(mesh[1]), facesComponents)
+
+            shared = np.flatnonzero((self._verticesComponents >= 0) & (lowest != self._verticesComponents))
+
+            if shared.size > 0:
+                raise ValueError('Components share {} vertices, vertex {} for example'.format(shared.size, shared[0]))
+
+            self._verticesComponents = np.maximum(self._verticesComponents, 0)
+
+        self.context = SolverContext(*self._get_mesh(self._mesh[0], self._empty_wake()), scratchDirectory=scratchDirectory, cacheDirectory=cacheDirectory)
+        self._symmetric = bool(symmetric)
+
+        if self._symmetric:
+            self.context.set_symmetry(True)
+
+        if components is not None:
+            self.context.set_components(components)
+
+    def _inertial(self, x: np.ndarray) -> np.ndarray:
+        return self.position + x @ self.attitude.T
+
+    def _body(self, x: np.ndarray) -> np.ndarray:
+        return (x - self.position) @ self.attitude
+
+    def _empty_wake(self) -> list:
+        return [(np.zeros((0, 2), np.int32), np.zeros((0, 3)), np.zeros((0, 2), np.int32))] * 3
+
+    def _get_mesh(self, vertices: np.ndarray, wake: list) -> list:
+        """The mesh of the context, with new vertices (their panel geometry derived natively on a deformation) and wake"""
+
+        mesh = list(self._mesh)
+        mesh[6:15] = [x for part in wake for x in part]
+
+        if vertices is not self._mesh[0]:
+            mesh[0] = vertices
+            mesh[2:6] = [None] * 4
+            mesh[15:21] = [None] * 6
+
+        return mesh
+
+    def step(self,
+             dt: float,
+             velocity: np.ndarray,
+             rotation: np.ndarray,
+             density: float,
+             viscosity: float,
+             soundSpeed: float,
+             vertices: np.ndarray = None,
+             reference: float = None,
+             verticesFields: list = None,
+             views: bool = False,
+             transforms: np.ndarray = None):
+        """
+        Advances dt with the velocity of the body origin and the rotation
+        rate, both in body axes, held over the step. vertices are the
+        deformed vertices at the end of the step in body axes (None keeps
+        the current ones). transforms [nComponents x 3 x 4] instead move
+        the components rigidly over the step, x -> R x + t in body axes,
+        and only the blocks between components that moved relative to
+        each other are integrated again. reference is the velocity of cp
+        and of the forces, |velocity| by default. Returns the solve, as
+        SolverContext.solve() does; the forces are in body axes.
+        """
+
+        velocity = np.asarray(velocity, dtype=np.double)
+        rotation = np.asarray(rotation, dtype=np.double)
+
+        if reference is None:
+            reference = np.linalg.norm(velocity)
+
+        if reference == 0.0:
+            raise ValueError('A reference velocity is needed when the body does not translate')
+
+        # Pose
+        attitude = self.attitude @ _rotation_matrix(rotation * dt)
+        self.position = self.position + 0.5 * dt * (self.attitude + attitude) @ velocity
+        self.attitude = attitude
+        self.time = self.time + dt
+
+        # Shed row: trailing edge of this step and of the previous one, in body axes
+        if transforms is not None:
+            if self._verticesComponents is None:
+                raise ValueError('transforms need the components of the solver')
+
+            transforms = np.asarray(transforms, dtype=np.double)
+            vertices = np.einsum('vij,vj->vi', transforms[self._verticesComponents, :, :3], self._mesh[0]) + transforms[self._verticesComponents, :, 3]
+
+        deformed = vertices is not None
+        vertices = np.asarray(vertices, dtype=np.double) if deformed else self._mesh[0]
+
+        wake = self._empty_wake()
+
+        for (k, edge, faces), rows in zip(self._edges, self._rows):
+            n = edge.shape[0]
+            wake[k] = (np.arange(2 * n, dtype=np.int32).reshape(2, n).T.copy(), np.concatenate([vertices[edge], self._body(rows[-1])]), faces)
+
+        if deformed:
+            controlPoints = panel_frames(vertices, self._mesh[1])['controlPoints']
+            onset = -(controlPoints - self._controlPoints) / dt
+
+            if transforms is not None:
+                self.context.move(transforms, *self._get_mesh(vertices, wake))
+            else:
+                self.context.update(*self._get_mesh(vertices, wake))
+            self.context.onset[:] = onset
+            self._mesh[0] = vertices
+            self._controlPoints = controlPoints
+        else:
+            self.context.update_wake(*[x for part in wake for x in part])
+            self.context.onset[:] = 0.0
+
+        # Older rows at the control points; the rate of their potential includes the row frozen this step
+        self.context.induced[:] = 0.0
+        potential = np.zeros(self._controlPoints.shape[0])
+
+        for rows, gammas in zip(self._rows, self._gammas):
+            if len(gammas) > 0:
+                lattice = self._body(np.array(rows[::-1]))
+                vel, phi = vortex_lattice_velocity(lattice, np.array(gammas[::-1]), self._controlPoints, self.core, potential=True)
+                self.context.induced[:] += vel
+                potential += phi
+
+                # Image rows: the velocity at the image of the control points, mirrored
+                if self._symmetric:
+                    mirror = np.array([1.0, -1.0, 1.0])
+                    vel, phi = vortex_lattice_velocity(lattice, np.array(gammas[::-1]), self._controlPoints * mirror, self.core, potential=True)
+                    self.context.induced[:] += vel * mirror
+                    potential += phi
+
+        self.context.inducedRate[:] = (potential - self._potential) / dt
+        self._potential = potential
+
+        # Solve
+        self.context.set_time_step(dt)
+
+        out = self.context.solve(-velocity, density, viscosity, soundSpeed, verticesFields=verticesFields, views=views, rotation=rotation, reference=reference)
+
+        # The shed row keeps its circulation
+        gamma = self.context.wake_strengths()
+        first = 0
+
+        for (k, edge, _), rows, gammas in zip(self._edges, self._rows, self._gammas):
+            rows.append(self._inertial(vertices[edge]))
+            gammas.append(gamma[first:first + edge.shape[0] - 1])
+            first = first + edge.shape[0] - 1
+
+        return out
+
+    @property
+    def forces(self) -> np.ndarray:
+        """Forces of the last step in body axes (a view of the library owned buffer)"""
+        return self.context.forces
+
+    @property
+    def wake(self) -> list:
+        """Rows shed so far by each trailing edge, in the inertial frame [nRows + 1 x nSpan x 3], oldest first, and their circulations [nRows x nSpan - 1]"""
+        return [(np.array(rows), np.array(gammas).reshape(len(gammas), -1)) for rows, gammas in zip(self._rows, self._gammas)]
+
+    def close(self):
+        self.context.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
 #---------------------------------------------#
 #                   WRAPPER                   #
 #---------------------------------------------#
@@ -88,118 +1047,181 @@ def wrapper(vertices: np.ndarray,
             freestream: np.ndarray,
             density: float,
             viscosity: float,
-            soundSpeed: float):
+            soundSpeed: float,
+            verticesFields: list = None,
+            cacheDirectory: str = None):
+    """
+    Single solve. Use SolverContext to reuse the assembled system in sweeps.
+    Without a cache directory a mesh mirror symmetric about y = 0, wake
+    included, is solved as a symmetric and an antisymmetric half, the
+    results being unfolded to the full mesh.
+    """
 
-    nv = vertices.shape[0]
-    nf = faces.shape[0]
+    if cacheDirectory is None:
 
-    # Input/output
-    surfaceMesh = SURFACE_MESH(
-        nv,
-        nf,
-        np.ctypeslib.as_ctypes(vertices.astype(np.double).reshape(vertices.size)),
-        np.ctypeslib.as_ctypes(faces.astype(np.int32).reshape(faces.size)),
-        np.ctypeslib.as_ctypes(facesAreas.astype(np.double).reshape(facesAreas.size)),
-        np.ctypeslib.as_ctypes(facesMaxDistance.astype(np.double).reshape(facesMaxDistance.size)),
-        np.ctypeslib.as_ctypes(facesCenter.astype(np.double).reshape(facesCenter.size)),
-        np.ctypeslib.as_ctypes(controlPoints.astype(np.double).reshape(controlPoints.size)),
-        np.ctypeslib.as_ctypes(p1.astype(np.double).reshape(p1.size)),
-        np.ctypeslib.as_ctypes(p2.astype(np.double).reshape(p2.size)),
-        np.ctypeslib.as_ctypes(p3.astype(np.double).reshape(p3.size)),
-        np.ctypeslib.as_ctypes(e1.astype(np.double).reshape(e1.size)),
-        np.ctypeslib.as_ctypes(e2.astype(np.double).reshape(e2.size)),
-        np.ctypeslib.as_ctypes(e3.astype(np.double).reshape(e3.size))
-    )
+        lib = load_lib()
+        input = get_input(vertices, faces, facesAreas, facesMaxDistance, facesCenter, controlPoints,
+                          gridWakeLeft, verticesWakeLeft, facesWakeLeft,
+                          gridWakeRight, verticesWakeRight, facesWakeRight,
+                          gridWakeTail, verticesWakeTail, facesWakeTail,
+                          p1, p2, p3, e1, e2, e3, freestream, density, viscosity, soundSpeed)
 
-    left = WAKE_MESH_PART(
-        gridWakeLeft.shape[0],
-        gridWakeLeft.shape[1],
-        np.ctypeslib.as_ctypes(gridWakeLeft.astype(np.int32).reshape(gridWakeLeft.size)),
-        np.ctypeslib.as_ctypes(verticesWakeLeft.astype(np.double).reshape(verticesWakeLeft.size)),
-        np.ctypeslib.as_ctypes(facesWakeLeft.astype(np.int32).reshape(facesWakeLeft.size))
-    )
+        if lib.checkSolverInput(input) == 0:
+            raise ValueError('Invalid mesh, see the message above')
 
-    right = WAKE_MESH_PART(
-        gridWakeRight.shape[0],
-        gridWakeRight.shape[1],
-        np.ctypeslib.as_ctypes(gridWakeRight.astype(np.int32).reshape(gridWakeRight.size)),
-        np.ctypeslib.as_ctypes(verticesWakeRight.astype(np.double).reshape(verticesWakeRight.size)),
-        np.ctypeslib.as_ctypes(facesWakeRight.astype(np.int32).reshape(facesWakeRight.size))
-    )
+        verticesFields = VERTICES_FIELDS if verticesFields is None else verticesFields
+        outputs = [np.empty(vertices.shape[0]) if name in verticesFields else None for name in VERTICES_FIELDS]
+        forces = np.empty(3)
 
-    tail = WAKE_MESH_PART(
-        gridWakeTail.shape[0],
-        gridWakeTail.shape[1],
-        np.ctypeslib.as_ctypes(gridWakeTail.astype(np.int32).reshape(gridWakeTail.size)),
-        np.ctypeslib.as_ctypes(verticesWakeTail.astype(np.double).reshape(verticesWakeTail.size)),
-        np.ctypeslib.as_ctypes(facesWakeTail.astype(np.int32).reshape(facesWakeTail.size))
-    )
+        if lib.solve(input, *outputs, forces) == 0:
+            raise MemoryError('Influence matrices of {} faces do not fit'.format(input.mesh.surface.nf))
 
-    wakeMesh = WAKE_MESH(
-        left,
-        right,
-        tail
-    )
+        print('Forces: {}'.format(forces))
 
-    mesh = MESH(
-        surfaceMesh,
-        wakeMesh
-    )
+        vel_x_v, vel_y_v, vel_z_v, transpiration_v, sigma_v, doublet_v = outputs
 
-    environment = ENVIRONMENT(
-        freestream[0],
-        freestream[1],
-        freestream[2],
-        sqrt(freestream[0] * freestream[0] + freestream[1] * freestream[1] + freestream[2] * freestream[2]),
-        density,
-        viscosity,
-        soundSpeed
-    )
+        cp_v = None
 
-    input = INPUT(
-        1,
-        mesh,
-        environment
-    )
+        if (vel_x_v is not None) and (vel_y_v is not None) and (vel_z_v is not None):
+            cp_v = 1 - (vel_x_v * vel_x_v + vel_y_v * vel_y_v + vel_z_v * vel_z_v) / input.environment.velNorm ** 2
 
-    cp_v = np.empty(nv, dtype=np.double)
-    vel_x_v = np.empty(nv, dtype=np.double)
-    vel_y_v = np.empty(nv, dtype=np.double)
-    vel_z_v = np.empty(nv, dtype=np.double)
-    transpiration_v = np.empty(nv, dtype=np.double)
-    sigma_v = np.empty(nv, dtype=np.double)
-    doublet_v = np.empty(nv, dtype=np.double)
-    forces = np.empty(3, dtype=np.double)
+        return [cp_v, vel_x_v, vel_y_v, vel_z_v, transpiration_v, sigma_v, doublet_v]
 
-    # Load library
-    lib = ctypes.CDLL('./utils/bin/libsolver.so')
+    with SolverContext(vertices, faces, facesAreas, facesMaxDistance, facesCenter, controlPoints,
+                       gridWakeLeft, verticesWakeLeft, facesWakeLeft,
+                       gridWakeRight, verticesWakeRight, facesWakeRight,
+                       gridWakeTail, verticesWakeTail, facesWakeTail,
+                       p1, p2, p3, e1, e2, e3, cacheDirectory=cacheDirectory) as context:
+        return context.solve(freestream, density, viscosity, soundSpeed, verticesFields)
 
-    # Set input and output
-    lib.solve.argtypes = [
-        INPUT,
-        ND_POINTER_DOUBLE,
-        ND_POINTER_DOUBLE,
-        ND_POINTER_DOUBLE,
-        ND_POINTER_DOUBLE,
-        ND_POINTER_DOUBLE,
-        ND_POINTER_DOUBLE,
-        ND_POINTER_DOUBLE,
-    ]
+#---------------------------------------------#
+#                     VTK                     #
+#---------------------------------------------#
+def write_vtk(file: str,
+              *mesh,
+              pointFields: dict = None,
+              cellFields: dict = None,
+              wake: bool = False,
+              compressed: bool = True):
+    """
+    Writes the mesh (the arguments of get_input) to a VTK PolyData (.vtp)
+    file. The fields map a name to an array, or to a tuple of three arrays
+    for vectors, of vertices (pointFields) or faces (cellFields) values.
+    """
+
+    lib = load_lib()
+    input = get_input(*mesh, np.zeros(3), 0.0, 0.0, 0.0)
+
+    arrays = []
+    fields = []
+
+    for cells, group in ((0, pointFields or {}), (1, cellFields or {})):
+        for name, value in group.items():
+            components = [np.ascontiguousarray(x, dtype=np.double) for x in (value if isinstance(value, tuple) else (value,))]
+            arrays.extend(components)
+            data = (ctypes.POINTER(ctypes.c_double) * 3)(*[x.ctypes.data_as(ctypes.POINTER(ctypes.c_double)) for x in components])
+            fields.append(VTK_FIELD(name.encode(), len(components), cells, data))
+
+    fieldsArray = (VTK_FIELD * max(len(fields), 1))(*fields)
+
+    if lib.writeVtkFile(file.encode(), input.mesh, int(wake), int(compressed), len(fields), fieldsArray) == 0:
+        raise IOError('Could not write {}'.format(file))
+
+def unfold_half_model(vertices: np.ndarray, faces: np.ndarray, *fields: np.ndarray, sign: int = 1):
+    """
+    Full model of a half one solved with set_symmetry(): the image vertices
+    (y reversed) follow the half ones, and the image faces the half ones
+    with their vertices in the reverse order. Each field, of vertices or
+    faces values, is repeated for the images with the sign of the
+    symmetry; vectors [n x 3] have their y component reversed. cp, even in
+    both symmetries, is unfolded with sign = 1. Returns the vertices,
+    faces and fields.
+    """
+
+    vertices = np.asarray(vertices, dtype=np.double)
+    faces = np.asarray(faces)
+    mirror = sign * np.array([1.0, -1.0, 1.0])
+
+    unfolded = [np.concatenate([vertices, vertices * [1.0, -1.0, 1.0]]), np.concatenate([faces, faces[:, ::-1] + vertices.shape[0]])]
+
+    for field in fields:
+        field = np.asarray(field, dtype=np.double)
+        unfolded.append(np.concatenate([field, field * mirror if field.ndim == 2 else sign * field]))
+
+    return tuple(unfolded)
+
+#---------------------------------------------#
+#                PANEL FRAMES                 #
+#---------------------------------------------#
+def panel_frames(vertices: np.ndarray, faces: np.ndarray, controlPointOffset: float = 1e-8) -> dict:
+    """
+    Panel geometry derived natively from the vertices and faces, keyed by
+    the MeshData names (facesCenter, e1, ..., p1Local, ...)
+    """
+
+    lib = load_lib()
+
+    nf = faces.shape[0]
+
+    out = {
+        'facesAreas': np.empty(nf, dtype=np.double),
+        'facesMaxDistance': np.empty(nf, dtype=np.double),
+        'facesCenter': np.empty((nf, 3), dtype=np.double),
+        'controlPoints': np.empty((nf, 3), dtype=np.double),
+        'p1Local': np.empty((nf, 2), dtype=np.double),
+        'p2Local': np.empty((nf, 2), dtype=np.double),
+        'p3Local': np.empty((nf, 2), dtype=np.double),
+        'e1': np.empty((nf, 3), dtype=np.double),
+        'e2': np.empty((nf, 3), dtype=np.double),
+        'e3': np.empty((nf, 3), dtype=np.double),
+    }
+
+    frames = PANEL_FRAMES(nf, *[x.ctypes.data_as(ctypes.POINTER(ctypes.c_double)) for x in out.values()])
+
+    lib.getPanelFrames(nf, np.ascontiguousarray(vertices, dtype=np.double).reshape(-1), np.ascontiguousarray(faces, dtype=np.int32).reshape(-1), controlPointOffset, frames)
+
+    return out
+
+def wake_grid(vertices: np.ndarray,
+              faces: np.ndarray,
+              starts: np.ndarray,
+              ends: np.ndarray,
+              direction: np.ndarray,
+              ds: float,
+              nWake: int,
+              length: float,
+              accommodation: float) -> list:
+    """
+    Wake parts shed from the trailing edges running from starts[i] to
+    ends[i] (the nearest mesh vertices are used), as a list of (grid,
+    vertices, faces). The trailing edge follows the sharpest edges of the
+    mesh; the wake lines turn from the trailing edge bisector towards
+    direction as accommodation / (accommodation + s). The last step is
+    along direction, ds long or length - (nWake - 1) * ds if length is
+    positive. The solver continues each line to infinity from there, so
+    the grid only needs to cover the near wake.
+    """
+
+    lib = load_lib()
+
+    starts = np.ascontiguousarray(starts, dtype=np.double).reshape(-1, 3)
+    ends = np.ascontiguousarray(ends, dtype=np.double).reshape(-1, 3)
+    nParts = starts.shape[0]
 
-    lib.solve.restype = None
+    parameters = WAKE_GRID_PARAMETERS((ctypes.c_double * 3)(*direction), ds, nWake, length, accommodation)
+    parts = (WAKE_MESH_PART * nParts)()
 
-    lib.solve(input, vel_x_v, vel_y_v, vel_z_v, transpiration_v, sigma_v, doublet_v, forces)
+    if lib.getWakeMeshParts(vertices.shape[0], faces.shape[0], np.ascontiguousarray(vertices, dtype=np.double).reshape(-1), np.ascontiguousarray(faces, dtype=np.int32).reshape(-1), nParts, starts.reshape(-1), ends.reshape(-1), parameters, parts) == 0:
+        raise ValueError('Wake grid could not be built, see the message above')
 
-    print('Forces: {}'.format(forces))
+    out = []
 
-    cp_v = 1 - (vel_x_v * vel_x_v + vel_y_v * vel_y_v + vel_z_v * vel_z_v) / (freestream[0] ** 2 + freestream[1] ** 2 + freestream[2] ** 2)
+    for part in parts:
+        out.append((
+            np.ctypeslib.as_array(part.grid, shape=(part.nSpan, part.nWake)).copy(),
+            np.ctypeslib.as_array(part.vertices, shape=(part.nSpan * part.nWake, 3)).copy(),
+            np.ctypeslib.as_array(part.faces, shape=(part.nSpan - 1, 2)).copy(),
+        ))
+        lib.freeWakeMeshPart(part)
 
-    return [
-        cp_v,
-        vel_x_v,
-        vel_y_v,
-        vel_z_v,
-        transpiration_v,
-        sigma_v,
-        doublet_v,
-    ]
\ No newline at end of file
+    return out
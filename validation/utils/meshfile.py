@@ -0,0 +1,109 @@
+"""
+Binary mesh container, read natively by utils/bin/modules/helpers/meshFile.h.
+
+Layout (little endian):
+    header    64 bytes: magic, version, byte order mark, number of sections,
+              file size, offset of the first section and CRC-32 of the data
+    table     64 bytes per section: name, type, rank, shape, offset, size
+    sections  C ordered arrays aligned to 64 bytes
+"""
+import struct
+import zlib
+import numpy as np
+
+from utils.mesh import MeshData
+
+MAGIC = b'PBMESH\x00\x00'
+VERSION = 1
+BYTE_ORDER = 0x01020304
+ALIGNMENT = 64
+
+HEADER = struct.Struct('<8sIIIIQQII16x')
+SECTION = struct.Struct('<24sII2QQQ')
+
+TYPES = {1: np.dtype('<i4'), 2: np.dtype('<f8')}
+
+# MeshData field: section type
+FIELDS = {
+    'vertices': 2,
+    'edges': 1,
+    'faces': 1,
+    'facesCenter': 2,
+    'e1': 2,
+    'e2': 2,
+    'e3': 2,
+    'controlPoints': 2,
+    'facesAreas': 2,
+    'facesMaxDistance': 2,
+    'p1Local': 2,
+    'p2Local': 2,
+    'p3Local': 2,
+    'wake_vertices': 2,
+    'wake_grid': 1,
+    'wake_faces': 1,
+}
+
+def _align(offset: int) -> int:
+    return (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+def write_mesh_file(file: str, mesh: MeshData) -> None:
+    """Writes the mesh fields that are set; the wake is optional"""
+
+    arrays = []
+    for name, type in FIELDS.items():
+        value = getattr(mesh, name)
+        if value is None:
+            continue
+        arrays.append((name, type, np.ascontiguousarray(value, dtype=TYPES[type])))
+
+    # Layout
+    dataOffset = HEADER.size + SECTION.size * len(arrays)
+    offset = dataOffset
+    table = []
+
+    for name, type, array in arrays:
+        offset = _align(offset)
+        shape = array.shape if array.ndim == 2 else (array.shape[0], 1)
+        table.append(SECTION.pack(name.encode(), type, array.ndim, shape[0], shape[1], offset, array.nbytes))
+        offset = offset + array.nbytes
+
+    fileBytes = offset
+
+    # Data
+    data = bytearray(fileBytes - dataOffset)
+    for (name, type, array), entry in zip(arrays, table):
+        start = SECTION.unpack(entry)[5] - dataOffset
+        data[start:start + array.nbytes] = array.tobytes()
+
+    header = HEADER.pack(MAGIC, VERSION, BYTE_ORDER, len(arrays), 0, fileBytes, dataOffset, zlib.crc32(data), 0)
+
+    with open(file, 'wb') as f:
+        f.write(header)
+        f.write(b''.join(table))
+        f.write(data)
+
+    return
+
+def read_mesh_file(file: str, check: bool = True) -> MeshData:
+    """
+    The arrays are read only views of a memory map of the file, so nothing
+    is copied until they are used. check verifies the checksum first.
+    """
+
+    buffer = np.memmap(file, dtype=np.uint8, mode='r')
+
+    magic, version, byteOrder, nSections, _, fileBytes, dataOffset, checksum, _ = HEADER.unpack_from(buffer, 0)
+
+    if magic != MAGIC or version != VERSION or byteOrder != BYTE_ORDER or fileBytes != buffer.size:
+        raise ValueError('{} is not a version {} mesh file'.format(file, VERSION))
+
+    if check and zlib.crc32(buffer[dataOffset:]) != checksum:
+        raise ValueError('Checksum mismatch in the mesh file {}'.format(file))
+
+    fields = {}
+    for k in range(nSections):
+        name, type, ndim, rows, cols, offset, nbytes = SECTION.unpack_from(buffer, HEADER.size + k * SECTION.size)
+        shape = (rows, cols) if ndim == 2 else (rows,)
+        fields[name.rstrip(b'\x00').decode()] = np.ndarray(shape, dtype=TYPES[type], buffer=buffer, offset=offset)
+
+    return MeshData(**{name: fields.get(name) for name in FIELDS})
@@ -13,12 +13,43 @@ class SolverData(NamedTuple):
     doublet_v: np.ndarray
     transpiration_v: np.ndarray
 
+def mesh_args(mesh: MeshData) -> list:
+    """
+    Mesh arguments of the wrapper, with the wake as the tail part. The
+    panel geometry is left to the solver, which derives it natively.
+    """
+
+    return [
+        mesh.vertices,
+        mesh.faces,
+        None,
+        None,
+        None,
+        None,
+        np.zeros((0, 2), dtype=np.int32),
+        np.zeros((0, 3), dtype=np.double),
+        np.zeros((0, 2), dtype=np.int32),
+        np.zeros((0, 2), dtype=np.int32),
+        np.zeros((0, 3), dtype=np.double),
+        np.zeros((0, 2), dtype=np.int32),
+        mesh.wake_grid,
+        mesh.wake_vertices,
+        mesh.wake_faces,
+        None, None, None,
+        None, None, None,
+    ]
+
 def solve(mesh: MeshData,
           freestream: float,
           alpha: float,
           density: float,
           viscosity: float,
-          soundSpeed: float) -> None:
+          soundSpeed: float,
+          cacheDirectory: str = None) -> None:
+    """
+    cacheDirectory keeps the assembled influence matrices on disk, so
+    repeated runs on the same mesh skip the assembly.
+    """
 
     # Freestream vector
     x = np.array([-1.0, 0.0, 0.0])
@@ -31,24 +62,9 @@ def solve(mesh: MeshData,
     freestream = freestream * x
 
     sol = wrapper(
-        mesh.vertices,
-        mesh.faces,
-        mesh.facesAreas,
-        mesh.facesMaxDistance,
-        mesh.facesCenter,
-        mesh.controlPoints,
-        np.zeros((2, 2), dtype=np.int32),
-        np.zeros((2, 2), dtype=np.double),
-        np.zeros((2, 2), dtype=np.int32),
-        np.zeros((3, 3), dtype=np.int32),
-        np.zeros((3, 3), dtype=np.double),
-        np.zeros((3, 3), dtype=np.int32),
-        mesh.wake_grid,
-        mesh.wake_vertices,
-        mesh.wake_faces,
-        mesh.p1Local, mesh.p2Local, mesh.p3Local,
-        mesh.e1, mesh.e2, mesh.e3,
-        freestream, density, viscosity, soundSpeed)
+        *mesh_args(mesh),
+        freestream, density, viscosity, soundSpeed,
+        cacheDirectory=cacheDirectory)
     
     out = SolverData(
         cp_v=sol[0],